@@ -13,6 +13,8 @@
 //
 //=============================================================================
 
+#include <stdio.h>
+
 #include "tier0/dbg.h"
 #include "tier0/icommandline.h"
 #include "datamodel/idatamodel.h"
@@ -20,6 +22,9 @@
 #include "appframework/AppFramework.h"
 #include "dmserializers/idmserializers.h"
 #include "tier1/utlstring.h"
+#include "tier1/utlvector.h"
+#include "tier1/strtools.h"
+#include "tier1/batchworkers.h"
 #include "datamodel/dmelement.h"
 #include "tier2/tier2.h"
 
@@ -75,50 +80,29 @@ void CDmxConvertApp::PostShutdown()
 
 
 //-----------------------------------------------------------------------------
-// The application object
+// Converts one file. Single file conversions stop at the first error, batch
+// conversions report it and move on to the next file.
 //-----------------------------------------------------------------------------
-int CDmxConvertApp::Main()
+static void ConversionError( bool bFatal, const char *pMsgFormat, const char *pFileName )
 {
-    MathLib_Init(2.2f, 2.2f, 0.0f, 2.0f, false, false, false, false);
-	g_pDataModel->OnlyCreateUntypedElements( true );
-	g_pDataModel->SetDefaultElementFactory(nullptr );
-
-	// This bit of hackery allows us to access files on the harddrive
-	g_pFullFileSystem->AddSearchPath( "", "LOCAL", PATH_ADD_TO_HEAD ); 
-
-	const char *pInFileName = CommandLine()->ParmValue("-i" );
-	const char *pOutFileName = CommandLine()->ParmValue("-o" );
-	const char *pInFormat = CommandLine()->ParmValue("-if" );
-	const char *pOutFormat = CommandLine()->ParmValue("-of" );
-	const char *pOutEncoding = CommandLine()->ParmValue("-oe" );
-
-	if ( !pInFileName )
+	if ( bFatal )
 	{
-		Msg( "Usage: dmxconvert -i <in file> [-if <in format_hint>] [-o <out file>] [-oe <out encoding>] [-of <out format>]\n" );
-		Msg( "If no output file is specified, dmx to dmx conversion will overwrite the input\n" );
-		Msg( "Supported DMX file encodings:\n" );
-		for ( int i = 0; i < g_pDataModel->GetEncodingCount(); ++i )
-		{
-			Msg( "   %s\n", g_pDataModel->GetEncodingName( i ) );
-		}
-
-		Msg( "Supported DMX file formats:\n" );
-		for ( int i = 0; i < g_pDataModel->GetFormatCount(); ++i )
-		{
-			Msg( "   %s\n", g_pDataModel->GetFormatName( i ) );
-		}
-
-		return -1;
+		Error( pMsgFormat, pFileName );
 	}
+	Warning( pMsgFormat, pFileName );
+}
 
+static bool ConvertFile( const char *pInFileName, const char *pOutFileName, const char *pInFormat,
+	const char *pOutFormat, const char *pOutEncoding, bool bFatal )
+{
 	// When reading, keep the CRLF; this will make ReadFile read it in binary format
 	// and also append a couple 0s to the end of the buffer.
 	DmxHeader_t header;
 	CDmElement *pRoot;
 	if ( g_pDataModel->RestoreFromFile( pInFileName, nullptr, pInFormat, &pRoot, CR_DELETE_NEW, &header ) == DMFILEID_INVALID )
 	{
-		Error( "Encountered an error reading file \"%s\"!\n", pInFileName );
-		return -1;
+		ConversionError( bFatal, "Encountered an error reading file \"%s\"!\n", pInFileName );
+		return false;
 	}
 
 	if ( !pOutFormat )
@@ -149,16 +133,314 @@ int CDmxConvertApp::Main()
 	// TODO - in theory, at some point, we may have converters from pInFormat to pOutFormat
 	//		  until then, treat it as a noop, and hope for the best
 
-	if ( !g_pDataModel->SaveToFile( pOutFileName, nullptr, pOutEncoding, pOutFormat, pRoot ) )
+	bool bSaved = g_pDataModel->SaveToFile( pOutFileName, nullptr, pOutEncoding, pOutFormat, pRoot );
+	g_pDataModel->RemoveFileId( pRoot->GetFileId() );
+	if ( !bSaved )
+	{
+		ConversionError( bFatal, "Encountered an error writing file \"%s\"!\n", pOutFileName );
+		return false;
+	}
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Batch conversion
+//
+// The datamodel is a single global with no locking, and elements reach it
+// through g_pDataModel, so files can't be converted on several threads of one
+// process. The batch is split between worker processes instead (see
+// batchworkers.h), each converting its share with its own datamodel. A
+// worker is just dmxconvert run on a list file with -workers 1.
+//-----------------------------------------------------------------------------
+struct ConvertJob_t
+{
+	CUtlString m_InFileName;
+	CUtlString m_OutFileName;
+	int64 m_nSize;
+	int m_nIndex;		// position in the list, which is what -donefile records
+	bool m_bDone;
+};
+
+static void AddJob( CUtlVector< ConvertJob_t > &jobs, const char *pInFileName, const char *pOutFileName )
+{
+	ConvertJob_t &job = jobs[ jobs.AddToTail() ];
+	job.m_InFileName = pInFileName;
+	job.m_OutFileName = ( pOutFileName && *pOutFileName ) ? pOutFileName : pInFileName;
+	job.m_nSize = 0;
+	job.m_nIndex = jobs.Count() - 1;
+	job.m_bDone = false;
+}
+
+// One job per line: the input file, optionally followed by a tab and the output file
+static void ReadJobList( FILE *fp, CUtlVector< ConvertJob_t > &jobs )
+{
+	char pLine[ 2 * MAX_PATH ];
+	while ( fgets( pLine, sizeof( pLine ), fp ) )
+	{
+		int nLen = V_strlen( pLine );
+		while ( nLen > 0 && ( pLine[ nLen - 1 ] == '\n' || pLine[ nLen - 1 ] == '\r' ) )
+		{
+			pLine[ --nLen ] = 0;
+		}
+		if ( nLen == 0 )
+			continue;
+
+		char *pOut = strchr( pLine, '\t' );
+		if ( pOut )
+		{
+			*pOut++ = 0;
+		}
+		AddJob( jobs, pLine, pOut );
+	}
+}
+
+static bool GatherJobs( CUtlVector< ConvertJob_t > &jobs )
+{
+	const char *pListFileName = CommandLine()->ParmValue( "-list" );
+	if ( pListFileName )
+	{
+		FILE *fp = fopen( pListFileName, "rt" );
+		if ( !fp )
+		{
+			Warning( "Unable to open list file \"%s\"!\n", pListFileName );
+			return false;
+		}
+		ReadJobList( fp, jobs );
+		fclose( fp );
+	}
+
+	if ( CommandLine()->FindParm( "-stdin" ) )
+	{
+		ReadJobList( stdin, jobs );
+	}
+
+	const char *pWildCard = CommandLine()->ParmValue( "-glob" );
+	if ( pWildCard )
+	{
+		const char *pOutDir = CommandLine()->ParmValue( "-odir" );
+
+		char pInDir[ MAX_PATH ];
+		if ( !V_ExtractFilePath( pWildCard, pInDir, sizeof( pInDir ) ) )
+		{
+			pInDir[ 0 ] = 0;
+		}
+
+		FileFindHandle_t hFind;
+		for ( const char *pFound = g_pFullFileSystem->FindFirstEx( pWildCard, "LOCAL", &hFind ); pFound; pFound = g_pFullFileSystem->FindNext( hFind ) )
+		{
+			if ( g_pFullFileSystem->FindIsDirectory( hFind ) )
+				continue;
+
+			char pInFileName[ MAX_PATH ];
+			char pOutFileName[ MAX_PATH ];
+			V_ComposeFileName( pInDir, pFound, pInFileName, sizeof( pInFileName ) );
+			if ( pOutDir )
+			{
+				V_ComposeFileName( pOutDir, pFound, pOutFileName, sizeof( pOutFileName ) );
+			}
+			else
+			{
+				pOutFileName[ 0 ] = 0;
+			}
+			AddJob( jobs, pInFileName, pOutFileName );
+		}
+		g_pFullFileSystem->FindClose( hFind );
+	}
+	return true;
+}
+
+// Converts the jobs in this process, printing a status line for each
+static void ConvertJobs( CUtlVector< ConvertJob_t > &jobs, const char *pInFormat, const char *pOutFormat,
+	const char *pOutEncoding )
+{
+	CBatchDoneFile doneFile;
+	for ( int i = 0; i < jobs.Count(); ++i )
+	{
+		ConvertJob_t &job = jobs[ i ];
+		double flStartTime = Plat_FloatTime();
+		doneFile.MarkStarted( job.m_nIndex );
+		job.m_bDone = ConvertFile( job.m_InFileName.Get(), job.m_OutFileName.Get(), pInFormat, pOutFormat, pOutEncoding, false );
+		if ( job.m_bDone )
+		{
+			Msg( "ok      %s -> %s (%.2fs)\n", job.m_InFileName.Get(), job.m_OutFileName.Get(), Plat_FloatTime() - flStartTime );
+			doneFile.MarkDone( job.m_nIndex );
+		}
+		else
+		{
+			Msg( "failed  %s\n", job.m_InFileName.Get() );
+		}
+		fflush( stdout );
+	}
+}
+
+// Hands the jobs to nWorkerCount copies of dmxconvert
+static void RunWorkers( CUtlVector< ConvertJob_t > &jobs, int nWorkerCount, const char *pInFormat,
+	const char *pOutFormat, const char *pOutEncoding )
+{
+	CUtlVector< BatchJob_t > batch;
+	for ( int i = 0; i < jobs.Count(); ++i )
+	{
+		BatchJob_t &batchJob = batch[ batch.AddToTail() ];
+		batchJob.m_Line.Format( "%s\t%s", jobs[ i ].m_InFileName.Get(), jobs[ i ].m_OutFileName.Get() );
+		batchJob.m_nSize = jobs[ i ].m_nSize;
+		batchJob.m_bDone = false;
+	}
+
+	CUtlVector< CUtlString > args;
+	args.AddToTail( "-workers" );
+	args.AddToTail( "1" );
+	args.AddToTail( "-force" );
+	if ( pInFormat )
+	{
+		args.AddToTail( "-if" );
+		args.AddToTail( pInFormat );
+	}
+	if ( pOutFormat )
+	{
+		args.AddToTail( "-of" );
+		args.AddToTail( pOutFormat );
+	}
+	if ( pOutEncoding )
+	{
+		args.AddToTail( "-oe" );
+		args.AddToTail( pOutEncoding );
+	}
+	args.AddToTail( "-list" );	// the worker's list file goes last
+
+	if ( !Batch_RunWorkers( batch, nWorkerCount, args ) )
 	{
-		Error( "Encountered an error writing file \"%s\"!\n", pOutFileName );
+		ConvertJobs( jobs, pInFormat, pOutFormat, pOutEncoding );
+		return;
+	}
+
+	for ( int i = 0; i < jobs.Count(); ++i )
+	{
+		jobs[ i ].m_bDone = batch[ i ].m_bDone;
+	}
+}
+
+static int ConvertBatch( const char *pInFormat, const char *pOutFormat, const char *pOutEncoding )
+{
+	double flStartTime = Plat_FloatTime();
+
+	CUtlVector< ConvertJob_t > jobs;
+	if ( !GatherJobs( jobs ) )
 		return -1;
+
+	// Skip outputs newer than their inputs, unless asked not to
+	bool bForce = CommandLine()->FindParm( "-force" ) != 0;
+	int nUpToDate = 0;
+	int nMissing = 0;
+	for ( int i = jobs.Count(); --i >= 0; )
+	{
+		ConvertJob_t &job = jobs[ i ];
+		int64 nInTime, nOutSize, nOutTime;
+		if ( !Batch_GetFileInfo( job.m_InFileName.Get(), job.m_nSize, nInTime ) )
+		{
+			Msg( "missing %s\n", job.m_InFileName.Get() );
+			jobs.Remove( i );
+			++nMissing;
+			continue;
+		}
+		if ( !bForce && V_strcmp( job.m_InFileName.Get(), job.m_OutFileName.Get() ) &&
+			Batch_GetFileInfo( job.m_OutFileName.Get(), nOutSize, nOutTime ) && nOutTime >= nInTime )
+		{
+			jobs.Remove( i );
+			++nUpToDate;
+		}
 	}
 
-	g_pDataModel->RemoveFileId( pRoot->GetFileId() );
+	int nWorkerCount = Batch_GetWorkerCount( jobs.Count() );
+	if ( nWorkerCount == 1 )
+	{
+		ConvertJobs( jobs, pInFormat, pOutFormat, pOutEncoding );
+	}
+	else
+	{
+		RunWorkers( jobs, nWorkerCount, pInFormat, pOutFormat, pOutEncoding );
+	}
 
-	return 0;
+	// Workers report their own files, the parent just sums them up
+	if ( CommandLine()->FindParm( "-donefile" ) )
+		return 0;
+
+	int nConverted = 0;
+	int64 nConvertedBytes = 0;
+	for ( int i = 0; i < jobs.Count(); ++i )
+	{
+		if ( jobs[ i ].m_bDone )
+		{
+			++nConverted;
+			nConvertedBytes += jobs[ i ].m_nSize;
+		}
+		else if ( nWorkerCount > 1 )
+		{
+			Warning( "Failed to convert \"%s\"\n", jobs[ i ].m_InFileName.Get() );
+		}
+	}
+
+	double flTime = MAX( Plat_FloatTime() - flStartTime, 0.001 );
+	int nFailed = jobs.Count() - nConverted + nMissing;
+	Msg( "%d converted, %d failed, %d up to date in %.2fs with %d worker%s (%.1f files/s, %.2f MB/s)\n",
+		nConverted, nFailed, nUpToDate, flTime, nWorkerCount, nWorkerCount == 1 ? "" : "s",
+		nConverted / flTime, nConvertedBytes / ( 1024.0 * 1024.0 ) / flTime );
+
+	return nFailed ? -1 : 0;
 }
 
 
+//-----------------------------------------------------------------------------
+// The application object
+//-----------------------------------------------------------------------------
+int CDmxConvertApp::Main()
+{
+    MathLib_Init(2.2f, 2.2f, 0.0f, 2.0f, false, false, false, false);
+	g_pDataModel->OnlyCreateUntypedElements( true );
+	g_pDataModel->SetDefaultElementFactory(nullptr );
+
+	// This bit of hackery allows us to access files on the harddrive
+	g_pFullFileSystem->AddSearchPath( "", "LOCAL", PATH_ADD_TO_HEAD ); 
+
+	const char *pInFileName = CommandLine()->ParmValue("-i" );
+	const char *pOutFileName = CommandLine()->ParmValue("-o" );
+	const char *pInFormat = CommandLine()->ParmValue("-if" );
+	const char *pOutFormat = CommandLine()->ParmValue("-of" );
+	const char *pOutEncoding = CommandLine()->ParmValue("-oe" );
+
+	if ( !pInFileName && ( CommandLine()->FindParm( "-list" ) || CommandLine()->FindParm( "-stdin" ) || CommandLine()->FindParm( "-glob" ) ) )
+	{
+		return ConvertBatch( pInFormat, pOutFormat, pOutEncoding );
+	}
+
+	if ( !pInFileName )
+	{
+		Msg( "Usage: dmxconvert -i <in file> [-if <in format_hint>] [-o <out file>] [-oe <out encoding>] [-of <out format>]\n" );
+		Msg( "If no output file is specified, dmx to dmx conversion will overwrite the input\n" );
+		Msg( "\n" );
+		Msg( "Batch usage: dmxconvert [-list <list file>] [-stdin] [-glob <wildcard> [-odir <out dir>]]\n" );
+		Msg( "                        [-workers <count>] [-force] [-if ...] [-oe ...] [-of ...]\n" );
+		Msg( "List files and stdin have one \"<in file>[<tab><out file>]\" per line\n" );
+		Msg( "Files are converted by -workers processes at once (default: one per CPU)\n" );
+		Msg( "Outputs newer than their input are skipped unless -force is given\n" );
+		Msg( "\n" );
+		Msg( "Supported DMX file encodings:\n" );
+		for ( int i = 0; i < g_pDataModel->GetEncodingCount(); ++i )
+		{
+			Msg( "   %s\n", g_pDataModel->GetEncodingName( i ) );
+		}
+
+		Msg( "Supported DMX file formats:\n" );
+		for ( int i = 0; i < g_pDataModel->GetFormatCount(); ++i )
+		{
+			Msg( "   %s\n", g_pDataModel->GetFormatName( i ) );
+		}
+
+		return -1;
+	}
+
+	if ( !ConvertFile( pInFileName, pOutFileName, pInFormat, pOutFormat, pOutEncoding, true ) )
+		return -1;
 
+	return 0;
+}
@@ -130,6 +130,16 @@ void CmdLib_Cleanup();
 unsigned short SetConsoleTextColor( int red, int green, int blue, int intensity );
 void RestoreConsoleTextColor( unsigned short color );
 
+// False when stdout goes to a pipe or file. Colors are skipped and stdout is fully buffered then.
+bool CmdLib_IsStdoutConsole();
+
+// Identical warnings are only echoed the first time. Returns true (and counts it)
+// if pMessage was already seen, in which case the caller shouldn't print it.
+bool CmdLib_IsRepeatedWarning( const char *pMessage );
+
+// Lists the warnings collapsed by CmdLib_IsRepeatedWarning with their counts.
+void CmdLib_PrintRepeatedWarningSummary();
+
 class CCmdLibStandardLoggingListener : public ILoggingListener
 {
 public:
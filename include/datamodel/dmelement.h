@@ -730,7 +730,9 @@ inline CUtlSymbolLarge CDmElement::GetStaticTypeSymbol()
 
 inline bool CDmElement::IsA( const char *pTypeName ) const
 {												
-	CUtlSymbolLarge typeSymbol = g_pDataModel->GetSymbol( pTypeName ); 
+	CUtlSymbolLarge typeSymbol = g_pDataModel->FindSymbol( pTypeName ); 
+	if ( pTypeName && !typeSymbol.IsValid() )
+		return false;
 	return IsA( typeSymbol );				
 }
 
@@ -1130,7 +1132,9 @@ void CopyElements( const CUtlVector< T* > &from, CUtlVector< T* > &to, Traversal
 													\
 		bool IsA( const char *pTypeName ) const		\
 		{											\
-			CUtlSymbolLarge typeSymbol = g_pDataModel->GetSymbol( pTypeName ); \
+			CUtlSymbolLarge typeSymbol = g_pDataModel->FindSymbol( pTypeName ); \
+			if ( pTypeName && !typeSymbol.IsValid() )	\
+				return false;						\
 			return IsA( typeSymbol );				\
 		}											\
 													\
@@ -410,6 +410,9 @@ public:
 
 	// Global symbol table for the datamodel system
 	virtual CUtlSymbolLarge		GetSymbol( const char *pString ) = 0;
+	// Same, but never adds the string; returns UTL_INVAL_SYMBOL_LARGE if it isn't in the table.
+	// Use this for pure lookups so queries for missing names don't grow the table.
+	virtual CUtlSymbolLarge		FindSymbol( const char *pString ) = 0;
 	// Once you have a CUtlSymbolLarge, don't need an external API to get the char *, just use the String() method.
 
 	// Returns the total number of elements allocated at the moment
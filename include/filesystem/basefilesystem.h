@@ -76,8 +76,10 @@
 #include "tier1/utlvector.h"
 #include "tier1/UtlStringMap.h"
 #include <cstdarg>
+#include <mutex>
 #include "tier1/utlrbtree.h"
 #include "tier1/utlsymbol.h"
+#include "tier1/utlhashtable.h"
 #include "tier1/utllinkedlist.h"
 #include "tier1/utlstring.h"
 #include "tier1/utlsortvector.h"
@@ -203,6 +205,12 @@ public:
 
     bool EndOfFile();
 
+    // Read-ahead for line reads. Returns the buffered bytes not handed out yet,
+    // refilling the buffer from the file once they've all been consumed.
+    const char *ReadAhead(int &nAvailable);
+
+    void ConsumeReadAhead(int nBytes) { m_nReadAheadPos += nBytes; }
+
     char *m_pszTrueFileName;
 
     char const *Name() const { return m_pszTrueFileName ? m_pszTrueFileName : ""; }
@@ -230,7 +238,21 @@ protected:
     };
     unsigned int m_nMagic;
 
+    enum {
+        READ_AHEAD_SIZE = 64 * 1024
+    };
+
+    // The FILE sits past the buffered bytes; anything other than a read
+    // moves it back to the logical position and drops the buffer first
+    char *m_pReadAhead;
+    int m_nReadAheadPos;
+    int m_nReadAheadEnd;
+    long m_nReadAheadBase;    // FILE position of the first buffered byte
+    bool m_bReadAheadExact;    // false if text mode translation changed the byte count
+
     bool IsValid();
+
+    void SyncReadAhead();
 };
 
 
@@ -736,38 +758,26 @@ protected:
 
 protected:
     //-----------------------------------------------------------------------------
-    // Purpose: For tracking unclosed files
-    // NOTE:  The symbol table could take up memory that we don't want to eat here.
-    // In that case, we shouldn't store them in a table, or we should store them as locally allocates stings
-    //  so we can control the size
+    // Purpose: For tracking unclosed files, keyed by FILE*. Names are interned in
+    // m_OpenedFileNames, so an open file costs a hash entry rather than a string.
+    // The counters are only kept while access tracing is on.
     //-----------------------------------------------------------------------------
-    class COpenedFile {
-    public:
-        COpenedFile(void);
-
-        ~COpenedFile(void);
-
-        COpenedFile(const COpenedFile &src);
-
-        bool operator==(const COpenedFile &src) const;
-
-        void SetName(char const *name);
-
-        char const *GetName(void);
-
-        FILE *m_pFile;
-        char *m_pName;
+    struct COpenedFile {
+        FileNameHandle_t m_hName;
+        int m_nReads;
+        int m_nWrites;
+        int64 m_nBytesRead;
+        int64 m_nBytesWritten;
     };
 
-    //CUtlRBTree< COpenedFile, int > m_OpenedFiles;
-    CUtlVector<COpenedFile> m_OpenedFiles;
+    CUtlHashtable<FILE *, COpenedFile, PointerHashFunctor, PointerEqualFunctor> m_OpenedFiles;
+    CUtlFilenameSymbolTable m_OpenedFileNames;
+    std::mutex m_OpenedFilesMutex;
     CUtlStringMap<bool> m_NonexistingFilesExtensions;
 #ifdef NONEXISTING_FILES_CACHE_SUPPORT
     CUtlStringMap< double >		m_NonexistingFilesCache;
 #endif
 
-    static bool OpenedFileLessFunc(COpenedFile const &src1, COpenedFile const &src2);
-
     FileWarningLevel_t m_fwLevel;
 
     void (*m_pfnWarning)(const char *fmt, ...);
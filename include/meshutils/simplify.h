@@ -26,6 +26,7 @@ struct mesh_simplifyparams_t
 		m_nMaxVertexCount = INT_MAX;
 		m_flOpenEdgePenalty = 2.0f;
 		m_flIntegrationPenalty = 1.0f;
+		m_nPartitionCount = 0;
 	}
 	inline void SimplifyToVertexCount( int nMaxVertices )
 	{
@@ -50,6 +51,10 @@ struct mesh_simplifyparams_t
 	float m_flIntegrationPenalty;	// scale error each time edges are collapsed and their error functions are summed
 	int m_nMaxVertexCount;			// don't allow more than this many vertices in the output model
 	int m_nMaxTriangleCount;		// don't allow more than this many triangles in the output model
+
+	// If > 1, large meshes are split into this many spatial clusters which are simplified concurrently
+	// with their shared vertices locked, then the whole mesh gets a final pass to reach the limits above
+	int m_nPartitionCount;
 };
 
 struct mesh_simplifyweights_t
@@ -63,6 +68,8 @@ struct mesh_simplifyweights_t
 	float	*m_pVertexWeights;
 	int		m_nVertexCount;
 };
-void SimplifyMesh( CMesh &meshOut, const CMesh &input, const mesh_simplifyparams_t &params, const mesh_simplifyweights_t *pWeights = NULL );
+// If pSourceVertexOut is supplied it receives, for each output vertex, the index of the input vertex it was collapsed into.
+// Use it to carry over per-vertex data that can't be interpolated (bone indices, material ids, etc.)
+void SimplifyMesh( CMesh &meshOut, const CMesh &input, const mesh_simplifyparams_t &params, const mesh_simplifyweights_t *pWeights = NULL, CUtlVector<int> *pSourceVertexOut = NULL );
 
 #endif // SIMPLIFY_H
\ No newline at end of file
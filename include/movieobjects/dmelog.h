@@ -608,6 +608,10 @@ public:
 
 	const T& GetValue( DmeTime_t time ) const;
 
+	// Evaluates the layer at nCount times in increasing order in a single pass
+	// over the keys; the results match calling GetValue for each time
+	void GetValues( const DmeTime_t *pTimes, int nCount, T *pValues ) const;
+
 	const T& GetKeyValue( int nKeyIndex ) const;
 	const T& GetValueSkippingKey( int nKeyToSkip ) const;
 
@@ -737,6 +741,9 @@ public:
 	bool ValuesDiffer( const T& a, const T& b ) const;
 	const T& GetValue( DmeTime_t time ) const;
 	const T& GetValueSkippingTopmostLayer( DmeTime_t time ) const;
+
+	// Evaluates the log at nCount times in increasing order, see CDmeTypedLogLayer::GetValues
+	void GetValues( const DmeTime_t *pTimes, int nCount, T *pValues ) const;
 	const T& GetValueBelowLayer( DmeTime_t time, int nTopLayerIndex ) const;
 
 	const T& GetKeyValue( int nKeyIndex ) const;
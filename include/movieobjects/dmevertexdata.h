@@ -32,6 +32,27 @@ class Color;
 typedef int FieldIndex_t;
 
 
+//-----------------------------------------------------------------------------
+// Read-only view of the vertex indices which refer to a single data index.
+// Points into the vertex data's inverse map, so it's only valid until the
+// field's index data next changes
+//-----------------------------------------------------------------------------
+class CVertexIndexSpan
+{
+public:
+	CVertexIndexSpan() : m_pIndices( NULL ), m_nCount( 0 ) {}
+	CVertexIndexSpan( const int *pIndices, int nCount ) : m_pIndices( pIndices ), m_nCount( nCount ) {}
+
+	int Count() const { return m_nCount; }
+	const int *Base() const { return m_pIndices; }
+	const int &operator[]( int i ) const { Assert( i >= 0 && i < m_nCount ); return m_pIndices[i]; }
+
+private:
+	const int *m_pIndices;
+	int m_nCount;
+};
+
+
 class CDmeVertexDataBase : public CDmElement
 {
 	DEFINE_ELEMENT( CDmeVertexDataBase, CDmElement );
@@ -148,8 +169,8 @@ public:
 	void FlipVCoordinate( bool bFlip );
 
 	// Returns an inverse map from vertex data index to vertex index
-	const CUtlVector< int > &FindVertexIndicesFromDataIndex( FieldIndex_t nFieldIndex, int nDataIndex );
-	const CUtlVector< int > &FindVertexIndicesFromDataIndex( StandardFields_t nFieldIndex, int nDataIndex );
+	CVertexIndexSpan FindVertexIndicesFromDataIndex( FieldIndex_t nFieldIndex, int nDataIndex );
+	CVertexIndexSpan FindVertexIndicesFromDataIndex( StandardFields_t nFieldIndex, int nDataIndex );
 
 	int FieldCount() const;
 
@@ -169,7 +190,10 @@ protected:
 		CUtlString m_Name;
 		CDmAttribute *m_pVertexData;
 		CDmAttribute* m_pIndexData;
-		CUtlVector< CUtlVector< int > > m_InverseMap;
+		// Inverse map in compressed sparse row form: the vertices using data index i
+		// are m_InverseMapIndices[ m_InverseMapOffsets[i] ... m_InverseMapOffsets[i+1] )
+		CUtlVector< int > m_InverseMapOffsets;
+		CUtlVector< int > m_InverseMapIndices;
 		bool m_bInverseMapDirty;
 	};
 
@@ -16,11 +16,11 @@
 #include "mathlib/mathlib.h"
 #include "tier1/utlvector.h"
 #include "tier1/utllinkedlist.h"
+#include "movieobjects/dmevertexdata.h"
 
 
 // Forward declarations
 class CDmeMesh;
-class CDmeVertexData;
 
 
 //=============================================================================
@@ -40,7 +40,7 @@ public:
 	class CVert
 	{
 	public:
-		CVert( int nPositionIndex, const CUtlVector< int > *pVertexIndices, const Vector *pPosition );
+		CVert( int nPositionIndex, CVertexIndexSpan vertexIndices, const Vector *pPosition );
 
 		CVert( const CVert &src );
 
@@ -48,7 +48,7 @@ public:
 
 		const Vector *Position() const;
 
-		const CUtlVector< int > *VertexIndices() const;
+		CVertexIndexSpan VertexIndices() const;
 
 		bool operator==( const CVert &rhs ) const;
 
@@ -56,7 +56,7 @@ public:
 		friend class CDmMeshComp;
 
 		int m_positionIndex;						// Index in the position data
-		const CUtlVector< int > *m_pVertexIndices;	// Pointer to a list of the vertex indices for this vertex
+		CVertexIndexSpan m_vertexIndices;			// The vertex indices for this vertex
 		const Vector *m_pPosition;
 		CUtlVector< CEdge * > m_edges;				// An array of pointers to the edges containing this vertex
 
@@ -89,6 +89,11 @@ void CalcBoneDerivatives( Vector &velocity, AngularImpulse &angVel, const matrix
 // Give a derivative of a bone, compute the velocity & angular velocity of that bone
 void CalcBoneVelocityFromDerivative( const QAngle &vecAngles, Vector &velocity, AngularImpulse &angVel, const matrix3x4_t &current );
 
+// Decode a single channel of RLE compressed animation data at a frame, as the
+// second value also returning the next frame's value for blending
+void ExtractAnimValue( int frame, mstudioanimvalue_t *panimvalue, float scale, float &v1, float &v2 );
+void ExtractAnimValue( int frame, mstudioanimvalue_t *panimvalue, float scale, float &v1 );
+
 // This function sets up the local transform for a single frame of animation. It doesn't handle
 // pose parameters or interpolation between frames.
 void SetupSingleBoneMatrix( 
@@ -0,0 +1,73 @@
+//===== Copyright © 1996-2008, Valve Corporation, All rights reserved. ======//
+//
+// Purpose: Memory-mapped line input and fast number scanning for the
+//          text source loaders (SMD, VTA, VRM, OBJ)
+//
+//===========================================================================//
+
+#ifndef LINEINPUT_H
+#define LINEINPUT_H
+
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include <cstddef>
+
+
+//-----------------------------------------------------------------------------
+// Read-only view of a whole text file, handed out one line at a time
+//-----------------------------------------------------------------------------
+class CLineInput {
+public:
+    CLineInput();
+    ~CLineInput();
+
+    bool Open(const char *pFileName);
+    void Close();
+    bool IsOpen() const { return m_pBase != nullptr; }
+
+    // Reads the next line exactly the way fgets on a file opened with "r" would:
+    // at most nMaxLen - 1 characters, the newline included if it fits.
+    // Returns false at the end of the file, leaving pDest untouched.
+    bool ReadLine(char *pDest, int nMaxLen);
+
+private:
+    CLineInput(const CLineInput &);
+    CLineInput &operator=(const CLineInput &);
+
+    bool ReadLineSlow(char *pDest, int nMaxLen);
+
+    const char *m_pBase;
+    const char *m_pCurr;
+    const char *m_pEnd;
+    size_t m_nMappedSize;
+    void *m_hFile;
+    void *m_hMapping;
+};
+
+
+//-----------------------------------------------------------------------------
+// Fast versions of the sscanf / atof / atoi calls made on source file lines.
+//
+// They only handle plain decimal numbers which convert with a single correctly
+// rounded operation, and return false for anything else (exponents out of range,
+// long mantissas, inf/nan, hex, odd delimiters...). In that case the caller must
+// fall back to the C runtime call, so results are always identical to it.
+// Outputs are only written when the call succeeds.
+//-----------------------------------------------------------------------------
+
+// sscanf( pLine, "%f %f ..." ) == nCount
+bool FastScanFloats(const char *pLine, float *pFloats, int nCount);
+
+// sscanf( pLine, "%d %f %f ..." ) == 1 + nCount
+bool FastScanIntAndFloats(const char *pLine, int &nValue, float *pFloats, int nCount);
+
+// (float)atof( pString )
+bool FastAtof(const char *pString, float &flValue);
+
+// atoi( pString )
+bool FastAtoi(const char *pString, int &nValue);
+
+
+#endif // LINEINPUT_H
@@ -0,0 +1,38 @@
+//===== Copyright © 1996-2008, Valve Corporation, All rights reserved. ======//
+//
+// Purpose: Build manifest for incremental model compiles
+//
+//===========================================================================//
+
+#ifndef MANIFEST_H
+#define MANIFEST_H
+
+#ifdef _WIN32
+#pragma once
+#endif
+
+
+//-----------------------------------------------------------------------------
+// The manifest sits next to the compiled .mdl and records everything the
+// compile depended on: each input file with its content hash, the command
+// line switches that affect the output, and a hash of the compiler itself.
+// It also records every file the compile wrote, and the compile is only
+// skipped if all of them are still as they were.
+//-----------------------------------------------------------------------------
+
+// Records a file read by the compile
+void Manifest_AddInput(const char *pFileName);
+
+// Records a file written by the compile
+void Manifest_AddOutput(const char *pFileName);
+
+// Returns true if the manifest for the model the script builds says the
+// outputs are current, so the compile can be skipped. Only looks at the
+// script's own $modelname; anything it can't resolve up front means no.
+bool Manifest_IsUpToDate(const char *pScriptPath);
+
+// Writes the manifest for the model just compiled from pScriptPath
+void Manifest_Write(const char *pScriptPath);
+
+
+#endif // MANIFEST_H
@@ -19,6 +19,7 @@
 #include <array>
 #include <cstdio>
 #include "tier0/basetypes.h"
+#include "tier0/memalloc.h"
 #include "tier1/utlvector.h"
 #include "tier1/utlsymbol.h"
 #include "tier1/utlstring.h"
@@ -26,6 +27,7 @@
 #include "studio.h"
 #include "datamodel/dmelementhandle.h"
 #include "worldsize.h"
+#include "studiomdl/lineinput.h"
 
 struct LodScriptData_t;
 struct s_flexkey_t;
@@ -393,6 +395,63 @@ struct s_bone_t {
     RadianEuler rot;
 };
 
+struct s_animation_t;
+
+//-----------------------------------------------------------------------------
+// Channel-major (SoA) copy of an animation's processed frames, for the passes
+// that walk one bone channel across all frames. Each bone has six channels
+// (pos x y z, rot x y z) and each channel holds all of its frames contiguously,
+// padded with the last frame to a multiple of four.
+//-----------------------------------------------------------------------------
+struct s_animchannels_t {
+    enum { NUM_CHANNELS = 6 };
+
+    void Build(const s_animation_t *panim, int nBones);
+    void Purge();
+
+    int FrameCount() const { return m_nFrames; }
+    int PaddedFrameCount() const { return m_nStride; }
+    const float *Channel(int nBone, int nChannel) const {
+        return m_Data.Base() + (nBone * NUM_CHANNELS + nChannel) * m_nStride;
+    }
+
+    int m_nFrames;
+    int m_nStride;
+    CUtlVector<float> m_Data;
+};
+
+//-----------------------------------------------------------------------------
+// Per-bone weights of an animation. Most animations use a $weightlist as is,
+// so this points at the weightlist's own array, and only takes a copy (sized
+// to the bones in use) when a weight is changed for this one animation.
+// All zero until Share() is called.
+//-----------------------------------------------------------------------------
+struct s_animweights_t {
+    float operator[](int nBone) const {
+        return m_pWeights ? m_pWeights[nBone] : 0.0f;
+    }
+
+    // Uses pWeights (a weightlist's array), or all zeros if NULL
+    void Share(const float *pWeights) {
+        m_Owned.Purge();
+        m_pWeights = pWeights;
+    }
+
+    void Set(int nBoneCount, int nBone, float flWeight) {
+        if (m_Owned.Count() == 0) {
+            m_Owned.SetCount(nBoneCount);
+            for (int i = 0; i < nBoneCount; i++) {
+                m_Owned[i] = (*this)[i];
+            }
+            m_pWeights = m_Owned.Base();
+        }
+        m_Owned[nBone] = flWeight;
+    }
+
+    const float *m_pWeights;
+    CUtlVector<float> m_Owned;
+};
+
 struct s_linearmove_t {
     int endframe;    // frame when pos, rot is valid.
     int flags;        // type of motion.  Only linear, linear accel, and linear decel is allowed
@@ -648,6 +707,8 @@ struct s_animation_t {
     int flags;
     // animations processed (time shifted, linearized, and bone adjusted ) from source animations
     CUtlVectorAuto<s_bone_t *> sanim; // [MAXSTUDIOANIMFRAMES]; // [frame][bones];
+    // the same frames in channel-major order, only valid while compressing
+    s_animchannels_t channels;
 
     int motiontype;
 
@@ -657,7 +718,7 @@ struct s_animation_t {
 
     // piecewise linear motion
     int numpiecewisekeys;
-    s_linearmove_t piecewisemove[MAXSTUDIOMOVEKEYS];
+    CUtlVectorAuto<s_linearmove_t> piecewisemove; // [MAXSTUDIOMOVEKEYS]
 
     // default adjustments
     Vector adjust;
@@ -678,18 +739,18 @@ struct s_animation_t {
     CUtlVectorAuto<CUtlVectorAuto<s_compressed_t> > anim;
 
     // int				weightlist;
-    float weight[MAXSTUDIOSRCBONES];
-    float posweight[MAXSTUDIOSRCBONES];
+    s_animweights_t weight;
+    s_animweights_t posweight;
 
     int numcmds;
-    s_animcmd_t cmds[MAXSTUDIOCMDS];
+    CUtlVectorAuto<s_animcmd_t> cmds; // [MAXSTUDIOCMDS]
 
     int numikrules;
-    s_ikrule_t ikrule[MAXSTUDIOIKRULES];
+    CUtlVectorAuto<s_ikrule_t> ikrule; // [MAXSTUDIOIKRULES]
     bool noAutoIK;
 
     int numlocalhierarchy;
-    s_localhierarchy_t localhierarchy[MAXSTUDIOIKRULES];
+    CUtlVectorAuto<s_localhierarchy_t> localhierarchy; // [MAXSTUDIOIKRULES]
 
     float motionrollback;
 
@@ -698,6 +759,13 @@ struct s_animation_t {
     int numNostallFrames;        // number of frames to keep in memory (modulo segement size)
 
     int rootDriverIndex;
+
+    // compression results, for the -animerror / -checklengths report
+    int numanimvalues;        // values written for all sections and bones
+    int numexactvalues;        // values a lossless encoding would have needed
+    float maxposerror;        // worst world space bone position error
+    float maxangerror;        // worst world space bone rotation error, in degrees
+    double decodetime;        // seconds spent decoding all frames with ExtractAnimValue
 };
 EXTERN    s_animation_t *g_panimation[MAXSTUDIOANIMS];
 
@@ -829,8 +897,8 @@ EXTERN int g_numanimblocks;
 struct s_animblock_t {
     int iStartAnim;
     int iEndAnim;
-    byte *start;
-    byte *end;
+    int start;  // offsets into the .ani file
+    int end;
 };
 EXTERN s_animblock_t g_animblock[MAXSTUDIOANIMBLOCKS];
 EXTERN int g_animblocksize;
@@ -1496,8 +1564,18 @@ struct s_bonesaveframe_t {
 
 EXTERN CUtlVector<s_bonesaveframe_t> g_bonesaveframe;
 
+// calloc through the tier0 allocator, for the source, mesh and animation data
+// -memstats should count. Release with MemAlloc_Free.
+inline void *MdlCalloc(size_t nCount, size_t nSize) {
+    void *pMem = MemAlloc_Alloc(nCount * nSize);
+    memset(pMem, 0, nCount * nSize);
+    return pMem;
+}
+
 int OpenGlobalFile(char *src);
 
+void CloseGlobalFile();
+
 bool GetGlobalFilePath(const char *pSrc, char *pFullPath, int nMaxLen);
 
 s_source_t *Load_Source(const char *filename, const char *ext, bool reverse = false, bool isActiveModel = false,
@@ -1638,6 +1716,8 @@ void MarkParentBoneLODs(void);
 
 extern bool GetLineInput(void);
 
+extern bool ReadLineInput(void);
+
 
 struct v_unify_t {
     int refcount;
@@ -1718,6 +1798,9 @@ public:
     CUtlVector<CLodScriptReplacement_t> materialReplacements;
     CUtlVector<CLodScriptReplacement_t> meshRemovals;
 
+    // $autolod: fraction of the root source's triangles to keep when a model
+    // has no replacemodel for this LOD, 0 to use the root source as-is
+    float autoLODRatio;
 
     void EnableFacialAnimation(bool val) {
         m_bFacialAnimation = val;
@@ -1736,6 +1819,7 @@ public:
     }
 
     LodScriptData_t() {
+        autoLODRatio = 0.0f;
         m_bFacialAnimation = true;
         m_bStrippedFromModel = false;
     }
@@ -1847,6 +1931,7 @@ struct StudioMdlContext {
     unsigned createMakefile: 1;
     unsigned ZBrush: 1;
     unsigned verifyOnly: 1;
+    unsigned noIncremental: 1;
     unsigned useBoneInBBox: 1;
     unsigned lockBoneLengths: 1;
     unsigned defineBonesLockedByDefault: 1;
@@ -1868,6 +1953,8 @@ struct StudioMdlContext {
     unsigned bHasModelName: 1;
     unsigned bMakeVsi: 1;
     unsigned bNoWarnings: 1;
+    unsigned memStats: 1;
+    unsigned batchModels: 1;
     int g_maxWarnings = -1;
     char g_path[1024];
 
@@ -1877,13 +1964,15 @@ struct StudioMdlContext {
     float CollisionPrecision;
     int minSectionFrameLimit;
     int sectionFrames;
+    float animPosError;    // allowed bone position error when compressing animations, 0 for lossless
+    float animAngError;    // allowed bone rotation error, in degrees
     float preloadTime;
     int maxZeroFrames; // clamped from 1..4
     float minZeroFramePosDelta;
     float defaultFadeInTime;
     float defaultFadeOutTime;
     char szFilename[1024];
-    FILE *fpInput;
+    CLineInput lineInput;
     char szLine[4096];
     int iLinecount;
 
@@ -1934,6 +2023,7 @@ struct StudioMdlContext {
               createMakefile(0),
               ZBrush(0),
               verifyOnly(0),
+              noIncremental(0),
               useBoneInBBox(1),
               lockBoneLengths(0),
               defineBonesLockedByDefault(1),
@@ -1957,15 +2047,18 @@ struct StudioMdlContext {
               bHasModelName(0),
               bMakeVsi(0),
               bNoWarnings(0),
+              memStats(0),
+              batchModels(0),
               defaultMotionRollback(0.3f),
               minSectionFrameLimit(30),
               sectionFrames(30),
+              animPosError(0.0f),
+              animAngError(0.0f),
               preloadTime(1.0f),
               maxZeroFrames(3),
               minZeroFramePosDelta(2.0f),
               defaultFadeInTime(0.2f),
               defaultFadeOutTime(0.2f),
-              fpInput(nullptr),
               iLinecount(0),
               vecMinWorldspace(MIN_COORD_INTEGER, MIN_COORD_INTEGER, MIN_COORD_INTEGER),
               vecMaxWorldspace(MAX_COORD_INTEGER, MAX_COORD_INTEGER, MAX_COORD_INTEGER),
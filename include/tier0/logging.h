@@ -19,6 +19,7 @@
 #include "color.h"
 #include "icommandline.h"
 #include <stdio.h>
+#include <mutex>
 
 // For XBX_** functions
 #if defined( _X360 )
@@ -569,6 +570,14 @@ public:
 	// NOTE: test 'IsChannelEnabled(channelID,severity)' before calling this!
 	//-----------------------------------------------------------------------------
 	LoggingResponse_t LogDirect( LoggingChannelID_t channelID, LoggingSeverity_t severity, Color color, const tchar *pMessage );
+
+	//-----------------------------------------------------------------------------
+	// Holds the lock LogDirect takes around the listeners, for code that writes
+	// to the console itself and must not interleave with logged messages.
+	// The lock is recursive, so logging while holding it is fine.
+	//-----------------------------------------------------------------------------
+	void Lock() { m_StateMutex.lock(); }
+	void Unlock() { m_StateMutex.unlock(); }
 	
 	// Internal data to represent a logging tag
 	struct LoggingTag_t
@@ -642,8 +651,8 @@ private:
 
 	// Protects all data in this class except the registered channels 
 	// (which are supposed to be registered using the macros at static/global init time).
-	// It is assumed that this mutex is reentrant safe on all platforms.
-//	CThreadFastMutex *m_pStateMutex;
+	// Recursive, so listeners may log from inside Log().
+	std::recursive_mutex m_StateMutex;
 	
 	// The index of the current "global" state of the logging system.  By default, all threads use this state
 	// for logging unless a given thread has pushed the logging state with bThreadLocal == true.
@@ -763,6 +772,9 @@ PLATFORM_OVERLOAD LoggingResponse_t LoggingSystem_Log( LoggingChannelID_t channe
 PLATFORM_INTERFACE LoggingResponse_t LoggingSystem_LogDirect( LoggingChannelID_t channelID, LoggingSeverity_t severity, Color spewColor, const char *pMessage );
 PLATFORM_INTERFACE LoggingResponse_t LoggingSystem_LogAssert( PRINTF_FORMAT_STRING const char *pMessageFormat, ... ) FMTFUNCTION( 1, 2 );
 
+PLATFORM_INTERFACE void LoggingSystem_Lock();
+PLATFORM_INTERFACE void LoggingSystem_Unlock();
+
 #endif //#if !defined(__SPU__)
 
 #endif // LOGGING_H
\ No newline at end of file
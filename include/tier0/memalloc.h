@@ -103,6 +103,27 @@ PLATFORM_INTERFACE void RemoveMemoryInfoCallback( IMemoryInfo* pMemoryInfo );
 // Display the memory statistics from the callbacks controlled by the above functions.
 PLATFORM_INTERFACE void DumpMemoryInfoStats();
 
+//-----------------------------------------------------------------------------
+// Allocation counters. Between MemAlloc_BeginStatsScope and the matching
+// MemAlloc_EndStatsScope, every block any thread allocates, reallocates or
+// frees through g_pMemAlloc is counted, by its actual block size. Scopes nest,
+// and an outer scope includes everything its inner scopes saw. Open and close
+// them from one thread. Nothing is counted while no scope is open. Memory from
+// the CRT's malloc/calloc is not seen unless it is routed through g_pMemAlloc.
+//-----------------------------------------------------------------------------
+struct MemAllocScopeStats_t
+{
+	uint64 m_nBytesAllocated;	// Sum of all blocks handed out, reallocations included
+	uint64 m_nBytesFreed;		// Sum of all blocks released, reallocations included
+	uint32 m_nAllocs;
+	uint32 m_nFrees;
+	int64 m_nNetBytes;			// Allocated - freed; negative if the scope freed older memory
+	int64 m_nPeakBytes;			// Highest net bytes reached at any point inside the scope
+};
+
+PLATFORM_INTERFACE void MemAlloc_BeginStatsScope();
+PLATFORM_INTERFACE void MemAlloc_EndStatsScope( MemAllocScopeStats_t *pStats );
+
 //-----------------------------------------------------------------------------
 // NOTE! This should never be called directly from leaf code
 // Just use new,delete,malloc,free etc. They will call into this eventually
@@ -442,6 +463,11 @@ inline void MemAlloc_Free(void *pMemBlock)
 	g_pMemAlloc->Free(pMemBlock);
 }
 
+inline void *MemAlloc_Realloc( void *pMemBlock, size_t nSize )
+{
+	return g_pMemAlloc->Realloc( pMemBlock, nSize );
+}
+
 inline size_t MemAlloc_GetSizeAligned( void *pMemBlock )
 {
 #ifdef MEMALLOC_SUPPORTS_ALIGNED_ALLOCATIONS
@@ -656,6 +682,7 @@ inline void _aligned_free( void *ptr )																				{ free( ptr ); }
 
 inline void *MemAlloc_Alloc( size_t nSize, const char *pFileName = NULL, int nLine = 0 )							{ return malloc( nSize ); }
 inline void MemAlloc_Free( void *ptr, const char *pFileName = NULL, int nLine = 0 )									{ free( ptr ); }
+inline void *MemAlloc_Realloc( void *ptr, size_t nSize )																{ return realloc( ptr, nSize ); }
 
 inline void *MemAlloc_AllocAligned( size_t size, size_t align )														{ return memalign( align, size ); }
 inline void *MemAlloc_AllocAlignedFileLine( size_t size, size_t align, const char *pszFile = NULL, int nLine = 0 )	{ return memalign( align, size ); }
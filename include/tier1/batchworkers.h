@@ -0,0 +1,75 @@
+//===== Copyright © 1996-2008, Valve Corporation, All rights reserved. ======//
+//
+// Purpose: Splits a batch of files between worker processes
+//
+//===========================================================================//
+
+#ifndef BATCHWORKERS_H
+#define BATCHWORKERS_H
+
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include <stdio.h>
+#include "tier0/platform.h"
+#include "tier1/utlstring.h"
+#include "tier1/utlvector.h"
+
+
+//-----------------------------------------------------------------------------
+// For tools whose batches work on global state that can't be shared between
+// threads (dmxconvert's datamodel, studiomdl's model tools). A batch is split
+// between copies of the tool itself, each working through its share of the
+// files one at a time and paying the startup cost once.
+//
+// Each job is one line of text the worker knows how to read back. A worker
+// is run as:
+//     <this exe> -donefile <done file> <args...> <list file>
+// where the list file holds its share of the job lines. The worker goes
+// through them in order, writing the index of every line it starts and
+// finishes to the done file, so the parent can tell which jobs failed even if
+// a worker dies part way through, and which ones it never got to.
+//-----------------------------------------------------------------------------
+struct BatchJob_t
+{
+	CUtlString m_Line;	// what the worker's list file gets
+	int64 m_nSize;		// for balancing the workers, usually the input size
+	bool m_bDone;
+};
+
+// Size and modification time of a file, false if it doesn't exist
+bool Batch_GetFileInfo( const char *pFileName, int64 &nSize, int64 &nTime );
+
+// One worker per CPU, or the -workers command line value
+int Batch_GetWorkerCount( int nJobCount );
+
+// Runs the jobs on nWorkerCount worker processes and waits for them.
+// Sets m_bDone on each job a worker finished. When a worker exits part way,
+// the job it was on fails and the ones it didn't reach go to a new worker.
+// Returns false if no worker could be started at all, in which case the
+// caller should do the jobs itself.
+bool Batch_RunWorkers( CUtlVector< BatchJob_t > &jobs, int nWorkerCount, const CUtlVector< CUtlString > &args );
+
+
+//-----------------------------------------------------------------------------
+// Worker side: records finished jobs in the -donefile, if there is one
+//-----------------------------------------------------------------------------
+class CBatchDoneFile
+{
+public:
+	CBatchDoneFile();
+	~CBatchDoneFile();
+
+	// Index is the job's line in the worker's list file
+	void MarkStarted( int nIndex );
+	void MarkDone( int nIndex );
+
+	bool IsWorker() const { return m_fp != NULL; }
+
+private:
+	FILE *m_fp;
+};
+
+
+#endif // BATCHWORKERS_H
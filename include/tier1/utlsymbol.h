@@ -93,7 +93,8 @@ protected:
 // 
 //    This class stores the strings in a series of string pools. The first
 //    two bytes of each string are decorated with a hash to speed up
-//	  comparisons.
+//	  comparisons. Lookups go through an open-addressed hash table which
+//	  caches those hashes, and don't modify the table.
 //-----------------------------------------------------------------------------
 
 class CUtlSymbolTable
@@ -122,7 +123,7 @@ public:
 
 	int GetNumStrings( void ) const
 	{
-		return m_Lookup.Count();
+		return m_Strings.Count();
 	}
 
 	// We store one of these at the beginning of every string to speed
@@ -150,22 +151,6 @@ protected:
 		unsigned short m_iOffset;	// Index into the string pool.
 	};
 
-	class CLess
-	{
-	public:
-		CLess( int ignored = 0 ) {} // permits default initialization to NULL in CUtlRBTree
-		bool operator!() const { return false; }
-		bool operator()( const CStringPoolIndex &left, const CStringPoolIndex &right ) const;
-	};
-
-	// Stores the symbol lookup
-	class CTree : public CUtlRBTree<CStringPoolIndex, unsigned short, CLess>
-	{
-	public:
-		CTree(  int growSize, int initSize ) : CUtlRBTree<CStringPoolIndex, unsigned short, CLess>( growSize, initSize ) {}
-		friend class CUtlSymbolTable::CLess; // Needed to allow CLess to calculate pointer to symbol table
-	};
-
 	struct StringPool_t
 	{	
 		int m_TotalLen;		// How large is 
@@ -173,11 +158,15 @@ protected:
 		char m_Data[1];
 	};
 
-	CTree m_Lookup;
+	// Where each symbol's string lives, indexed by symbol
+	CUtlVector<CStringPoolIndex> m_Strings;
+
+	// Open-addressed lookup, power of 2 sized and at most half full. Each slot holds
+	// the string's hash decoration in the high 16 bits and its symbol + 1 in the
+	// low 16 bits; 0 is an empty slot.
+	CUtlVector<unsigned int> m_HashSlots;
 
 	bool m_bInsensitive;
-	mutable unsigned short m_nUserSearchStringHash;
-	mutable const char* m_pUserSearchString;
 
 	// stores the string data
 	CUtlVector<StringPool_t*> m_StringPools;
@@ -186,8 +175,9 @@ private:
 	int FindPoolWithSpace( int len ) const;
 	const char* StringFromIndex( const CStringPoolIndex &index ) const;
 	const char* DecoratedStringFromIndex( const CStringPoolIndex &index ) const;
+	void InsertHashSlot( hashDecoration_t hash, UtlSymId_t id );
+	void GrowHashSlots();
 
-	friend class CLess;
 	friend class CSymbolHash;
 
 };
@@ -15,6 +15,9 @@
 
 
 #include "tier1/stringpool.h"
+#include <atomic>
+#include <mutex>
+#include <new>
 
 //-----------------------------------------------------------------------------
 // CUtlSymbolTableLarge:
@@ -112,9 +115,19 @@ private:
 
 #define MIN_STRING_POOL_SIZE	2048
 
+#define UTL_SYMBOL_LARGE_HASH_SEED	0x31415926
+
+// len includes the terminator. HashString() only produces 16 bits, which isn't enough
+// to spread a large table, so these use a full 32 bit hash.
 inline uint32 CUtlSymbolLarge_Hash( bool CASEINSENSITIVE, const char *pString, int len )
 {
-	return ( CASEINSENSITIVE ? HashStringCaseless( pString ) : HashString( pString ) ); 
+	return ( CASEINSENSITIVE ? MurmurHash2LowerCase( pString, UTL_SYMBOL_LARGE_HASH_SEED ) : MurmurHash2( pString, len - 1, UTL_SYMBOL_LARGE_HASH_SEED ) ); 
+}
+
+template< bool CASEINSENSITIVE >
+inline bool CUtlSymbolLarge_StringsEqual( const char *pString1, const char *pString2 )
+{
+	return ( CASEINSENSITIVE ? V_stricmp( pString1, pString2 ) : V_strcmp( pString1, pString2 ) ) == 0;
 }
 
 typedef uint32 LargeSymbolTableHashDecoration_t; 
@@ -211,6 +224,131 @@ public:
 	}
 };
 
+//-----------------------------------------------------------------------------
+// Open-addressed lookup for the non-threaded tables. Each slot caches the
+// string's full hash next to its index, so a probe only touches string data
+// when the hashes match. Indices are handed out in insertion order, which keeps
+// GetElements() ordered the same way the red-black tree was.
+//-----------------------------------------------------------------------------
+template< bool CASEINSENSITIVE >
+class CHashedSymbolTree
+{
+public:
+	CHashedSymbolTree() : m_Elements( 0, 16 )
+	{
+	}
+	inline void Commit() 
+	{
+		// Nothing, only matters for thread-safe tables
+	}
+	intp Insert( CUtlSymbolTableLargeBaseTreeEntry_t *entry );
+	intp Find( CUtlSymbolTableLargeBaseTreeEntry_t *entry ) const;
+	inline intp InvalidIndex() const
+	{
+		return -1;
+	}
+	inline int Count() const
+	{
+		return m_Elements.Count();
+	}
+	inline CUtlSymbolTableLargeBaseTreeEntry_t *Element( intp i ) const
+	{
+		return m_Elements[ i ];
+	}
+	inline CUtlSymbolTableLargeBaseTreeEntry_t *operator[]( intp i ) const
+	{
+		return m_Elements[ i ];
+	}
+	inline void Purge()
+	{
+		m_Elements.Purge();
+		m_Slots.Purge();
+	}
+	inline int GetElements( int nFirstElement, int nCount, CUtlSymbolLarge *pElements ) const
+	{
+		nCount = MIN( nCount, m_Elements.Count() - nFirstElement );
+		for ( int i = 0; i < nCount; ++i )
+		{
+			pElements[ i ] = m_Elements[ nFirstElement + i ]->ToSymbol();
+		}
+		return MAX( nCount, 0 );
+	}
+
+private:
+	struct Slot_t
+	{
+		LargeSymbolTableHashDecoration_t m_nHash;
+		int m_nIndex;	// -1 if empty
+	};
+
+	void Grow();
+
+	CUtlVector< CUtlSymbolTableLargeBaseTreeEntry_t * > m_Elements;
+	CUtlVector< Slot_t > m_Slots;	// power of 2 sized, at most half full
+};
+
+template< bool CASEINSENSITIVE >
+inline intp CHashedSymbolTree< CASEINSENSITIVE >::Find( CUtlSymbolTableLargeBaseTreeEntry_t *entry ) const
+{
+	if ( m_Slots.Count() == 0 )
+		return InvalidIndex();
+
+	int nMask = m_Slots.Count() - 1;
+	for ( int i = entry->m_Hash & nMask; ; i = ( i + 1 ) & nMask )
+	{
+		const Slot_t &slot = m_Slots[ i ];
+		if ( slot.m_nIndex < 0 )
+			return InvalidIndex();
+
+		if ( slot.m_nHash == entry->m_Hash && CUtlSymbolLarge_StringsEqual< CASEINSENSITIVE >( m_Elements[ slot.m_nIndex ]->String(), entry->String() ) )
+			return slot.m_nIndex;
+	}
+}
+
+template< bool CASEINSENSITIVE >
+inline intp CHashedSymbolTree< CASEINSENSITIVE >::Insert( CUtlSymbolTableLargeBaseTreeEntry_t *entry )
+{
+	if ( ( m_Elements.Count() + 1 ) * 2 > m_Slots.Count() )
+	{
+		Grow();
+	}
+
+	int nIndex = m_Elements.AddToTail( entry );
+	int nMask = m_Slots.Count() - 1;
+	int i = entry->m_Hash & nMask;
+	while ( m_Slots[ i ].m_nIndex >= 0 )
+	{
+		i = ( i + 1 ) & nMask;
+	}
+	m_Slots[ i ].m_nHash = entry->m_Hash;
+	m_Slots[ i ].m_nIndex = nIndex;
+	return nIndex;
+}
+
+template< bool CASEINSENSITIVE >
+inline void CHashedSymbolTree< CASEINSENSITIVE >::Grow()
+{
+	int nSlots = MAX( m_Slots.Count() * 2, 32 );
+	m_Slots.SetCount( nSlots );
+	for ( int i = 0; i < nSlots; ++i )
+	{
+		m_Slots[ i ].m_nIndex = -1;
+	}
+
+	int nMask = nSlots - 1;
+	for ( int nIndex = 0; nIndex < m_Elements.Count(); ++nIndex )
+	{
+		LargeSymbolTableHashDecoration_t nHash = m_Elements[ nIndex ]->m_Hash;
+		int i = nHash & nMask;
+		while ( m_Slots[ i ].m_nIndex >= 0 )
+		{
+			i = ( i + 1 ) & nMask;
+		}
+		m_Slots[ i ].m_nHash = nHash;
+		m_Slots[ i ].m_nIndex = nIndex;
+	}
+}
+
 // Since CUtlSymbolTableLargeBaseTreeEntry_t already has the hash 
 //  contained inside of it, don't need to recompute a hash here
 template < int BUCKET_COUNT, class KEYTYPE, bool CASEINSENSITIVE >
@@ -449,8 +587,324 @@ ANALYZE_UNSUPPRESS(); // warning C6001: Using uninitialized memory '*m_StringPoo
 #endif
 
 // Case-sensitive
-typedef CUtlSymbolTableLargeBase< CNonThreadsafeTree< false >, false > CUtlSymbolTableLarge;
+typedef CUtlSymbolTableLargeBase< CHashedSymbolTree< false >, false > CUtlSymbolTableLarge;
+// Case-insensitive
+typedef CUtlSymbolTableLargeBase< CHashedSymbolTree< true >, true > CUtlSymbolTableLarge_CI;
+
+
+//-----------------------------------------------------------------------------
+// CUtlSymbolTableLargeMT:
+//    Same symbols as CUtlSymbolTableLarge, but any number of threads can look
+//    strings up and add them at the same time.
+//
+//    Lookups never lock. The table is split into shards by the top bits of the
+//    hash; each shard publishes an open-addressed slot array, a filled slot never
+//    changes, and when a shard grows the old slot array is kept until RemoveAll()
+//    so a reader still probing it stays safe. AddString() only locks the shard the
+//    string hashes to, and every shard owns its own string pools.
+//-----------------------------------------------------------------------------
+template < bool CASEINSENSITIVE, size_t POOL_SIZE = MIN_STRING_POOL_SIZE >
+class CUtlSymbolTableLargeMTBase
+{
+public:
+	// constructor, destructor
+	CUtlSymbolTableLargeMTBase();
+	~CUtlSymbolTableLargeMTBase();
+
+	// Finds and/or creates a symbol based on the string
+	CUtlSymbolLarge AddString( const char* pString );
+
+	// Finds the symbol for pString, never adds it
+	CUtlSymbolLarge Find( const char* pString ) const;
+
+	// Remove all symbols in the table. Not safe while other threads are using it.
+	void RemoveAll();
+
+	int GetNumStrings( void ) const;
+
+	void Commit()
+	{
+		// Nothing, strings are visible to every thread as soon as they're added
+	}
+
+	// Returns elements in the table, in no particular order
+	int GetElements( int nFirstElement, int nCount, CUtlSymbolLarge *pElements ) const;
+
+	uint64 GetMemoryUsage() const;
+
+private:
+	enum
+	{
+		SHARD_BITS = 4,
+		SHARD_COUNT = 1 << SHARD_BITS,
+		MIN_SLOT_COUNT = 64,
+	};
+
+	typedef CUtlSymbolTableLargeBaseTreeEntry_t Entry_t;
+
+	struct SlotArray_t
+	{
+		uint32 m_nMask;
+		std::atomic< Entry_t * > m_Slots[1];
+	};
+
+	struct StringPool_t
+	{	
+		int m_TotalLen;
+		int m_SpaceUsed;
+		char m_Data[1];
+	};
+
+	struct Shard_t
+	{
+		std::atomic< SlotArray_t * > m_pSlots;
+		std::atomic< int > m_nCount;
+		std::mutex m_Mutex;
+		CUtlVector< SlotArray_t * > m_RetiredSlots;
+		CUtlVector< StringPool_t * > m_StringPools;
+	};
+
+	static SlotArray_t *AllocSlots( uint32 nSlotCount );
+	static Entry_t *FindInSlots( const SlotArray_t *pSlots, LargeSymbolTableHashDecoration_t nHash, const char *pString );
+	static void InsertInSlots( SlotArray_t *pSlots, Entry_t *pEntry );
+	static Entry_t *AllocEntry( Shard_t &shard, LargeSymbolTableHashDecoration_t nHash, const char *pString, int lenString );
+
+	Shard_t &ShardForHash( LargeSymbolTableHashDecoration_t nHash ) const
+	{
+		return const_cast< Shard_t & >( m_Shards[ nHash >> ( 32 - SHARD_BITS ) ] );
+	}
+
+	Shard_t m_Shards[ SHARD_COUNT ];
+};
+
+template < bool CASEINSENSITIVE, size_t POOL_SIZE >
+inline CUtlSymbolTableLargeMTBase< CASEINSENSITIVE, POOL_SIZE >::CUtlSymbolTableLargeMTBase()
+{
+	for ( int i = 0; i < SHARD_COUNT; ++i )
+	{
+		m_Shards[ i ].m_pSlots.store( NULL, std::memory_order_relaxed );
+		m_Shards[ i ].m_nCount.store( 0, std::memory_order_relaxed );
+	}
+}
+
+template < bool CASEINSENSITIVE, size_t POOL_SIZE >
+inline CUtlSymbolTableLargeMTBase< CASEINSENSITIVE, POOL_SIZE >::~CUtlSymbolTableLargeMTBase()
+{
+	RemoveAll();
+}
+
+template < bool CASEINSENSITIVE, size_t POOL_SIZE >
+inline typename CUtlSymbolTableLargeMTBase< CASEINSENSITIVE, POOL_SIZE >::SlotArray_t *CUtlSymbolTableLargeMTBase< CASEINSENSITIVE, POOL_SIZE >::AllocSlots( uint32 nSlotCount )
+{
+	Assert( ( nSlotCount & ( nSlotCount - 1 ) ) == 0 );
+	SlotArray_t *pSlots = (SlotArray_t*)malloc( sizeof( SlotArray_t ) + ( nSlotCount - 1 ) * sizeof( std::atomic< Entry_t * > ) );
+	pSlots->m_nMask = nSlotCount - 1;
+	for ( uint32 i = 0; i < nSlotCount; ++i )
+	{
+		new ( &pSlots->m_Slots[ i ] ) std::atomic< Entry_t * >( NULL );
+	}
+	return pSlots;
+}
+
+template < bool CASEINSENSITIVE, size_t POOL_SIZE >
+inline typename CUtlSymbolTableLargeMTBase< CASEINSENSITIVE, POOL_SIZE >::Entry_t *CUtlSymbolTableLargeMTBase< CASEINSENSITIVE, POOL_SIZE >::FindInSlots( const SlotArray_t *pSlots, LargeSymbolTableHashDecoration_t nHash, const char *pString )
+{
+	if ( !pSlots )
+		return NULL;
+
+	// Tables are never more than half full, so this always hits an empty slot
+	for ( uint32 i = nHash & pSlots->m_nMask; ; i = ( i + 1 ) & pSlots->m_nMask )
+	{
+		Entry_t *pEntry = pSlots->m_Slots[ i ].load( std::memory_order_acquire );
+		if ( !pEntry )
+			return NULL;
+
+		if ( pEntry->m_Hash == nHash && CUtlSymbolLarge_StringsEqual< CASEINSENSITIVE >( pEntry->String(), pString ) )
+			return pEntry;
+	}
+}
+
+template < bool CASEINSENSITIVE, size_t POOL_SIZE >
+inline void CUtlSymbolTableLargeMTBase< CASEINSENSITIVE, POOL_SIZE >::InsertInSlots( SlotArray_t *pSlots, Entry_t *pEntry )
+{
+	uint32 i = pEntry->m_Hash & pSlots->m_nMask;
+	while ( pSlots->m_Slots[ i ].load( std::memory_order_relaxed ) )
+	{
+		i = ( i + 1 ) & pSlots->m_nMask;
+	}
+
+	// Release, so a reader that sees the pointer also sees the string behind it
+	pSlots->m_Slots[ i ].store( pEntry, std::memory_order_release );
+}
+
+template < bool CASEINSENSITIVE, size_t POOL_SIZE >
+inline typename CUtlSymbolTableLargeMTBase< CASEINSENSITIVE, POOL_SIZE >::Entry_t *CUtlSymbolTableLargeMTBase< CASEINSENSITIVE, POOL_SIZE >::AllocEntry( Shard_t &shard, LargeSymbolTableHashDecoration_t nHash, const char *pString, int lenString )
+{
+	int lenDecorated = ALIGN_VALUE( lenString + sizeof( LargeSymbolTableHashDecoration_t ), sizeof( LargeSymbolTableHashDecoration_t ) );
+
+	// Strings are never freed individually, so only the newest pool can have space
+	StringPool_t *pPool = shard.m_StringPools.Count() ? shard.m_StringPools.Tail() : NULL;
+	if ( !pPool || ( pPool->m_TotalLen - pPool->m_SpaceUsed ) < lenDecorated )
+	{
+		int newPoolSize = MAX( lenDecorated + sizeof( StringPool_t ), POOL_SIZE );
+		pPool = (StringPool_t*)malloc( newPoolSize );
+		pPool->m_TotalLen = newPoolSize - sizeof( StringPool_t );
+		pPool->m_SpaceUsed = 0;
+		shard.m_StringPools.AddToTail( pPool );
+	}
+
+	Entry_t *pEntry = ( Entry_t * )&pPool->m_Data[ pPool->m_SpaceUsed ];
+	pPool->m_SpaceUsed += lenDecorated;
+
+	pEntry->m_Hash = nHash;
+	Q_memcpy( (char *)&pEntry->m_String[ 0 ], pString, lenString );
+	return pEntry;
+}
+
+template < bool CASEINSENSITIVE, size_t POOL_SIZE >
+inline CUtlSymbolLarge CUtlSymbolTableLargeMTBase< CASEINSENSITIVE, POOL_SIZE >::Find( const char* pString ) const
+{
+	if ( !pString )
+		return CUtlSymbolLarge();
+
+	int len = Q_strlen( pString ) + 1;
+	LargeSymbolTableHashDecoration_t nHash = CUtlSymbolLarge_Hash( CASEINSENSITIVE, pString, len );
+
+	const Shard_t &shard = ShardForHash( nHash );
+	Entry_t *pEntry = FindInSlots( shard.m_pSlots.load( std::memory_order_acquire ), nHash, pString );
+	return pEntry ? pEntry->ToSymbol() : CUtlSymbolLarge();
+}
+
+template < bool CASEINSENSITIVE, size_t POOL_SIZE >
+inline CUtlSymbolLarge CUtlSymbolTableLargeMTBase< CASEINSENSITIVE, POOL_SIZE >::AddString( const char* pString )
+{
+	if ( !pString )
+		return UTL_INVAL_SYMBOL_LARGE;
+
+	int lenString = Q_strlen( pString ) + 1;
+	LargeSymbolTableHashDecoration_t nHash = CUtlSymbolLarge_Hash( CASEINSENSITIVE, pString, lenString );
+
+	Shard_t &shard = ShardForHash( nHash );
+	Entry_t *pEntry = FindInSlots( shard.m_pSlots.load( std::memory_order_acquire ), nHash, pString );
+	if ( pEntry )
+		return pEntry->ToSymbol();
+
+	std::lock_guard< std::mutex > lock( shard.m_Mutex );
+
+	// Someone may have added it while we waited for the lock
+	SlotArray_t *pSlots = shard.m_pSlots.load( std::memory_order_relaxed );
+	pEntry = FindInSlots( pSlots, nHash, pString );
+	if ( pEntry )
+		return pEntry->ToSymbol();
+
+	MEM_ALLOC_CREDIT();
+
+	int nCount = shard.m_nCount.load( std::memory_order_relaxed );
+	if ( !pSlots || uint32( nCount + 1 ) * 2 > pSlots->m_nMask + 1 )
+	{
+		SlotArray_t *pNewSlots = AllocSlots( pSlots ? ( pSlots->m_nMask + 1 ) * 2 : MIN_SLOT_COUNT );
+		if ( pSlots )
+		{
+			for ( uint32 i = 0; i <= pSlots->m_nMask; ++i )
+			{
+				Entry_t *pOld = pSlots->m_Slots[ i ].load( std::memory_order_relaxed );
+				if ( pOld )
+				{
+					InsertInSlots( pNewSlots, pOld );
+				}
+			}
+			shard.m_RetiredSlots.AddToTail( pSlots );
+		}
+		shard.m_pSlots.store( pNewSlots, std::memory_order_release );
+		pSlots = pNewSlots;
+	}
+
+	pEntry = AllocEntry( shard, nHash, pString, lenString );
+	InsertInSlots( pSlots, pEntry );
+	shard.m_nCount.store( nCount + 1, std::memory_order_relaxed );
+	return pEntry->ToSymbol();
+}
+
+template < bool CASEINSENSITIVE, size_t POOL_SIZE >
+inline void CUtlSymbolTableLargeMTBase< CASEINSENSITIVE, POOL_SIZE >::RemoveAll()
+{
+	for ( int s = 0; s < SHARD_COUNT; ++s )
+	{
+		Shard_t &shard = m_Shards[ s ];
+		std::lock_guard< std::mutex > lock( shard.m_Mutex );
+
+		free( shard.m_pSlots.load( std::memory_order_relaxed ) );
+		shard.m_pSlots.store( NULL, std::memory_order_relaxed );
+		shard.m_nCount.store( 0, std::memory_order_relaxed );
+
+		for ( int i = 0; i < shard.m_RetiredSlots.Count(); ++i )
+			free( shard.m_RetiredSlots[ i ] );
+		shard.m_RetiredSlots.Purge();
+
+		for ( int i = 0; i < shard.m_StringPools.Count(); ++i )
+			free( shard.m_StringPools[ i ] );
+		shard.m_StringPools.Purge();
+	}
+}
+
+template < bool CASEINSENSITIVE, size_t POOL_SIZE >
+inline int CUtlSymbolTableLargeMTBase< CASEINSENSITIVE, POOL_SIZE >::GetNumStrings( void ) const
+{
+	int nCount = 0;
+	for ( int s = 0; s < SHARD_COUNT; ++s )
+	{
+		nCount += m_Shards[ s ].m_nCount.load( std::memory_order_relaxed );
+	}
+	return nCount;
+}
+
+template < bool CASEINSENSITIVE, size_t POOL_SIZE >
+inline int CUtlSymbolTableLargeMTBase< CASEINSENSITIVE, POOL_SIZE >::GetElements( int nFirstElement, int nCount, CUtlSymbolLarge *pElements ) const
+{
+	int nSkip = nFirstElement;
+	int nWritten = 0;
+	for ( int s = 0; s < SHARD_COUNT && nWritten < nCount; ++s )
+	{
+		const SlotArray_t *pSlots = m_Shards[ s ].m_pSlots.load( std::memory_order_acquire );
+		if ( !pSlots )
+			continue;
+
+		for ( uint32 i = 0; i <= pSlots->m_nMask && nWritten < nCount; ++i )
+		{
+			Entry_t *pEntry = pSlots->m_Slots[ i ].load( std::memory_order_acquire );
+			if ( !pEntry )
+				continue;
+
+			if ( nSkip > 0 )
+			{
+				--nSkip;
+				continue;
+			}
+			pElements[ nWritten++ ] = pEntry->ToSymbol();
+		}
+	}
+	return nWritten;
+}
+
+template < bool CASEINSENSITIVE, size_t POOL_SIZE >
+inline uint64 CUtlSymbolTableLargeMTBase< CASEINSENSITIVE, POOL_SIZE >::GetMemoryUsage() const
+{
+	uint64 unBytesUsed = 0u;
+	for ( int s = 0; s < SHARD_COUNT; ++s )
+	{
+		Shard_t &shard = ShardForHash( uint32( s ) << ( 32 - SHARD_BITS ) );
+		std::lock_guard< std::mutex > lock( shard.m_Mutex );
+		for ( int i = 0; i < shard.m_StringPools.Count(); ++i )
+		{
+			unBytesUsed += (uint64)shard.m_StringPools[ i ]->m_TotalLen;
+		}
+	}
+	return unBytesUsed;
+}
+
+// Case-sensitive
+typedef CUtlSymbolTableLargeMTBase< false > CUtlSymbolTableLargeMT;
 // Case-insensitive
-typedef CUtlSymbolTableLargeBase< CNonThreadsafeTree< true >, true > CUtlSymbolTableLarge_CI;
+typedef CUtlSymbolTableLargeMTBase< true > CUtlSymbolTableLargeMT_CI;
 
 #endif // UTLSYMBOLLARGE_H
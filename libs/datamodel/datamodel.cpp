@@ -13,6 +13,9 @@
 #include "dmserializerkeyvalues.h"
 #include "dmserializerkeyvalues2.h"
 #include "dmserializerbinary.h"
+#include "dmfilearena.h"
+#include "dmelementdictionary.h"
+#include "DmElementFramework.h"
 #include "undomanager.h"
 #include "tier1/fmtstr.h"
 #include "tier2/utlstreambuffer.h"
@@ -76,7 +79,8 @@ IDataModel *g_pDataModel = &g_DataModel;
 //-----------------------------------------------------------------------------
 CDataModel::CDataModel() :
         m_elementIds(4096),
-        m_unloadedIdElementMap(16, 0, 0, ElementIdHandlePair_t::Compare, ElementIdHandlePair_t::HashKey) {
+        m_unloadedIdElementMap(16, 0, 0, ElementIdHandlePair_t::Compare, ElementIdHandlePair_t::HashKey),
+        m_UpgradeElements(0, 0, DefLessFunc(DmElementHandle_t)) {
     m_pDefaultFactory = &s_DefaultElementFactory;
     m_bUnableToSetDefaultFactory = false;
     m_bOnlyCreateUntypedElements = false;
@@ -86,6 +90,7 @@ CDataModel::CDataModel() :
     m_nMaxNumberOfElements = 0;
     m_bIsUnserializing = false;
     m_bDeleteOrphanedElements = false;
+    m_bUpgradingInPlace = false;
 }
 
 CDataModel::~CDataModel() {
@@ -526,6 +531,10 @@ CUtlSymbolLarge CDataModel::GetSymbol(const char *pString) {
     return m_SymbolTable.AddString(pString);
 }
 
+CUtlSymbolLarge CDataModel::FindSymbol(const char *pString) {
+    return m_SymbolTable.Find(pString);
+}
+
 
 //-----------------------------------------------------------------------------
 // file format methods
@@ -708,6 +717,11 @@ void CDataModel::SetSerializationArrayDelimiter(const char *pDelimiter) {
     ::SetSerializationArrayDelimiter(pDelimiter);
 }
 
+//-----------------------------------------------------------------------------
+// How much binary output to buffer up before flushing to disk
+//-----------------------------------------------------------------------------
+static const int BINARY_SAVE_BUFFER_SIZE = 4 * 1024 * 1024;
+
 bool
 CDataModel::SaveToFile(char const *pFileName, char const *pPathID, const char *pEncodingName, const char *pFormatName,
                        CDmElement *pRoot) {
@@ -737,6 +751,10 @@ CDataModel::SaveToFile(char const *pFileName, char const *pPathID, const char *p
             return false;
         }
 
+        // Buffer up large runs of output so big files go to disk in a few large writes
+        // instead of one write per 16k stream chunk
+        buf.EnsureCapacity(BINARY_SAVE_BUFFER_SIZE);
+
         bool bOk = Serialize(buf, pEncodingName, pFormatName, pRoot->GetHandle());
         if (!bOk)
             return false;
@@ -1049,46 +1067,6 @@ CDataModel::Unserialize(CUtlBuffer &inBuf, const char *pEncodingName, const char
         Q_strncpy(header.encodingName, pSerializer->GetName(), sizeof(header.encodingName));
     }
 
-
-
-//     if we're not in dmxconvert, and we're not at the latest version, call dmxconvert and unserialize from the converted file
-    if (!m_bOnlyCreateUntypedElements && !bIsCurrentVersion) {
-        CDataModel tmp;
-        for (const auto &item: m_FormatUpdaters) {
-            tmp.AddFormatUpdater(item);
-        }
-        for (const auto &item: m_LegacyUpdaters) {
-            tmp.AddLegacyUpdater(item);
-        }
-        tmp.Init();
-        auto orig = g_pDataModel;
-        g_pDataModelImp = &tmp;
-        g_pDataModel = &tmp;
-
-        tmp.SetUndoEnabled(false);
-        tmp.OnlyCreateUntypedElements(true);
-        DmFileId_t fileid = tmp.FindOrCreateFileId("tmp_convert.dmx");
-        tmp.SetFileName(fileid, "tmp_convert.dmx");
-
-        auto hTmpRoot = tmp.CreateElement(CDmElement::GetStaticTypeSymbol(), "root",
-                                          fileid, nullptr);
-        inBuf.SeekGet(CUtlBuffer::SEEK_HEAD, 0);
-        auto res = tmp.Unserialize(inBuf, pEncodingName, header.formatName, nullptr, pFileName,
-                                   DmConflictResolution_t::CR_DELETE_OLD, hTmpRoot);
-        CUtlBuffer outBuf;
-        tmp.Serialize(outBuf, "binary", header.formatName, hTmpRoot);
-        for (int i = 0; i < tmp.NumFileIds(); ++i)
-            tmp.UnloadFile(tmp.GetFileId(i), true);
-
-        outBuf.SeekGet(CUtlBuffer::SEEK_HEAD, 0);
-        g_pDataModelImp = dynamic_cast<CDataModel *>(orig);
-        g_pDataModel = orig;
-        auto bSuccess = Unserialize(outBuf, "binary", header.formatName, header.formatName, pFileName,
-                                    idConflictResolution, hRoot);
-        return bSuccess;
-    }
-
-
     // advance the buffer the the end of the header
     if (bStoresVersionInFile) {
         if (V_strcmp(pEncodingName, header.encodingName) != 0)
@@ -1111,15 +1089,36 @@ CDataModel::Unserialize(CUtlBuffer &inBuf, const char *pEncodingName, const char
         }
     }
 
+    // If we're not in dmxconvert and the file isn't at the latest version, read it as untyped elements
+    // so the updaters can change their types, then turn them into typed elements once they're done
+    bool bUpgradeInPlace = !m_bOnlyCreateUntypedElements && !bIsCurrentVersion;
+    if (bUpgradeInPlace) {
+        Assert(!m_bUpgradingInPlace);
+        m_bUpgradingInPlace = true;
+        m_bOnlyCreateUntypedElements = true;
+    }
+
     m_bIsUnserializing = true;
 
     DmFileId_t fileid = FindOrCreateFileId(pFileName);
 
-    // Now read the file using the appropriate format
+    // Attributes created by the serializer are bump-allocated out of a per-file arena,
+    // which goes back to the heap in one piece when the file is unloaded
+    FileElementSet_t *fes = m_openFiles.GetHandle(fileid);
+    if (fes && !fes->m_pArena) {
+        fes->m_pArena = CDmFileArena::Create(fileid);
+    }
+
+    // Now read the file using the appropriate format. Untyped elements only live until the upgrade
+    // is done, so they stay on the heap; their typed replacements go in the arena.
     CDmElement *pRoot;
-    bool bOk = pSerializer->Unserialize(inBuf, pEncodingName, header.nEncodingVersion, header.formatName,
-                                        header.nFormatVersion,
-                                        fileid, idConflictResolution, &pRoot);
+    bool bOk;
+    {
+        CDmFileArenaScope arenaScope(fes && !bUpgradeInPlace ? fes->m_pArena : NULL);
+        bOk = pSerializer->Unserialize(inBuf, pEncodingName, header.nEncodingVersion, header.formatName,
+                                       header.nFormatVersion,
+                                       fileid, idConflictResolution, &pRoot);
+    }
     if (bOk) {
         hRoot = pRoot ? pRoot->GetHandle() : DMELEMENT_HANDLE_INVALID;
 
@@ -1129,10 +1128,17 @@ CDataModel::Unserialize(CUtlBuffer &inBuf, const char *pEncodingName, const char
             header.nFormatVersion = updater->GetCurrentVersion();
         }
 
+        if (bUpgradeInPlace) {
+            FinishInPlaceUpgrade(fileid, hRoot, true);
+        }
+
         SetFileModificationUTCTime(fileid, 0);
         SetFileFormat(fileid, header.formatName);
         SetFileRoot(fileid, hRoot);
     } else {
+        if (bUpgradeInPlace) {
+            FinishInPlaceUpgrade(fileid, DMELEMENT_HANDLE_INVALID, false);
+        }
         RemoveFileId(fileid);
     }
 
@@ -1161,6 +1167,141 @@ bool CDataModel::UpdateUnserializedElements(const char *pSourceFormatName, int n
     return pFormatUpdater->Update(ppRoot, nSourceFormatVersion);
 }
 
+//-----------------------------------------------------------------------------
+// Legacy files are read and updated as untyped elements, in place. Once the
+// updaters are done, the elements the file would save get swapped for typed
+// ones and the rest are deleted, which leaves the same elements as writing the
+// updated file out and reading it back in.
+//-----------------------------------------------------------------------------
+void CDataModel::FinishInPlaceUpgrade(DmFileId_t fileid, DmElementHandle_t hRoot, bool bSucceeded) {
+    m_bOnlyCreateUntypedElements = false;
+
+    // Only elements reachable from the root within the file would have been saved
+    CDmElementSerializationDictionary dict;
+    CDmElement *pRoot = bSucceeded ? GetElement(hRoot) : NULL;
+    if (pRoot) {
+        dict.BuildElementList(pRoot, true);
+    }
+
+    CUtlVector<DmElementHandle_t> saved;
+    for (DmElementDictHandle_t i = dict.FirstRootElement(); i != ELEMENT_DICT_HANDLE_INVALID;
+         i = dict.NextRootElement(i)) {
+        DmElementHandle_t hElement = dict.GetRootElement(i)->GetHandle();
+        if (m_UpgradeElements.Find(hElement) != m_UpgradeElements.InvalidIndex()) {
+            saved.AddToTail(hElement);
+        }
+    }
+
+    CUtlVector<DmElementHandle_t> orphaned;
+    for (int i = m_UpgradeElements.FirstInorder(); i != m_UpgradeElements.InvalidIndex();
+         i = m_UpgradeElements.NextInorder(i)) {
+        CDmElement *pElement = GetElement(m_UpgradeElements[i]);
+        if (pElement && dict.Find(pElement) == ELEMENT_DICT_HANDLE_INVALID) {
+            orphaned.AddToTail(m_UpgradeElements[i]);
+        }
+    }
+
+    // Drop the orphans' attributes before deleting any of them, so only references
+    // from outside the file keep their handles around
+    for (int i = 0; i < orphaned.Count(); ++i) {
+        CDmeElementAccessor::Purge(GetElement(orphaned[i]));
+    }
+    for (int i = 0; i < orphaned.Count(); ++i) {
+        DeleteElement(orphaned[i], HR_IF_NOT_REFERENCED);
+    }
+
+    m_UpgradeElements.RemoveAll();
+    m_bUpgradingInPlace = false;
+
+    {
+        FileElementSet_t *fes = m_openFiles.GetHandle(fileid);
+        CDmFileArenaScope arenaScope(fes ? fes->m_pArena : NULL);
+        for (int i = 0; i < saved.Count(); ++i) {
+            RetypeUpgradedElement(GetElement(saved[i]));
+        }
+    }
+
+    // As with reading a file, nothing is resolved until every element has its attributes
+    for (int i = 0; i < saved.Count(); ++i) {
+        CDmElement *pElement = GetElement(saved[i]);
+        CDmeElementAccessor::EnableOnChangedCallbacks(pElement);
+        CDmeElementAccessor::FinishUnserialization(pElement);
+    }
+
+    g_pDmElementFrameworkImp->RemoveCleanElementsFromDirtyList();
+}
+
+//-----------------------------------------------------------------------------
+// Replaces an untyped element with one made by its type's factory. The new
+// element takes over the handle, id and referrers of the old one, and gets a
+// copy of the attributes the file would have saved.
+//-----------------------------------------------------------------------------
+void CDataModel::RetypeUpgradedElement(CDmElement *pElement) {
+    const char *pElementType = pElement->GetTypeString();
+    if (m_Factories.Find(pElementType) == m_Factories.InvalidIndex())
+        return; // reading it back in would have left it untyped as well
+
+    DmElementHandle_t hElement = pElement->GetHandle();
+    DmObjectId_t id;
+    CopyUniqueId(pElement->GetId(), &id);
+
+    UtlHashHandle_t h = m_elementIds.Find(id);
+    Assert(h != m_elementIds.InvalidHandle());
+    m_elementIds.Remove(h);
+
+    // Park the untyped element on a scratch handle until its attributes are copied
+    DmElementReference_t ref = *CDmeElementAccessor::GetReference(pElement);
+    DmElementHandle_t hScratch = AcquireElementHandle();
+    m_Handles.SetHandle(hScratch, pElement);
+    CDmeElementAccessor::ChangeHandle(pElement, hScratch);
+
+    CDmElement *pTyped = CreateElement(ref, pElementType, pElement->GetName(), pElement->GetFileId(), &id);
+    if (!pTyped) {
+        m_Handles.SetHandle(hElement, pElement);
+        CDmeElementAccessor::ChangeHandle(pElement, hElement);
+        ReleaseElementHandle(hScratch);
+        m_elementIds.Insert(hElement);
+        return;
+    }
+
+    CDmeElementAccessor::DisableOnChangedCallbacks(pTyped);
+
+    // FirstAttribute is the last one added, so walk them backwards to keep the file's order
+    CUtlVector<CDmAttribute *> attributes(0, pElement->AttributeCount());
+    for (CDmAttribute *pAttr = pElement->FirstAttribute(); pAttr; pAttr = pAttr->NextAttribute()) {
+        if (pAttr->IsStandard() || pAttr->IsFlagSet(FATTRIB_DONTSAVE))
+            continue;
+
+        attributes.AddToTail(pAttr);
+    }
+
+    for (int i = attributes.Count(); --i >= 0;) {
+        CDmAttribute *pSrcAttr = attributes[i];
+        CDmAttribute *pAttr = pTyped->AddAttribute(pSrcAttr->GetName(), pSrcAttr->GetType());
+        if (!pAttr) {
+            CDmAttribute *pExistingAttr = pTyped->GetAttribute(pSrcAttr->GetName());
+            Warning("Unserialize: Attribute '%s' of element '%s' read as '%s' but expected '%s'\n",
+                    pSrcAttr->GetName(), pTyped->GetName(), pSrcAttr->GetTypeString(),
+                    pExistingAttr ? pExistingAttr->GetTypeString() : "unknown");
+            continue;
+        }
+
+        bool bReadOnly = pAttr->IsFlagSet(FATTRIB_READONLY);
+        if (bReadOnly) {
+            pAttr->RemoveFlag(FATTRIB_READONLY);
+        }
+        pAttr->SetValue(pSrcAttr);
+        if (bReadOnly) {
+            pAttr->AddFlag(FATTRIB_READONLY);
+        }
+    }
+
+    CDmeElementAccessor::PerformDestruction(pElement);
+    CDmeElementAccessor::Purge(pElement);
+    m_pDefaultFactory->Destroy(hScratch);
+    ReleaseElementHandle(hScratch);
+}
+
 //-----------------------------------------------------------------------------
 // file id reference methods
 //-----------------------------------------------------------------------------
@@ -1219,6 +1360,9 @@ void CDataModel::RemoveFileId(DmFileId_t fileid) {
     if (fes->m_bLoaded) {
         UnloadFile(fileid, true);
     }
+    if (fes->m_pArena) {
+        fes->m_pArena->Release();
+    }
     delete fes;
 
     m_openFiles.RemoveHandle(fileid);
@@ -1343,6 +1487,12 @@ void CDataModel::UnloadFile(DmFileId_t fileid, bool bDeleteElements) {
     FileElementSet_t *fes = m_openFiles.GetHandle(fileid);
     if (fes) {
         fes->m_bLoaded = false;
+
+        // All of the file's elements are gone, so this normally frees the whole arena at once
+        if (fes->m_pArena) {
+            fes->m_pArena->Release();
+            fes->m_pArena = NULL;
+        }
     }
 }
 
@@ -2103,6 +2253,10 @@ CDataModel::CreateElement(const DmElementReference_t &ref, const char *pElementT
         m_Handles.SetHandle(ref.m_hElement, pElement);
         m_elementIds.Insert(ref.m_hElement);
 
+        if (m_bUpgradingInPlace && pFactory == m_pDefaultFactory) {
+            m_UpgradeElements.Insert(ref.m_hElement);
+        }
+
         CDmeElementAccessor::PerformConstruction(pElement);
         CDmeElementAccessor::EnableOnChangedCallbacks(pElement);
 
@@ -2283,8 +2437,18 @@ void CDataModel::DeleteElement(DmElementHandle_t hElement, DmHandleReleasePolicy
         m_unloadedIdElementMap.Insert(ElementIdHandlePair_t(GetElementId(hElement), *pRef));
     }
 
+    // While upgrading in place, elements that were already loaded keep their own factory
+    bool bUntyped = m_bOnlyCreateUntypedElements;
+    if (m_bUpgradingInPlace) {
+        int nUpgradeIndex = m_UpgradeElements.Find(hElement);
+        bUntyped = nUpgradeIndex != m_UpgradeElements.InvalidIndex();
+        if (bUntyped) {
+            m_UpgradeElements.RemoveAt(nUpgradeIndex);
+        }
+    }
+
     IDmElementFactory *pFactory = NULL;
-    if (m_bOnlyCreateUntypedElements) {
+    if (bUntyped) {
         pFactory = m_pDefaultFactory;
     } else {
         int idx = m_Factories.Find(pElementType);
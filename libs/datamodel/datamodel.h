@@ -21,6 +21,7 @@
 #include "tier1/utlstring.h"
 #include "tier1/utlhandletable.h"
 #include "tier1/utlhash.h"
+#include "tier1/utlrbtree.h"
 #include "tier2/tier2.h"
 #include "clipboardmanager.h"
 #include "undomanager.h"
@@ -33,6 +34,7 @@
 class IDmElementFramework;
 class IUndoElement;
 class CDmElement;
+class CDmFileArena;
 
 enum DmHandleReleasePolicy
 {
@@ -158,10 +160,11 @@ struct FileElementSet_t
 		m_hRoot( DMELEMENT_HANDLE_INVALID ),
 		m_bLoaded( true ),
 		m_nElements( 0 ),
-		m_fileModificationTime( 0 )
+		m_fileModificationTime( 0 ),
+		m_pArena( NULL )
 	{
 	}
-	FileElementSet_t( const FileElementSet_t& that ) : m_filename( that.m_filename ), m_format( that.m_format ), m_hRoot( DMELEMENT_HANDLE_INVALID ), m_bLoaded( that.m_bLoaded ), m_nElements( that.m_nElements )
+	FileElementSet_t( const FileElementSet_t& that ) : m_filename( that.m_filename ), m_format( that.m_format ), m_hRoot( DMELEMENT_HANDLE_INVALID ), m_bLoaded( that.m_bLoaded ), m_nElements( that.m_nElements ), m_pArena( NULL )
 	{
 		// the only time this should be copy constructed is when passing in an empty set to the parent array
 		// otherwise it could get prohibitively expensive time and memory wise
@@ -174,6 +177,7 @@ struct FileElementSet_t
 	bool m_bLoaded;
 	int m_nElements;
 	long m_fileModificationTime;
+	CDmFileArena *m_pArena; // attributes created while unserializing this file live here
 };
 
 
@@ -246,6 +250,7 @@ public:
 	virtual void				SetKeyValuesElementCallback( IElementForKeyValueCallback *pCallbackInterface );
 	virtual const char *		GetKeyValuesElementName( const char *pszKeyName, int iNestingLevel );
 	virtual CUtlSymbolLarge			GetSymbol( const char *pString );
+	virtual CUtlSymbolLarge			FindSymbol( const char *pString );
 	virtual int					GetElementsAllocatedSoFar();
 	virtual int					GetMaxNumberOfElements();
 	virtual int					GetAllocatedAttributeCount();
@@ -429,6 +434,10 @@ private:
 	void UnloadFile( DmFileId_t fileid, bool bDeleteElements );
 	void SetFileModificationUTCTime( DmFileId_t fileid, long fileModificationTime );
 
+	// Turns the untyped elements left by upgrading a legacy file into typed ones
+	void FinishInPlaceUpgrade( DmFileId_t fileid, DmElementHandle_t hRoot, bool bSucceeded );
+	void RetypeUpgradedElement( CDmElement *pElement );
+
 	friend class CDmeElementRefHelper;
 	friend class CDmAttribute;
 	template< class T > friend class CDmArrayAttributeOp;
@@ -447,7 +456,7 @@ private:
 
 	IDmElementFactory *m_pDefaultFactory;
 	CUtlDict< CDmElementFactoryHelper*, int >	m_Factories;
-	CUtlSymbolTableLarge m_SymbolTable;
+	CUtlSymbolTableLargeMT m_SymbolTable;
 	CUtlHandleTable< CDmElement, 21 > m_Handles;
 	CUtlHandleTable< CDmAttribute, 21 > m_AttributeHandles;
 	CUndoManager m_UndoMgr;
@@ -457,12 +466,16 @@ private:
 	bool m_bOnlyCreateUntypedElements : 1;
 	bool m_bUnableToCreateOnlyUntypedElements : 1;
 	bool m_bDeleteOrphanedElements : 1;
+	bool m_bUpgradingInPlace : 1;
 
 	CUtlHandleTable< FileElementSet_t, 20 > m_openFiles;
 
 	CElementIdHash m_elementIds;
 	CUtlHash< ElementIdHandlePair_t > m_unloadedIdElementMap;
 
+	// Untyped elements created while upgrading a legacy file in place
+	CUtlRBTree< DmElementHandle_t, int > m_UpgradeElements;
+
 	CClipboardManager m_ClipboardMgr;
 	IElementForKeyValueCallback *m_pKeyvaluesCallbackInterface;
 
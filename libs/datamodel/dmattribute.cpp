@@ -10,6 +10,7 @@
 #include "dmelementdictionary.h"
 #include "datamodel/idatamodel.h"
 #include "datamodel.h"
+#include "dmfilearena.h"
 #include "tier1/uniqueid.h"
 #include "color.h"
 #include "mathlib/vector.h"
@@ -99,6 +100,8 @@ abstract_class IDmAttributeOp
 public:
 	virtual void* CreateAttributeData() = 0;
 	virtual void DestroyAttributeData( void *pData ) = 0;
+	virtual void* ConstructAttributeData( void *pMemory ) = 0;
+	virtual void DestructAttributeData( void *pData ) = 0;
 	virtual void SetDefaultValue( void *pData ) = 0;
 	virtual int DataSize() = 0;
 	virtual int ValueSize() = 0;
@@ -137,6 +140,8 @@ class CDmAttributeOp : public IDmAttributeOp
 public:
 	virtual void* CreateAttributeData();
 	virtual void DestroyAttributeData( void *pData );
+	virtual void* ConstructAttributeData( void *pMemory );
+	virtual void DestructAttributeData( void *pData );
 	virtual void SetDefaultValue( void *pData );
 	virtual int DataSize();
 	virtual int ValueSize();
@@ -254,6 +259,33 @@ void CDmAttributeOp<T>::DestroyAttributeData( void *pData )
 }
 
 
+//-----------------------------------------------------------------------------
+// Construct, destruct attribute data in memory owned by someone else (file arenas)
+//-----------------------------------------------------------------------------
+template< class T >
+void* CDmAttributeOp<T>::ConstructAttributeData( void *pMemory )
+{
+	typedef typename CDmAttributeInfo< T >::StorageType_t D;
+	D *pData = ::new( pMemory ) D();
+	CDmAttributeInfo< T >::SetDefaultValue( *reinterpret_cast<T*>( pData ) );
+	return pData;
+}
+
+template<> void* CDmAttributeOp< DmUnknownAttribute_t >::ConstructAttributeData( void *pMemory )
+{
+	// Fail if someone tries to create an AT_UNKNOWN attribute
+	Assert(0);
+	return NULL;
+}
+
+template< class T >
+void CDmAttributeOp<T>::DestructAttributeData( void *pData )
+{
+	typedef typename CDmAttributeInfo< T >::StorageType_t D;
+	reinterpret_cast< D* >( pData )->~D();
+}
+
+
 //-----------------------------------------------------------------------------
 // Sets the data to a default value, no undo (used for construction)
 //-----------------------------------------------------------------------------
@@ -1973,7 +2005,8 @@ CDmAttribute *CDmAttribute::CreateAttribute( CDmElement *pOwner, DmAttributeType
 			void *pMem = 0;
 			{
 				DMX_PROFILE_SCOPE( CreateAttribute_Alloc );
-				pMem = g_AttrAlloc.Alloc( sizeof( CDmAttribute ) );
+				CDmFileArena *pArena = pOwner ? CDmFileArena::GetActiveArena( pOwner->GetFileId() ) : NULL;
+				pMem = pArena ? pArena->Alloc( sizeof( CDmAttribute ) ) : g_AttrAlloc.Alloc( sizeof( CDmAttribute ) );
 			}
 			{
 				DMX_PROFILE_SCOPE( CreateAttribute_new_CDmAttribute );
@@ -1996,7 +2029,8 @@ CDmAttribute *CDmAttribute::CreateExternalAttribute( CDmElement *pOwner, DmAttri
 			void *pMem = 0;
 			{
 				DMX_PROFILE_SCOPE( CreateExternalAttribute_Alloc );
-				pMem = g_AttrAlloc.Alloc( sizeof( CDmAttribute ) );
+				CDmFileArena *pArena = pOwner ? CDmFileArena::GetActiveArena( pOwner->GetFileId() ) : NULL;
+				pMem = pArena ? pArena->Alloc( sizeof( CDmAttribute ) ) : g_AttrAlloc.Alloc( sizeof( CDmAttribute ) );
 			}
 			{
 				DMX_PROFILE_SCOPE( CreateExternalAttribute_new_CDmAttribute );
@@ -2023,7 +2057,14 @@ void CDmAttribute::DestroyAttribute( CDmAttribute *pAttribute )
 		memset( pAttribute, 0xDD, sizeof(CDmAttribute) );
 #endif
 
-		g_AttrAlloc.Free( pAttribute );
+		if ( CDmFileArena *pArena = CDmFileArena::FindArena( pAttribute ) )
+		{
+			pArena->Free( pAttribute );
+		}
+		else
+		{
+			g_AttrAlloc.Free( pAttribute );
+		}
 		break;
 	}
 }
@@ -2118,7 +2159,18 @@ void CDmAttribute::CreateAttributeData()
 	if ( !IsFlagSet( FATTRIB_EXTERNAL ) )
 	{
 		Assert( !m_pData );
-		m_pData = s_pAttrInfo[ GetType() ]->CreateAttributeData( );
+
+		// Attributes created while their file is being unserialized put their data in the file's arena
+		CDmFileArena *pArena = m_pOwner ? CDmFileArena::GetActiveArena( m_pOwner->GetFileId() ) : NULL;
+		void *pMemory = pArena ? pArena->Alloc( s_pAttrInfo[ GetType() ]->DataSize() ) : NULL;
+		if ( pMemory )
+		{
+			m_pData = s_pAttrInfo[ GetType() ]->ConstructAttributeData( pMemory );
+		}
+		else
+		{
+			m_pData = s_pAttrInfo[ GetType() ]->CreateAttributeData( );
+		}
 	}
 }
 
@@ -2131,7 +2183,15 @@ void CDmAttribute::DeleteAttributeData()
 	// Free the attribute memory
 	if ( m_pData && !IsFlagSet( FATTRIB_EXTERNAL ) )
 	{
-		s_pAttrInfo[ GetType() ]->DestroyAttributeData( m_pData );
+		if ( CDmFileArena *pArena = CDmFileArena::FindArena( m_pData ) )
+		{
+			s_pAttrInfo[ GetType() ]->DestructAttributeData( m_pData );
+			pArena->Free( m_pData );
+		}
+		else
+		{
+			s_pAttrInfo[ GetType() ]->DestroyAttributeData( m_pData );
+		}
 		m_pData = NULL;
 	}
 }
@@ -205,7 +205,10 @@ int	CDmElement::GetInheritanceDepth( CUtlSymbolLarge typeSymbol ) const
 // Helper for GetInheritanceDepth
 int CDmElement::GetInheritanceDepth( const char *pTypeName ) const
 {
-	CUtlSymbolLarge typeSymbol = g_pDataModel->GetSymbol( pTypeName );
+	// An unknown type name can't be in the hierarchy; don't add it to the symbol table
+	CUtlSymbolLarge typeSymbol = g_pDataModel->FindSymbol( pTypeName );
+	if ( pTypeName && !typeSymbol.IsValid() )
+		return -1;
 	return GetInheritanceDepth( typeSymbol ); 
 }
 
@@ -1048,7 +1051,10 @@ void CDmElement::RemoveAttribute( CDmAttribute **pAttrRef )
 
 void CDmElement::RemoveAttribute( const char *pAttributeName )
 {
-	CUtlSymbolLarge find = g_pDataModel->GetSymbol( pAttributeName );
+	CUtlSymbolLarge find = g_pDataModel->FindSymbol( pAttributeName );
+	if ( !find.IsValid() )
+		return;
+
 	for ( CDmAttribute **ppAttr = &m_pAttributes; *ppAttr; ppAttr = ( *ppAttr )->GetNextAttributeRef() )
 	{
 		if ( find == ( *ppAttr )->GetNameSymbol() )
@@ -1201,7 +1207,10 @@ CDmAttribute* CDmElement::AddExternalAttribute( const char *pAttributeName, DmAt
 //-----------------------------------------------------------------------------
 CDmAttribute *CDmElement::FindAttribute( const char *pAttributeName ) const
 {
-	CUtlSymbolLarge find = g_pDataModel->GetSymbol( pAttributeName );
+	// Lookups for names nobody has used shouldn't grow the symbol table
+	CUtlSymbolLarge find = g_pDataModel->FindSymbol( pAttributeName );
+	if ( !find.IsValid() )
+		return NULL;
 
 	for ( CDmAttribute *pAttr = m_pAttributes; pAttr; pAttr = pAttr->NextAttribute() )
 	{
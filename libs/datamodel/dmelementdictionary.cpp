@@ -287,74 +287,64 @@ void CDmElementDictionary::HookUpElementReferences()
 // Element dictionary used in serialization
 //
 //-----------------------------------------------------------------------------
-CDmElementSerializationDictionary::CDmElementSerializationDictionary() :
-	m_Dict( 1024, 0, CDmElementSerializationDictionary::LessFunc )
+CDmElementSerializationDictionary::CDmElementSerializationDictionary()
 {
 }
 
 
-//-----------------------------------------------------------------------------
-// Used to sort the list of elements
-//-----------------------------------------------------------------------------
-bool CDmElementSerializationDictionary::LessFunc( const ElementInfo_t &lhs, const ElementInfo_t &rhs )
-{
-	return lhs.m_pElement < rhs.m_pElement;
-}
-
-
 //-----------------------------------------------------------------------------
 // Finds the handle of the element
 //-----------------------------------------------------------------------------
 DmElementDictHandle_t CDmElementSerializationDictionary::Find( CDmElement *pElement )
 {
-	ElementInfo_t find;
-	find.m_pElement = pElement;
-	return m_Dict.Find( find );
+	UtlHashHandle_t h = m_ElementIndices.Find( pElement );
+	return ( h != m_ElementIndices.InvalidHandle() ) ? m_ElementIndices.Element( h ) : ELEMENT_DICT_HANDLE_INVALID;
 }
 
-	
+
 //-----------------------------------------------------------------------------
-// Creates the list of all things to serialize
+// Adds an element to the list; returns false if it was already in there
 //-----------------------------------------------------------------------------
-void CDmElementSerializationDictionary::BuildElementList_R( CDmElement *pElement, bool bFlatMode, bool bIsRoot )
+bool CDmElementSerializationDictionary::AddElement( CDmElement *pElement, bool bIsRoot )
 {
-	if ( !pElement )
-		return;
-
-	// FIXME: Right here we should ask the element if it's an external
-	// file reference and exit immediately if so.
-
-	// This means we've already encountered this guy.
-	// Therefore, he can never be a root element
-	DmElementDictHandle_t h = Find( pElement );
-	if ( h != m_Dict.InvalidIndex() )
+	bool bInserted = false;
+	UtlHashHandle_t h = m_ElementIndices.Insert( pElement, m_Dict.Count(), &bInserted );
+	if ( !bInserted )
 	{
-		m_Dict[h].m_bRoot = true;
-		return;
+		// This means we've already encountered this guy.
+		// Therefore, he can never be a root element
+		m_Dict[ m_ElementIndices.Element( h ) ].m_bRoot = true;
+		return false;
 	}
 
-	ElementInfo_t info;
-	info.m_bRoot = bFlatMode || bIsRoot;
+	ElementInfo_t &info = m_Dict[ m_Dict.AddToTail() ];
+	info.m_bRoot = bIsRoot;
 	info.m_pElement = pElement;
-	m_Dict.Insert( info );
+	return true;
+}
 
-	// Tell the element we're about to serialize it
-	pElement->OnElementSerialized();
 
-	for ( CDmAttribute *pAttribute = pElement->FirstAttribute(); pAttribute; pAttribute = pAttribute->NextAttribute() )
+//-----------------------------------------------------------------------------
+// Returns the next child of the frame's element that lives in the same file
+//-----------------------------------------------------------------------------
+CDmElement *CDmElementSerializationDictionary::NextChildElement( BuildFrame_t &frame )
+{
+	DmFileId_t fileid = frame.m_pElement->GetFileId();
+	for ( ; frame.m_pAttribute; frame.m_pAttribute = frame.m_pAttribute->NextAttribute(), frame.m_nArrayIndex = 0 )
 	{
+		CDmAttribute *pAttribute = frame.m_pAttribute;
 		if ( pAttribute->IsFlagSet( FATTRIB_DONTSAVE ) )
 			continue;
 
 		switch( pAttribute->GetType() )
 		{
 		case AT_ELEMENT:
+			if ( frame.m_nArrayIndex == 0 )
 			{
+				frame.m_nArrayIndex = 1;
 				CDmElement *pChild = pAttribute->GetValueElement<CDmElement>();
-				if ( !pChild || pChild->GetFileId() != pElement->GetFileId() )
-					break;
-
-				BuildElementList_R( pChild, bFlatMode, false );
+				if ( pChild && pChild->GetFileId() == fileid )
+					return pChild;
 			}
 			break;
 
@@ -362,23 +352,64 @@ void CDmElementSerializationDictionary::BuildElementList_R( CDmElement *pElement
 			{
 				CDmrElementArray<> array( pAttribute );
 				int nCount = array.Count();
-				for ( int i = 0; i < nCount; ++i )
+				while ( frame.m_nArrayIndex < nCount )
 				{
-					CDmElement *pChild = array[i];
-					if ( !pChild || pChild->GetFileId() != pElement->GetFileId() )
-						continue;
-
-					BuildElementList_R( pChild, bFlatMode, false );
+					CDmElement *pChild = array[ frame.m_nArrayIndex++ ];
+					if ( pChild && pChild->GetFileId() == fileid )
+						return pChild;
 				}
 			}
 			break;
 		}
 	}
+	return NULL;
 }
 
+	
+//-----------------------------------------------------------------------------
+// Creates the list of all things to serialize
+// NOTE: This walks the tree with an explicit stack, visiting elements in
+// exactly the order a depth-first recursion would, since that order
+// determines the element indices written out by the serializers
+//-----------------------------------------------------------------------------
 void CDmElementSerializationDictionary::BuildElementList( CDmElement *pElement, bool bFlatMode )
 {
-	BuildElementList_R( pElement, bFlatMode, true );
+	if ( !pElement )
+		return;
+
+	// FIXME: Right here we should ask the element if it's an external
+	// file reference and exit immediately if so.
+	if ( !AddElement( pElement, true ) )
+		return;
+
+	// Tell the element we're about to serialize it
+	pElement->OnElementSerialized();
+
+	CUtlVector< BuildFrame_t > stack( 0, 64 );
+	BuildFrame_t &root = stack[ stack.AddToTail() ];
+	root.m_pElement = pElement;
+	root.m_pAttribute = pElement->FirstAttribute();
+	root.m_nArrayIndex = 0;
+
+	while ( stack.Count() )
+	{
+		CDmElement *pChild = NextChildElement( stack.Tail() );
+		if ( !pChild )
+		{
+			stack.RemoveMultipleFromTail( 1 );
+			continue;
+		}
+
+		if ( !AddElement( pChild, bFlatMode ) )
+			continue;
+
+		pChild->OnElementSerialized();
+
+		BuildFrame_t &frame = stack[ stack.AddToTail() ];
+		frame.m_pElement = pChild;
+		frame.m_pAttribute = pChild->FirstAttribute();
+		frame.m_nArrayIndex = 0;
+	}
 }
 
 
@@ -390,7 +421,7 @@ bool CDmElementSerializationDictionary::ShouldInlineElement( CDmElement *pElemen
 	// This means we've already encountered this guy.
 	// Therefore, he can never be a root element
 	DmElementDictHandle_t h = Find( pElement );
-	if ( h != m_Dict.InvalidIndex() )
+	if ( h != ELEMENT_DICT_HANDLE_INVALID )
 		return !m_Dict[h].m_bRoot;
 
 	// If we didn't find the element, it means it's a reference to an external
@@ -405,6 +436,7 @@ bool CDmElementSerializationDictionary::ShouldInlineElement( CDmElement *pElemen
 void CDmElementSerializationDictionary::Clear()
 {
 	m_Dict.RemoveAll();
+	m_ElementIndices.RemoveAll();
 }
 
 
@@ -414,14 +446,13 @@ void CDmElementSerializationDictionary::Clear()
 int CDmElementSerializationDictionary::RootElementCount() const
 {
 	int nCount = 0;
-	DmElementDictHandle_t h = m_Dict.FirstInorder();
-	while( h != m_Dict.InvalidIndex() )
+	int nElements = m_Dict.Count();
+	for ( DmElementDictHandle_t h = 0; h < nElements; ++h )
 	{
 		if ( m_Dict[h].m_bRoot )
 		{
 			++nCount;
 		}
-		h = m_Dict.NextInorder( h );
 	}
 	return nCount;
 }
@@ -432,11 +463,8 @@ int CDmElementSerializationDictionary::RootElementCount() const
 //-----------------------------------------------------------------------------
 DmElementDictHandle_t CDmElementSerializationDictionary::FirstRootElement() const
 {
-	// NOTE - this code only works with BlockMemory or Memory (NOT FixedMemory)
-
-	// NOTE: I don't have to use First/NextInorder here because there
-	// are guaranteed to be no removals from the dictionary.
-	// Also, using inorder traversal won't get my actual root element to be first in the file
+	// NOTE: Elements are stored in the order they were encountered,
+	// which gets the actual root element to be first in the file
 	int nCount = m_Dict.Count();
 	for ( DmElementDictHandle_t h = 0; h < nCount; ++h )
 	{
@@ -448,11 +476,8 @@ DmElementDictHandle_t CDmElementSerializationDictionary::FirstRootElement() cons
 
 DmElementDictHandle_t CDmElementSerializationDictionary::NextRootElement( DmElementDictHandle_t h ) const
 {
-	// NOTE - this code only works with BlockMemory or Memory (NOT FixedMemory)
-
-	// NOTE: I don't have to use First/NextInorder here because there
-	// are guaranteed to be no removals from the dictionary.
-	// Also, using inorder traversal won't get my actual root element to be first in the file
+	// NOTE: Elements are stored in the order they were encountered,
+	// which gets the actual root element to be first in the file
 	++h;
 	int nCount = m_Dict.Count();
 	for ( ; h < nCount; ++h )
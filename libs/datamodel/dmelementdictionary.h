@@ -17,6 +17,7 @@
 #include "datamodel/dmattribute.h"
 #include "tier1/utlrbtree.h"
 #include "tier1/utlhash.h"
+#include "tier1/utlhashtable.h"
 
 
 //-----------------------------------------------------------------------------
@@ -174,11 +175,23 @@ private:
 		CDmElement* m_pElement;
 	};
 
-	// Creates the list of all things to serialize
-	void BuildElementList_R( CDmElement *pRoot, bool bFlatMode, bool bIsRoot );
-	static bool LessFunc( const ElementInfo_t &lhs, const ElementInfo_t &rhs );
+	// Walk state for one element while building the list
+	struct BuildFrame_t
+	{
+		CDmElement *m_pElement;
+		CDmAttribute *m_pAttribute;
+		int m_nArrayIndex;
+	};
+
+	// Adds an element to the list; returns false if it was already in there
+	bool AddElement( CDmElement *pElement, bool bIsRoot );
+
+	// Returns the next child of the frame's element that lives in the same file
+	CDmElement *NextChildElement( BuildFrame_t &frame );
 
-	CUtlBlockRBTree< ElementInfo_t, DmElementDictHandle_t > m_Dict;
+	// Elements in the order they were encountered; handles are indices into this
+	CUtlVector< ElementInfo_t > m_Dict;
+	CUtlHashtable< CDmElement*, DmElementDictHandle_t, PointerHashFunctor, PointerEqualFunctor > m_ElementIndices;
 };
 
 
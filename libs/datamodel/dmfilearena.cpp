@@ -0,0 +1,129 @@
+//====== Copyright � 1996-2004, Valve Corporation, All rights reserved. =======
+//
+// Purpose: Per-file bump allocator used while unserializing DMX files
+//
+//=============================================================================
+
+#include "dmfilearena.h"
+#include "tier0/memalloc.h"
+#include "tier1/utlhash.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+// DISABLED #include "tier0/memdbgon.h"
+
+
+CDmFileArena *CDmFileArena::s_pActiveArena = NULL;
+
+
+//-----------------------------------------------------------------------------
+// Maps chunk addresses (shifted down by CHUNK_SHIFT) to the arena owning them.
+// Chunks are aligned to their size, so any pointer inside one maps to its key.
+//-----------------------------------------------------------------------------
+static CUtlHashFast< CDmFileArena*, CUtlHashFastGenericHash > &ChunkMap()
+{
+	static CUtlHashFast< CDmFileArena*, CUtlHashFastGenericHash > s_ChunkMap;
+	static bool s_bInitialized = false;
+	if ( !s_bInitialized )
+	{
+		s_ChunkMap.Init( 1024 );
+		s_bInitialized = true;
+	}
+	return s_ChunkMap;
+}
+
+
+//-----------------------------------------------------------------------------
+// Constructor, destructor
+//-----------------------------------------------------------------------------
+CDmFileArena::CDmFileArena( DmFileId_t fileid ) :
+	m_pNextAlloc( NULL ), m_pChunkLimit( NULL ), m_nLiveBlocks( 0 ), m_FileId( fileid ), m_bReleased( false )
+{
+}
+
+CDmFileArena::~CDmFileArena()
+{
+	Assert( m_nLiveBlocks == 0 );
+	Assert( s_pActiveArena != this );
+
+	int nChunks = m_Chunks.Count();
+	for ( int i = 0; i < nChunks; ++i )
+	{
+		UtlHashFastHandle_t h = ChunkMap().Find( (uintp)m_Chunks[ i ] >> CHUNK_SHIFT );
+		Assert( h != ChunkMap().InvalidHandle() );
+		ChunkMap().Remove( h );
+		MemAlloc_FreeAligned( m_Chunks[ i ] );
+	}
+	m_Chunks.Purge();
+}
+
+CDmFileArena *CDmFileArena::Create( DmFileId_t fileid )
+{
+	return new CDmFileArena( fileid );
+}
+
+
+//-----------------------------------------------------------------------------
+// The file owning the arena has been unloaded
+//-----------------------------------------------------------------------------
+void CDmFileArena::Release()
+{
+	Assert( !m_bReleased );
+	m_bReleased = true;
+	if ( s_pActiveArena == this )
+	{
+		s_pActiveArena = NULL;
+	}
+
+	if ( m_nLiveBlocks == 0 )
+	{
+		delete this;
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Adds a new chunk to bump-allocate out of
+//-----------------------------------------------------------------------------
+void CDmFileArena::AllocChunk()
+{
+	MEM_ALLOC_CREDIT_CLASS();
+
+	byte *pChunk = (byte*)MemAlloc_AllocAligned( CHUNK_SIZE, CHUNK_SIZE );
+	m_Chunks.AddToTail( pChunk );
+	ChunkMap().Insert( (uintp)pChunk >> CHUNK_SHIFT, this );
+
+	m_pNextAlloc = pChunk;
+	m_pChunkLimit = pChunk + CHUNK_SIZE;
+}
+
+
+//-----------------------------------------------------------------------------
+// Blocks aren't reused; the chunks go away when the last block is freed
+//-----------------------------------------------------------------------------
+void CDmFileArena::Free( void *pMemory )
+{
+	Assert( FindArena( pMemory ) == this );
+	Assert( m_nLiveBlocks > 0 );
+
+#ifdef _DEBUG
+	memset( pMemory, 0xDD, BLOCK_ALIGNMENT );
+#endif
+
+	if ( --m_nLiveBlocks == 0 && m_bReleased )
+	{
+		delete this;
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Finds the arena a block was allocated from
+//-----------------------------------------------------------------------------
+CDmFileArena *CDmFileArena::FindArena( const void *pMemory )
+{
+	if ( !pMemory )
+		return NULL;
+
+	UtlHashFastHandle_t h = ChunkMap().Find( (uintp)pMemory >> CHUNK_SHIFT );
+	return ( h != ChunkMap().InvalidHandle() ) ? ChunkMap()[ h ] : NULL;
+}
@@ -0,0 +1,126 @@
+//====== Copyright � 1996-2004, Valve Corporation, All rights reserved. =======
+//
+// Purpose: Per-file bump allocator used while unserializing DMX files
+//
+//=============================================================================
+
+#ifndef DMFILEARENA_H
+#define DMFILEARENA_H
+
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include "tier1/utlvector.h"
+#include "datamodel/idatamodel.h"
+
+
+//-----------------------------------------------------------------------------
+// Arena that CDmAttributes and their data are placement-constructed into
+// while a file is being unserialized.
+//
+// Blocks are never individually returned to the heap; freeing a block only
+// drops the arena's live count. Once the owning file is unloaded (Release)
+// and the live count reaches zero, all chunks go back to the heap at once.
+// Attributes that outlive their file (because their element was moved to
+// another file) simply keep the arena alive until they're destroyed.
+//-----------------------------------------------------------------------------
+class CDmFileArena
+{
+public:
+	static CDmFileArena *Create( DmFileId_t fileid );
+
+	// Called when the owning file is unloaded; the arena deletes itself
+	// as soon as there are no more live blocks in it
+	void Release();
+
+	DmFileId_t GetFileId() const { return m_FileId; }
+	int GetLiveCount() const { return m_nLiveBlocks; }
+	size_t GetCommittedBytes() const { return (size_t)m_Chunks.Count() * CHUNK_SIZE; }
+
+	void *Alloc( size_t nBytes );
+	void Free( void *pMemory );
+
+	// Returns the arena the memory was allocated from, or NULL if it came from somewhere else
+	static CDmFileArena *FindArena( const void *pMemory );
+
+	// The arena (if any) that attribute memory for elements in its file should come from
+	static CDmFileArena *GetActiveArena( DmFileId_t fileid );
+
+private:
+	enum
+	{
+		CHUNK_SHIFT = 18,
+		CHUNK_SIZE = 1 << CHUNK_SHIFT,
+		MAX_BLOCK_SIZE = 256,
+		BLOCK_ALIGNMENT = 16,
+	};
+
+	CDmFileArena( DmFileId_t fileid );
+	~CDmFileArena();
+
+	void AllocChunk();
+
+	CUtlVector< byte* > m_Chunks;
+	byte *m_pNextAlloc;
+	byte *m_pChunkLimit;
+	int m_nLiveBlocks;
+	DmFileId_t m_FileId;
+	bool m_bReleased;
+
+	static CDmFileArena *s_pActiveArena;
+
+	friend class CDmFileArenaScope;
+};
+
+
+//-----------------------------------------------------------------------------
+// Makes an arena active for the duration of an unserialize call
+//-----------------------------------------------------------------------------
+class CDmFileArenaScope
+{
+public:
+	CDmFileArenaScope( CDmFileArena *pArena ) : m_pPrevArena( CDmFileArena::s_pActiveArena )
+	{
+		CDmFileArena::s_pActiveArena = pArena;
+	}
+	~CDmFileArenaScope()
+	{
+		CDmFileArena::s_pActiveArena = m_pPrevArena;
+	}
+
+private:
+	CDmFileArena *m_pPrevArena;
+};
+
+
+//-----------------------------------------------------------------------------
+// Inline methods
+//-----------------------------------------------------------------------------
+inline CDmFileArena *CDmFileArena::GetActiveArena( DmFileId_t fileid )
+{
+	if ( !s_pActiveArena || s_pActiveArena->m_FileId != fileid )
+		return NULL;
+	return s_pActiveArena;
+}
+
+inline void *CDmFileArena::Alloc( size_t nBytes )
+{
+	Assert( !m_bReleased );
+	if ( nBytes > MAX_BLOCK_SIZE )
+		return NULL;
+
+	nBytes = AlignValue( MAX( nBytes, (size_t)1 ), (size_t)BLOCK_ALIGNMENT );
+	if ( m_pNextAlloc + nBytes > m_pChunkLimit )
+	{
+		AllocChunk();
+	}
+
+	void *pResult = m_pNextAlloc;
+	m_pNextAlloc += nBytes;
+	++m_nLiveBlocks;
+	return pResult;
+}
+
+
+#endif // DMFILEARENA_H
@@ -13,6 +13,7 @@
 #include "dmelementdictionary.h"
 #include "tier1/utlbuffer.h"
 #include "tier1/utlbufferutil.h"
+#include "tier1/utlhashtable.h"
 #include "DmElementFramework.h"
 
 
@@ -63,8 +64,8 @@ public:
 
 private:
 
-	// For serialize
-	typedef CUtlDict< int, int > mapSymbolToIndex_t;
+	// For serialize (case sensitive, keyed on the strings in the file's symbol table)
+	typedef CUtlHashtable< const char*, int > mapSymbolToIndex_t;
 	// For unserialize
 	typedef CUtlMap< int, CUtlSymbolLarge > mapIndexToSymbol_t;
 
@@ -76,6 +77,13 @@ private:
 	bool SaveElementDict( CUtlBuffer& buf, mapSymbolToIndex_t *pStringValueSymbols, CDmElement *pElement );
 	bool SaveElement( CUtlBuffer& buf, CDmElementSerializationDictionary& dict, mapSymbolToIndex_t *pStringValueSymbols, CDmElement *pElement);
 	void GatherSymbols( CUtlSymbolTableLarge *pStringValueSymbols, CDmElement *pElement );
+	bool SerializeArrayAttributeBulk( CUtlBuffer &buf, CDmAttribute *pAttribute );
+
+	inline int Dme_GetIndexFromString( mapSymbolToIndex_t *pMap, const char *pString )
+	{
+		UtlHashHandle_t h = pMap->Find( pString );
+		return ( h != pMap->InvalidHandle() ) ? pMap->Element( h ) : -1;
+	}
 
 	// Methods related to unserialization
 	DmElementHandle_t UnserializeElementIndex( CUtlBuffer &buf, CUtlVector<CDmElement*> &elementList );
@@ -205,12 +213,15 @@ bool CDmSerializerBinary::SerializeAttributes( CUtlBuffer& buf, CDmElementSerial
 		CDmAttribute *pAttribute = ppAttributes[ i ];
 		Assert( pAttribute );
 
-		buf.PutInt( pStringValueSymbols->Find(pAttribute->GetName()) );
+		buf.PutInt( Dme_GetIndexFromString( pStringValueSymbols, pAttribute->GetName() ) );
 		buf.PutChar( pAttribute->GetType() );
 		switch( pAttribute->GetType() )
 		{
 		default:
- 			pAttribute->Serialize( buf );
+			if ( !SerializeArrayAttributeBulk( buf, pAttribute ) )
+			{
+				pAttribute->Serialize( buf );
+			}
 			break;
 
 		case AT_ELEMENT:
@@ -222,7 +233,7 @@ bool CDmSerializerBinary::SerializeAttributes( CUtlBuffer& buf, CDmElementSerial
 			break;
 
 		case AT_STRING:
-			buf.PutInt( pStringValueSymbols->Find(pAttribute->GetValueString()) );
+			buf.PutInt( Dme_GetIndexFromString( pStringValueSymbols, pAttribute->GetValueString() ) );
 			break;
 		}
 	}
@@ -239,12 +250,72 @@ bool CDmSerializerBinary::SaveElement( CUtlBuffer& buf, CDmElementSerializationD
 
 bool CDmSerializerBinary::SaveElementDict( CUtlBuffer& buf, mapSymbolToIndex_t *pStringValueSymbols, CDmElement *pElement )
 {
-	buf.PutInt( pStringValueSymbols->Find( pElement->GetTypeString() ) );
-	buf.PutInt( pStringValueSymbols->Find( pElement->GetName() ) );
+	buf.PutInt( Dme_GetIndexFromString( pStringValueSymbols, pElement->GetTypeString() ) );
+	buf.PutInt( Dme_GetIndexFromString( pStringValueSymbols, pElement->GetName() ) );
 	buf.Put( &pElement->GetId(), sizeof(DmObjectId_t) );
 	return buf.IsValid();
 }
 
+//-----------------------------------------------------------------------------
+// Writes out arrays of plain float/int data with a single copy.
+// The layout matches what ::Serialize writes for a CUtlVector of these types,
+// which never byteswaps outside of the consoles
+//-----------------------------------------------------------------------------
+template< class T >
+static void PutArrayBin( CUtlBuffer &buf, CDmAttribute *pAttribute )
+{
+	CDmrArrayConst< T > array( pAttribute );
+	int nCount = array.Count();
+	buf.PutInt( nCount );
+	if ( nCount )
+	{
+		buf.Put( array.Base(), nCount * sizeof( T ) );
+	}
+}
+
+bool CDmSerializerBinary::SerializeArrayAttributeBulk( CUtlBuffer &buf, CDmAttribute *pAttribute )
+{
+#ifdef _GAMECONSOLE
+	return false;
+#else
+	COMPILE_TIME_ASSERT( sizeof( Vector2D ) == 2 * sizeof( float ) );
+	COMPILE_TIME_ASSERT( sizeof( Vector ) == 3 * sizeof( float ) );
+	COMPILE_TIME_ASSERT( sizeof( Vector4D ) == 4 * sizeof( float ) );
+	COMPILE_TIME_ASSERT( sizeof( QAngle ) == 3 * sizeof( float ) );
+	COMPILE_TIME_ASSERT( sizeof( Quaternion ) == 4 * sizeof( float ) );
+
+	if ( buf.IsText() )
+		return false;
+
+	switch( pAttribute->GetType() )
+	{
+	case AT_INT_ARRAY:
+		PutArrayBin< int >( buf, pAttribute );
+		return true;
+	case AT_FLOAT_ARRAY:
+		PutArrayBin< float >( buf, pAttribute );
+		return true;
+	case AT_VECTOR2_ARRAY:
+		PutArrayBin< Vector2D >( buf, pAttribute );
+		return true;
+	case AT_VECTOR3_ARRAY:
+		PutArrayBin< Vector >( buf, pAttribute );
+		return true;
+	case AT_VECTOR4_ARRAY:
+		PutArrayBin< Vector4D >( buf, pAttribute );
+		return true;
+	case AT_QANGLE_ARRAY:
+		PutArrayBin< QAngle >( buf, pAttribute );
+		return true;
+	case AT_QUATERNION_ARRAY:
+		PutArrayBin< Quaternion >( buf, pAttribute );
+		return true;
+	default:
+		return false;
+	}
+#endif
+}
+
 void CDmSerializerBinary::GatherSymbols( CUtlSymbolTableLarge *pStringValueSymbols, CDmElement *pElement )
 {
 	pStringValueSymbols->AddString( pElement->GetTypeString() );
@@ -284,10 +355,9 @@ bool CDmSerializerBinary::Serialize( CUtlBuffer &outBuf, CDmElement *pRoot )
 	symbols.EnsureCount( nSymbols );
 	stringSymbols.GetElements( 0, nSymbols, symbols.Base() );
 	
-	// It's case sensitive
-	mapSymbolToIndex_t symbolToIndexMap( k_eDictCompareTypeCaseSensitive );
-
 	// Build the helper map based on the gathered symbols
+	mapSymbolToIndex_t symbolToIndexMap;
+	symbolToIndexMap.Reserve( nSymbols );
 	for ( int si = 0; si < nSymbols; ++si )
 	{
 		CUtlSymbolLarge sym = symbols[ si ];
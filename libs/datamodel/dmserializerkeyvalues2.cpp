@@ -14,8 +14,22 @@
 #include "dmelementdictionary.h"
 #include "DmElementFramework.h"
 #include "tier1/utlbuffer.h"
+#include "tier1/utlbufferutil.h"
+#include "mathlib/vector.h"
+#include "mathlib/vector4d.h"
+#include "mathlib/mathlib.h"
 #include <limits.h>
 
+#if defined( _M_X64 ) || ( defined( _M_IX86_FP ) && ( _M_IX86_FP >= 2 ) ) || defined( __SSE2__ )
+#define KV2_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined( _MSC_VER )
+#include <intrin.h>
+#pragma intrinsic(_BitScanForward)
+#endif
+
 
 //-----------------------------------------------------------------------------
 // Forward declarations
@@ -268,6 +282,7 @@ private:
 	bool UnserializeElementAttribute( CUtlBuffer &buf, DmElementDictHandle_t hElement, const char *pAttributeName, const char *pElementType );
 	bool UnserializeElementArrayAttribute( CUtlBuffer &buf, DmElementDictHandle_t hElement, const char *pAttributeName );
 	bool UnserializeArrayAttribute( CUtlBuffer &buf, DmElementDictHandle_t hElement, const char *pAttributeName, DmAttributeType_t nAttrType );
+	template< class T > bool UnserializeNumericArrayAttribute( CUtlBuffer &buf, CDmAttribute *pAttribute, const char *pAttributeName );
 	bool UnserializeAttribute( CUtlBuffer &buf, DmElementDictHandle_t hElement, const char *pAttributeName, DmAttributeType_t nAttrType );
 	bool UnserializeElement( CUtlBuffer &buf, const char *pElementType, DmElementDictHandle_t *pHandle );
 	bool UnserializeElement( CUtlBuffer &buf, DmElementDictHandle_t *pHandle );
@@ -530,6 +545,113 @@ bool CDmSerializerKeyValues2::Serialize( CUtlBuffer &outBuf, CDmElement *pRoot )
 }
 
 
+//-----------------------------------------------------------------------------
+// Block scanning helpers used by the tokenizer. The text is scanned 16 bytes
+// at a time; whitespace is ' ' or 9..13, same as V_isspace.
+//-----------------------------------------------------------------------------
+static inline int LowestSetBit( unsigned int nMask )
+{
+#if defined( _MSC_VER )
+	unsigned long nIndex;
+	_BitScanForward( &nIndex, nMask );
+	return (int)nIndex;
+#else
+	return __builtin_ctz( nMask );
+#endif
+}
+
+static inline int CountBits16( unsigned int nMask )
+{
+	nMask = nMask - ( ( nMask >> 1 ) & 0x5555 );
+	nMask = ( nMask & 0x3333 ) + ( ( nMask >> 2 ) & 0x3333 );
+	nMask = ( nMask + ( nMask >> 4 ) ) & 0x0F0F;
+	return ( nMask + ( nMask >> 8 ) ) & 0x1F;
+}
+
+// Returns the offset of the first non-whitespace character in [nOffset, nEnd), adds newlines skipped to nNewLines
+static int SkipWhitespace( const char *pBuf, int nOffset, int nEnd, int &nNewLines )
+{
+#ifdef KV2_USE_SSE2
+	const __m128i vSpace = _mm_set1_epi8( ' ' );
+	const __m128i vNewLine = _mm_set1_epi8( '\n' );
+	const __m128i vCtrlLo = _mm_set1_epi8( 8 );
+	const __m128i vCtrlHi = _mm_set1_epi8( 14 );
+	while ( nOffset + 16 <= nEnd )
+	{
+		__m128i v = _mm_loadu_si128( (const __m128i*)( pBuf + nOffset ) );
+		__m128i vCtrl = _mm_and_si128( _mm_cmpgt_epi8( v, vCtrlLo ), _mm_cmplt_epi8( v, vCtrlHi ) );
+		unsigned int nWhite = _mm_movemask_epi8( _mm_or_si128( _mm_cmpeq_epi8( v, vSpace ), vCtrl ) );
+		unsigned int nLines = _mm_movemask_epi8( _mm_cmpeq_epi8( v, vNewLine ) );
+		if ( nWhite != 0xFFFF )
+		{
+			int nRun = LowestSetBit( ~nWhite & 0xFFFF );
+			nNewLines += CountBits16( nLines & ( ( 1u << nRun ) - 1 ) );
+			return nOffset + nRun;
+		}
+		nNewLines += CountBits16( nLines );
+		nOffset += 16;
+	}
+#endif
+
+	for ( ; nOffset < nEnd; ++nOffset )
+	{
+		if ( !V_isspace( pBuf[ nOffset ] ) )
+			break;
+		if ( pBuf[ nOffset ] == '\n' )
+		{
+			++nNewLines;
+		}
+	}
+	return nOffset;
+}
+
+// Returns the offset of the first '"' or '\\' in [nOffset, nEnd), or nEnd
+static int FindQuoteOrEscape( const char *pBuf, int nOffset, int nEnd )
+{
+#ifdef KV2_USE_SSE2
+	const __m128i vQuote = _mm_set1_epi8( '\"' );
+	const __m128i vEscape = _mm_set1_epi8( '\\' );
+	while ( nOffset + 16 <= nEnd )
+	{
+		__m128i v = _mm_loadu_si128( (const __m128i*)( pBuf + nOffset ) );
+		unsigned int nHits = _mm_movemask_epi8( _mm_or_si128( _mm_cmpeq_epi8( v, vQuote ), _mm_cmpeq_epi8( v, vEscape ) ) );
+		if ( nHits )
+			return nOffset + LowestSetBit( nHits );
+		nOffset += 16;
+	}
+#endif
+
+	for ( ; nOffset < nEnd; ++nOffset )
+	{
+		if ( pBuf[ nOffset ] == '\"' || pBuf[ nOffset ] == '\\' )
+			break;
+	}
+	return nOffset;
+}
+
+static int CountNewLines( const char *pBuf, int nLength )
+{
+	int nCount = 0;
+	int i = 0;
+#ifdef KV2_USE_SSE2
+	const __m128i vNewLine = _mm_set1_epi8( '\n' );
+	for ( ; i + 16 <= nLength; i += 16 )
+	{
+		__m128i v = _mm_loadu_si128( (const __m128i*)( pBuf + i ) );
+		nCount += CountBits16( _mm_movemask_epi8( _mm_cmpeq_epi8( v, vNewLine ) ) );
+	}
+#endif
+	for ( ; i < nLength; ++i )
+	{
+		if ( pBuf[i] == '\n' )
+		{
+			++nCount;
+		}
+	}
+	return nCount;
+}
+
+
 //-----------------------------------------------------------------------------
 // Eats whitespaces and c++ style comments
 //-----------------------------------------------------------------------------
@@ -537,8 +659,40 @@ bool CDmSerializerKeyValues2::Serialize( CUtlBuffer &outBuf, CDmElement *pRoot )
 
 void CDmSerializerKeyValues2::EatWhitespacesAndComments( CUtlBuffer &buf )
 {
-	// eating white spaces and remarks loop
 	int nMaxPut = buf.TellMaxPut() - buf.TellGet();
+	if ( nMaxPut <= 0 )
+		return;
+
+	// Fast path: the whole remaining buffer is resident, so scan it in place
+	const char *pBuf = (const char *)buf.PeekGet( nMaxPut, 0 );
+	if ( pBuf )
+	{
+		int nOffset = 0;
+		int nNewLines = 0;
+		while ( nOffset < nMaxPut )
+		{
+			nOffset = SkipWhitespace( pBuf, nOffset, nMaxPut, nNewLines );
+
+			// If we don't have a a c++ style comment next, we're done
+			if ( ( nOffset + 1 >= nMaxPut ) || ( pBuf[nOffset] != '/' ) || ( pBuf[nOffset+1] != '/' ) )
+				break;
+
+			// Deal with c++ style comments; the newline itself is counted again when it's eaten as whitespace
+			nOffset += 2;
+			const char *pEndOfLine = (const char *)memchr( pBuf + nOffset, '\n', nMaxPut - nOffset );
+			nOffset = pEndOfLine ? (int)( pEndOfLine - pBuf ) : nMaxPut;
+			++nNewLines;
+		}
+
+		for ( int i = 0; i < nNewLines; ++i )
+		{
+			g_KeyValues2ErrorStack.IncrementCurrentLine();
+		}
+		buf.SeekGet( CUtlBuffer::SEEK_CURRENT, nOffset );
+		return;
+	}
+
+	// eating white spaces and remarks loop
 	int nOffset = 0;
 	while ( nOffset < nMaxPut )	
 	{
@@ -627,8 +781,21 @@ CDmSerializerKeyValues2::TokenType_t CDmSerializerKeyValues2::ReadToken( CUtlBuf
 		break;
 
 	case '\"':
-		// NOTE: The -1 is because peek includes room for the /0
-		nLength = buf.PeekDelimitedStringLength( GetCStringCharConversion(), false ) - 1;
+		{
+			// Most strings contain no escapes; find the closing quote directly in that case
+			int nMaxGet = buf.TellMaxPut() - buf.TellGet();
+			const char *pBuf = (const char *)buf.PeekGet( nMaxGet, 0 );
+			int nEnd = pBuf ? FindQuoteOrEscape( pBuf, 1, nMaxGet ) : nMaxGet;
+			if ( pBuf && nEnd < nMaxGet && pBuf[ nEnd ] == '\"' )
+			{
+				nLength = nEnd + 1;
+			}
+			else
+			{
+				// NOTE: The -1 is because peek includes room for the /0
+				nLength = buf.PeekDelimitedStringLength( GetCStringCharConversion(), false ) - 1;
+			}
+		}
 		if ( (nLength <= 1) || ( *(const char *)buf.PeekGet( nLength - 1 ) != '\"' ))
 		{
 			g_KeyValues2ErrorStack.ReportError( "Unexpected EOF in quoted string" );
@@ -651,13 +818,10 @@ CDmSerializerKeyValues2::TokenType_t CDmSerializerKeyValues2::ReadToken( CUtlBuf
 	token.SeekPut( CUtlBuffer::SEEK_HEAD, nLength );
 
 	// Count the number of crs in the token + update the current line
-	const char *pMem = (const char *)token.Base();
-	for ( int i = 0; i < nLength; ++i )
+	int nNewLines = CountNewLines( (const char *)token.Base(), nLength );
+	for ( int i = 0; i < nNewLines; ++i )
 	{
-		if ( pMem[i] == '\n' )
-		{
-			g_KeyValues2ErrorStack.IncrementCurrentLine();
-		}
+		g_KeyValues2ErrorStack.IncrementCurrentLine();
 	}
 
 	return t;
@@ -866,6 +1030,283 @@ bool CDmSerializerKeyValues2::UnserializeAttributeValueFromToken( CDmAttribute *
 }
 
 
+//-----------------------------------------------------------------------------
+// Fast-path parsing of numeric array values. These produce exactly what the
+// generic path produces (strtol, and strtod truncated to float, both via
+// CUtlBuffer::Scanf); anything they don't recognize is left to the generic path.
+//-----------------------------------------------------------------------------
+static const double s_pPowersOf10[] =
+{
+	1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static inline bool IsDigit( char c )
+{
+	return (unsigned)( c - '0' ) < 10;
+}
+
+static inline bool IsEndOfNumber( const char *pCur, const char *pEnd )
+{
+	return ( pCur == pEnd ) || V_isspace( *pCur );
+}
+
+static bool FastParseNumber( const char *&pCur, const char *pEnd, int &nValue )
+{
+	const char *p = pCur;
+	bool bNegative = false;
+	if ( p < pEnd && ( *p == '-' || *p == '+' ) )
+	{
+		bNegative = ( *p == '-' );
+		++p;
+	}
+
+	// Stay well clear of overflow; strtol handles the long ones
+	int nDigits = 0;
+	int nResult = 0;
+	for ( ; p < pEnd && IsDigit( *p ); ++p )
+	{
+		if ( ++nDigits > 9 )
+			return false;
+		nResult = nResult * 10 + ( *p - '0' );
+	}
+
+	if ( nDigits == 0 || !IsEndOfNumber( p, pEnd ) )
+		return false;
+
+	nValue = bNegative ? -nResult : nResult;
+	pCur = p;
+	return true;
+}
+
+static bool FastParseNumber( const char *&pCur, const char *pEnd, float &flValue )
+{
+	const char *p = pCur;
+	bool bNegative = false;
+	if ( p < pEnd && ( *p == '-' || *p == '+' ) )
+	{
+		bNegative = ( *p == '-' );
+		++p;
+	}
+
+	uint64 nMantissa = 0;
+	int nSignificantDigits = 0;
+	int nExponent = 0;
+	bool bHasDigits = false;
+	for ( ; p < pEnd && IsDigit( *p ); ++p )
+	{
+		bHasDigits = true;
+		if ( nMantissa || *p != '0' )
+		{
+			if ( ++nSignificantDigits > 19 )
+				return false;
+			nMantissa = nMantissa * 10 + ( *p - '0' );
+		}
+	}
+	if ( p < pEnd && *p == '.' )
+	{
+		for ( ++p; p < pEnd && IsDigit( *p ); ++p )
+		{
+			bHasDigits = true;
+			--nExponent;
+			if ( nMantissa || *p != '0' )
+			{
+				if ( ++nSignificantDigits > 19 )
+					return false;
+				nMantissa = nMantissa * 10 + ( *p - '0' );
+			}
+		}
+	}
+	if ( !bHasDigits )
+		return false;
+
+	if ( p < pEnd && ( *p == 'e' || *p == 'E' ) )
+	{
+		++p;
+		bool bNegativeExponent = false;
+		if ( p < pEnd && ( *p == '-' || *p == '+' ) )
+		{
+			bNegativeExponent = ( *p == '-' );
+			++p;
+		}
+		int nExponentDigits = 0;
+		int nExplicitExponent = 0;
+		for ( ; p < pEnd && IsDigit( *p ); ++p )
+		{
+			if ( ++nExponentDigits > 4 )
+				return false;
+			nExplicitExponent = nExplicitExponent * 10 + ( *p - '0' );
+		}
+		if ( nExponentDigits == 0 )
+			return false;
+		nExponent += bNegativeExponent ? -nExplicitExponent : nExplicitExponent;
+	}
+
+	if ( !IsEndOfNumber( p, pEnd ) )
+		return false;
+
+	double flResult = 0.0;
+	if ( nMantissa != 0 )
+	{
+		// Exact integer mantissa and exact power of ten means a single correctly
+		// rounded multiply or divide, i.e. the same double strtod returns
+		if ( nMantissa > ( (uint64)1 << 53 ) || nExponent < -22 || nExponent > 22 )
+			return false;
+
+		flResult = (double)(int64)nMantissa;
+		flResult = ( nExponent < 0 ) ? flResult / s_pPowersOf10[ -nExponent ] : flResult * s_pPowersOf10[ nExponent ];
+	}
+
+	flValue = (float)( bNegative ? -flResult : flResult );
+	pCur = p;
+	return true;
+}
+
+template< class C >
+static bool FastParseComponents( const char *pCur, const char *pEnd, C *pDest, int nCount )
+{
+	int nNewLines = 0;
+	for ( int i = 0; i < nCount; ++i )
+	{
+		pCur += SkipWhitespace( pCur, 0, (int)( pEnd - pCur ), nNewLines );
+		if ( !FastParseNumber( pCur, pEnd, pDest[i] ) )
+			return false;
+	}
+	pCur += SkipWhitespace( pCur, 0, (int)( pEnd - pCur ), nNewLines );
+	return pCur == pEnd;
+}
+
+static inline bool FastParseValue( const char *pCur, const char *pEnd, int &value )
+{
+	return FastParseComponents( pCur, pEnd, &value, 1 );
+}
+
+static inline bool FastParseValue( const char *pCur, const char *pEnd, float &value )
+{
+	return FastParseComponents( pCur, pEnd, &value, 1 );
+}
+
+static inline bool FastParseValue( const char *pCur, const char *pEnd, Vector2D &value )
+{
+	return FastParseComponents( pCur, pEnd, value.Base(), 2 );
+}
+
+static inline bool FastParseValue( const char *pCur, const char *pEnd, Vector &value )
+{
+	return FastParseComponents( pCur, pEnd, value.Base(), 3 );
+}
+
+static inline bool FastParseValue( const char *pCur, const char *pEnd, Vector4D &value )
+{
+	return FastParseComponents( pCur, pEnd, value.Base(), 4 );
+}
+
+static inline bool FastParseValue( const char *pCur, const char *pEnd, QAngle &value )
+{
+	return FastParseComponents( pCur, pEnd, value.Base(), 3 );
+}
+
+static inline bool FastParseValue( const char *pCur, const char *pEnd, Quaternion &value )
+{
+	if ( !FastParseComponents( pCur, pEnd, value.Base(), 4 ) )
+		return false;
+	QuaternionNormalize( value );
+	return true;
+}
+
+// Generic path, used for values the fast path doesn't understand
+template< class T >
+static bool UnserializeValueFromToken( CUtlBuffer &tokenBuf, T &value )
+{
+	int nLength = tokenBuf.PeekDelimitedStringLength( GetCStringCharConversion() );
+	char *pTemp = (char*)stackalloc( nLength + 1 );
+	tokenBuf.GetDelimitedString( GetCStringCharConversion(), pTemp, nLength + 1 );
+
+	CUtlBuffer buf( pTemp, nLength, CUtlBuffer::TEXT_BUFFER | CUtlBuffer::READ_ONLY );
+	return ::Unserialize( buf, value );
+}
+
+
+//-----------------------------------------------------------------------------
+// Reads a numeric array attribute; values are parsed straight out of the
+// tokens and swapped into the attribute's storage in one go
+//-----------------------------------------------------------------------------
+template< class T >
+bool CDmSerializerKeyValues2::UnserializeNumericArrayAttribute( CUtlBuffer &buf, CDmAttribute *pAttribute, const char *pAttributeName )
+{
+	// Arrays first must have a '[' specified
+	TokenType_t token;
+	CUtlBuffer tokenBuf( 0, 0, CUtlBuffer::TEXT_BUFFER );
+	token = ReadToken( buf, tokenBuf );
+	if ( token != TOKEN_OPEN_BRACKET )
+	{
+		g_KeyValues2ErrorStack.ReportError( "Expecting '[', didn't find it!" );
+		return false;
+	}
+
+	CUtlVector< T > values;
+	int nElementIndex = 0;
+
+	// Now read a list of array values, separated by commas
+	while ( buf.IsValid() )
+	{
+		token = ReadToken( buf, tokenBuf );
+		if ( token == TOKEN_INVALID || token == TOKEN_EOF )
+		{
+			g_KeyValues2ErrorStack.ReportError( "Expecting ']', didn't find it!" );
+			return false;
+		}
+
+		// Then, keep reading until we hit a ']'
+		if ( token == TOKEN_CLOSE_BRACKET )
+			break;
+
+		// If we've already read in an array value, we need to read a comma next
+		if ( nElementIndex > 0 )
+		{
+			if ( token != TOKEN_COMMA )
+			{
+				g_KeyValues2ErrorStack.ReportError( "Expecting ',', didn't find it!" );
+				return false;
+			}
+
+			// Read in the next thing, which should be a value
+			token = ReadToken( buf, tokenBuf );
+		}
+
+		// Ok, we must be reading an attributearray value
+		if ( token != TOKEN_DELIMITED_STRING )
+		{
+			g_KeyValues2ErrorStack.ReportError( "Expecting array attribute value, didn't find it!" );
+			return false;
+		}
+
+		// The token includes its delimiting quotes
+		const char *pToken = (const char *)tokenBuf.Base();
+		int nTokenLength = tokenBuf.TellPut();
+
+		T value;
+		if ( !FastParseValue( pToken + 1, pToken + nTokenLength - 1, value ) && !UnserializeValueFromToken( tokenBuf, value ) )
+		{
+			g_KeyValues2ErrorStack.ReportError("Error reading in array attribute \"%s\" element %d", pAttributeName, nElementIndex );
+			return false;
+		}
+		values.AddToTail( value );
+
+		// Ok, we've read in another value
+		++nElementIndex;
+	}
+
+	CDmrArray< T > array( pAttribute );
+	if ( array.Count() > 0 )
+	{
+		values.InsertMultipleBefore( 0, array.Count(), array.Base() );
+	}
+	array.SwapArray( values );
+	return true;
+}
+
+
 //-----------------------------------------------------------------------------
 // Reads an attribute for an element array
 //-----------------------------------------------------------------------------
@@ -880,6 +1321,26 @@ bool CDmSerializerKeyValues2::UnserializeArrayAttribute( CUtlBuffer &buf, DmElem
 		return false;
 	}
 
+	switch( nAttrType )
+	{
+	case AT_INT_ARRAY:
+		return UnserializeNumericArrayAttribute< int >( buf, pAttribute, pAttributeName );
+	case AT_FLOAT_ARRAY:
+		return UnserializeNumericArrayAttribute< float >( buf, pAttribute, pAttributeName );
+	case AT_VECTOR2_ARRAY:
+		return UnserializeNumericArrayAttribute< Vector2D >( buf, pAttribute, pAttributeName );
+	case AT_VECTOR3_ARRAY:
+		return UnserializeNumericArrayAttribute< Vector >( buf, pAttribute, pAttributeName );
+	case AT_VECTOR4_ARRAY:
+		return UnserializeNumericArrayAttribute< Vector4D >( buf, pAttribute, pAttributeName );
+	case AT_QANGLE_ARRAY:
+		return UnserializeNumericArrayAttribute< QAngle >( buf, pAttribute, pAttributeName );
+	case AT_QUATERNION_ARRAY:
+		return UnserializeNumericArrayAttribute< Quaternion >( buf, pAttribute, pAttributeName );
+	default:
+		break;
+	}
+
 	// Arrays first must have a '[' specified
 	TokenType_t token;
 	CUtlBuffer tokenBuf( 0, 0, CUtlBuffer::TEXT_BUFFER );
@@ -2010,7 +2010,7 @@ struct VertexWeightMap_s
 	struct VertexWeight_s
 	{
 		int m_vertexDataIndex;						// Index into the CDmeVertexData data (only used for joint weights & indices)
-		const CUtlVector< int > *m_pVertexIndices;	// Index into the CDmeVertexData vertex indices
+		CVertexIndexSpan m_vertexIndices;			// Index into the CDmeVertexData vertex indices
 		float m_vertexWeight;
 	};
 
@@ -2206,7 +2206,7 @@ void CopyFieldData(
 
 			CDmAttributeInfo< T_t >::SetDefaultValue( sum );
 
-			const CUtlVector< int > &vertexList = *vWeight.m_pVertexIndices;
+			const CVertexIndexSpan &vertexList = vWeight.m_vertexIndices;
 			for ( int k = 0; k < vertexList.Count(); ++k )
 			{
 				sum += srcData[ srcIndices[ vertexList[ k ] ] ];
@@ -2427,7 +2427,7 @@ bool CDmMeshUtils::Merge(
 				vertexWeight.m_nVertexWeights = 1;
 				vertexWeight.m_vertexWeights[ 0 ].m_vertexDataIndex = j;
 				vertexWeight.m_vertexWeights[ 0 ].m_vertexWeight = 1.0f;
-				vertexWeight.m_vertexWeights[ 0 ].m_pVertexIndices = &pDstData->FindVertexIndicesFromDataIndex( CDmeVertexData::FIELD_POSITION, j );
+				vertexWeight.m_vertexWeights[ 0 ].m_vertexIndices = pDstData->FindVertexIndicesFromDataIndex( CDmeVertexData::FIELD_POSITION, j );
 				break;
 			}
 
@@ -2450,7 +2450,7 @@ bool CDmMeshUtils::Merge(
 			vertexWeight.m_nVertexWeights = 1;
 			vertexWeight.m_vertexWeights[ 0 ].m_vertexDataIndex = nClosestIndex;
 			vertexWeight.m_vertexWeights[ 0 ].m_vertexWeight = 1.0f;
-			vertexWeight.m_vertexWeights[ 0 ].m_pVertexIndices = &pDstData->FindVertexIndicesFromDataIndex( CDmeVertexData::FIELD_POSITION, nClosestIndex );
+			vertexWeight.m_vertexWeights[ 0 ].m_vertexIndices = pDstData->FindVertexIndicesFromDataIndex( CDmeVertexData::FIELD_POSITION, nClosestIndex );
 
 			//			Assert( vertexWeight.m_nVertexWeights );
 			//			return false;
@@ -3132,7 +3132,7 @@ bool CDmMeshUtils::CreateWrinkleDeltaFromBaseState(
 			v = bindPos[ i ] - currPos[ i ];
 
 			// Figure out the texture indices for this position index
-			const CUtlVector< int > &baseVerts = pBind->FindVertexIndicesFromDataIndex( CDmeVertexData::FIELD_POSITION, i );
+			CVertexIndexSpan baseVerts = pBind->FindVertexIndicesFromDataIndex( CDmeVertexData::FIELD_POSITION, i );
 
 			for ( int j = 0; j < baseVerts.Count(); ++j )
 			{
@@ -3202,7 +3202,7 @@ bool CDmMeshUtils::CreateWrinkleDeltaFromBaseState(
 
 		// NOTE: This will produce bad behavior in cases where two positions share the
 		// same texcoord, which shouldn't theoretically happen.
-		const CUtlVector< int > &baseVerts = pBind->FindVertexIndicesFromDataIndex( CDmeVertexData::FIELD_POSITION, pWrinkleIndices[ i ] );
+		CVertexIndexSpan baseVerts = pBind->FindVertexIndicesFromDataIndex( CDmeVertexData::FIELD_POSITION, pWrinkleIndices[ i ] );
 		const int nBaseVertCount = baseVerts.Count();
 		for ( int j = 0; j < nBaseVertCount; ++j )
 		{
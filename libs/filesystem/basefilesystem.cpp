@@ -816,18 +816,6 @@ inline void CBaseFileSystem::ComputeFullWritePath( char* pDest, int maxlen, cons
 }
 
 
-//-----------------------------------------------------------------------------
-// Purpose: 
-// Input  : src1 - 
-//			src2 - 
-// Output : Returns true on success, false on failure.
-//-----------------------------------------------------------------------------
-bool CBaseFileSystem::OpenedFileLessFunc( COpenedFile const& src1, COpenedFile const& src2 )
-{
-	return src1.m_pFile < src2.m_pFile;
-}
-
-
 void CBaseFileSystem::InstallDirtyDiskReportFunc( FSDirtyDiskReportFunc_t func )
 {
 	m_DirtyDiskReportFunc = func;
@@ -938,11 +926,13 @@ FILE *CBaseFileSystem::Trace_FOpen( const char *filename, const char *options, u
 		}
 
 		COpenedFile file;
+		memset( &file, 0, sizeof( file ) );
 
-		file.SetName( filename );
-		file.m_pFile = fp;
-
-		m_OpenedFiles.AddToTail( file );
+		{
+			std::lock_guard< std::mutex > lock( m_OpenedFilesMutex );
+			file.m_hName = m_OpenedFileNames.FindOrAddFileName( filename );
+			m_OpenedFiles.Insert( fp, file );
+		}
 
 		LogAccessToFile( "open", filename, options );
 	}
@@ -952,8 +942,6 @@ FILE *CBaseFileSystem::Trace_FOpen( const char *filename, const char *options, u
 
 void CBaseFileSystem::GetFileNameForHandle( FileHandle_t handle, char *buf, size_t buflen )
 {
-	V_strncpy( buf, "Unknown", buflen );
-	/*
 	CFileHandle *fh = ( CFileHandle *)handle;
 	if ( !fh )
 	{
@@ -962,28 +950,19 @@ void CBaseFileSystem::GetFileNameForHandle( FileHandle_t handle, char *buf, size
 	}
 
 	// Pack file filehandles store the underlying name for convenience
-	if ( fh->IsPack() )
+	if ( !fh->m_pFile )
 	{
 		Q_strncpy( buf, fh->Name(), buflen );
 		return;
 	}
 
-	AUTO_LOCK( m_OpenedFilesMutex );
-
-	COpenedFile file;
-	file.m_pFile = fh->GetFileHandle();
+	std::lock_guard< std::mutex > lock( m_OpenedFilesMutex );
 
-	int result = m_OpenedFiles.Find( file );
-	if ( result != -1 )
-	{
-		COpenedFile found = m_OpenedFiles[ result ];
-		Q_strncpy( buf, found.GetName(), buflen );
-	}
-	else
+	UtlHashHandle_t result = m_OpenedFiles.Find( fh->m_pFile );
+	if ( result == m_OpenedFiles.InvalidHandle() || !m_OpenedFileNames.String( m_OpenedFiles[ result ].m_hName, buf, buflen ) )
 	{
 		buf[ 0 ] = 0;
 	}
-	*/
 }
 
 //-----------------------------------------------------------------------------
@@ -994,15 +973,33 @@ void CBaseFileSystem::Trace_FClose( FILE *fp )
 {
 	if ( fp )
 	{
+		COpenedFile found;
+		bool bFound;
+		char name[ MAX_PATH ];
 
-		COpenedFile file;
-		file.m_pFile = fp;
+		{
+			std::lock_guard< std::mutex > lock( m_OpenedFilesMutex );
+
+			UtlHashHandle_t result = m_OpenedFiles.Find( fp );
+			bFound = ( result != m_OpenedFiles.InvalidHandle() );
+			if ( bFound )
+			{
+				found = m_OpenedFiles[ result ];
+				m_OpenedFiles.RemoveByHandle( result );
+				if ( !m_OpenedFileNames.String( found.m_hName, name, sizeof( name ) ) )
+				{
+					V_strncpy( name, "???", sizeof( name ) );
+				}
+			}
+		}
 
-		int result = m_OpenedFiles.Find( file );
-		if ( result != -1 /*m_OpenedFiles.InvalidIdx()*/ )
+		if ( bFound )
 		{
-			COpenedFile found = m_OpenedFiles[ result ];
-			m_OpenedFiles.Remove( result );
+			if ( m_fwLevel >= FILESYSTEM_WARNING_REPORTALLACCESSES_READ )
+			{
+				FileSystemWarning( FILESYSTEM_WARNING_REPORTALLACCESSES_READ, "Closed %s: %d reads (%lld bytes), %d writes (%lld bytes)\n",
+					name, found.m_nReads, found.m_nBytesRead, found.m_nWrites, found.m_nBytesWritten );
+			}
 		}
 		else
 		{
@@ -1022,19 +1019,18 @@ void CBaseFileSystem::Trace_FClose( FILE *fp )
 
 void CBaseFileSystem::Trace_FRead( int size, FILE* fp )
 {
+	// Nothing is locked unless reads are being traced
 	if ( !fp || m_fwLevel < FILESYSTEM_WARNING_REPORTALLACCESSES_READ )
 		return;
 
+	std::lock_guard< std::mutex > lock( m_OpenedFilesMutex );
 
-	COpenedFile file;
-	file.m_pFile = fp;
-
-	int result = m_OpenedFiles.Find( file );
-
-	if( result != -1 )
+	UtlHashHandle_t result = m_OpenedFiles.Find( fp );
+	if( result != m_OpenedFiles.InvalidHandle() )
 	{
-		COpenedFile found = m_OpenedFiles[ result ];
-		
+		COpenedFile &found = m_OpenedFiles[ result ];
+		++found.m_nReads;
+		found.m_nBytesRead += size;
 	}
 }
 
@@ -1043,15 +1039,14 @@ void CBaseFileSystem::Trace_FWrite( int size, FILE* fp )
 	if ( !fp || m_fwLevel < FILESYSTEM_WARNING_REPORTALLACCESSES_READWRITE )
 		return;
 
-	COpenedFile file;
-	file.m_pFile = fp;
-
-
-	int result = m_OpenedFiles.Find( file );
+	std::lock_guard< std::mutex > lock( m_OpenedFilesMutex );
 
-	if( result != -1 )
+	UtlHashHandle_t result = m_OpenedFiles.Find( fp );
+	if( result != m_OpenedFiles.InvalidHandle() )
 	{
-		COpenedFile found = m_OpenedFiles[ result ];
+		COpenedFile &found = m_OpenedFiles[ result ];
+		++found.m_nWrites;
+		found.m_nBytesWritten += size;
 	}
 }
 
@@ -1060,15 +1055,28 @@ void CBaseFileSystem::Trace_FWrite( int size, FILE* fp )
 //-----------------------------------------------------------------------------
 void CBaseFileSystem::Trace_DumpUnclosedFiles( void )
 {
-	for ( int i = 0 ; i < m_OpenedFiles.Count(); i++ )
+	if ( m_fwLevel < FILESYSTEM_WARNING_REPORTUNCLOSED )
+		return;
+
+	CUtlVector< CUtlString > names;
 	{
-		COpenedFile *found = &m_OpenedFiles[ i ];
+		std::lock_guard< std::mutex > lock( m_OpenedFilesMutex );
 
-		if ( m_fwLevel >= FILESYSTEM_WARNING_REPORTUNCLOSED )
+		for ( UtlHashHandle_t i = m_OpenedFiles.FirstHandle(); i != m_OpenedFiles.InvalidHandle(); i = m_OpenedFiles.NextHandle( i ) )
 		{
-			FileSystemWarning( FILESYSTEM_WARNING_REPORTUNCLOSED, "File %s was never closed\n", found->GetName() );
+			char name[ MAX_PATH ];
+			if ( !m_OpenedFileNames.String( m_OpenedFiles[ i ].m_hName, name, sizeof( name ) ) )
+			{
+				V_strncpy( name, "???", sizeof( name ) );
+			}
+			names.AddToTail( name );
 		}
 	}
+
+	for ( int i = 0; i < names.Count(); ++i )
+	{
+		FileSystemWarning( FILESYSTEM_WARNING_REPORTUNCLOSED, "File %s was never closed\n", names[ i ].Get() );
+	}
 }
 
 //-----------------------------------------------------------------------------
@@ -2843,36 +2851,60 @@ char *CBaseFileSystem::ReadLine( char *pOutput, int maxChars, FileHandle_t file
 
 	int nRead = 0;
 
-	// Read up to maxchars:
-	while( nRead < ( maxChars - 1 ) )
+	// Read up to maxchars, scanning the handle's read-ahead for the end of the line:
+	bool bDone = false;
+	while( !bDone && nRead < ( maxChars - 1 ) )
 	{
+		int nAvailable;
+		const char *pData = fh->ReadAhead( nAvailable );
+
 		// Are we at the end of the file?
-		if( 1 != fh->Read( pOutput + nRead, 1 ) )
+		if( !nAvailable )
 			break;
 
 		// Translate for text mode files:
-		if( fh->m_type == FT_PACK_TEXT && pOutput[nRead] == '\r' )
+		if( fh->m_type == FT_PACK_TEXT )
 		{
-			// Ignore \r
+			int nUsed = 0;
+			while( nUsed < nAvailable && nRead < ( maxChars - 1 ) )
+			{
+				char c = pData[nUsed++];
+
+				// Ignore \r
+				if( c == '\r' )
+					continue;
+
+				// Get outta here if we find a NULL.
+				pOutput[nRead++] = c ? c : '\n';
+				if( c == '\n' || c == '\0' )
+				{
+					bDone = true;
+					break;
+				}
+			}
+			fh->ConsumeReadAhead( nUsed );
 			continue;
 		}
 
-		// We're done when we hit a '\n'
-		if( pOutput[nRead] == '\n' )
+		// We're done when we hit a '\n', or a NULL which gets turned into one
+		int nScan = MIN( nAvailable, maxChars - 1 - nRead );
+		const char *pEnd = (const char *)memchr( pData, '\n', nScan );
+		int nLine = pEnd ? ( pEnd - pData + 1 ) : nScan;
+		const char *pNull = (const char *)memchr( pData, '\0', nLine );
+		if( pNull )
 		{
-			nRead++;
-			break;
+			nLine = pNull - pData + 1;
 		}
 
-		// Get outta here if we find a NULL.
-		if( pOutput[nRead] == '\0' )
+		memcpy( pOutput + nRead, pData, nLine );
+		fh->ConsumeReadAhead( nLine );
+		nRead += nLine;
+
+		if( pNull )
 		{
-			pOutput[nRead] = '\n';
-			nRead++;
-			break;
+			pOutput[nRead - 1] = '\n';
 		}
-
-		nRead++;
+		bDone = ( pEnd || pNull );
 	}
 
 	if( nRead < maxChars )
@@ -3935,74 +3967,6 @@ void CBaseFileSystem::FileSystemWarning( FileWarningLevel_t level, const char *f
 }
 
 
-//-----------------------------------------------------------------------------
-// Purpose: 
-//-----------------------------------------------------------------------------
-CBaseFileSystem::COpenedFile::COpenedFile( void )
-{
-	m_pFile = NULL;
-	m_pName = NULL;
-}
-
-//-----------------------------------------------------------------------------
-// Purpose: 
-//-----------------------------------------------------------------------------
-CBaseFileSystem::COpenedFile::~COpenedFile( void )
-{
-	delete[] m_pName;
-}
-
-//-----------------------------------------------------------------------------
-// Purpose: 
-// Input  : src - 
-//-----------------------------------------------------------------------------
-CBaseFileSystem::COpenedFile::COpenedFile( const COpenedFile& src )
-{
-	m_pFile = src.m_pFile;
-	if ( src.m_pName )
-	{
-		int len = strlen( src.m_pName ) + 1;
-		m_pName = new char[ len ];
-		Q_strncpy( m_pName, src.m_pName, len );
-	}
-	else
-	{
-		m_pName = NULL;
-	}
-}
-
-//-----------------------------------------------------------------------------
-// Purpose: 
-// Input  : src - 
-// Output : Returns true on success, false on failure.
-//-----------------------------------------------------------------------------
-bool CBaseFileSystem::COpenedFile::operator==( const CBaseFileSystem::COpenedFile& src ) const
-{
-	return src.m_pFile == m_pFile;
-}
-
-//-----------------------------------------------------------------------------
-// Purpose: 
-// Input  : *name - 
-//-----------------------------------------------------------------------------
-void CBaseFileSystem::COpenedFile::SetName( char const *name )
-{
-	delete[] m_pName;
-	int len = strlen( name ) + 1;
-	m_pName = new char[ len ];
-	Q_strncpy( m_pName, name, len );
-}
-
-//-----------------------------------------------------------------------------
-// Purpose: 
-// Output : char
-//-----------------------------------------------------------------------------
-char const *CBaseFileSystem::COpenedFile::GetName( void )
-{
-	return m_pName ? m_pName : "???";
-}
-
-
 //-----------------------------------------------------------------------------
 // Purpose: 
 //-----------------------------------------------------------------------------
@@ -4394,6 +4358,7 @@ CFileHandle::~CFileHandle()
 {
 	Assert( IsValid() );
 	delete[] m_pszTrueFileName;
+	delete[] m_pReadAhead;
 
 	if ( m_pPackFileHandle )
 	{
@@ -4421,6 +4386,12 @@ void CFileHandle::Init( CBaseFileSystem *fs )
 	m_fs = fs;
 
 	m_pszTrueFileName = 0;
+
+	m_pReadAhead = NULL;
+	m_nReadAheadPos = 0;
+	m_nReadAheadEnd = 0;
+	m_nReadAheadBase = 0;
+	m_bReadAheadExact = true;
 }
 
 bool CFileHandle::IsValid()
@@ -4490,7 +4461,21 @@ int CFileHandle::Read( void* pBuffer, int nDestSize, int nLength )
 	// Is this a regular file or a pack file?  
 	if ( m_pFile )
 	{
-		return m_fs->FS_fread( pBuffer, nDestSize, nLength, m_pFile );
+		// Hand out anything line reads have buffered first
+		int nBuffered = MIN( nLength, m_nReadAheadEnd - m_nReadAheadPos );
+		if ( nBuffered <= 0 )
+			return m_fs->FS_fread( pBuffer, nDestSize, nLength, m_pFile );
+
+		memcpy( pBuffer, m_pReadAhead + m_nReadAheadPos, nBuffered );
+		m_nReadAheadPos += nBuffered;
+		if ( nBuffered == nLength )
+			return nLength;
+
+		if ( nDestSize != -1 )
+		{
+			nDestSize -= nBuffered;
+		}
+		return nBuffered + m_fs->FS_fread( (char*)pBuffer + nBuffered, nDestSize, nLength - nBuffered, m_pFile );
 	}
 
 	return 0;
@@ -4506,6 +4491,7 @@ int CFileHandle::Write( const void* pBuffer, int nLength )
 		return 0;
 	}
 
+	SyncReadAhead();
 	size_t nBytesWritten = m_fs->FS_fwrite( (void*)pBuffer, nLength, m_pFile  );
 
 	m_fs->Trace_FWrite(nBytesWritten,m_pFile);
@@ -4519,6 +4505,7 @@ int CFileHandle::Seek( int64 nOffset, int nWhence )
 
 	if ( m_pFile )
 	{
+		SyncReadAhead();
 		m_fs->FS_fseek( m_pFile, nOffset, nWhence );
 		// TODO - FS_fseek should return the resultant offset
 		return 0;
@@ -4533,6 +4520,13 @@ int CFileHandle::Tell()
 
 	if ( m_pFile )
 	{
+		if ( m_nReadAheadPos < m_nReadAheadEnd )
+		{
+			if ( m_bReadAheadExact )
+				return m_nReadAheadBase + m_nReadAheadPos;
+
+			SyncReadAhead();
+		}
 		return m_fs->FS_ftell( m_pFile );
 	}
 
@@ -4571,6 +4565,50 @@ bool CFileHandle::EndOfFile()
 	return ( Tell() >= Size() );
 }
 
+const char *CFileHandle::ReadAhead( int &nAvailable )
+{
+	Assert( IsValid() );
+
+	if ( m_nReadAheadPos == m_nReadAheadEnd && m_pFile )
+	{
+		if ( !m_pReadAhead )
+		{
+			m_pReadAhead = new char[ READ_AHEAD_SIZE ];
+		}
+
+		m_nReadAheadBase = m_fs->FS_ftell( m_pFile );
+		m_nReadAheadPos = 0;
+		m_nReadAheadEnd = (int)m_fs->FS_fread( m_pReadAhead, READ_AHEAD_SIZE, READ_AHEAD_SIZE, m_pFile );
+		m_bReadAheadExact = ( m_fs->FS_ftell( m_pFile ) - m_nReadAheadBase == m_nReadAheadEnd );
+	}
+
+	nAvailable = m_nReadAheadEnd - m_nReadAheadPos;
+	return m_pReadAhead + m_nReadAheadPos;
+}
+
+void CFileHandle::SyncReadAhead()
+{
+	if ( m_nReadAheadPos < m_nReadAheadEnd )
+	{
+		if ( m_bReadAheadExact )
+		{
+			m_fs->FS_fseek( m_pFile, m_nReadAheadBase + m_nReadAheadPos, FILESYSTEM_SEEK_HEAD );
+		}
+		else
+		{
+			// Offsets don't line up with what was read, so read the consumed part again
+			m_fs->FS_fseek( m_pFile, m_nReadAheadBase, FILESYSTEM_SEEK_HEAD );
+			if ( m_nReadAheadPos )
+			{
+				m_fs->FS_fread( m_pReadAhead, READ_AHEAD_SIZE, m_nReadAheadPos, m_pFile );
+			}
+		}
+	}
+
+	m_nReadAheadPos = 0;
+	m_nReadAheadEnd = 0;
+}
+
 void CBaseFileSystem::MarkLocalizedPath( CSearchPath *sp )
 {
 // game console only for now
@@ -5,9 +5,11 @@
 //===========================================================================//
 #include "mathlib/vector.h"
 #include "simplify.h"
-#include "tier1/utlpriorityqueue.h"
 #include "mathlib/cholesky.h"
 #include "tier1/utlhash.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
 
 //#include "memdbgon.h"
 
@@ -117,28 +119,145 @@ public:
 	bool m_bNonManifold;
 };
 
-// We maintain a sorted queue of edges to collapse.  The queue stores a copy of the error and links back to an edge
-// as edges collapse, adjacent edges are updated.  Rather than searching the queue for their current errors we simply
-// insert additional records.  So the copy of the error is convenient for sorting the queue and also determining if 
-// this is the most up to date record for a given edge
+// We maintain a sorted queue of edges to collapse.  The queue stores a copy of the error (so sorting doesn't
+// touch the edges) and links back to the edge.
 struct edge_queue_entry_t
 {
 	float m_flError;
 	int m_nEdgeIndex;
 };
 
-// This is the sorted queue of edges to collapse.  It includes some invalid records
-// This implements the comparison function for sorting
-class CEdgeQueue : public CUtlPriorityQueue<edge_queue_entry_t>
+// This is the sorted queue of edges to collapse, a binary min-heap on error.  Each edge is in the queue at most
+// once and the queue tracks where, so when an edge's error changes it is moved in place rather than inserted again.
+// Collapsed edges are removed right away, so the queue never holds more than the edge count.
+class CEdgeQueue
 {
 public:
-	static bool IsLowerPriority( const edge_queue_entry_t &node1, const edge_queue_entry_t &node2 )
+	void Init( int nEdgeCount )
 	{
-		// edges with higher error are lower priority
-		return ( node1.m_flError > node2.m_flError ) ? true : false;
+		m_heap.RemoveAll();
+		m_heap.EnsureCapacity( nEdgeCount );
+		m_heapIndex.SetCount( nEdgeCount );
+		m_heapIndex.FillWithValue( -1 );
 	}
 
-	CEdgeQueue( int nInitSize = 0 ) : CUtlPriorityQueue<edge_queue_entry_t>( 0, nInitSize, IsLowerPriority ) {}
+	inline int Count() const { return m_heap.Count(); }
+	inline const edge_queue_entry_t &ElementAtHead() const { return m_heap[0]; }
+	inline bool IsQueued( int nEdgeIndex ) const { return m_heapIndex[nEdgeIndex] >= 0; }
+
+	// Adds the edge, or re-sorts it if it's already queued
+	void Update( int nEdgeIndex, float flError )
+	{
+		int nPos = m_heapIndex[nEdgeIndex];
+		if ( nPos < 0 )
+		{
+			nPos = m_heap.AddToTail();
+			m_heap[nPos].m_nEdgeIndex = nEdgeIndex;
+			m_heap[nPos].m_flError = flError;
+			m_heapIndex[nEdgeIndex] = nPos;
+			SiftUp( nPos );
+			return;
+		}
+		float flOldError = m_heap[nPos].m_flError;
+		m_heap[nPos].m_flError = flError;
+		if ( flError < flOldError )
+		{
+			SiftUp( nPos );
+		}
+		else
+		{
+			SiftDown( nPos );
+		}
+	}
+
+	// Adds an edge without sorting, call Heapify() once all edges are in
+	void InsertUnsorted( int nEdgeIndex, float flError )
+	{
+		Assert( m_heapIndex[nEdgeIndex] < 0 );
+		int nPos = m_heap.AddToTail();
+		m_heap[nPos].m_nEdgeIndex = nEdgeIndex;
+		m_heap[nPos].m_flError = flError;
+		m_heapIndex[nEdgeIndex] = nPos;
+	}
+
+	void Heapify()
+	{
+		for ( int i = m_heap.Count() / 2; --i >= 0; )
+		{
+			SiftDown( i );
+		}
+	}
+
+	void Remove( int nEdgeIndex )
+	{
+		int nPos = m_heapIndex[nEdgeIndex];
+		if ( nPos < 0 )
+			return;
+		m_heapIndex[nEdgeIndex] = -1;
+		int nLast = m_heap.Count() - 1;
+		if ( nPos != nLast )
+		{
+			float flRemovedError = m_heap[nPos].m_flError;
+			m_heap[nPos] = m_heap[nLast];
+			m_heapIndex[m_heap[nPos].m_nEdgeIndex] = nPos;
+			m_heap.RemoveMultipleFromTail( 1 );
+			if ( m_heap[nPos].m_flError < flRemovedError )
+			{
+				SiftUp( nPos );
+			}
+			else
+			{
+				SiftDown( nPos );
+			}
+			return;
+		}
+		m_heap.RemoveMultipleFromTail( 1 );
+	}
+
+	inline void RemoveAtHead() { Remove( m_heap[0].m_nEdgeIndex ); }
+
+private:
+	void SiftUp( int nPos )
+	{
+		edge_queue_entry_t entry = m_heap[nPos];
+		while ( nPos > 0 )
+		{
+			int nParent = ( nPos - 1 ) >> 1;
+			if ( !( entry.m_flError < m_heap[nParent].m_flError ) )
+				break;
+			m_heap[nPos] = m_heap[nParent];
+			m_heapIndex[m_heap[nPos].m_nEdgeIndex] = nPos;
+			nPos = nParent;
+		}
+		m_heap[nPos] = entry;
+		m_heapIndex[entry.m_nEdgeIndex] = nPos;
+	}
+
+	void SiftDown( int nPos )
+	{
+		int nCount = m_heap.Count();
+		edge_queue_entry_t entry = m_heap[nPos];
+		while ( true )
+		{
+			int nChild = nPos * 2 + 1;
+			if ( nChild >= nCount )
+				break;
+			if ( nChild + 1 < nCount && m_heap[nChild + 1].m_flError < m_heap[nChild].m_flError )
+			{
+				nChild++;
+			}
+			if ( !( m_heap[nChild].m_flError < entry.m_flError ) )
+				break;
+			m_heap[nPos] = m_heap[nChild];
+			m_heapIndex[m_heap[nPos].m_nEdgeIndex] = nPos;
+			nPos = nChild;
+		}
+		m_heap[nPos] = entry;
+		m_heapIndex[entry.m_nEdgeIndex] = nPos;
+	}
+
+	CUtlVector<edge_queue_entry_t> m_heap;
+	CUtlVector<int> m_heapIndex;		// position of each edge in m_heap, -1 if it isn't queued
 };
 
 
@@ -164,17 +283,8 @@ struct edge_hash_t
 	uint32			m_nV1;
 };
 
-class CUniqueVertexList : public CUtlVectorFixedGrowable<uint32, 32>
-{
-public:
-	void AddIfUnique( uint32 nVertex )
-	{
-		if ( Find( nVertex ) == -1 )
-		{
-			AddToTail( nVertex );
-		}
-	}
-};
+// Vertex lists are kept unique with CMeshVisit's vertex marks rather than by searching them
+typedef CUtlVectorFixedGrowable<uint32, 32> CUniqueVertexList;
 
 class CMeshVisit
 {
@@ -183,14 +293,41 @@ public:
 	int FindMinErrorEdge();
 	void CollapseEdge( int nCollapse );
 	void RemapEdge( int nVertexRemove, int nVertexConnect, int nVertexKeep );
-	void ComputeVertListError( float flOpenEdgePenalty, float flMinArea, float flMaxArea, const mesh_simplifyweights_t *pWeights );
+	void ComputeVertListError( float flOpenEdgePenalty, float flMinArea, float flMaxArea, const mesh_simplifyweights_t *pWeights, const CQuadricError *pInitialError = NULL, const uint8 *pHasInitialError = NULL );
 	inline void UpdateEdgeError( CQEMEdge *pEdge )
 	{
 		pEdge->UpdateError( GetVertexPosition(pEdge->m_nVert[0]), GetVertexPosition(pEdge->m_nVert[1]), m_errorVert.Base() );
-		edge_queue_entry_t entry;
-		entry.m_flError = pEdge->m_flCurrentError;
-		entry.m_nEdgeIndex = pEdge - m_edgeList.Base();
-		m_edgeQueue.Insert( entry );
+		// edges touching a locked vertex are never collapsed, so don't bother queueing them
+		if ( !IsLockedEdge( pEdge ) )
+		{
+			m_edgeQueue.Update( pEdge - m_edgeList.Base(), pEdge->m_flCurrentError );
+		}
+		else
+		{
+			m_edgeQueue.Remove( pEdge - m_edgeList.Base() );
+		}
+	}
+	inline void MarkEdgeCollapsed( CQEMEdge *pEdge )
+	{
+		pEdge->MarkCollapsed();
+		m_edgeQueue.Remove( pEdge - m_edgeList.Base() );
+	}
+	inline bool IsLockedEdge( const CQEMEdge *pEdge ) const
+	{
+		return m_pLockedVerts && ( m_pLockedVerts[pEdge->m_nVert[0]] || m_pLockedVerts[pEdge->m_nVert[1]] );
+	}
+
+	// Returns a stamp (or nMarks consecutive stamps) no vertex is marked with yet
+	inline uint32 NewVertexMark( uint32 nMarks = 1 )
+	{
+		if ( m_nVertexMark > 0xFFFFFFFFu - nMarks )
+		{
+			m_vertexMark.FillWithValue( 0 );
+			m_nVertexMark = 0;
+		}
+		uint32 nFirst = m_nVertexMark + 1;
+		m_nVertexMark += nMarks;
+		return nFirst;
 	}
 	void Get1Ring( CUniqueVertexList &list, uint32 nVertex );
 	int CountSharedVerts( int nVert0, int nVert1 );
@@ -231,6 +368,9 @@ public:
 	CUtlVector<CVertVisit>	m_vertList;
 
 	CEdgeQueue				m_edgeQueue;
+	CUtlVector<uint32>		m_vertexMark;
+	uint32					m_nVertexMark;
+	const uint8				*m_pLockedVerts;		// optional, vertices that must not move
 	CUtlVector<float>		m_vertData;
 	float					*m_pVertexBase;
 	int						m_nVertexStrideFloats;
@@ -294,7 +434,7 @@ void CMeshVisit::RemapEdge( int nVertexRemove, int nVertexConnect, int nVertexKe
 		m_edgeHash.Remove( edgeHashIndex );
 		if ( pEdge->m_nVert[0] == pEdge->m_nVert[1] )
 		{
-			pEdge->MarkCollapsed();
+			MarkEdgeCollapsed( pEdge );
 		}
 		else
 		{
@@ -310,7 +450,7 @@ void CMeshVisit::RemapEdge( int nVertexRemove, int nVertexConnect, int nVertexKe
 			if ( m_edgeHash.Find( nHashKey, tmp ) != m_edgeHash.InvalidHandle() )
 			{
 				// another edge with these indices exists in the table, mark as collapsed
-				pEdge->MarkCollapsed();
+				MarkEdgeCollapsed( pEdge );
 			}
 			else
 			{
@@ -322,12 +462,21 @@ void CMeshVisit::RemapEdge( int nVertexRemove, int nVertexConnect, int nVertexKe
 
 void CMeshVisit::Get1Ring( CUniqueVertexList &list, uint32 nVertex )
 {
+	uint32 nMark = NewVertexMark();
 	int nTriCount = m_vertList[nVertex].m_triangles.Count();
 	for ( int i = 0; i < nTriCount; i++ )
 	{
 		const vertex_triangle_t &tri = m_vertList[nVertex].m_triangles[i];
-		list.AddIfUnique( tri.nV1 );
-		list.AddIfUnique( tri.nV2 );
+		if ( m_vertexMark[tri.nV1] != nMark )
+		{
+			m_vertexMark[tri.nV1] = nMark;
+			list.AddToTail( tri.nV1 );
+		}
+		if ( m_vertexMark[tri.nV2] != nMark )
+		{
+			m_vertexMark[tri.nV2] = nMark;
+			list.AddToTail( tri.nV2 );
+		}
 	}
 }
 
@@ -335,16 +484,29 @@ void CMeshVisit::Get1Ring( CUniqueVertexList &list, uint32 nVertex )
 // This is used to prevent creating shark fin topologies
 int CMeshVisit::CountSharedVerts( int nVert0, int nVert1 )
 {
-	CUniqueVertexList vertIndex0;
-	CUniqueVertexList vertIndex1;
+	// mark the 1-ring of vert0, then count (and re-mark, so they aren't counted twice) the ones vert1 reaches
+	uint32 nRing0 = NewVertexMark( 2 );
+	uint32 nShared = nRing0 + 1;
+
+	const CUtlVector<vertex_triangle_t> &tris0 = m_vertList[nVert0].m_triangles;
+	for ( int i = 0; i < tris0.Count(); i++ )
+	{
+		m_vertexMark[tris0[i].nV1] = nRing0;
+		m_vertexMark[tris0[i].nV2] = nRing0;
+	}
 
-	Get1Ring( vertIndex0, nVert0 );
-	Get1Ring( vertIndex1, nVert1 );
 	int nSharedCount = 0;
-	for ( int i = 0; i < vertIndex1.Count(); i++ )
+	const CUtlVector<vertex_triangle_t> &tris1 = m_vertList[nVert1].m_triangles;
+	for ( int i = 0; i < tris1.Count(); i++ )
 	{
-		if ( vertIndex0.Find(vertIndex1[i]) != -1 )
+		if ( m_vertexMark[tris1[i].nV1] == nRing0 )
 		{
+			m_vertexMark[tris1[i].nV1] = nShared;
+			nSharedCount++;
+		}
+		if ( m_vertexMark[tris1[i].nV2] == nRing0 )
+		{
+			m_vertexMark[tris1[i].nV2] = nShared;
 			nSharedCount++;
 		}
 	}
@@ -391,7 +553,7 @@ bool CMeshVisit::IsValidCollapse( int nMinEdge )
 	if ( nMinEdge < 0 )
 		return true;
 
-	if ( m_edgeList[nMinEdge].m_bNonManifold )
+	if ( m_edgeList[nMinEdge].m_bNonManifold || IsLockedEdge( &m_edgeList[nMinEdge] ) )
 		return false;
 
 	int nVert0 = m_edgeList[nMinEdge].m_nVert[0];
@@ -408,7 +570,7 @@ bool CMeshVisit::IsValidCollapse( int nMinEdge )
 void CMeshVisit::CollapseEdge( int nCollapse )
 {
 
-	m_edgeList[nCollapse].MarkCollapsed();
+	MarkEdgeCollapsed( &m_edgeList[nCollapse] );
 	Vector vOptimal = m_edgeList[nCollapse].m_vOptimal;
 	// get the vert being removed
 	Assert(nCollapse < m_edgeList.Count() );
@@ -561,6 +723,8 @@ void CMeshVisit::BuildFromMesh( const CMesh &input )
 {
 
 
+	m_pLockedVerts = NULL;
+
 	// NOTE: This assumes that position is the FIRST float3 in the buffer
 	int nPosOffset = input.FindFirstAttributeOffset( VERTEX_ELEMENT_POSITION );
 	if ( nPosOffset != 0 )
@@ -635,6 +799,11 @@ void CMeshVisit::BuildFromMesh( const CMesh &input )
 	m_nVertexStrideFloats = input.m_nVertexStrideFloats;
 	V_memcpy( m_pVertexBase, input.GetVertex(0), input.GetTotalVertexSizeInBytes() );
 	m_nCollapseIndex = 0;
+
+	m_vertexMark.SetCount( nInputVertCount );
+	m_vertexMark.FillWithValue( 0 );
+	m_nVertexMark = 0;
+	m_edgeQueue.Init( m_edgeList.Count() );
 }
 
 // Removes elements from the queue until a valid one is found, returns that index or -1 indicating there are no valid edges
@@ -648,24 +817,25 @@ int CMeshVisit::FindMinErrorEdge()
 		if ( !m_edgeQueue.Count() )
 			return -1;
 
-		edge_queue_entry_t entry = m_edgeQueue.ElementAtHead();
+		// queued edges are always current; ones that can't be collapsed now drop out
+		// of the queue until a neighboring collapse updates them
+		int nEdgeIndex = m_edgeQueue.ElementAtHead().m_nEdgeIndex;
 		m_edgeQueue.RemoveAtHead();
 
-		CQEMEdge &edge = m_edgeList[entry.m_nEdgeIndex];
-		if ( edge.m_flCurrentError == entry.m_flError && !edge.IsCollapsed() )
+		Assert( !m_edgeList[nEdgeIndex].IsCollapsed() );
+		if ( IsValidCollapse( nEdgeIndex ) )
 		{
-			if ( IsValidCollapse( entry.m_nEdgeIndex ) )
-			{
-				nBest = entry.m_nEdgeIndex;
-				break;
-			}
+			nBest = nEdgeIndex;
+			break;
 		}
 	}
 
 	return nBest;
 }
 
-void CMeshVisit::ComputeVertListError( float flOpenEdgePenalty, float flMinArea, float flMaxArea, const mesh_simplifyweights_t *pWeights )
+// Vertices flagged in pHasInitialError start from the (already weighted) error in pInitialError instead,
+// so a mesh that was simplified in pieces keeps the error those collapses accumulated
+void CMeshVisit::ComputeVertListError( float flOpenEdgePenalty, float flMinArea, float flMaxArea, const mesh_simplifyweights_t *pWeights, const CQuadricError *pInitialError, const uint8 *pHasInitialError )
 {
 	m_errorVert.SetCount( m_nInputVertCount );
 	if ( pWeights )
@@ -678,6 +848,11 @@ void CMeshVisit::ComputeVertListError( float flOpenEdgePenalty, float flMinArea,
 	}
 	for ( int i = 0; i < m_nInputVertCount; i++ )
 	{
+		if ( pInitialError && pHasInitialError[i] )
+		{
+			m_errorVert[i] = pInitialError[i];
+			continue;
+		}
 		m_errorVert[i].SetToZero();
 		for ( int j = 0; j < m_vertList[i].m_triangles.Count(); j++ )
 		{
@@ -707,11 +882,18 @@ void CMeshVisit::ComputeVertListError( float flOpenEdgePenalty, float flMinArea,
 		}
 	}
 
+	// every edge is new here, so queue them all and sort once
 	int nInputEdgeCount = m_edgeList.Count();
 	for ( int i = 0; i < nInputEdgeCount; i++ )
 	{
-		UpdateEdgeError( &m_edgeList[i] );
+		CQEMEdge *pEdge = &m_edgeList[i];
+		pEdge->UpdateError( GetVertexPosition(pEdge->m_nVert[0]), GetVertexPosition(pEdge->m_nVert[1]), m_errorVert.Base() );
+		if ( !IsLockedEdge( pEdge ) )
+		{
+			m_edgeQueue.InsertUnsorted( i, pEdge->m_flCurrentError );
+		}
 	}
+	m_edgeQueue.Heapify();
 }
 
 void GetOpenEdges( CUtlVector<Vector> &list, const CMesh &input )
@@ -729,11 +911,14 @@ void GetOpenEdges( CUtlVector<Vector> &list, const CMesh &input )
 	}
 }
 
-void SimplifyMeshQEM2( CMesh &meshOut, const CMesh &input, const mesh_simplifyparams_t &params, const mesh_simplifyweights_t *pWeights )
+// pErrorOut receives each output vertex's accumulated error, which can be passed back in as pInitialError
+void SimplifyMeshQEM2( CMesh &meshOut, const CMesh &input, const mesh_simplifyparams_t &params, const mesh_simplifyweights_t *pWeights, CUtlVector<int> *pSourceVertexOut, const uint8 *pLockedVerts = NULL,
+	CUtlVector<CQuadricError> *pErrorOut = NULL, const CQuadricError *pInitialError = NULL, const uint8 *pHasInitialError = NULL )
 {
 
 	CMeshVisit visit;
 	visit.BuildFromMesh( input );
+	visit.m_pLockedVerts = pLockedVerts;
 	CUtlVector<CQuadricError> errorEdge;
 
 	int nInputVertCount = input.m_nVertexCount;
@@ -741,7 +926,7 @@ void SimplifyMeshQEM2( CMesh &meshOut, const CMesh &input, const mesh_simplifypa
 	int nInputEdgeCount = visit.m_edgeList.Count();
 	errorEdge.SetCount( nInputEdgeCount );
 	visit.m_flIntegrationPenalty = params.m_flIntegrationPenalty;
-	visit.ComputeVertListError( params.m_flOpenEdgePenalty, 0.0f, 1.0f, pWeights );
+	visit.ComputeVertListError( params.m_flOpenEdgePenalty, 0.0f, 1.0f, pWeights, pInitialError, pHasInitialError );
 
 	int nMinEdge = visit.FindMinErrorEdge();
 	int nVertexCurrent = CountUsedVerts( input.m_pIndices, input.m_nIndexCount, input.m_nVertexCount );
@@ -792,11 +977,27 @@ void SimplifyMeshQEM2( CMesh &meshOut, const CMesh &input, const mesh_simplifypa
 	{
 		meshOut.m_pIndices[i] = indexOut[i];
 	}
+	if ( pSourceVertexOut )
+	{
+		pSourceVertexOut->SetCount( nOutputVertexCount );
+	}
+	if ( pErrorOut )
+	{
+		pErrorOut->SetCount( nOutputVertexCount );
+	}
 	for ( int i = 0; i < nInputVertCount; i++ )
 	{
 		if ( nIndexMap[i] != nInvalidIndex )
 		{
 			V_memcpy( meshOut.GetVertex(nIndexMap[i]), visit.GetVertex(i), meshOut.m_nVertexStrideFloats * sizeof(float) );
+			if ( pSourceVertexOut )
+			{
+				(*pSourceVertexOut)[ nIndexMap[i] ] = i;
+			}
+			if ( pErrorOut )
+			{
+				(*pErrorOut)[ nIndexMap[i] ] = visit.m_errorVert[i];
+			}
 		}
 	}
 #if _DEBUG
@@ -805,10 +1006,285 @@ void SimplifyMeshQEM2( CMesh &meshOut, const CMesh &input, const mesh_simplifypa
 #endif
 }
 
-void SimplifyMesh( CMesh &meshOut, const CMesh &input, const mesh_simplifyparams_t &params, const mesh_simplifyweights_t *pWeights )
+// Partitioned simplification doesn't pay off (and locks too much of the mesh) below this many triangles per cluster
+#define MIN_PARTITION_TRIANGLES 4096
+
+// Splits a list of triangles into nParts spatially coherent runs by recursive median splits along the longest axis
+static void PartitionTriangles( CUtlVector<int> &partStart, int *pTriangles, int nCount, int nFirst, const Vector *pCentroids, int nParts )
+{
+	if ( nParts <= 1 )
+	{
+		partStart.AddToTail( nFirst );
+		return;
+	}
+
+	Vector vMins( FLT_MAX, FLT_MAX, FLT_MAX ), vMaxs( -FLT_MAX, -FLT_MAX, -FLT_MAX );
+	for ( int i = 0; i < nCount; i++ )
+	{
+		VectorMin( pCentroids[pTriangles[i]], vMins, vMins );
+		VectorMax( pCentroids[pTriangles[i]], vMaxs, vMaxs );
+	}
+	Vector vSize = vMaxs - vMins;
+	int nAxis = ( vSize.x > vSize.y ) ? ( ( vSize.x > vSize.z ) ? 0 : 2 ) : ( ( vSize.y > vSize.z ) ? 1 : 2 );
+
+	int nLeftParts = nParts / 2;
+	int nLeftCount = (int)( (int64)nCount * nLeftParts / nParts );
+	std::nth_element( pTriangles, pTriangles + nLeftCount, pTriangles + nCount, [pCentroids, nAxis]( int a, int b )
+	{
+		return pCentroids[a][nAxis] < pCentroids[b][nAxis];
+	} );
+
+	PartitionTriangles( partStart, pTriangles, nLeftCount, nFirst, pCentroids, nLeftParts );
+	PartitionTriangles( partStart, pTriangles + nLeftCount, nCount - nLeftCount, nFirst + nLeftCount, pCentroids, nParts - nLeftParts );
+}
+
+// Scales a count limit down to part of the mesh, INT_MAX means no limit
+static int ScaleSimplifyLimit( int nLimit, int nPartCount, int nTotalCount )
+{
+	if ( nLimit == INT_MAX || nTotalCount <= 0 )
+		return nLimit;
+	return (int)ceil( (double)nLimit * nPartCount / nTotalCount );
+}
+
+struct simplify_partition_t
+{
+	CUtlVector<int> m_localToInput;
+	CUtlVector<uint8> m_locked;
+	CUtlVector<float> m_weights;
+	CMesh m_mesh;
+	CMesh m_meshOut;
+	CUtlVector<int> m_sourceVertex;
+	CUtlVector<CQuadricError> m_errorOut;
+	int m_nUsedVertexCount;
+};
+
+// Simplifies spatial clusters of the mesh concurrently, keeping the vertices on cluster boundaries fixed,
+// then simplifies the stitched result as a whole.  Most collapses happen in the clusters; the final pass
+// only has to deal with the boundaries and whatever is left to reach the limits.
+// The final pass starts every interior vertex from the error its cluster accumulated, so later collapses
+// are ranked the same as in a single pass.  Boundary vertices get their error rebuilt from the stitched mesh,
+// since inside a cluster the edges between two boundary vertices look open.
+static void SimplifyMeshPartitioned( CMesh &meshOut, const CMesh &input, const mesh_simplifyparams_t &params, const mesh_simplifyweights_t *pWeights, CUtlVector<int> *pSourceVertexOut )
+{
+	int nInputVertCount = input.m_nVertexCount;
+	int nTriangleCount = input.m_nIndexCount / 3;
+	int nParts = params.m_nPartitionCount;
+	int nStride = input.m_nVertexStrideFloats;
+	if ( pWeights && pWeights->m_nVertexCount != nInputVertCount )
+	{
+		pWeights = NULL;
+	}
+
+	CUtlVector<Vector> centroids;
+	CUtlVector<int> triangles;
+	centroids.SetCount( nTriangleCount );
+	triangles.SetCount( nTriangleCount );
+	for ( int i = 0; i < nTriangleCount; i++ )
+	{
+		const uint32 *pIndices = input.m_pIndices + i * 3;
+		centroids[i] = ( *(const Vector *)input.GetVertex( pIndices[0] ) + *(const Vector *)input.GetVertex( pIndices[1] ) + *(const Vector *)input.GetVertex( pIndices[2] ) ) * ( 1.0f / 3.0f );
+		triangles[i] = i;
+	}
+	CUtlVector<int> partStart;
+	PartitionTriangles( partStart, triangles.Base(), nTriangleCount, 0, centroids.Base(), nParts );
+	partStart.AddToTail( nTriangleCount );
+
+	// vertices used by more than one partition are on a boundary and must not move
+	const int nUnused = -1, nShared = -2;
+	CUtlVector<int> vertexOwner;
+	vertexOwner.SetCount( nInputVertCount );
+	vertexOwner.FillWithValue( nUnused );
+	for ( int p = 0; p < nParts; p++ )
+	{
+		for ( int t = partStart[p]; t < partStart[p + 1]; t++ )
+		{
+			const uint32 *pIndices = input.m_pIndices + triangles[t] * 3;
+			for ( int k = 0; k < 3; k++ )
+			{
+				int &nOwner = vertexOwner[pIndices[k]];
+				if ( nOwner == nUnused )
+				{
+					nOwner = p;
+				}
+				else if ( nOwner != p )
+				{
+					nOwner = nShared;
+				}
+			}
+		}
+	}
+
+	int nUsedVertexCount = 0;
+	for ( int i = 0; i < nInputVertCount; i++ )
+	{
+		if ( vertexOwner[i] != nUnused )
+		{
+			nUsedVertexCount++;
+		}
+	}
+
+	simplify_partition_t *pParts = new simplify_partition_t[nParts];
+	CUtlVector<int> inputToLocal;
+	inputToLocal.SetCount( nInputVertCount );
+	for ( int p = 0; p < nParts; p++ )
+	{
+		simplify_partition_t &part = pParts[p];
+		int nPartTriangles = partStart[p + 1] - partStart[p];
+		inputToLocal.FillWithValue( -1 );
+		CUtlVector<uint32> indices;
+		indices.SetCount( nPartTriangles * 3 );
+		for ( int t = 0; t < nPartTriangles; t++ )
+		{
+			const uint32 *pIndices = input.m_pIndices + triangles[partStart[p] + t] * 3;
+			for ( int k = 0; k < 3; k++ )
+			{
+				int nVertex = pIndices[k];
+				if ( inputToLocal[nVertex] < 0 )
+				{
+					inputToLocal[nVertex] = part.m_localToInput.AddToTail( nVertex );
+					part.m_locked.AddToTail( vertexOwner[nVertex] == nShared ? 1 : 0 );
+					if ( pWeights )
+					{
+						part.m_weights.AddToTail( pWeights->m_pVertexWeights[nVertex] );
+					}
+				}
+				indices[t * 3 + k] = inputToLocal[nVertex];
+			}
+		}
+		int nPartVerts = part.m_localToInput.Count();
+		part.m_nUsedVertexCount = nPartVerts;
+		part.m_mesh.AllocateMesh( nPartVerts, indices.Count(), nStride, input.m_pAttributes, input.m_nAttributeCount );
+		for ( int i = 0; i < nPartVerts; i++ )
+		{
+			V_memcpy( part.m_mesh.GetVertex( i ), input.GetVertex( part.m_localToInput[i] ), nStride * sizeof(float) );
+		}
+		V_memcpy( part.m_mesh.m_pIndices, indices.Base(), indices.Count() * sizeof(uint32) );
+	}
+
+	std::atomic<int> nNextPart( 0 );
+	auto simplifyThread = [&]()
+	{
+		for ( int p = nNextPart++; p < nParts; p = nNextPart++ )
+		{
+			simplify_partition_t &part = pParts[p];
+			mesh_simplifyparams_t partParams = params;
+			partParams.m_nPartitionCount = 0;
+			partParams.m_nMaxTriangleCount = ScaleSimplifyLimit( params.m_nMaxTriangleCount, part.m_mesh.m_nIndexCount / 3, nTriangleCount );
+			partParams.m_nMaxVertexCount = ScaleSimplifyLimit( params.m_nMaxVertexCount, part.m_nUsedVertexCount, nUsedVertexCount );
+
+			mesh_simplifyweights_t partWeights;
+			partWeights.m_pVertexWeights = part.m_weights.Base();
+			partWeights.m_nVertexCount = part.m_weights.Count();
+
+			SimplifyMeshQEM2( part.m_meshOut, part.m_mesh, partParams, pWeights ? &partWeights : NULL, &part.m_sourceVertex, part.m_locked.Base(), &part.m_errorOut );
+		}
+	};
+	int nThreadCount = MIN( (int)std::thread::hardware_concurrency(), nParts );
+	CUtlVector<std::thread *> threads;
+	for ( int i = 1; i < nThreadCount; i++ )
+	{
+		threads.AddToTail( new std::thread( simplifyThread ) );
+	}
+	simplifyThread();
+	for ( int i = 0; i < threads.Count(); i++ )
+	{
+		threads[i]->join();
+		delete threads[i];
+	}
+
+	// Stitch the clusters back together.  Locked vertices come out of every cluster untouched
+	// and every other vertex comes out of one cluster only, so input indices identify them.
+	CUtlVector<int> mergedToInput;
+	CUtlVector<uint32> mergedIndices;
+	CUtlVector<int> &inputToMerged = inputToLocal;
+	inputToMerged.FillWithValue( -1 );
+	for ( int p = 0; p < nParts; p++ )
+	{
+		simplify_partition_t &part = pParts[p];
+		if ( !part.m_meshOut.m_nIndexCount )
+		{
+			// the cluster was too small to simplify, keep it as it was
+			part.m_errorOut.Purge();
+			part.m_sourceVertex.SetCount( part.m_mesh.m_nVertexCount );
+			for ( int i = 0; i < part.m_mesh.m_nVertexCount; i++ )
+			{
+				part.m_sourceVertex[i] = i;
+			}
+			part.m_meshOut.AllocateAndCopyMesh( part.m_mesh.m_nVertexCount, part.m_mesh.m_pVerts, part.m_mesh.m_nIndexCount, part.m_mesh.m_pIndices, nStride, input.m_pAttributes, input.m_nAttributeCount );
+		}
+		for ( int i = 0; i < part.m_meshOut.m_nIndexCount; i++ )
+		{
+			int nInput = part.m_localToInput[ part.m_sourceVertex[ part.m_meshOut.m_pIndices[i] ] ];
+			if ( inputToMerged[nInput] < 0 )
+			{
+				inputToMerged[nInput] = mergedToInput.AddToTail( nInput );
+			}
+			mergedIndices.AddToTail( inputToMerged[nInput] );
+		}
+	}
+
+	CMesh merged;
+	merged.AllocateMesh( mergedToInput.Count(), mergedIndices.Count(), nStride, input.m_pAttributes, input.m_nAttributeCount );
+	V_memcpy( merged.m_pIndices, mergedIndices.Base(), mergedIndices.Count() * sizeof(uint32) );
+	CUtlVector<CQuadricError> mergedError;
+	CUtlVector<uint8> mergedHasError;
+	mergedError.SetCount( mergedToInput.Count() );
+	mergedHasError.SetCount( mergedToInput.Count() );
+	mergedHasError.FillWithValue( 0 );
+	for ( int p = 0; p < nParts; p++ )
+	{
+		simplify_partition_t &part = pParts[p];
+		bool bHasError = part.m_errorOut.Count() == part.m_meshOut.m_nVertexCount;
+		for ( int i = 0; i < part.m_meshOut.m_nVertexCount; i++ )
+		{
+			int nLocal = part.m_sourceVertex[i];
+			int nMerged = inputToMerged[ part.m_localToInput[nLocal] ];
+			V_memcpy( merged.GetVertex( nMerged ), part.m_meshOut.GetVertex( i ), nStride * sizeof(float) );
+			if ( bHasError && !part.m_locked[nLocal] )
+			{
+				mergedError[nMerged] = part.m_errorOut[i];
+				mergedHasError[nMerged] = 1;
+			}
+		}
+	}
+	delete[] pParts;
+
+	CUtlVector<float> mergedWeights;
+	mesh_simplifyweights_t weights;
+	if ( pWeights )
+	{
+		mergedWeights.SetCount( mergedToInput.Count() );
+		for ( int i = 0; i < mergedToInput.Count(); i++ )
+		{
+			mergedWeights[i] = pWeights->m_pVertexWeights[ mergedToInput[i] ];
+		}
+		weights.m_pVertexWeights = mergedWeights.Base();
+		weights.m_nVertexCount = mergedWeights.Count();
+	}
+
+	CUtlVector<int> sourceVertex;
+	SimplifyMeshQEM2( meshOut, merged, params, pWeights ? &weights : NULL, &sourceVertex, NULL, NULL, mergedError.Base(), mergedHasError.Base() );
+	if ( pSourceVertexOut )
+	{
+		pSourceVertexOut->SetCount( sourceVertex.Count() );
+		for ( int i = 0; i < sourceVertex.Count(); i++ )
+		{
+			(*pSourceVertexOut)[i] = mergedToInput[ sourceVertex[i] ];
+		}
+	}
+}
+
+void SimplifyMesh( CMesh &meshOut, const CMesh &input, const mesh_simplifyparams_t &params, const mesh_simplifyweights_t *pWeights, CUtlVector<int> *pSourceVertexOut )
 {
 	Vprof_Start_IfEnabled();
-	SimplifyMeshQEM2( meshOut, input, params, pWeights);
+	if ( params.m_nPartitionCount > 1 && input.m_nIndexCount / 3 >= params.m_nPartitionCount * MIN_PARTITION_TRIANGLES )
+	{
+		SimplifyMeshPartitioned( meshOut, input, params, pWeights, pSourceVertexOut );
+	}
+	else
+	{
+		SimplifyMeshQEM2( meshOut, input, params, pWeights, pSourceVertexOut );
+	}
 
 	Vprof_Report_IfEnabled();
 }
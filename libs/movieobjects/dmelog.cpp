@@ -9,6 +9,7 @@
 #include "datamodel/dmelementfactoryhelper.h"
 #include "datamodel/dmehandle.h"
 #include "vstdlib/random.h"
+#include "mathlib/ssemath.h"
 
 #include "tier0/dbg.h"
 
@@ -1365,37 +1366,52 @@ bool CDmeLogLayer::ValidateKeys() const
 
 int CDmeLogLayer::FindKey( DmeTime_t time ) const
 {
-	int tn = m_times.Count();
-	if ( m_lastKey >= 0 && m_lastKey < tn )
+	// The answer is the last key at or before time, and lies in [nLow - 1, nHigh)
+	int nLow = 0;
+	int nHigh = m_times.Count();
+	if ( m_lastKey >= 0 && m_lastKey < nHigh )
 	{
 		if ( time >= m_times[ m_lastKey ] )
 		{
-			// common case - playing forward
-			for ( ; m_lastKey < tn - 1; ++m_lastKey )
+			// common case - playing forward by a key or so
+			int nLastStep = MIN( m_lastKey + 4, nHigh - 1 );
+			for ( ; m_lastKey < nLastStep; ++m_lastKey )
 			{
 				if ( time < m_times[ m_lastKey + 1 ] )
 					return m_lastKey;
 			}
 
 			// if time past the end, return the last key
-			return m_lastKey;
+			if ( m_lastKey == nHigh - 1 )
+				return m_lastKey;
+
+			nLow = m_lastKey + 1;
 		}
 		else
 		{
-			tn = m_lastKey;
+			nHigh = m_lastKey;
 		}
 	}
 
-	for ( int ti = tn - 1; ti >= 0; --ti )
+	while ( nLow < nHigh )
 	{
-		if ( time >= m_times[ ti ] )
+		int nMid = ( nLow + nHigh ) >> 1;
+		if ( time >= m_times[ nMid ] )
+		{
+			nLow = nMid + 1;
+		}
+		else
 		{
-			m_lastKey = ti;
-			return ti;
+			nHigh = nMid;
 		}
 	}
 
-	return -1;
+	int ti = nLow - 1;
+	if ( ti >= 0 )
+	{
+		m_lastKey = ti;
+	}
+	return ti;
 }
 
 void CDmeLogLayer::ScaleSampleTimes( float scale )
@@ -2728,6 +2744,118 @@ const T& CDmeTypedLogLayer< T >::GetValue( DmeTime_t time ) const
 	return s_value;
 }
 
+//-----------------------------------------------------------------------------
+// Interpolates a batch of segments in place, pFrom receiving the results.
+// The float and Vector versions do 4 lanes at a time, using the same
+// operations as Interpolate so results are bit-identical to it
+//-----------------------------------------------------------------------------
+template< class T >
+static void InterpolateValues( int nCount, const float *pFractions, T *pFrom, const T *pTo )
+{
+	for ( int i = 0; i < nCount; ++i )
+	{
+		pFrom[ i ] = Interpolate( pFractions[ i ], pFrom[ i ], pTo[ i ] );
+	}
+}
+
+template<>
+void InterpolateValues( int nCount, const float *pFractions, float *pFrom, const float *pTo )
+{
+	int i = 0;
+	for ( ; i + 4 <= nCount; i += 4 )
+	{
+		fltx4 t = LoadUnalignedSIMD( pFractions + i );
+		fltx4 result = AddSIMD( MulSIMD( t, LoadUnalignedSIMD( pTo + i ) ), MulSIMD( SubSIMD( Four_Ones, t ), LoadUnalignedSIMD( pFrom + i ) ) );
+		StoreUnalignedSIMD( pFrom + i, result );
+	}
+	for ( ; i < nCount; ++i )
+	{
+		pFrom[ i ] = Interpolate( pFractions[ i ], pFrom[ i ], pTo[ i ] );
+	}
+}
+
+template<>
+void InterpolateValues( int nCount, const float *pFractions, Vector *pFrom, const Vector *pTo )
+{
+	COMPILE_TIME_ASSERT( sizeof( Vector ) == 3 * sizeof( float ) );
+
+	// Treat the vectors as flat float arrays, with each fraction repeated per component
+	CUtlVector< float > componentFractions;
+	componentFractions.SetCount( nCount * 3 );
+	for ( int i = 0; i < nCount; ++i )
+	{
+		componentFractions[ i * 3 + 0 ] = componentFractions[ i * 3 + 1 ] = componentFractions[ i * 3 + 2 ] = pFractions[ i ];
+	}
+	InterpolateValues( nCount * 3, componentFractions.Base(), pFrom->Base(), pTo->Base() );
+}
+
+template< class T >
+void CDmeTypedLogLayer< T >::GetValues( const DmeTime_t *pTimes, int nCount, T *pValues ) const
+{
+	// Curve interpolation looks at 4 keys per sample, just sample it directly
+	if ( IsUsingCurveTypes() && CanInterpolateType( GetDataType() ) )
+	{
+		for ( int i = 0; i < nCount; ++i )
+		{
+			pValues[ i ] = GetValue( pTimes[ i ] );
+		}
+		return;
+	}
+
+	int tc = m_times.Count();
+	bool bInterpolable = IsInterpolableType( GetDataType() );
+
+	// Samples between two keys are gathered up and interpolated together
+	CUtlVector< int > lerpSamples;
+	CUtlVector< float > lerpFractions;
+	CUtlVector< T > lerpFrom;
+	CUtlVector< T > lerpTo;
+
+	int ti = -1;
+	for ( int i = 0; i < nCount; ++i )
+	{
+		DmeTime_t time = pTimes[ i ];
+		if ( i > 0 && time < pTimes[ i - 1 ] )
+		{
+			Assert( 0 );
+			ti = FindKey( time );
+		}
+		else
+		{
+			while ( ti < tc - 1 && time >= m_times[ ti + 1 ] )
+			{
+				++ti;
+			}
+		}
+
+		// Before the first key, the owner's default value may be used
+		if ( ti < 0 )
+		{
+			pValues[ i ] = GetValue( time );
+			continue;
+		}
+
+		if ( ti >= tc - 1 || !bInterpolable || GetSegmentInterpolationSetting( ti ) == SEGMENT_NOINTERPOLATE )
+		{
+			pValues[ i ] = GetKeyValue( ti );
+			continue;
+		}
+
+		lerpSamples.AddToTail( i );
+		lerpFractions.AddToTail( GetFractionOfTimeBetween( time, m_times[ ti ], m_times[ ti + 1 ] ) );
+		int j = lerpFrom.AddToTail();
+		lerpTo.AddToTail();
+		GetTwoKeyValues( ti, lerpFrom[ j ], lerpTo[ j ] );
+	}
+
+	int nLerpCount = lerpSamples.Count();
+	InterpolateValues( nLerpCount, lerpFractions.Base(), lerpFrom.Base(), lerpTo.Base() );
+	for ( int j = 0; j < nLerpCount; ++j )
+	{
+		pValues[ lerpSamples[ j ] ] = lerpFrom[ j ];
+	}
+}
+
 template< class T >
 void CDmeTypedLogLayer< T >::SetKey( DmeTime_t time, const CDmAttribute *pAttr, uint index, SegmentInterpolation_t interpSetting /*= SEGMENT_INTERPOLATE*/, int curveType /*= CURVE_DEFAULT*/ )
 {
@@ -6716,6 +6844,22 @@ const T& CDmeTypedLog< T >::GetValue( DmeTime_t time ) const
 	return GetLayer( bestLayer )->GetValue( time );
 }
 
+template< class T >
+void CDmeTypedLog< T >::GetValues( const DmeTime_t *pTimes, int nCount, T *pValues ) const
+{
+	// FindLayerForTime always picks the only layer there is
+	if ( GetNumLayers() == 1 )
+	{
+		GetLayer( 0 )->GetValues( pTimes, nCount, pValues );
+		return;
+	}
+
+	for ( int i = 0; i < nCount; ++i )
+	{
+		pValues[ i ] = GetValue( pTimes[ i ] );
+	}
+}
+
 template< class T >
 SegmentInterpolation_t CDmeTypedLog< T >::GetSegmentInterpolationSetting( DmeTime_t time ) const
 {
@@ -401,7 +401,7 @@ template< class T > bool CDmeMesh::AddVertexDelta(
 	for ( int j = 0; j < nDeltaCount; ++j )
 	{
 		int nDataIndex = indices.Get( j );
-		const CUtlVector<int> &list = pBaseState->FindVertexIndicesFromDataIndex( nBaseFieldIndex, nDataIndex );
+		CVertexIndexSpan list = pBaseState->FindVertexIndicesFromDataIndex( nBaseFieldIndex, nDataIndex );
 		Assert( list.Count() > 0 );
 		// FIXME: Average everything in the list.. shouldn't be necessary though
 		float flSpeed = speedDelta.Get( speedIndices.Get( list[0] ) );
@@ -498,7 +498,7 @@ template< class T > bool CDmeMesh::AddStereoVertexDelta(
 		for ( int j = 0; j < nDeltaCount; ++j )
 		{
 			int nDataIndex = indices.Get( j );
-			const CUtlVector<int> &list = pBaseState->FindVertexIndicesFromDataIndex( nBaseFieldIndex, nDataIndex );
+			CVertexIndexSpan list = pBaseState->FindVertexIndicesFromDataIndex( nBaseFieldIndex, nDataIndex );
 			Assert( list.Count() > 0 );
 			// FIXME: Average everything in the list.. shouldn't be necessary though
 			float flRightAmount = balanceDelta[ balanceIndices[ list[0] ] ];
@@ -519,7 +519,7 @@ template< class T > bool CDmeMesh::AddStereoVertexDelta(
 	for ( int j = 0; j < nDeltaCount; ++j )
 	{   
 		int nDataIndex = indices.Get( j );
-		const CUtlVector<int> &list = pBaseState->FindVertexIndicesFromDataIndex( nBaseFieldIndex, nDataIndex );
+		CVertexIndexSpan list = pBaseState->FindVertexIndicesFromDataIndex( nBaseFieldIndex, nDataIndex );
 		Assert( list.Count() > 0 );
 		// FIXME: Average everything in the list.. shouldn't be necessary though
 		float flRightAmount = balanceDelta[ balanceIndices[ list[0] ] ];
@@ -4353,7 +4353,7 @@ static bool CollapseRedundantBaseNormals( CDmeVertexData *pDmeVertexData, CUtlVe
 	{
 		int nNewNormalDataIndex = newNormalData.Count();
 
-		const CUtlVector< int > &vertexIndices = pDmeVertexData->FindVertexIndicesFromDataIndex( CDmeVertexData::FIELD_POSITION, i );
+		CVertexIndexSpan vertexIndices = pDmeVertexData->FindVertexIndicesFromDataIndex( CDmeVertexData::FIELD_POSITION, i );
 		for ( int j = 0; j < vertexIndices.Count(); ++j )
 		{
 			bool bUnique = true;
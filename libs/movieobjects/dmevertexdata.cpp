@@ -735,10 +735,10 @@ const CUtlVector<int> &CDmeVertexDataBase::GetVertexIndexData( StandardFields_t
 //-----------------------------------------------------------------------------
 // Returns an inverse map from vertex data index to vertex index
 //-----------------------------------------------------------------------------
-const CUtlVector< int > &CDmeVertexDataBase::FindVertexIndicesFromDataIndex( FieldIndex_t nFieldIndex, int nDataIndex )
+CVertexIndexSpan CDmeVertexDataBase::FindVertexIndicesFromDataIndex( FieldIndex_t nFieldIndex, int nDataIndex )
 {
 	if ( nFieldIndex < 0 )
-		return s_EmptyInt;
+		return CVertexIndexSpan();
 
 	FieldInfo_t &info = m_FieldInfo[nFieldIndex]; 
 	if ( info.m_bInverseMapDirty )
@@ -748,23 +748,46 @@ const CUtlVector< int > &CDmeVertexDataBase::FindVertexIndicesFromDataIndex( Fie
 
 		int nDataCount = vertexArray.Count();
 		int nCount = array.Count();
+		const int *pIndices = array.Base();
 
-		// Clear out the utlvectors
-		info.m_InverseMap.RemoveAll();
-		info.m_InverseMap.SetCount( nDataCount );
+		// Count the vertices using each data index, offset by one so the
+		// running sum below leaves each entry at the start of its row
+		info.m_InverseMapOffsets.SetCount( nDataCount + 1 );
+		int *pOffsets = info.m_InverseMapOffsets.Base();
+		memset( pOffsets, 0, ( nDataCount + 1 ) * sizeof( int ) );
+		for ( int i = 0; i < nCount; ++i )
+		{
+			Assert( pIndices[i] >= 0 && pIndices[i] < nDataCount );
+			++pOffsets[ pIndices[i] + 1 ];
+		}
+		for ( int i = 0; i < nDataCount; ++i )
+		{
+			pOffsets[i + 1] += pOffsets[i];
+		}
 
+		// Scatter the vertex indices into their rows; this advances each offset
+		// to the start of the next row, so shift them back afterwards
+		info.m_InverseMapIndices.SetCount( nCount );
+		int *pInverse = info.m_InverseMapIndices.Base();
 		for ( int i = 0; i < nCount; ++i )
 		{
-			int nIndex = array[ i ];
-			info.m_InverseMap[nIndex].AddToTail( i );
+			pInverse[ pOffsets[ pIndices[i] ]++ ] = i;
+		}
+		for ( int i = nDataCount; i > 0; --i )
+		{
+			pOffsets[i] = pOffsets[i - 1];
 		}
+		pOffsets[0] = 0;
+
 		info.m_bInverseMapDirty = false;
 	}
 
-	return info.m_InverseMap[ nDataIndex ];
+	Assert( nDataIndex >= 0 && nDataIndex < info.m_InverseMapOffsets.Count() - 1 );
+	int nStart = info.m_InverseMapOffsets[ nDataIndex ];
+	return CVertexIndexSpan( info.m_InverseMapIndices.Base() + nStart, info.m_InverseMapOffsets[ nDataIndex + 1 ] - nStart );
 }
 
-const CUtlVector< int > &CDmeVertexDataBase::FindVertexIndicesFromDataIndex( StandardFields_t fieldId, int nDataIndex )
+CVertexIndexSpan CDmeVertexDataBase::FindVertexIndicesFromDataIndex( StandardFields_t fieldId, int nDataIndex )
 {
 	// NOTE! Wrinkles don't exist in the base state, therefore we use the index to index
 	// into the TEXCOORD base state fields instead of the wrinkle fields
@@ -1090,7 +1113,7 @@ void CDmeVertexDeltaData::GenerateWrinkleDelta(
 
 			// NOTE: This will produce bad behavior in cases where two positions share the
 			// same texcoord, which shouldn't theoretically happen.
-			const CUtlVector< int > &baseVerts = pBindState->FindVertexIndicesFromDataIndex( FIELD_POSITION, positionIndices[i] );
+			CVertexIndexSpan baseVerts = pBindState->FindVertexIndicesFromDataIndex( FIELD_POSITION, positionIndices[i] );
 			int nBaseVertCount = baseVerts.Count();
 			for ( int j = 0; j < nBaseVertCount; ++j )
 			{
@@ -1127,7 +1150,7 @@ void CDmeVertexDeltaData::GenerateWrinkleDelta(
 
 			// NOTE: This will produce bad behavior in cases where two positions share the
 			// same texcoord, which shouldn't theoretically happen.
-			const CUtlVector< int > &baseVerts = pBindState->FindVertexIndicesFromDataIndex( FIELD_POSITION, positionIndices[i] );
+			CVertexIndexSpan baseVerts = pBindState->FindVertexIndicesFromDataIndex( FIELD_POSITION, positionIndices[i] );
 			int nBaseVertCount = baseVerts.Count();
 			for ( int j = 0; j < nBaseVertCount; ++j )
 			{
@@ -43,8 +43,8 @@ CDmMeshComp::CDmMeshComp( CDmeMesh *pMesh, CDmeVertexData *pPassedBase )
 	m_verts.EnsureCapacity( nVertices );
 	for ( int i = 0; i < nVertices; ++i )
 	{
-		const CUtlVector< int > &vertexIndices = m_pBase->FindVertexIndicesFromDataIndex( CDmeVertexData::FIELD_POSITION, i );
-		m_verts.AddToTail( new CVert( i, &vertexIndices, &pPositionData[ i ] ) );
+		CVertexIndexSpan vertexIndices = m_pBase->FindVertexIndicesFromDataIndex( CDmeVertexData::FIELD_POSITION, i );
+		m_verts.AddToTail( new CVert( i, vertexIndices, &pPositionData[ i ] ) );
 	}
 
 	// Create edges and faces
@@ -130,9 +130,9 @@ CDmMeshComp::~CDmMeshComp()
 //-----------------------------------------------------------------------------
 //
 //-----------------------------------------------------------------------------
-CDmMeshComp::CVert::CVert( int nPositionIndex, const CUtlVector< int > *pVertexIndices, const Vector *pPosition )
+CDmMeshComp::CVert::CVert( int nPositionIndex, CVertexIndexSpan vertexIndices, const Vector *pPosition )
 : m_positionIndex( nPositionIndex )
-, m_pVertexIndices( pVertexIndices )
+, m_vertexIndices( vertexIndices )
 , m_pPosition( pPosition )
 , m_edges( 8, 8 )
 {
@@ -144,7 +144,7 @@ CDmMeshComp::CVert::CVert( int nPositionIndex, const CUtlVector< int > *pVertexI
 //-----------------------------------------------------------------------------
 CDmMeshComp::CVert::CVert( const CVert &src )
 : m_positionIndex( src.m_positionIndex )
-, m_pVertexIndices( src.m_pVertexIndices )
+, m_vertexIndices( src.m_vertexIndices )
 , m_pPosition( src.m_pPosition )
 , m_edges( 8, 8 )
 {
@@ -173,9 +173,9 @@ const Vector *CDmMeshComp::CVert::Position() const
 //-----------------------------------------------------------------------------
 //
 //-----------------------------------------------------------------------------
-const CUtlVector< int > *CDmMeshComp::CVert::VertexIndices() const
+CVertexIndexSpan CDmMeshComp::CVert::VertexIndices() const
 {
-	return m_pVertexIndices;
+	return m_vertexIndices;
 }
 
 
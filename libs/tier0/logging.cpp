@@ -8,6 +8,7 @@
 #include "logging.h"
 
 #include <cstring>
+#include <mutex>
 
 
 #define DBG_SPEW_ALL_WARNINGS_AND_ERRORS_ASSERT false
@@ -120,13 +121,11 @@ m_nGlobalStateIndex( 0 )
 		m_LoggingStates[i].m_nListenerCount = -1;
 	}
 
-//	m_pStateMutex = NULL;
 }
 
 CLoggingSystem::~CLoggingSystem()
 {
 	g_bEnforceLoggingSystemSingleton = false;
-//	delete m_pStateMutex;
 }
 
 LoggingChannelID_t CLoggingSystem::RegisterLoggingChannel( const char *pChannelName, RegisterTagsFunc registerTagsFunc, int flags, LoggingSeverity_t severity, Color spewColor )
@@ -251,10 +250,7 @@ void CLoggingSystem::SetGlobalSpewLevel( LoggingSeverity_t minimumSeverity )
 
 void CLoggingSystem::PushLoggingState( bool bThreadLocal, bool bClearState )
 {
-//	if ( !m_pStateMutex )
-//		m_pStateMutex = new CThreadFastMutex();
-
-//	m_pStateMutex->Lock();
+	std::lock_guard< std::recursive_mutex > lock( m_StateMutex );
 	
 	int nNewState = FindUnusedStateIndex();
 	// Ensure we're not out of state blocks.
@@ -283,15 +279,11 @@ void CLoggingSystem::PushLoggingState( bool bThreadLocal, bool bClearState )
 		m_nGlobalStateIndex = nNewState;
 	/*}*/
 
-//	m_pStateMutex->Unlock();
 }
 
 void CLoggingSystem::PopLoggingState( bool bThreadLocal )
 {
-//	if ( !m_pStateMutex )
-//		m_pStateMutex = new CThreadFastMutex();
-//
-//	m_pStateMutex->Lock();
+	std::lock_guard< std::recursive_mutex > lock( m_StateMutex );
 
 	int nCurrentState = /*bThreadLocal ? (int)g_nThreadLocalStateIndex :*/ m_nGlobalStateIndex;
 	
@@ -310,15 +302,11 @@ void CLoggingSystem::PopLoggingState( bool bThreadLocal )
 		m_nGlobalStateIndex = m_LoggingStates[nCurrentState].m_nPreviousStackEntry;
 	/*}*/
 
-//	m_pStateMutex->Unlock();
 }
 
 void CLoggingSystem::RegisterLoggingListener( ILoggingListener *pListener )
 {
-//	if ( !m_pStateMutex )
-//		m_pStateMutex = new CThreadFastMutex();
-//
-//	m_pStateMutex->Lock();
+	std::lock_guard< std::recursive_mutex > lock( m_StateMutex );
 	LoggingState_t *pState = GetCurrentState();
 	if ( pState->m_nListenerCount >= ARRAYSIZE(pState->m_RegisteredListeners) )
 	{
@@ -330,15 +318,11 @@ void CLoggingSystem::RegisterLoggingListener( ILoggingListener *pListener )
 		pState->m_RegisteredListeners[pState->m_nListenerCount] = pListener;
 		++ pState->m_nListenerCount;
 	}
-//	m_pStateMutex->Unlock();
 }
 
 bool CLoggingSystem::IsListenerRegistered( ILoggingListener *pListener )
 {
-//	if ( !m_pStateMutex )
-//		m_pStateMutex = new CThreadFastMutex();
-//
-//	m_pStateMutex->Lock();
+	std::lock_guard< std::recursive_mutex > lock( m_StateMutex );
 	const LoggingState_t *pState = GetCurrentState();
 	bool bFound = false;
 	for ( int i = 0; i < pState->m_nListenerCount; ++ i )
@@ -349,28 +333,20 @@ bool CLoggingSystem::IsListenerRegistered( ILoggingListener *pListener )
 			break;
 		}
 	}
-//	m_pStateMutex->Unlock();
 	return bFound;
 }
 
 void CLoggingSystem::ResetCurrentLoggingState()
 {
-//	if ( !m_pStateMutex )
-//		m_pStateMutex = new CThreadFastMutex();
-//
-//	m_pStateMutex->Lock();
+	std::lock_guard< std::recursive_mutex > lock( m_StateMutex );
 	LoggingState_t *pState = GetCurrentState();
 	pState->m_nListenerCount = 0;
 	pState->m_pLoggingResponse = &m_DefaultLoggingResponse;
-//	m_pStateMutex->Unlock();
 }
 
 void CLoggingSystem::SetLoggingResponsePolicy( ILoggingResponsePolicy *pLoggingResponse )
 {
-//	if ( !m_pStateMutex )
-//		m_pStateMutex = new CThreadFastMutex();
-//
-//	m_pStateMutex->Lock();
+	std::lock_guard< std::recursive_mutex > lock( m_StateMutex );
 	LoggingState_t *pState = GetCurrentState();
 	if ( pLoggingResponse == NULL )
 	{
@@ -380,7 +356,6 @@ void CLoggingSystem::SetLoggingResponsePolicy( ILoggingResponsePolicy *pLoggingR
 	{
 		pState->m_pLoggingResponse = pLoggingResponse;
 	}
-//	m_pStateMutex->Unlock();
 }
 
 LoggingResponse_t CLoggingSystem::LogDirect( LoggingChannelID_t channelID, LoggingSeverity_t severity, Color color, const tchar *pMessage )
@@ -395,36 +370,35 @@ LoggingResponse_t CLoggingSystem::LogDirect( LoggingChannelID_t channelID, Loggi
 	context.m_Severity = severity;
 	context.m_Color = ( color == UNSPECIFIED_LOGGING_COLOR ) ? m_RegisteredChannels[channelID].m_SpewColor : color;
 	
-	// It is assumed that the mutex is reentrant safe on all platforms.
-//	if ( !m_pStateMutex )
-//		m_pStateMutex = new CThreadFastMutex();
-
-//	m_pStateMutex->Lock();
-
-	LoggingState_t *pState = GetCurrentState();
-	
-	for ( int i = 0; i < pState->m_nListenerCount; ++ i )
+	// The mutex is recursive, so a listener that logs from inside Log() doesn't deadlock.
+	// Holding it across the listeners also keeps messages from different threads whole.
+	LoggingResponse_t response;
 	{
-		pState->m_RegisteredListeners[i]->Log( &context, pMessage );
-	}
+		std::lock_guard< std::recursive_mutex > lock( m_StateMutex );
+
+		LoggingState_t *pState = GetCurrentState();
+		
+		for ( int i = 0; i < pState->m_nListenerCount; ++ i )
+		{
+			pState->m_RegisteredListeners[i]->Log( &context, pMessage );
+		}
 
 #if defined( _PS3 ) && !defined( _CERT )
-	if ( !pState->m_nListenerCount )
-	{
-		unsigned int unBytesWritten;
-		sys_tty_write( SYS_TTYP15, pMessage, strlen( pMessage ), &unBytesWritten );
-	}
+		if ( !pState->m_nListenerCount )
+		{
+			unsigned int unBytesWritten;
+			sys_tty_write( SYS_TTYP15, pMessage, strlen( pMessage ), &unBytesWritten );
+		}
 #endif
-	
-	LoggingResponse_t response = pState->m_pLoggingResponse->OnLog( &context );
+		
+		response = pState->m_pLoggingResponse->OnLog( &context );
+	}
 
 	if ( DBG_SPEW_ALL_WARNINGS_AND_ERRORS_ASSERT && severity != LS_MESSAGE )
 	{
 		response = LR_DEBUGGER;
 	}
 
-//	m_pStateMutex->Unlock();
-
 	switch( response )
 	{
 	case LR_DEBUGGER:
@@ -672,6 +646,16 @@ LoggingResponse_t LoggingSystem_LogDirect( LoggingChannelID_t channelID, Logging
 	return GetGlobalLoggingSystem()->LogDirect( channelID, severity, spewColor, pMessage );
 }
 
+void LoggingSystem_Lock()
+{
+	GetGlobalLoggingSystem()->Lock();
+}
+
+void LoggingSystem_Unlock()
+{
+	GetGlobalLoggingSystem()->Unlock();
+}
+
 LoggingResponse_t LoggingSystem_LogAssert( const char *pMessageFormat, ... ) 
 {
 	if ( !GetGlobalLoggingSystem()->IsChannelEnabled( LOG_ASSERT, LS_ASSERT ) )
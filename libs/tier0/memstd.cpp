@@ -13,6 +13,7 @@
 
 
 #include <algorithm>
+#include <atomic>
 
 #include "tier0/dbg.h"
 #include "tier0/memalloc.h"
@@ -2210,6 +2211,142 @@ void CStdMemAlloc::CompactOnFail()
 	CompactHeap();
 }
 
+//-----------------------------------------------------------------------------
+// Process-wide allocation counters (see MemAlloc_BeginStatsScope). Every thread
+// adds to the same atomic totals, so a scope opened on the main thread also sees
+// the work it hands to other threads. Block sizes are only looked up while a
+// scope is open; otherwise the cost is one relaxed load per call.
+//-----------------------------------------------------------------------------
+#define MAX_STATS_SCOPE_DEPTH 32
+
+struct MemAllocStatsSnapshot_t
+{
+	uint64 m_nBytesAllocated;
+	uint64 m_nBytesFreed;
+	uint32 m_nAllocs;
+	uint32 m_nFrees;
+	int64 m_nLiveBytes;
+	int64 m_nPeakBytes;
+};
+
+struct MemAllocStats_t
+{
+	std::atomic< int > m_nDepth;
+	std::atomic< uint64 > m_nBytesAllocated;
+	std::atomic< uint64 > m_nBytesFreed;
+	std::atomic< uint32 > m_nAllocs;
+	std::atomic< uint32 > m_nFrees;
+	std::atomic< int64 > m_nLiveBytes;
+	std::atomic< int64 > m_nPeakBytes;
+
+	// Only touched by the thread opening and closing scopes
+	MemAllocStatsSnapshot_t m_Saved[ MAX_STATS_SCOPE_DEPTH ];
+};
+
+static MemAllocStats_t s_MemStats;
+
+static FORCEINLINE bool StatsScopeActive()
+{
+	return s_MemStats.m_nDepth.load( std::memory_order_relaxed ) > 0;
+}
+
+static size_t StatsBlockSize( void *pMem )
+{
+	return ( pMem && StatsScopeActive() ) ? s_StdMemAlloc.CStdMemAlloc::GetSize( pMem ) : 0;
+}
+
+static void *NoteStatsAlloc( void *pMem )
+{
+	if ( pMem && StatsScopeActive() )
+	{
+		MemAllocStats_t &stats = s_MemStats;
+		size_t nSize = s_StdMemAlloc.CStdMemAlloc::GetSize( pMem );
+		stats.m_nBytesAllocated.fetch_add( nSize, std::memory_order_relaxed );
+		stats.m_nAllocs.fetch_add( 1, std::memory_order_relaxed );
+		int64 nLive = stats.m_nLiveBytes.fetch_add( nSize, std::memory_order_relaxed ) + nSize;
+		int64 nPeak = stats.m_nPeakBytes.load( std::memory_order_relaxed );
+		while ( nLive > nPeak && !stats.m_nPeakBytes.compare_exchange_weak( nPeak, nLive, std::memory_order_relaxed ) )
+		{
+		}
+	}
+	return pMem;
+}
+
+static void NoteStatsFree( size_t nSize )
+{
+	if ( nSize && StatsScopeActive() )
+	{
+		MemAllocStats_t &stats = s_MemStats;
+		stats.m_nBytesFreed.fetch_add( nSize, std::memory_order_relaxed );
+		stats.m_nFrees.fetch_add( 1, std::memory_order_relaxed );
+		stats.m_nLiveBytes.fetch_sub( nSize, std::memory_order_relaxed );
+	}
+}
+
+// A failed realloc leaves the old block alone, so it only counts once it succeeds.
+// Callers route reallocs of NULL to an alloc that already counted itself.
+static void *NoteStatsRealloc( size_t nOldSize, void *pNewMem )
+{
+	if ( pNewMem )
+	{
+		NoteStatsFree( nOldSize );
+		NoteStatsAlloc( pNewMem );
+	}
+	return pNewMem;
+}
+
+void MemAlloc_BeginStatsScope()
+{
+	MemAllocStats_t &stats = s_MemStats;
+	int nDepth = stats.m_nDepth.load( std::memory_order_relaxed );
+	Assert( nDepth < MAX_STATS_SCOPE_DEPTH );
+	if ( nDepth < MAX_STATS_SCOPE_DEPTH )
+	{
+		// The peak of the new scope starts from what is live now; the outer
+		// scope gets the larger of the two peaks back when this one ends
+		MemAllocStatsSnapshot_t &saved = stats.m_Saved[ nDepth ];
+		saved.m_nBytesAllocated = stats.m_nBytesAllocated.load( std::memory_order_relaxed );
+		saved.m_nBytesFreed = stats.m_nBytesFreed.load( std::memory_order_relaxed );
+		saved.m_nAllocs = stats.m_nAllocs.load( std::memory_order_relaxed );
+		saved.m_nFrees = stats.m_nFrees.load( std::memory_order_relaxed );
+		saved.m_nLiveBytes = stats.m_nLiveBytes.load( std::memory_order_relaxed );
+		saved.m_nPeakBytes = stats.m_nPeakBytes.exchange( saved.m_nLiveBytes, std::memory_order_relaxed );
+	}
+
+	// Still count the nesting past the limit, the overflowing scopes just report nothing
+	stats.m_nDepth.fetch_add( 1, std::memory_order_relaxed );
+}
+
+void MemAlloc_EndStatsScope( MemAllocScopeStats_t *pStats )
+{
+	MemAllocStats_t &stats = s_MemStats;
+	int nDepth = stats.m_nDepth.load( std::memory_order_relaxed );
+	Assert( nDepth > 0 );
+	if ( pStats )
+	{
+		memset( pStats, 0, sizeof( *pStats ) );
+	}
+	if ( nDepth <= 0 )
+		return;
+
+	stats.m_nDepth.fetch_sub( 1, std::memory_order_relaxed );
+	if ( nDepth > MAX_STATS_SCOPE_DEPTH )
+		return;
+
+	const MemAllocStatsSnapshot_t &start = stats.m_Saved[ nDepth - 1 ];
+	int64 nPeak = stats.m_nPeakBytes.load( std::memory_order_relaxed );
+	if ( pStats )
+	{
+		pStats->m_nBytesAllocated = stats.m_nBytesAllocated.load( std::memory_order_relaxed ) - start.m_nBytesAllocated;
+		pStats->m_nBytesFreed = stats.m_nBytesFreed.load( std::memory_order_relaxed ) - start.m_nBytesFreed;
+		pStats->m_nAllocs = stats.m_nAllocs.load( std::memory_order_relaxed ) - start.m_nAllocs;
+		pStats->m_nFrees = stats.m_nFrees.load( std::memory_order_relaxed ) - start.m_nFrees;
+		pStats->m_nNetBytes = stats.m_nLiveBytes.load( std::memory_order_relaxed ) - start.m_nLiveBytes;
+		pStats->m_nPeakBytes = nPeak - start.m_nLiveBytes;
+	}
+	stats.m_nPeakBytes.store( MAX( nPeak, start.m_nPeakBytes ), std::memory_order_relaxed );
+}
+
 //-----------------------------------------------------------------------------
 // Release versions
 //-----------------------------------------------------------------------------
@@ -2217,35 +2354,41 @@ void CStdMemAlloc::CompactOnFail()
 void *CStdMemAlloc::Alloc( size_t nSize )
 {
 	size_t nAdjustedSize = LMDAdjustSize( nSize );
-	return LMDNoteAlloc( CStdMemAlloc::InternalAlloc( DEF_REGION, nAdjustedSize ), nSize );
+	return NoteStatsAlloc( LMDNoteAlloc( CStdMemAlloc::InternalAlloc( DEF_REGION, nAdjustedSize ), nSize ) );
 }
 
 #ifdef MEMALLOC_SUPPORTS_ALIGNED_ALLOCATIONS
 void * CStdMemAlloc::AllocAlign( size_t nSize, size_t align )
 {
 	size_t nAdjustedSize = LMDAdjustSize( nSize, align );
-	return LMDNoteAlloc( CStdMemAlloc::InternalAllocAligned( DEF_REGION, nAdjustedSize, align ), nSize, align );
+	return NoteStatsAlloc( LMDNoteAlloc( CStdMemAlloc::InternalAllocAligned( DEF_REGION, nAdjustedSize, align ), nSize, align ) );
 }
 #endif // MEMALLOC_SUPPORTS_ALIGNED_ALLOCATIONS
 
 void *CStdMemAlloc::Realloc( void *pMem, size_t nSize )
 {
+	if ( !pMem )
+		return RegionAlloc( DEF_REGION, nSize );
+
+	size_t nOldSize = StatsBlockSize( pMem );
 	if ( UsingLMD() )
-		return LMDRealloc( pMem, nSize );
-	return CStdMemAlloc::InternalRealloc( pMem, nSize );
+		return NoteStatsRealloc( nOldSize, LMDRealloc( pMem, nSize ) );
+	return NoteStatsRealloc( nOldSize, CStdMemAlloc::InternalRealloc( pMem, nSize ) );
 }
 
 #ifdef MEMALLOC_SUPPORTS_ALIGNED_ALLOCATIONS
 void * CStdMemAlloc::ReallocAlign( void *pMem, size_t nSize, size_t align )
 {
+	size_t nOldSize = StatsBlockSize( pMem );
 	if ( UsingLMD() )
-		return LMDRealloc( pMem, nSize, align );
-	return CStdMemAlloc::InternalReallocAligned( pMem, nSize, align );
+		return NoteStatsRealloc( nOldSize, LMDRealloc( pMem, nSize, align ) );
+	return NoteStatsRealloc( nOldSize, CStdMemAlloc::InternalReallocAligned( pMem, nSize, align ) );
 }
 #endif // MEMALLOC_SUPPORTS_ALIGNED_ALLOCATIONS
 
 void  CStdMemAlloc::Free( void *pMem )
 {
+	NoteStatsFree( StatsBlockSize( pMem ) );
 	pMem = LMDNoteFree( pMem );
 	CStdMemAlloc::InternalFree( pMem );
 }
@@ -2261,35 +2404,41 @@ void *CStdMemAlloc::Expand_NoLongerSupported( void *pMem, size_t nSize )
 void *CStdMemAlloc::Alloc( size_t nSize, const char *pFileName, int nLine )
 {
 	size_t nAdjustedSize = LMDAdjustSize( nSize );
-	return LMDNoteAlloc( CStdMemAlloc::InternalAlloc( DEF_REGION, nAdjustedSize ), nSize, 0, pFileName, nLine );
+	return NoteStatsAlloc( LMDNoteAlloc( CStdMemAlloc::InternalAlloc( DEF_REGION, nAdjustedSize ), nSize, 0, pFileName, nLine ) );
 }
 
 #ifdef MEMALLOC_SUPPORTS_ALIGNED_ALLOCATIONS
 void *CStdMemAlloc::AllocAlign( size_t nSize, size_t align, const char *pFileName, int nLine )
 {
 	size_t nAdjustedSize = LMDAdjustSize( nSize, align );
-	return LMDNoteAlloc( CStdMemAlloc::InternalAllocAligned( DEF_REGION, nAdjustedSize, align ), nSize, align, pFileName, nLine );
+	return NoteStatsAlloc( LMDNoteAlloc( CStdMemAlloc::InternalAllocAligned( DEF_REGION, nAdjustedSize, align ), nSize, align, pFileName, nLine ) );
 }
 #endif // MEMALLOC_SUPPORTS_ALIGNED_ALLOCATIONS
 
 void *CStdMemAlloc::Realloc( void *pMem, size_t nSize, const char *pFileName, int nLine )
 {
+	if ( !pMem )
+		return RegionAlloc( DEF_REGION, nSize, pFileName, nLine );
+
+	size_t nOldSize = StatsBlockSize( pMem );
 	if ( UsingLMD() )
-		return LMDRealloc( pMem, nSize, 0, pFileName, nLine );
-	return CStdMemAlloc::InternalRealloc( pMem, nSize );
+		return NoteStatsRealloc( nOldSize, LMDRealloc( pMem, nSize, 0, pFileName, nLine ) );
+	return NoteStatsRealloc( nOldSize, CStdMemAlloc::InternalRealloc( pMem, nSize ) );
 }
 
 #ifdef MEMALLOC_SUPPORTS_ALIGNED_ALLOCATIONS
 void * CStdMemAlloc::ReallocAlign( void *pMem, size_t nSize, size_t align, const char *pFileName, int nLine )
 {
+	size_t nOldSize = StatsBlockSize( pMem );
 	if ( UsingLMD() )
-		return LMDRealloc( pMem, nSize, align, pFileName, nLine );
-	return CStdMemAlloc::InternalReallocAligned( pMem, nSize, align );
+		return NoteStatsRealloc( nOldSize, LMDRealloc( pMem, nSize, align, pFileName, nLine ) );
+	return NoteStatsRealloc( nOldSize, CStdMemAlloc::InternalReallocAligned( pMem, nSize, align ) );
 }
 #endif // MEMALLOC_SUPPORTS_ALIGNED_ALLOCATIONS
 
 void  CStdMemAlloc::Free( void *pMem, const char *pFileName, int nLine )
 {
+	NoteStatsFree( StatsBlockSize( pMem ) );
 	pMem = LMDNoteFree( pMem );
 	CStdMemAlloc::InternalFree( pMem );
 }
@@ -2305,13 +2454,13 @@ void *CStdMemAlloc::Expand_NoLongerSupported( void *pMem, size_t nSize, const ch
 void *CStdMemAlloc::RegionAlloc( int region, size_t nSize ) 
 {
 	size_t nAdjustedSize = LMDAdjustSize( nSize );
-	return LMDNoteAlloc( CStdMemAlloc::InternalAlloc( region, nAdjustedSize ), nSize );
+	return NoteStatsAlloc( LMDNoteAlloc( CStdMemAlloc::InternalAlloc( region, nAdjustedSize ), nSize ) );
 }
 
 void *CStdMemAlloc::RegionAlloc( int region, size_t nSize, const char *pFileName, int nLine )
 {
 	size_t nAdjustedSize = LMDAdjustSize( nSize );
-	return LMDNoteAlloc( CStdMemAlloc::InternalAlloc( region, nAdjustedSize ), nSize, 0, pFileName, nLine );
+	return NoteStatsAlloc( LMDNoteAlloc( CStdMemAlloc::InternalAlloc( region, nAdjustedSize ), nSize, 0, pFileName, nLine ) );
 }
 
 #if defined (LINUX)
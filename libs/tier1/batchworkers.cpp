@@ -0,0 +1,352 @@
+//===== Copyright © 1996-2008, Valve Corporation, All rights reserved. ======//
+//
+// Purpose: Splits a batch of files between worker processes
+//
+//===========================================================================//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <thread>
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+extern char **environ;
+#endif
+
+#include "tier0/dbg.h"
+#include "tier0/icommandline.h"
+#include "tier1/strtools.h"
+#include "tier1/batchworkers.h"
+
+
+#ifdef _WIN32
+typedef intptr_t ProcessHandle_t;
+#else
+typedef pid_t ProcessHandle_t;
+#endif
+
+
+bool Batch_GetFileInfo( const char *pFileName, int64 &nSize, int64 &nTime )
+{
+	struct stat buf;
+	if ( stat( pFileName, &buf ) != 0 || ( buf.st_mode & S_IFDIR ) )
+		return false;
+
+	nSize = buf.st_size;
+	nTime = buf.st_mtime;
+	return true;
+}
+
+int Batch_GetWorkerCount( int nJobCount )
+{
+	int nWorkerCount = CommandLine()->ParmValue( "-workers", (int)std::thread::hardware_concurrency() );
+	return clamp( nWorkerCount, 1, MAX( nJobCount, 1 ) );
+}
+
+static void GetTempDirectory( char *pDir, int nMaxLen )
+{
+	const char *pEnvNames[] = { "TMPDIR", "TEMP", "TMP" };
+	for ( int i = 0; i < ARRAYSIZE( pEnvNames ); ++i )
+	{
+		const char *pEnv = getenv( pEnvNames[ i ] );
+		if ( pEnv && *pEnv )
+		{
+			V_strncpy( pDir, pEnv, nMaxLen );
+			return;
+		}
+	}
+#ifdef _WIN32
+	V_strncpy( pDir, ".", nMaxLen );
+#else
+	V_strncpy( pDir, "/tmp", nMaxLen );
+#endif
+}
+
+static int GetProcessId()
+{
+#ifdef _WIN32
+	return _getpid();
+#else
+	return getpid();
+#endif
+}
+
+static bool StartWorker( const CUtlVector< const char * > &args, ProcessHandle_t &hProcess )
+{
+#ifdef _WIN32
+	// _spawnv joins the arguments with spaces, so anything with spaces in it (temp paths) needs quoting
+	CUtlVector< CUtlString > quoted;
+	CUtlVector< const char * > argv;
+	for ( int i = 0; i < args.Count(); ++i )
+	{
+		quoted[ quoted.AddToTail() ].Format( "\"%s\"", args[ i ] );
+	}
+	for ( int i = 0; i < quoted.Count(); ++i )
+	{
+		argv.AddToTail( quoted[ i ].Get() );
+	}
+	argv.AddToTail( NULL );
+
+	hProcess = _spawnv( _P_NOWAIT, args[ 0 ], argv.Base() );
+	return hProcess != -1;
+#else
+	CUtlVector< char * > argv;
+	for ( int i = 0; i < args.Count(); ++i )
+	{
+		argv.AddToTail( const_cast< char * >( args[ i ] ) );
+	}
+	argv.AddToTail( NULL );
+
+	return posix_spawn( &hProcess, args[ 0 ], NULL, NULL, argv.Base(), environ ) == 0;
+#endif
+}
+
+static void WaitForWorker( ProcessHandle_t hProcess )
+{
+#ifdef _WIN32
+	int nExitCode;
+	_cwait( &nExitCode, hProcess, _WAIT_CHILD );
+#else
+	int nStatus;
+	waitpid( hProcess, &nStatus, 0 );
+#endif
+}
+
+static const CUtlVector< BatchJob_t > *s_pSortJobs;
+
+static int __cdecl JobSizeSortFunc( const int *pLeft, const int *pRight )
+{
+	int64 nLeftSize = (*s_pSortJobs)[ *pLeft ].m_nSize;
+	int64 nRightSize = (*s_pSortJobs)[ *pRight ].m_nSize;
+	if ( nLeftSize != nRightSize )
+		return ( nLeftSize > nRightSize ) ? -1 : 1;
+	return *pLeft - *pRight;
+}
+
+// Reads back a worker's done file. Both arrays are indexed by the worker's list line.
+static void ReadDoneFile( const char *pFileName, CUtlVector< bool > &jobStarted, CUtlVector< bool > &jobDone )
+{
+	FILE *fp = fopen( pFileName, "rt" );
+	if ( !fp )
+		return;
+
+	char pWhat[ 16 ];
+	int nIndex;
+	while ( fscanf( fp, "%15s %d", pWhat, &nIndex ) == 2 )
+	{
+		if ( nIndex < 0 || nIndex >= jobStarted.Count() )
+			continue;
+
+		jobStarted[ nIndex ] = true;
+		if ( !V_strcmp( pWhat, "done" ) )
+		{
+			jobDone[ nIndex ] = true;
+		}
+	}
+	fclose( fp );
+}
+
+// Runs the pending jobs (biggest first) on up to nWorkerCount workers and waits for them.
+// Jobs left behind by a worker that died are added to unreached. Returns how many workers started.
+static int RunWorkerRound( CUtlVector< BatchJob_t > &jobs, const CUtlVector< int > &pending, int nWorkerCount,
+	const CUtlVector< CUtlString > &args, const char *pExePath, CUtlVector< int > &unreached )
+{
+	// Each job to the worker with the least work so far
+	nWorkerCount = MIN( nWorkerCount, pending.Count() );
+	CUtlVector< CUtlVector< int > > workerJobs;
+	CUtlVector< int64 > workerSize;
+	workerJobs.SetCount( nWorkerCount );
+	workerSize.SetCount( nWorkerCount );
+	for ( int i = 0; i < nWorkerCount; ++i )
+	{
+		workerSize[ i ] = 0;
+	}
+	for ( int i = 0; i < pending.Count(); ++i )
+	{
+		int nWorker = 0;
+		for ( int j = 1; j < nWorkerCount; ++j )
+		{
+			if ( workerSize[ j ] < workerSize[ nWorker ] )
+			{
+				nWorker = j;
+			}
+		}
+		workerJobs[ nWorker ].AddToTail( pending[ i ] );
+		workerSize[ nWorker ] += MAX( jobs[ pending[ i ] ].m_nSize, 1 );
+	}
+
+	char pTempDir[ MAX_PATH ];
+	GetTempDirectory( pTempDir, sizeof( pTempDir ) );
+
+	CUtlVector< CUtlString > listFileNames;
+	CUtlVector< CUtlString > doneFileNames;
+	CUtlVector< ProcessHandle_t > processes;
+	CUtlVector< bool > started;
+	listFileNames.SetCount( nWorkerCount );
+	doneFileNames.SetCount( nWorkerCount );
+	processes.SetCount( nWorkerCount );
+	started.SetCount( nWorkerCount );
+
+	int nStarted = 0;
+	for ( int i = 0; i < nWorkerCount; ++i )
+	{
+		char pFileName[ MAX_PATH ];
+		char pPath[ MAX_PATH ];
+		V_snprintf( pFileName, sizeof( pFileName ), "batch_%d_%d.txt", GetProcessId(), i );
+		V_ComposeFileName( pTempDir, pFileName, pPath, sizeof( pPath ) );
+		listFileNames[ i ] = pPath;
+		V_snprintf( pFileName, sizeof( pFileName ), "batch_%d_%d_done.txt", GetProcessId(), i );
+		V_ComposeFileName( pTempDir, pFileName, pPath, sizeof( pPath ) );
+		doneFileNames[ i ] = pPath;
+		started[ i ] = false;
+
+		FILE *fp = fopen( listFileNames[ i ].Get(), "wt" );
+		if ( !fp )
+		{
+			Warning( "Unable to write worker list file \"%s\"!\n", listFileNames[ i ].Get() );
+			continue;
+		}
+		for ( int j = 0; j < workerJobs[ i ].Count(); ++j )
+		{
+			fprintf( fp, "%s\n", jobs[ workerJobs[ i ][ j ] ].m_Line.Get() );
+		}
+		fclose( fp );
+
+		CUtlVector< const char * > workerArgs;
+		workerArgs.AddToTail( pExePath );
+		workerArgs.AddToTail( "-donefile" );
+		workerArgs.AddToTail( doneFileNames[ i ].Get() );
+		for ( int j = 0; j < args.Count(); ++j )
+		{
+			workerArgs.AddToTail( args[ j ].Get() );
+		}
+		workerArgs.AddToTail( listFileNames[ i ].Get() );
+
+		started[ i ] = StartWorker( workerArgs, processes[ i ] );
+		if ( started[ i ] )
+		{
+			++nStarted;
+		}
+		else
+		{
+			Warning( "Unable to start worker %d!\n", i );
+		}
+	}
+
+	for ( int i = 0; i < nWorkerCount; ++i )
+	{
+		if ( started[ i ] )
+		{
+			WaitForWorker( processes[ i ] );
+
+			CUtlVector< bool > jobStarted;
+			CUtlVector< bool > jobDone;
+			jobStarted.SetCount( workerJobs[ i ].Count() );
+			jobDone.SetCount( workerJobs[ i ].Count() );
+			for ( int j = 0; j < workerJobs[ i ].Count(); ++j )
+			{
+				jobStarted[ j ] = jobDone[ j ] = false;
+			}
+			ReadDoneFile( doneFileNames[ i ].Get(), jobStarted, jobDone );
+
+			// Workers go through their list in order, so a worker that exits part way
+			// (a fatal error in one job) died on the last job it started. That job fails,
+			// the ones after it go to a new worker. One that never started a job isn't
+			// retried, or a worker that can't start at all would be restarted forever.
+			int nLastStarted = -1;
+			for ( int j = 0; j < workerJobs[ i ].Count(); ++j )
+			{
+				BatchJob_t &job = jobs[ workerJobs[ i ][ j ] ];
+				job.m_bDone = jobDone[ j ];
+				if ( jobStarted[ j ] )
+				{
+					nLastStarted = j;
+				}
+			}
+			if ( nLastStarted >= 0 && nLastStarted + 1 < workerJobs[ i ].Count() )
+			{
+				Warning( "Worker %d exited on \"%s\", restarting it on the %d jobs after it\n", i,
+					jobs[ workerJobs[ i ][ nLastStarted ] ].m_Line.Get(), workerJobs[ i ].Count() - nLastStarted - 1 );
+				for ( int j = nLastStarted + 1; j < workerJobs[ i ].Count(); ++j )
+				{
+					unreached.AddToTail( workerJobs[ i ][ j ] );
+				}
+			}
+		}
+		remove( listFileNames[ i ].Get() );
+		remove( doneFileNames[ i ].Get() );
+	}
+
+	return nStarted;
+}
+
+bool Batch_RunWorkers( CUtlVector< BatchJob_t > &jobs, int nWorkerCount, const CUtlVector< CUtlString > &args )
+{
+	char pExePath[ MAX_PATH ];
+	if ( !Plat_GetExecutablePath( pExePath, sizeof( pExePath ) ) )
+	{
+		Warning( "Unable to find the executable's own path to start workers\n" );
+		return false;
+	}
+
+	// Biggest jobs first, and a round's leftovers stay in that order
+	CUtlVector< int > pending;
+	for ( int i = 0; i < jobs.Count(); ++i )
+	{
+		pending.AddToTail( i );
+	}
+	s_pSortJobs = &jobs;
+	pending.Sort( JobSizeSortFunc );
+
+	// Every round either starts a job on each worker that leaves some behind or
+	// gives up on that worker's jobs, so the pending list shrinks each time
+	bool bFirstRound = true;
+	while ( pending.Count() )
+	{
+		CUtlVector< int > unreached;
+		if ( !RunWorkerRound( jobs, pending, nWorkerCount, args, pExePath, unreached ) )
+			return !bFirstRound;
+
+		bFirstRound = false;
+		pending.Swap( unreached );
+	}
+
+	return true;
+}
+
+
+CBatchDoneFile::CBatchDoneFile()
+{
+	const char *pDoneFileName = CommandLine()->ParmValue( "-donefile" );
+	m_fp = pDoneFileName ? fopen( pDoneFileName, "wt" ) : NULL;
+}
+
+CBatchDoneFile::~CBatchDoneFile()
+{
+	if ( m_fp )
+	{
+		fclose( m_fp );
+	}
+}
+
+void CBatchDoneFile::MarkStarted( int nIndex )
+{
+	if ( m_fp )
+	{
+		fprintf( m_fp, "start %d\n", nIndex );
+		fflush( m_fp );
+	}
+}
+
+void CBatchDoneFile::MarkDone( int nIndex )
+{
+	if ( m_fp )
+	{
+		fprintf( m_fp, "done %d\n", nIndex );
+		fflush( m_fp );
+	}
+}
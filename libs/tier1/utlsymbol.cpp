@@ -14,8 +14,6 @@
 // memdbgon must be the last include file in a .cpp file!!!
 // DISABLED #include "tier0/memdbgon.h"
 
-#define INVALID_STRING_INDEX CStringPoolIndex( 0xFFFF, 0xFFFF )
-
 #define MIN_STRING_POOL_SIZE	2048
 
 //-----------------------------------------------------------------------------
@@ -118,90 +116,11 @@ inline const char* CUtlSymbolTable::StringFromIndex( const CStringPoolIndex &ind
 	return DecoratedStringFromIndex(index)+sizeof(hashDecoration_t);
 }
 
-// The first two bytes of each string in the pool are actually the hash for that string.
-// Thus we compare hashes rather than entire strings for a significant perf benefit.
-// However since there is a high rate of hash collision we must still compare strings
-// if the hashes match.
-bool CUtlSymbolTable::CLess::operator()( const CStringPoolIndex &i1, const CStringPoolIndex &i2 ) const
+// Where a string's search starts in the hash slots. The decoration is only
+// 16 bits, so mix it before masking or big tables would only use their low end.
+static inline int HashSlotStart( unsigned short hash, int nMask )
 {
-	// Need to do pointer math because CUtlSymbolTable is used in CUtlVectors, and hence
-	// can be arbitrarily moved in memory on a realloc. Yes, this is portable. In reality,
-	// right now at least, because m_LessFunc is the first member of CUtlRBTree, and m_Lookup
-	// is the first member of CUtlSymbolTabke, this == pTable
-	CUtlSymbolTable *pTable = (CUtlSymbolTable *)( (byte *)this - offsetof(CUtlSymbolTable::CTree, m_LessFunc) ) - offsetof(CUtlSymbolTable, m_Lookup );
-
-#if 1 // using the hashes
-	const char *str1, *str2;
-	hashDecoration_t hash1, hash2;
-
-	if (i1 == INVALID_STRING_INDEX)
-	{
-		str1 = pTable->m_pUserSearchString;
-		hash1 = pTable->m_nUserSearchStringHash;
-	}
-	else
-	{
-		str1 = pTable->DecoratedStringFromIndex( i1 );
-		hashDecoration_t storedHash = *reinterpret_cast<const hashDecoration_t *>(str1);
-		str1 += sizeof(hashDecoration_t);
-		AssertMsg2( storedHash == ( !pTable->m_bInsensitive ? HashString(str1) : HashStringCaseless(str1) ),
-			"The stored hash (%d) for symbol %s is not correct.", storedHash, str1 );
-		hash1 = storedHash;
-	}
-
-	if (i2 == INVALID_STRING_INDEX)
-	{
-		str2 = pTable->m_pUserSearchString;
-		hash2 = pTable->m_nUserSearchStringHash;
-	}
-	else
-	{
-		str2 = pTable->DecoratedStringFromIndex( i2 );
-		hashDecoration_t storedHash = *reinterpret_cast<const hashDecoration_t *>(str2);
-		str2 += sizeof(hashDecoration_t);
-		AssertMsg2( storedHash == ( !pTable->m_bInsensitive ? HashString(str2) : HashStringCaseless(str2) ),
-			"The stored hash (%d) for symbol '%s' is not correct.", storedHash, str2 );
-		hash2 = storedHash;
-	}
-
-	// compare the hashes
-	if ( hash1 == hash2 )
-	{
-		if ( !str1 && str2 )
-			return 1;
-		if ( !str2 && str1 )
-			return -1;
-		if ( !str1 && !str2 )
-			return 0;
-		
-		// if the hashes match compare the strings
-		if ( !pTable->m_bInsensitive )
-			return strcmp( str1, str2 ) < 0;
-		else
-			return V_stricmp( str1, str2 ) < 0;
-	}
-	else
-	{
-		return hash1 < hash2;
-	}
-
-#else // not using the hashes, just comparing strings
-	const char* str1 = (i1 == INVALID_STRING_INDEX) ? pTable->m_pUserSearchString :
-		pTable->StringFromIndex( i1 );
-	const char* str2 = (i2 == INVALID_STRING_INDEX) ? pTable->m_pUserSearchString :
-		pTable->StringFromIndex( i2 );
-
-	if ( !str1 && str2 )
-		return 1;
-	if ( !str2 && str1 )
-		return -1;
-	if ( !str1 && !str2 )
-		return 0;
-	if ( !pTable->m_bInsensitive )
-		return strcmp( str1, str2 ) < 0;
-	else
-		return strcmpi( str1, str2 ) < 0;
-#endif
+	return HashIntAlternate( hash ) & nMask;
 }
 
 
@@ -209,7 +128,7 @@ bool CUtlSymbolTable::CLess::operator()( const CStringPoolIndex &i1, const CStri
 // constructor, destructor
 //-----------------------------------------------------------------------------
 CUtlSymbolTable::CUtlSymbolTable( int growSize, int initSize, bool caseInsensitive ) : 
-	m_Lookup( growSize, initSize ), m_bInsensitive( caseInsensitive ), m_StringPools( 8 )
+	m_Strings( growSize, initSize ), m_bInsensitive( caseInsensitive ), m_StringPools( 8 )
 {
 }
 
@@ -222,23 +141,55 @@ CUtlSymbolTable::~CUtlSymbolTable()
 
 CUtlSymbol CUtlSymbolTable::Find( const char* pString ) const
 {	
-	if (!pString)
+	if (!pString || m_HashSlots.Count() == 0)
 		return CUtlSymbol();
 	
-	// Store a special context used to help with insertion
-	m_pUserSearchString = pString;
-	m_nUserSearchStringHash = m_bInsensitive ? HashStringCaseless(pString) : HashString(pString) ;
-	
-	// Passing this special invalid symbol makes the comparison function
-	// use the string passed in the context
-	UtlSymId_t idx = m_Lookup.Find( INVALID_STRING_INDEX );
+	hashDecoration_t hash = m_bInsensitive ? HashStringCaseless(pString) : HashString(pString);
 
-#ifdef _DEBUG
-	m_pUserSearchString = NULL;
-	m_nUserSearchStringHash = 0;
-#endif
+	int nMask = m_HashSlots.Count() - 1;
+	for ( int i = HashSlotStart( hash, nMask ); ; i = ( i + 1 ) & nMask )
+	{
+		unsigned int slot = m_HashSlots[i];
+		if ( slot == 0 )
+			return CUtlSymbol();
+
+		// compare the hashes first, the strings only if they match
+		if ( ( slot >> 16 ) != hash )
+			continue;
+
+		UtlSymId_t id = (UtlSymId_t)( ( slot & 0xFFFF ) - 1 );
+		const char *pSymbolString = StringFromIndex( m_Strings[id] );
+		if ( ( !m_bInsensitive ? strcmp( pSymbolString, pString ) : V_stricmp( pSymbolString, pString ) ) == 0 )
+			return CUtlSymbol( id );
+	}
+}
 
-	return CUtlSymbol( idx );
+
+//-----------------------------------------------------------------------------
+// Hash slot maintenance
+//-----------------------------------------------------------------------------
+void CUtlSymbolTable::InsertHashSlot( hashDecoration_t hash, UtlSymId_t id )
+{
+	int nMask = m_HashSlots.Count() - 1;
+	int i = HashSlotStart( hash, nMask );
+	while ( m_HashSlots[i] != 0 )
+	{
+		i = ( i + 1 ) & nMask;
+	}
+	m_HashSlots[i] = ( (unsigned int)hash << 16 ) | ( (unsigned int)id + 1 );
+}
+
+void CUtlSymbolTable::GrowHashSlots()
+{
+	int nSlots = MAX( m_HashSlots.Count() * 2, 32 );
+	m_HashSlots.SetCount( nSlots );
+	memset( m_HashSlots.Base(), 0, nSlots * sizeof( unsigned int ) );
+
+	for ( int id = 0; id < m_Strings.Count(); ++id )
+	{
+		hashDecoration_t hash = *reinterpret_cast<const hashDecoration_t *>( DecoratedStringFromIndex( m_Strings[id] ) );
+		InsertHashSlot( hash, (UtlSymId_t)id );
+	}
 }
 
 
@@ -313,7 +264,18 @@ CUtlSymbol CUtlSymbolTable::AddString( const char* pString )
 	index.m_iOffset = iStringOffset;
 
 	MEM_ALLOC_CREDIT();
-	UtlSymId_t idx = m_Lookup.Insert( index );
+	// symbol + 1 has to fit in the low 16 bits of a hash slot
+	Assert( m_Strings.Count() < UTL_INVAL_SYMBOL );
+	UtlSymId_t idx = (UtlSymId_t)m_Strings.AddToTail( index );
+
+	if ( m_Strings.Count() * 2 > m_HashSlots.Count() )
+	{
+		GrowHashSlots();
+	}
+	else
+	{
+		InsertHashSlot( hash, idx );
+	}
 	return CUtlSymbol( idx );
 }
 
@@ -327,8 +289,8 @@ const char* CUtlSymbolTable::String( CUtlSymbol id ) const
 	if (!id.IsValid()) 
 		return "";
 	
-	Assert( m_Lookup.IsValidIndex((UtlSymId_t)id) );
-	return StringFromIndex( m_Lookup[id] );
+	Assert( m_Strings.IsValidIndex((UtlSymId_t)id) );
+	return StringFromIndex( m_Strings[id] );
 }
 
 
@@ -338,7 +300,8 @@ const char* CUtlSymbolTable::String( CUtlSymbol id ) const
 
 void CUtlSymbolTable::RemoveAll()
 {
-	m_Lookup.Purge();
+	m_Strings.Purge();
+	m_HashSlots.Purge();
 	
 	for ( int i=0; i < m_StringPools.Count(); i++ )
 		free( m_StringPools[i] );
@@ -15,6 +15,8 @@
 #include "cmdlib.h"
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <io.h>
+#include <mutex>
 #include "tier1/strtools.h"
 #ifdef _WIN32
 #include <conio.h>
@@ -22,6 +24,7 @@
 #include "tier1/utlvector.h"
 #include "filesystem_helpers.h"
 #include "tier1/utllinkedlist.h"
+#include "tier1/UtlStringMap.h"
 #include "tier0/icommandline.h"
 #include "tier1/keyvalues.h"
 #include "filesystem_tools.h"
@@ -99,33 +102,8 @@ void CmdLib_FPrintf( FileHandle_t hFile, const char *pFormat, ... )
 
 char* CmdLib_FGets( char *pOut, int outSize, FileHandle_t hFile )
 {
-	int iCur=0;
-	for ( ; iCur < (outSize-1); iCur++ )
-	{
-		char c;
-		if ( !g_pFileSystem->Read( &c, 1, hFile ) )
-		{
-			if ( iCur == 0 )
-				return NULL;
-			else
-				break;
-		}
-
-		pOut[iCur] = c;
-		if ( c == '\n' )
-			break;
-
-		if ( c == EOF )
-		{
-			if ( iCur == 0 )
-				return NULL;
-			else
-				break;
-		}
-	}
-
-	pOut[iCur] = 0;
-	return pOut;
+	// The filesystem buffers line reads per handle, so this doesn't go to it a byte at a time
+	return g_pFullFileSystem->ReadLine( pOut, outSize, hFile );
 }
 
 #if !defined( _X360 )
@@ -151,6 +129,7 @@ static unsigned short g_InitialColor = 0xFFFF;
 static unsigned short g_LastColor = 0xFFFF;
 static unsigned short g_BadColor = 0xFFFF;
 static WORD g_BackgroundFlags = 0xFFFF;
+static bool g_bStdoutIsConsole = true;
 static void GetInitialColors( )
 {
 #if !defined( _X360 )
@@ -209,7 +188,10 @@ WORD SetConsoleTextColor( int red, int green, int blue, int intensity )
 		g_LastColor = g_InitialColor;
 	}
 
-	SetConsoleTextAttribute( GetStdHandle( STD_OUTPUT_HANDLE ), g_LastColor | g_BackgroundFlags );
+	if ( g_bStdoutIsConsole )
+	{
+		SetConsoleTextAttribute( GetStdHandle( STD_OUTPUT_HANDLE ), g_LastColor | g_BackgroundFlags );
+	}
 #endif
 	return ret;
 }
@@ -217,11 +199,76 @@ WORD SetConsoleTextColor( int red, int green, int blue, int intensity )
 void RestoreConsoleTextColor( WORD color )
 {
 #if !defined( _X360 )
-	SetConsoleTextAttribute( GetStdHandle( STD_OUTPUT_HANDLE ), color | g_BackgroundFlags );
+	if ( g_bStdoutIsConsole )
+	{
+		SetConsoleTextAttribute( GetStdHandle( STD_OUTPUT_HANDLE ), color | g_BackgroundFlags );
+	}
 	g_LastColor = color;
 #endif
 }
 
+bool CmdLib_IsStdoutConsole()
+{
+	return g_bStdoutIsConsole;
+}
+
+
+//-----------------------------------------------------------------------------
+// Repeated warning collapsing. Tools tend to emit the same warning over and
+// over (once per vertex, bone, frame...), so only the first copy is printed.
+//-----------------------------------------------------------------------------
+
+// Past this many distinct warnings we stop remembering new ones and just print them
+#define MAX_TRACKED_WARNINGS 4096
+
+static std::mutex g_RepeatedWarningsMutex;
+static CUtlStringMap< int > g_RepeatedWarnings( false );
+static int g_nRepeatedWarnings = 0;
+
+bool CmdLib_IsRepeatedWarning( const char *pMessage )
+{
+	std::lock_guard< std::mutex > lock( g_RepeatedWarningsMutex );
+
+	UtlSymId_t id = g_RepeatedWarnings.Find( pMessage );
+	if ( id != UTL_INVAL_SYMBOL )
+	{
+		++g_RepeatedWarnings[ id ];
+		++g_nRepeatedWarnings;
+		return true;
+	}
+
+	if ( g_RepeatedWarnings.GetNumStrings() < MAX_TRACKED_WARNINGS )
+	{
+		g_RepeatedWarnings[ pMessage ] = 0;
+	}
+	return false;
+}
+
+void CmdLib_PrintRepeatedWarningSummary()
+{
+	std::lock_guard< std::mutex > lock( g_RepeatedWarningsMutex );
+
+	if ( g_nRepeatedWarnings == 0 )
+		return;
+
+	WORD oldColor = SetConsoleTextColor( 1, 1, 0, 1 );
+	printf( "\n%d repeated warnings were not shown:\n", g_nRepeatedWarnings );
+	for ( int i = 0; i < g_RepeatedWarnings.GetNumStrings(); ++i )
+	{
+		int nRepeats = g_RepeatedWarnings[ (UtlSymId_t)i ];
+		if ( nRepeats == 0 )
+			continue;
+
+		const char *pMessage = g_RepeatedWarnings.String( i );
+		int nLen = V_strlen( pMessage );
+		printf( "  %6dx %s%s", nRepeats, pMessage, ( nLen > 0 && pMessage[ nLen - 1 ] == '\n' ) ? "" : "\n" );
+	}
+	RestoreConsoleTextColor( oldColor );
+
+	g_RepeatedWarnings.Clear();
+	g_nRepeatedWarnings = 0;
+}
+
 
 #if defined( CMDLIB_NODBGLIB )
 
@@ -247,6 +294,12 @@ void CCmdLibStandardLoggingListener::Log( const LoggingContext_t *pContext, cons
 		return;
 	}
 
+	// Only the first copy of a warning is echoed; CmdLib_Cleanup summarizes the rest
+	if ( pContext->m_Severity == LS_WARNING && CmdLib_IsRepeatedWarning( pMessage ) )
+	{
+		return;
+	}
+
 	WORD oldColor;
 	Color spewColor = pContext->m_Color;
 	if ( spewColor == UNSPECIFIED_LOGGING_COLOR )
@@ -299,18 +352,32 @@ void CCmdLibStandardLoggingListener::Log( const LoggingContext_t *pContext, cons
 
 	if ( !g_bSuppressPrintfOutput || pContext->m_Severity == LS_ERROR )
 	{
-		printf( "%s", pMessage );
+		fputs( pMessage, stdout );
 	}
 
-	OutputDebugString( pMessage );
+	// Nobody is listening for debug strings without a debugger, and each one is a kernel call
+	bool bDebugging = Plat_IsInDebugSession();
+	if ( bDebugging )
+	{
+		OutputDebugString( pMessage );
+	}
 
 	if ( pContext->m_Severity == LS_ERROR )
 	{
 		if ( !g_bSuppressPrintfOutput )
 		{
-			printf( "\n" );
+			fputs( "\n", stdout );
 		}
-		OutputDebugString( "\n" );
+		if ( bDebugging )
+		{
+			OutputDebugString( "\n" );
+		}
+	}
+
+	// stdout is fully buffered when it isn't a console; get errors out before anything can go wrong
+	if ( pContext->m_Severity == LS_ERROR || pContext->m_Severity == LS_ASSERT )
+	{
+		fflush( stdout );
 	}
 
 	RestoreConsoleTextColor( oldColor );
@@ -323,7 +390,10 @@ void CCmdLibFileLoggingListener::Log( const LoggingContext_t *pContext, const tc
 	if( m_pLogFile != FILESYSTEM_INVALID_HANDLE && ( pContext->m_Flags & LCF_CONSOLE_ONLY ) == 0 )
 	{
 		CmdLib_FPrintf( m_pLogFile, "%s", pMessage );
-		g_pFileSystem->Flush( m_pLogFile );
+		if ( pContext->m_Severity != LS_MESSAGE )
+		{
+			g_pFileSystem->Flush( m_pLogFile );
+		}
 	}
 }
 
@@ -361,7 +431,11 @@ void InstallSpewFunction()
 	if ( !g_bInstalledSpewFunction )
 	{
 		g_bInstalledSpewFunction = true;
-		setvbuf( stdout, NULL, _IONBF, 0 );
+
+		// Keep an interactive console responsive, but write piped/redirected output in large blocks
+		// (exit() flushes it). Colors only mean something on a console.
+		g_bStdoutIsConsole = _isatty( _fileno( stdout ) ) != 0;
+		setvbuf( stdout, NULL, g_bStdoutIsConsole ? _IONBF : _IOFBF, g_bStdoutIsConsole ? 0 : 64 * 1024 );
 		setvbuf( stderr, NULL, _IONBF, 0 );
 
 		LoggingSystem_PushLoggingState();
@@ -400,6 +474,8 @@ void CmdLib_Cleanup()
 {
 	if ( g_bInstalledSpewFunction )
 	{
+		CmdLib_PrintRepeatedWarningSummary();
+		fflush( stdout );
 		LoggingSystem_PopLoggingState();
 	}
 
@@ -10,6 +10,9 @@
 #include <sys/stat.h>
 #include <math.h>
 #include <float.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
 
 #include "common/cmdlib.h"
 #include "common/scriplib.h"
@@ -20,6 +23,8 @@
 #include "tier1/strtools.h"
 #include "mathlib/vmatrix.h"
 #include "studiomdl/optimize.h"
+#include "studiomdl/hardwarevertexcache.h"
+#include "meshutils/simplify.h"
 
 // debugging only - enabling turns off remapping to create all lod vertexes as unique
 // to ensure remapping logic does not introduce collapse anomalies
@@ -36,6 +41,8 @@ struct VertexInfo_t;
 
 static void BuildBoneLODMapping(CUtlVector<int> &boneMap, int lodID);
 
+void CalcModelTangentSpaces(s_source_t *pSrc);
+
 
 //-----------------------------------------------------------------------------
 // Globals
@@ -1110,9 +1117,9 @@ static void SetProcessedWithDictionary(s_model_t *pSrcModel, CVertexDictionary &
 
     int nVertexCount = vertexDict.VertexCount();
 
-    pLodData->vertex = (s_lodvertexinfo_t *) calloc(nVertexCount, sizeof(s_lodvertexinfo_t));
+    pLodData->vertex = (s_lodvertexinfo_t *) MdlCalloc(nVertexCount, sizeof(s_lodvertexinfo_t));
     pLodData->numvertices = nVertexCount;
-    pLodData->face = (s_face_t *) calloc(faces.Count(), sizeof(s_face_t));
+    pLodData->face = (s_face_t *) MdlCalloc(faces.Count(), sizeof(s_face_t));
     pLodData->numfaces = faces.Count();
 
     for (i = 0; i < nVertexCount; ++i) {
@@ -1384,6 +1391,313 @@ void MarkParentBoneLODs() {
 }
 
 
+//-----------------------------------------------------------------------------
+// $autolod: reduced sources generated from the root source
+//-----------------------------------------------------------------------------
+#define AUTOLOD_SEAM_WEIGHT            10.0f    // error scale for vertices on uv seams, hard edges and material boundaries
+#define AUTOLOD_OPEN_EDGE_PENALTY      10.0f    // error scale for open edges (mesh borders and the far side of seams)
+#define AUTOLOD_MIN_MESH_TRIANGLES     8        // smaller meshes are copied as-is
+#define AUTOLOD_VERTEX_CACHE_SIZE      18       // 24 entry post-transform cache less the optimizer's CACHE_INEFFICIENCY
+#define AUTOLOD_PARTITION_COUNT        8        // clusters large meshes are split into; fixed so the output doesn't depend on the machine
+
+struct AutoLOD_t {
+    const s_source_t *m_pRoot;
+    s_source_t *m_pSource;
+    float m_flRatio;
+};
+
+static CUtlVector<AutoLOD_t> s_AutoLODs;
+
+static bool IsQuadFace(const s_face_t &face) {
+    // faces built by BuildIndividualMeshes leave d zeroed for triangles
+    return face.d != 0 && face.d != 0xFFFFFFFF;
+}
+
+
+//-----------------------------------------------------------------------------
+// Vertices sharing a position with another vertex sit on a uv seam, a hard
+// edge or a material boundary; collapsing them would tear the surface open
+//-----------------------------------------------------------------------------
+static void ComputeAutoLODVertexWeights(CUtlVector<float> &weights, const s_source_t *pRoot) {
+    int nVertexCount = pRoot->numvertices;
+    weights.SetCount(nVertexCount);
+    weights.FillWithValue(1.0f);
+
+    CUtlVector<int> sorted;
+    sorted.SetCount(nVertexCount);
+    for (int i = 0; i < nVertexCount; i++) {
+        sorted[i] = i;
+    }
+
+    const s_vertexinfo_t *pVertex = pRoot->vertex;
+    std::sort(sorted.Base(), sorted.Base() + nVertexCount, [pVertex](int a, int b) {
+        const Vector &va = pVertex[a].position;
+        const Vector &vb = pVertex[b].position;
+        if (va.x != vb.x)
+            return va.x < vb.x;
+        if (va.y != vb.y)
+            return va.y < vb.y;
+        return va.z < vb.z;
+    });
+
+    for (int i = 1; i < nVertexCount; i++) {
+        if (pVertex[sorted[i]].position == pVertex[sorted[i - 1]].position) {
+            weights[sorted[i]] = AUTOLOD_SEAM_WEIGHT;
+            weights[sorted[i - 1]] = AUTOLOD_SEAM_WEIGHT;
+        }
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+// Average cache misses per triangle, in source face order
+//-----------------------------------------------------------------------------
+static float ComputeACMR(const s_source_t *pSource) {
+    CHardwareVertexCache cache;
+    cache.Init(AUTOLOD_VERTEX_CACHE_SIZE);
+
+    int nMisses = 0;
+    int nTriangles = 0;
+    for (int i = 0; i < pSource->nummeshes; i++) {
+        const s_mesh_t &mesh = pSource->mesh[pSource->meshindex[i]];
+        cache.Flush();
+        for (int j = 0; j < mesh.numfaces; j++) {
+            const s_face_t &face = pSource->face[mesh.faceoffset + j];
+            uint32_t nIndices[4] = {face.a, face.b, face.c, face.d};
+            int nCorners = IsQuadFace(face) ? 4 : 3;
+            for (int k = 0; k < nCorners; k++) {
+                if (!cache.IsPresent(nIndices[k])) {
+                    cache.Insert(nIndices[k]);
+                    ++nMisses;
+                }
+            }
+            nTriangles += nCorners - 2;
+        }
+    }
+    return nTriangles ? (float) nMisses / nTriangles : 0.0f;
+}
+
+
+//-----------------------------------------------------------------------------
+// Simplifies each material mesh of the root on its own, so material boundaries
+// stay where they are. Bone weights and the extra texcoords come from the root
+// vertex each lod vertex was collapsed into; position, normal and the base
+// texcoord are interpolated by the simplifier.
+//-----------------------------------------------------------------------------
+static void BuildAutoLODSource(s_source_t *pSource, const s_source_t *pRoot, float flRatio) {
+    CUtlVector<float> weights;
+    ComputeAutoLODVertexWeights(weights, pRoot);
+
+    CMeshVertexAttribute attributes[3];
+    attributes[0].m_nOffsetFloats = 0;
+    attributes[0].m_nType = VERTEX_ELEMENT_POSITION;
+    attributes[1].m_nOffsetFloats = 3;
+    attributes[1].m_nType = VERTEX_ELEMENT_NORMAL;
+    attributes[2].m_nOffsetFloats = 6;
+    attributes[2].m_nType = VERTEX_ELEMENT_TEXCOORD2D_0;
+    const int nStrideFloats = 8;
+
+    CUtlVector<s_vertexinfo_t> vertices;
+    CUtlVector<s_face_t> faces;
+    for (int i = 0; i < pRoot->nummeshes; i++) {
+        int m = pRoot->meshindex[i];
+        const s_mesh_t &rootMesh = pRoot->mesh[m];
+        const s_vertexinfo_t *pRootVerts = &pRoot->vertex[rootMesh.vertexoffset];
+        const s_face_t *pRootFaces = &pRoot->face[rootMesh.faceoffset];
+
+        s_mesh_t &mesh = pSource->mesh[m];
+        mesh.vertexoffset = vertices.Count();
+        mesh.faceoffset = faces.Count();
+
+        bool bHasQuads = false;
+        CUtlVector<uint32> indices;
+        indices.EnsureCapacity(rootMesh.numfaces * 3);
+        for (int j = 0; j < rootMesh.numfaces; j++) {
+            const s_face_t &face = pRootFaces[j];
+            if (IsQuadFace(face)) {
+                bHasQuads = true;
+                break;
+            }
+            // the simplifier doesn't tolerate degenerate triangles
+            if (face.a == face.b || face.a == face.c || face.b == face.c)
+                continue;
+            indices.AddToTail(face.a);
+            indices.AddToTail(face.b);
+            indices.AddToTail(face.c);
+        }
+
+        CMesh meshOut;
+        CUtlVector<int> sourceVertex;
+        int nTargetTriangles = (int) (indices.Count() / 3 * flRatio + 0.5f);
+        if (!bHasQuads && indices.Count() / 3 >= AUTOLOD_MIN_MESH_TRIANGLES) {
+            CMesh meshIn;
+            meshIn.AllocateMesh(rootMesh.numvertices, indices.Count(), nStrideFloats, attributes, ARRAYSIZE(attributes));
+            for (int j = 0; j < rootMesh.numvertices; j++) {
+                float *pVert = meshIn.GetVertex(j);
+                const s_vertexinfo_t &v = pRootVerts[j];
+                pVert[0] = v.position.x;
+                pVert[1] = v.position.y;
+                pVert[2] = v.position.z;
+                pVert[3] = v.normal.x;
+                pVert[4] = v.normal.y;
+                pVert[5] = v.normal.z;
+                pVert[6] = v.texcoord[0].x;
+                pVert[7] = v.texcoord[0].y;
+            }
+            V_memcpy(meshIn.m_pIndices, indices.Base(), indices.Count() * sizeof(uint32));
+
+            mesh_simplifyparams_t params;
+            params.SimplifyToTriangleCount(MAX(nTargetTriangles, 1));
+            params.m_flOpenEdgePenalty = AUTOLOD_OPEN_EDGE_PENALTY;
+            params.m_nPartitionCount = AUTOLOD_PARTITION_COUNT;
+
+            mesh_simplifyweights_t meshWeights;
+            meshWeights.m_pVertexWeights = &weights[rootMesh.vertexoffset];
+            meshWeights.m_nVertexCount = rootMesh.numvertices;
+
+            SimplifyMesh(meshOut, meshIn, params, &meshWeights, &sourceVertex);
+        }
+
+        if (!meshOut.m_nIndexCount) {
+            // quads, tiny meshes, and meshes the simplifier gave up on are kept whole
+            for (int j = 0; j < rootMesh.numvertices; j++) {
+                vertices.AddToTail(pRootVerts[j]);
+            }
+            faces.AddMultipleToTail(rootMesh.numfaces, pRootFaces);
+            mesh.numvertices = rootMesh.numvertices;
+            mesh.numfaces = rootMesh.numfaces;
+            continue;
+        }
+
+        for (int j = 0; j < meshOut.m_nVertexCount; j++) {
+            const float *pVert = meshOut.GetVertex(j);
+            s_vertexinfo_t &v = vertices[vertices.AddToTail(pRootVerts[sourceVertex[j]])];
+            v.position.Init(pVert[0], pVert[1], pVert[2]);
+            v.normal.Init(pVert[3], pVert[4], pVert[5]);
+            VectorNormalize(v.normal);
+            v.texcoord[0].Init(pVert[6], pVert[7]);
+        }
+        for (int j = 0; j < meshOut.m_nIndexCount; j += 3) {
+            s_face_t &face = faces[faces.AddToTail()];
+            face.a = meshOut.m_pIndices[j + 0];
+            face.b = meshOut.m_pIndices[j + 1];
+            face.c = meshOut.m_pIndices[j + 2];
+            face.d = 0;
+        }
+        mesh.numvertices = meshOut.m_nVertexCount;
+        mesh.numfaces = meshOut.m_nIndexCount / 3;
+    }
+
+    pSource->numvertices = vertices.Count();
+    pSource->vertex = (s_vertexinfo_t *) MdlCalloc(MAX(pSource->numvertices, 1), sizeof(s_vertexinfo_t));
+    V_memcpy(pSource->vertex, vertices.Base(), vertices.Count() * sizeof(s_vertexinfo_t));
+    pSource->numfaces = faces.Count();
+    pSource->face = (s_face_t *) MdlCalloc(MAX(pSource->numfaces, 1), sizeof(s_face_t));
+    V_memcpy(pSource->face, faces.Base(), faces.Count() * sizeof(s_face_t));
+
+    CalcModelTangentSpaces(pSource);
+}
+
+
+//-----------------------------------------------------------------------------
+// Registers an (empty) autolod source so bone remapping sees it like any other
+// lod source. Its geometry is filled in by BuildAutoLODSources.
+//-----------------------------------------------------------------------------
+static s_source_t *FindOrCreateAutoLODSource(s_source_t *pRoot, float flRatio) {
+    if (flRatio >= 1.0f)
+        return pRoot;
+
+    for (int i = 0; i < s_AutoLODs.Count(); i++) {
+        if (s_AutoLODs[i].m_pRoot == pRoot && s_AutoLODs[i].m_flRatio == flRatio)
+            return s_AutoLODs[i].m_pSource;
+    }
+
+    s_source_t *pSource = (s_source_t *) MdlCalloc(1, sizeof(s_source_t));
+    g_source[g_numsources++] = pSource;
+
+    char pBaseName[MAX_PATH];
+    Q_StripExtension(pRoot->filename, pBaseName, sizeof(pBaseName));
+    Q_snprintf(pSource->filename, sizeof(pSource->filename), "%s_autolod%d.%s", pBaseName,
+               (int) (flRatio * 100.0f + 0.5f), Q_GetFileExtension(pRoot->filename));
+
+    pSource->version = pRoot->version;
+    pSource->isActiveModel = pRoot->isActiveModel;
+    pSource->numbones = pRoot->numbones;
+    pSource->localBone = pRoot->localBone;
+    pSource->boneToPose = pRoot->boneToPose;
+    memcpy(pSource->boneflags, pRoot->boneflags, sizeof(pSource->boneflags));
+    memcpy(pSource->boneref, pRoot->boneref, sizeof(pSource->boneref));
+    memcpy(pSource->boneLocalToGlobal, pRoot->boneLocalToGlobal, sizeof(pSource->boneLocalToGlobal));
+    memcpy(pSource->boneGlobalToLocal, pRoot->boneGlobalToLocal, sizeof(pSource->boneGlobalToLocal));
+    memcpy(pSource->texmap, pRoot->texmap, sizeof(pSource->texmap));
+    pSource->nummeshes = pRoot->nummeshes;
+    memcpy(pSource->meshindex, pRoot->meshindex, sizeof(pSource->meshindex));
+    VectorCopy(pRoot->adjust, pSource->adjust);
+    pSource->scale = pRoot->scale;
+    pSource->rotation = pRoot->rotation;
+    pSource->bNoAutoDMXRules = pRoot->bNoAutoDMXRules;
+
+    // the reference pose is all a lod source carries
+    if (pRoot->m_Animations.Count() && pRoot->m_Animations[0].rawanim.Count()) {
+        const s_sourceanim_t &srcAnim = pRoot->m_Animations[0];
+        s_sourceanim_t *pAnim = FindOrAddSourceAnim(pSource, srcAnim.animationname);
+        pAnim->numframes = 1;
+        pAnim->startframe = 0;
+        pAnim->endframe = 0;
+        pAnim->rawanim.AddToTail(new s_bone_t[pRoot->numbones]);
+        memcpy(pAnim->rawanim[0], srcAnim.rawanim[0], pRoot->numbones * sizeof(s_bone_t));
+    }
+
+    AutoLOD_t &autoLOD = s_AutoLODs[s_AutoLODs.AddToTail()];
+    autoLOD.m_pRoot = pRoot;
+    autoLOD.m_pSource = pSource;
+    autoLOD.m_flRatio = flRatio;
+    return pSource;
+}
+
+
+//-----------------------------------------------------------------------------
+// Simplifies all registered autolod sources, one per thread
+//-----------------------------------------------------------------------------
+static void BuildAutoLODSources() {
+    int nCount = s_AutoLODs.Count();
+    if (!nCount)
+        return;
+
+    // large meshes are also simplified in parallel clusters, but how many clusters
+    // there are never depends on the thread count, so every machine builds the same lods
+    int nThreadCount = MIN((int) std::thread::hardware_concurrency(), nCount);
+
+    std::atomic<int> nNext(0);
+    auto buildThread = [&]() {
+        for (int i = nNext++; i < nCount; i = nNext++) {
+            BuildAutoLODSource(s_AutoLODs[i].m_pSource, s_AutoLODs[i].m_pRoot, s_AutoLODs[i].m_flRatio);
+        }
+    };
+
+    CUtlVector<std::thread *> threads;
+    for (int i = 1; i < nThreadCount; ++i) {
+        threads.AddToTail(new std::thread(buildThread));
+    }
+    buildThread();
+    for (int i = 0; i < threads.Count(); ++i) {
+        threads[i]->join();
+        delete threads[i];
+    }
+
+    if (g_StudioMdlContext.quiet)
+        return;
+
+    for (int i = 0; i < nCount; i++) {
+        const AutoLOD_t &autoLOD = s_AutoLODs[i];
+        printf("$autolod %s: %d -> %d triangles, %d -> %d vertices, ACMR %.3f -> %.3f\n",
+               autoLOD.m_pSource->filename, autoLOD.m_pRoot->numfaces, autoLOD.m_pSource->numfaces,
+               autoLOD.m_pRoot->numvertices, autoLOD.m_pSource->numvertices,
+               ComputeACMR(autoLOD.m_pRoot), ComputeACMR(autoLOD.m_pSource));
+    }
+}
+
+
 //-----------------------------------------------------------------------------
 // Returns the sources associated with the various LODs based on the script commands
 //-----------------------------------------------------------------------------
@@ -1397,6 +1711,9 @@ static void GetLODSources(CUtlVector<s_source_t *> &lods, const s_model_t *pSrcM
         s_source_t *pSource = GetModelLODSource(pSrcModel->filename, scriptLOD, &bFound);
         if (!pSource && !bFound) {
             pSource = pSrcModel->source;
+            if (scriptLOD.autoLODRatio > 0.0f) {
+                pSource = FindOrCreateAutoLODSource(pSource, scriptLOD.autoLODRatio);
+            }
         }
 
         lods[lodID] = pSource;
@@ -1421,6 +1738,8 @@ void LoadLODSources() {
 
         GetLODSources(g_model[modelID]->m_LodSources, g_model[modelID]);
     }
+
+    BuildAutoLODSources();
 }
 
 static void ReplaceBonesRecursive(int globalBoneID, bool replaceThis,
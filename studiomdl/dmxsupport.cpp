@@ -30,6 +30,10 @@
 // Local includes
 #include "studiomdl/studiomdl.h"
 #include "tier1/fmtstr.h"
+#include "tier1/utlhashtable.h"
+
+#include <atomic>
+#include <thread>
 
 
 extern StudioMdlContext g_StudioMdlContext;
@@ -99,50 +103,43 @@ static CUtlVector<int> s_UniqueVerticesMap;
 // Delta state intermediate data [used for positions, normals, etc.]
 //-----------------------------------------------------------------------------
 struct DeltaIndex_t {
-    DeltaIndex_t() : m_nPositionIndex(-1), m_nNormalIndex(-1), m_nNextDelta(-1), m_nWrinkleIndex(-1),
-                     m_bInList(false) {}
+    DeltaIndex_t() : m_nUniqueVertex(-1), m_nPositionIndex(-1), m_nNormalIndex(-1), m_nWrinkleIndex(-1) {}
 
+    int m_nUniqueVertex;    // Index into s_UniqueVertices
     int m_nPositionIndex;    // Index into DeltaState_t::m_PositionDeltas
     int m_nNormalIndex;        // Index into DeltaState_t::m_NormalDeltas
     int m_nWrinkleIndex;    // Index into DeltaState_t::m_WrinkleDeltas
-    int m_nNextDelta;        // Index into DeltaState_t::m_DeltaIndices;
-    bool m_bInList;
 };
 
 struct DeltaState_t {
-    DeltaState_t() : m_nDeltaCount(0), m_nFirstDelta(-1) {}
-
     CUtlString m_Name;
     CUtlVector<Vector> m_PositionDeltas;
     CUtlVector<Vector> m_NormalDeltas;
     CUtlVector<float> m_WrinkleDeltas;
+
+    // Only the unique vertices which have a delta, in the order they were first touched
     CUtlVector<DeltaIndex_t> m_DeltaIndices;
-    int m_nDeltaCount;
-    int m_nFirstDelta;
 };
 
 
 // NOTE: This is a temporary which loses its state once Load_DMX is exited.
 static CUtlVector<DeltaState_t> s_DeltaStates;
+static CUtlHashtable<CUtlString, int, CaselessStringHashFunctor, CaselessStringEqualFunctor> s_DeltaStateIndices;
 
 
-// Finds or adds delta states. These pointers are invalidated by calling FindOrAddDeltaState again
+// Finds or adds delta states, returning its index into s_DeltaStates
 //-----------------------------------------------------------------------------
-static DeltaState_t *FindOrAddDeltaState(const char *pDeltaStateName, int nBaseStateVertexCount) {
-    int nCount = s_DeltaStates.Count();
-    for (int i = 0; i < nCount; ++i) {
-        if (!Q_stricmp(s_DeltaStates[i].m_Name, pDeltaStateName)) {
-            MdlWarning("Unsupported duplicate delta state named \"%s\" in DMX file\n", pDeltaStateName);
-
-            s_DeltaStates[i].m_DeltaIndices.EnsureCount(nBaseStateVertexCount);
-            return &s_DeltaStates[i];
-        }
+static int FindOrAddDeltaState(const char *pDeltaStateName) {
+    UtlHashHandle_t h = s_DeltaStateIndices.Find(pDeltaStateName);
+    if (h != s_DeltaStateIndices.InvalidHandle()) {
+        MdlWarning("Unsupported duplicate delta state named \"%s\" in DMX file\n", pDeltaStateName);
+        return s_DeltaStateIndices[h];
     }
 
     int j = s_DeltaStates.AddToTail();
     s_DeltaStates[j].m_Name = pDeltaStateName;
-    s_DeltaStates[j].m_DeltaIndices.SetCount(nBaseStateVertexCount);
-    return &s_DeltaStates[j];
+    s_DeltaStateIndices.Insert(pDeltaStateName, j);
+    return j;
 }
 
 
@@ -405,35 +402,36 @@ LoadVertices(CDmeDag *pDmeDag, CDmeVertexData *pBindState, const matrix3x4_t &ma
 
 
 //-----------------------------------------------------------------------------
-// Hook delta into delta list
+// Delta states of a single mesh waiting to be loaded. Deltas sharing a name
+// are chained so they're loaded in order by the same thread.
 //-----------------------------------------------------------------------------
-static void AddToDeltaList(DeltaState_t *pDeltaStateData, int nUniqueVertex) {
-    DeltaIndex_t &index = pDeltaStateData->m_DeltaIndices[nUniqueVertex];
-    if (!index.m_bInList) {
-        index.m_nNextDelta = pDeltaStateData->m_nFirstDelta;
-        pDeltaStateData->m_nFirstDelta = nUniqueVertex;
-        pDeltaStateData->m_nDeltaCount++;
-        index.m_bInList = true;
-    }
-}
+struct DeltaStateLoad_t {
+    CDmeVertexDeltaData *m_pDeltaState;
+    int m_nDeltaStateIndex;
+    int m_nNextSameState;
+};
 
 
 //-----------------------------------------------------------------------------
-// Loads the vertices from the delta state
+// Hook delta into delta list. pUniqueToDelta maps the unique vertices of the
+// mesh being loaded to their entry in m_DeltaIndices, or -1
 //-----------------------------------------------------------------------------
-static bool LoadDeltaState(
-        CDmeVertexDeltaData *pDeltaState,
-        CDmeVertexData *pBindState,
-        const matrix3x4_t &mat,
-        float flScale,
-        int nStartingUniqueVertex,
-        int nStartingUniqueVertexMap) {
-    DeltaState_t *pDeltaStateData = FindOrAddDeltaState(pDeltaState->GetName(),
-                                                        nStartingUniqueVertex + pBindState->VertexCount());
+static DeltaIndex_t &AddToDeltaList(DeltaState_t *pDeltaStateData, int *pUniqueToDelta, int nStartingUniqueVertex,
+                                    int nUniqueVertex) {
+    int &nDelta = pUniqueToDelta[nUniqueVertex - nStartingUniqueVertex];
+    if (nDelta < 0) {
+        nDelta = pDeltaStateData->m_DeltaIndices.AddToTail();
+        pDeltaStateData->m_DeltaIndices[nDelta].m_nUniqueVertex = nUniqueVertex;
+    }
+    return pDeltaStateData->m_DeltaIndices[nDelta];
+}
 
-    matrix3x4_t normalMat;
-    MatrixInverseTranspose(mat, normalMat);
 
+//-----------------------------------------------------------------------------
+// Validates a delta state and makes sure everything LoadDeltaState reads
+// from the bind state is built, since delta states are loaded concurrently
+//-----------------------------------------------------------------------------
+static bool PrepareDeltaState(CDmeVertexDeltaData *pDeltaState, CDmeVertexData *pBindState) {
     const CUtlVector<Vector> &positions = pDeltaState->GetPositionData();
     const CUtlVector<int> &positionIndices = pDeltaState->GetVertexIndexData(CDmeVertexDataBase::FIELD_POSITION);
     const CUtlVector<Vector> &normals = pDeltaState->GetNormalData();
@@ -457,8 +455,45 @@ static bool LoadDeltaState(
         return false;
     }
 
+    // The bind state builds its inverse maps on first use
+    if (positionIndices.Count()) {
+        pBindState->FindVertexIndicesFromDataIndex(CDmeVertexData::FIELD_POSITION, positionIndices[0]);
+    }
+    if (normalIndices.Count()) {
+        pBindState->FindVertexIndicesFromDataIndex(CDmeVertexData::FIELD_NORMAL, normalIndices[0]);
+    }
+    if (wrinkleIndices.Count()) {
+        pBindState->FindVertexIndicesFromDataIndex(CDmeVertexData::FIELD_WRINKLE, wrinkleIndices[0]);
+    }
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Loads the vertices from the delta state
+//-----------------------------------------------------------------------------
+static void LoadDeltaState(
+        CDmeVertexDeltaData *pDeltaState,
+        DeltaState_t *pDeltaStateData,
+        CDmeVertexData *pBindState,
+        const matrix3x4_t &mat,
+        float flScale,
+        int nStartingUniqueVertex,
+        int nStartingUniqueVertexMap,
+        int *pUniqueToDelta) {
+    matrix3x4_t normalMat;
+    MatrixInverseTranspose(mat, normalMat);
+
+    const CUtlVector<Vector> &positions = pDeltaState->GetPositionData();
+    const CUtlVector<int> &positionIndices = pDeltaState->GetVertexIndexData(CDmeVertexDataBase::FIELD_POSITION);
+    const CUtlVector<Vector> &normals = pDeltaState->GetNormalData();
+    const CUtlVector<int> &normalIndices = pDeltaState->GetVertexIndexData(CDmeVertexDataBase::FIELD_NORMAL);
+    const CUtlVector<float> &wrinkle = pDeltaState->GetWrinkleData();
+    const CUtlVector<int> &wrinkleIndices = pDeltaState->GetVertexIndexData(CDmeVertexDataBase::FIELD_WRINKLE);
+
     // Copy position delta
     int nCount = positions.Count();
+    pDeltaStateData->m_PositionDeltas.EnsureCapacity(pDeltaStateData->m_PositionDeltas.Count() + nCount);
     for (int i = 0; i < nCount; ++i) {
         Vector vecDelta;
 
@@ -471,52 +506,127 @@ static bool LoadDeltaState(
         int nPositionIndex = pDeltaStateData->m_PositionDeltas.AddToTail(vecDelta);
 
         // Indices
-        const CUtlVector<int> &baseVerts = pBindState->FindVertexIndicesFromDataIndex(CDmeVertexData::FIELD_POSITION,
+        CVertexIndexSpan baseVerts = pBindState->FindVertexIndicesFromDataIndex(CDmeVertexData::FIELD_POSITION,
                                                                                       positionIndices[i]);
         int nBaseVertCount = baseVerts.Count();
         for (int k = 0; k < nBaseVertCount; ++k) {
             int nUniqueVertexIndex = s_UniqueVerticesMap[nStartingUniqueVertexMap + baseVerts[k]];
-            AddToDeltaList(pDeltaStateData, nUniqueVertexIndex);
-            DeltaIndex_t &index = pDeltaStateData->m_DeltaIndices[nUniqueVertexIndex];
+            DeltaIndex_t &index = AddToDeltaList(pDeltaStateData, pUniqueToDelta, nStartingUniqueVertex, nUniqueVertexIndex);
             index.m_nPositionIndex = nPositionIndex;
         }
     }
 
     // Copy normals
     nCount = normals.Count();
+    pDeltaStateData->m_NormalDeltas.EnsureCapacity(pDeltaStateData->m_NormalDeltas.Count() + nCount);
     for (int i = 0; i < nCount; ++i) {
         Vector vecDelta;
         VectorRotate(normals[i], normalMat, vecDelta);
         int nNormalIndex = pDeltaStateData->m_NormalDeltas.AddToTail(vecDelta);
 
         // Indices
-        const CUtlVector<int> &baseVerts = pBindState->FindVertexIndicesFromDataIndex(CDmeVertexData::FIELD_NORMAL,
+        CVertexIndexSpan baseVerts = pBindState->FindVertexIndicesFromDataIndex(CDmeVertexData::FIELD_NORMAL,
                                                                                       normalIndices[i]);
         int nBaseVertCount = baseVerts.Count();
         for (int k = 0; k < nBaseVertCount; ++k) {
             int nUniqueVertexIndex = s_UniqueVerticesMap[nStartingUniqueVertexMap + baseVerts[k]];
-            AddToDeltaList(pDeltaStateData, nUniqueVertexIndex);
-            DeltaIndex_t &index = pDeltaStateData->m_DeltaIndices[nUniqueVertexIndex];
+            DeltaIndex_t &index = AddToDeltaList(pDeltaStateData, pUniqueToDelta, nStartingUniqueVertex, nUniqueVertexIndex);
             index.m_nNormalIndex = nNormalIndex;
         }
     }
 
     // Copy wrinkle
     nCount = wrinkle.Count();
+    pDeltaStateData->m_WrinkleDeltas.EnsureCapacity(pDeltaStateData->m_WrinkleDeltas.Count() + nCount);
     for (int i = 0; i < nCount; ++i) {
         int nWrinkleIndex = pDeltaStateData->m_WrinkleDeltas.AddToTail(wrinkle[i]);
 
         // Indices
-        const CUtlVector<int> &baseVerts = pBindState->FindVertexIndicesFromDataIndex(CDmeVertexData::FIELD_WRINKLE,
+        CVertexIndexSpan baseVerts = pBindState->FindVertexIndicesFromDataIndex(CDmeVertexData::FIELD_WRINKLE,
                                                                                       wrinkleIndices[i]);
         int nBaseVertCount = baseVerts.Count();
         for (int k = 0; k < nBaseVertCount; ++k) {
             int nUniqueVertexIndex = s_UniqueVerticesMap[nStartingUniqueVertexMap + baseVerts[k]];
-            AddToDeltaList(pDeltaStateData, nUniqueVertexIndex);
-            DeltaIndex_t &index = pDeltaStateData->m_DeltaIndices[nUniqueVertexIndex];
+            DeltaIndex_t &index = AddToDeltaList(pDeltaStateData, pUniqueToDelta, nStartingUniqueVertex, nUniqueVertexIndex);
             index.m_nWrinkleIndex = nWrinkleIndex;
         }
     }
+}
+
+
+//-----------------------------------------------------------------------------
+// Loads all delta states of a mesh. Each delta state only writes to its own
+// DeltaState_t and only reads the bind state, so they're spread over threads.
+//-----------------------------------------------------------------------------
+static bool LoadDeltaStates(CDmeMesh *pMesh, CDmeVertexData *pBindState, const matrix3x4_t &mat, float flScale,
+                            int nStartingUniqueVertex, int nStartingUniqueVertexMap) {
+    int nDeltaStateCount = pMesh->DeltaStateCount();
+    if (nDeltaStateCount == 0)
+        return true;
+
+    // Everything touching shared state happens up front, in order
+    CUtlVector<DeltaStateLoad_t> loads;
+    CUtlVector<int> firstLoads;
+    CUtlVector<int> lastLoadForState;
+    loads.SetCount(nDeltaStateCount);
+    for (int i = 0; i < nDeltaStateCount; ++i) {
+        CDmeVertexDeltaData *pDeltaState = pMesh->GetDeltaState(i);
+        if (!PrepareDeltaState(pDeltaState, pBindState))
+            return false;
+
+        DeltaStateLoad_t &load = loads[i];
+        load.m_pDeltaState = pDeltaState;
+        load.m_nDeltaStateIndex = FindOrAddDeltaState(pDeltaState->GetName());
+        load.m_nNextSameState = -1;
+
+        while (lastLoadForState.Count() <= load.m_nDeltaStateIndex) {
+            lastLoadForState.AddToTail(-1);
+        }
+        int &nLastLoad = lastLoadForState[load.m_nDeltaStateIndex];
+        if (nLastLoad >= 0) {
+            loads[nLastLoad].m_nNextSameState = i;
+        } else {
+            firstLoads.AddToTail(i);
+        }
+        nLastLoad = i;
+    }
+
+    int nMeshUniqueCount = s_UniqueVertices.Count() - nStartingUniqueVertex;
+    int nLoadCount = firstLoads.Count();
+    std::atomic<int> nNextLoad(0);
+    auto loadThread = [&]() {
+        CUtlVector<int> uniqueToDelta;
+        uniqueToDelta.SetCount(nMeshUniqueCount);
+        memset(uniqueToDelta.Base(), 0xFF, nMeshUniqueCount * sizeof(int));
+
+        for (int i = nNextLoad++; i < nLoadCount; i = nNextLoad++) {
+            int nFirstLoad = firstLoads[i];
+            DeltaState_t *pDeltaStateData = &s_DeltaStates[loads[nFirstLoad].m_nDeltaStateIndex];
+            int nFirstNewDelta = pDeltaStateData->m_DeltaIndices.Count();
+
+            for (int j = nFirstLoad; j >= 0; j = loads[j].m_nNextSameState) {
+                LoadDeltaState(loads[j].m_pDeltaState, pDeltaStateData, pBindState, mat, flScale, nStartingUniqueVertex,
+                               nStartingUniqueVertexMap, uniqueToDelta.Base());
+            }
+
+            // Only reset what this delta state touched
+            int nDeltaCount = pDeltaStateData->m_DeltaIndices.Count();
+            for (int j = nFirstNewDelta; j < nDeltaCount; ++j) {
+                uniqueToDelta[pDeltaStateData->m_DeltaIndices[j].m_nUniqueVertex - nStartingUniqueVertex] = -1;
+            }
+        }
+    };
+
+    int nThreadCount = MIN((int)std::thread::hardware_concurrency(), nLoadCount);
+    CUtlVector<std::thread *> threads;
+    for (int i = 1; i < nThreadCount; ++i) {
+        threads.AddToTail(new std::thread(loadThread));
+    }
+    loadThread();
+    for (int i = 0; i < threads.Count(); ++i) {
+        threads[i]->join();
+        delete threads[i];
+    }
     return true;
 }
 
@@ -661,12 +771,8 @@ LoadMesh(CDmeDag *pDmeDag, CDmeMesh *pMesh, CDmeVertexData *pBindState, const ma
     LoadVertices(pDmeDag, pBindState, mat, flScale, nBoneAssign, pBoneRemap, pSource);
 
     // Load the deltas
-    int nDeltaStateCount = pMesh->DeltaStateCount();
-    for (int i = 0; i < nDeltaStateCount; ++i) {
-        CDmeVertexDeltaData *pDeltaState = pMesh->GetDeltaState(i);
-        if (!LoadDeltaState(pDeltaState, pBindState, mat, flScale, nStartingUniqueCount, nStartingUniqueMapCount))
-            return false;
-    }
+    if (!LoadDeltaStates(pMesh, pBindState, mat, flScale, nStartingUniqueCount, nStartingUniqueMapCount))
+        return false;
 
     // load the base triangles
     int texture;
@@ -855,14 +961,13 @@ static void BuildVertexAnimations(s_source_t *pSource) {
         pSourceAnim->endframe = 0;
         pSourceAnim->newStyleVertexAnimations = true;
 
-        // Traverse the linked list of unique vertex indices j that has a delta
+        // Visit the unique vertices j that have a delta, most recently added first
         int nVertAnimCount = 0;
-        for (int j = state.m_nFirstDelta; j >= 0; j = state.m_DeltaIndices[j].m_nNextDelta) {
-            // The Delta Indices array is a parallel array to s_UniqueVertices
-            // j is used to index into both
-            DeltaIndex_t &delta = state.m_DeltaIndices[j];
+        for (int d = state.m_DeltaIndices.Count(); --d >= 0;) {
+            DeltaIndex_t &delta = state.m_DeltaIndices[d];
             Assert(delta.m_nPositionIndex >= 0 || delta.m_nNormalIndex >= 0 || delta.m_nWrinkleIndex >= 0);
 
+            int j = delta.m_nUniqueVertex;
             VertIndices_t &uniqueVert = s_UniqueVertices[j];
 
             const v_unify_t *pList = v_list[uniqueVert.v];
@@ -893,7 +998,7 @@ static void BuildVertexAnimations(s_source_t *pSource) {
             }
         }
         pSourceAnim->numvanims[0] = nVertAnimCount;
-        pSourceAnim->vanim[0] = (s_vertanim_t *) calloc(nVertAnimCount, sizeof(s_vertanim_t));
+        pSourceAnim->vanim[0] = (s_vertanim_t *) MdlCalloc(nVertAnimCount, sizeof(s_vertanim_t));
         memcpy(pSourceAnim->vanim[0], pVertAnim, nVertAnimCount * sizeof(s_vertanim_t));
     }
     free(pVertAnim);
@@ -1134,7 +1239,7 @@ static void LoadBindPose(CDmeModel *pModel, float flScale, const BoneTransformMa
     pSourceAnim->numframes = 1;
 
     // Default all transforms to identity
-    pSourceAnim->rawanim[0] = (s_bone_t *) calloc(pSource->numbones, sizeof(s_bone_t));
+    pSourceAnim->rawanim[0] = (s_bone_t *) MdlCalloc(pSource->numbones, sizeof(s_bone_t));
     for (int i = 0; i < pSource->numbones; ++i) {
         pSourceAnim->rawanim[0][i].pos.Init();
         pSourceAnim->rawanim[0][i].rot.Init();
@@ -1235,10 +1340,86 @@ static void PrepareChannels(
 }
 
 
+//-----------------------------------------------------------------------------
+// A channel whose log was sampled for every frame of the animation up front
+//-----------------------------------------------------------------------------
+struct BakedChannel_t {
+    CDmeChannel *m_pChannel;
+    CDmAttribute *m_pToAttr;
+    DmAttributeType_t m_nType;
+    int m_nStride;
+    CUtlVector<unsigned char> m_Samples;
+};
+
+template<class T>
+static void SampleChannelLog(CDmeLog *pLog, const CUtlVector<DmeTime_t> &logTimes, BakedChannel_t &baked) {
+    baked.m_nStride = sizeof(T);
+    baked.m_Samples.SetCount(logTimes.Count() * sizeof(T));
+    CastElement<CDmeTypedLog<T> >(pLog)->GetValues(logTimes.Base(), logTimes.Count(), (T *) baked.m_Samples.Base());
+}
+
+
+//-----------------------------------------------------------------------------
+// Samples the float, vector and quaternion channels at all frame times with
+// one pass over each log, instead of searching the log again every frame.
+// Baked channels are turned off; their values are written by UpdateChannels.
+// Anything else is left to CDmeChannel::Play.
+//-----------------------------------------------------------------------------
+static void BakeChannels(CUtlVector<BakedChannel_t> &baked, CDmeChannelsClip *pAnimation,
+                         const CUtlVector<DmeTime_t> &channelTimes) {
+    CUtlVector<DmeTime_t> logTimes;
+    logTimes.SetCount(channelTimes.Count());
+
+    int nChannelsCount = pAnimation->m_Channels.Count();
+    for (int i = 0; i < nChannelsCount; ++i) {
+        CDmeChannel *pChannel = pAnimation->m_Channels[i];
+        CDmAttribute *pToAttr = pChannel->GetToAttribute();
+        CDmeLog *pLog = pChannel->GetLog();
+        if (!pToAttr || !pLog)
+            continue;
+
+        DmAttributeType_t nType = pLog->GetDataType();
+        if (pToAttr->GetType() != nType)
+            continue;
+        if (nType != AT_FLOAT && nType != AT_VECTOR3 && nType != AT_QUATERNION)
+            continue;
+
+        // CDmeChannel::Play passes the from attribute through for empty logs
+        if (pLog->IsEmpty() && !pLog->HasDefaultValue() && pChannel->GetFromAttribute())
+            continue;
+
+        // Same clamping as CDmeChannel::Play
+        DmeTime_t t0 = pLog->GetBeginTime();
+        DmeTime_t tn = pLog->GetEndTime();
+        for (int j = 0; j < channelTimes.Count(); ++j) {
+            logTimes[j] = clamp(channelTimes[j], t0, tn);
+        }
+
+        BakedChannel_t &channel = baked[baked.AddToTail()];
+        channel.m_pChannel = pChannel;
+        channel.m_pToAttr = pToAttr;
+        channel.m_nType = nType;
+        switch (nType) {
+            case AT_FLOAT:
+                SampleChannelLog<float>(pLog, logTimes, channel);
+                break;
+            case AT_VECTOR3:
+                SampleChannelLog<Vector>(pLog, logTimes, channel);
+                break;
+            default:
+                SampleChannelLog<Quaternion>(pLog, logTimes, channel);
+                break;
+        }
+        pChannel->SetMode(CM_OFF);
+    }
+}
+
+
 //-----------------------------------------------------------------------------
 // Update channels so they are in position for the next frame
 //-----------------------------------------------------------------------------
-static void UpdateChannels(CUtlVector<IDmeOperator *> &operators, CDmeChannelsClip *pAnimation, DmeTime_t clipTime) {
+static void UpdateChannels(CUtlVector<IDmeOperator *> &operators, CDmeChannelsClip *pAnimation, DmeTime_t clipTime,
+                           const CUtlVector<BakedChannel_t> &baked, int nFrame) {
     int nChannelsCount = pAnimation->m_Channels.Count();
     DmeTime_t channelTime = pAnimation->ToChildMediaTime(clipTime);
     for (int i = 0; i < nChannelsCount; ++i) {
@@ -1248,6 +1429,10 @@ static void UpdateChannels(CUtlVector<IDmeOperator *> &operators, CDmeChannelsCl
     // Recompute the position of the joints
     {
         CDisableUndoScopeGuard guard;
+        for (int i = 0; i < baked.Count(); ++i) {
+            const BakedChannel_t &channel = baked[i];
+            channel.m_pToAttr->SetValue(channel.m_nType, &channel.m_Samples[nFrame * channel.m_nStride]);
+        }
         g_pDmElementFramework->SetOperators(operators);
         g_pDmElementFramework->Operate(true);
     }
@@ -1259,7 +1444,7 @@ static void UpdateChannels(CUtlVector<IDmeOperator *> &operators, CDmeChannelsCl
 // Initialize the pose for this frame
 //-----------------------------------------------------------------------------
 static void ComputeFramePose(s_sourceanim_t *pSourceAnim, int nFrame, float flScale, BoneTransformMap_t &boneMap) {
-    pSourceAnim->rawanim[nFrame] = (s_bone_t *) calloc(boneMap.m_nBoneCount, sizeof(s_bone_t));
+    pSourceAnim->rawanim[nFrame] = (s_bone_t *) MdlCalloc(boneMap.m_nBoneCount, sizeof(s_bone_t));
 
     for (int i = 0; i < boneMap.m_nBoneCount; ++i) {
         matrix3x4_t jointTransform;
@@ -1298,14 +1483,27 @@ LoadAnimations(s_source_t *pSource, CDmeAnimationList *pAnimationList, float flS
         CUtlVector<IDmeOperator *> operatorList;
         PrepareChannels(operatorList, pAnimation);
         float flOOFrameRate = 1.0f / (float) nFrameRateVal;
-        int nFrame = 0;
-        while (nFrame < pSourceAnim->numframes) {
+        CUtlVector<DmeTime_t> frameTimes;
+        CUtlVector<DmeTime_t> channelTimes;
+        frameTimes.SetCount(MAX(pSourceAnim->numframes, 0));
+        channelTimes.SetCount(frameTimes.Count());
+        for (int nFrame = 0; nFrame < frameTimes.Count(); ++nFrame) {
             int nSecond = nFrame / nFrameRateVal;
             int nFraction = nFrame - nSecond * nFrameRateVal;
-            DmeTime_t t = nStartTime + DmeTime_t(nSecond * 10000) + DmeTime_t((float) nFraction * flOOFrameRate);
-            UpdateChannels(operatorList, pAnimation, t);
+            frameTimes[nFrame] = nStartTime + DmeTime_t(nSecond * 10000) + DmeTime_t((float) nFraction * flOOFrameRate);
+            channelTimes[nFrame] = pAnimation->ToChildMediaTime(frameTimes[nFrame]);
+        }
+
+        CUtlVector<BakedChannel_t> baked;
+        BakeChannels(baked, pAnimation, channelTimes);
+
+        for (int nFrame = 0; nFrame < frameTimes.Count(); ++nFrame) {
+            UpdateChannels(operatorList, pAnimation, frameTimes[nFrame], baked, nFrame);
             ComputeFramePose(pSourceAnim, nFrame, flScale, boneMap);
-            ++nFrame;
+        }
+
+        for (int j = 0; j < baked.Count(); ++j) {
+            baked[j].m_pChannel->SetMode(CM_PLAY);
         }
     }
 }
@@ -1617,6 +1815,7 @@ static bool
 LoadModelAndSkeleton(s_source_t *pSource, BoneTransformMap_t &boneMap, CDmeDag *pSkeleton, CDmeModel *pModel,
                      CDmeCombinationOperator *pCombinationOperator, bool bStaticProp) {
     s_DeltaStates.RemoveAll();
+    s_DeltaStateIndices.RemoveAll();
     s_Balance.RemoveAll();
     s_Speed.RemoveAll();
     s_UniqueVertices.RemoveAll();
@@ -2097,7 +2296,7 @@ void LoadQcModelElements(s_source_t *pSource, s_model_t *pModel, CDmeModel *pDme
 static s_source_t *AllocateDmxSource( const char *pSourceName )
 {
 	// Allocate a new source
-	s_source_t *pSource = (s_source_t *)calloc( 1, sizeof( s_source_t ) );
+	s_source_t *pSource = (s_source_t *)MdlCalloc( 1, sizeof( s_source_t ) );
 	g_source[g_numsources++] = pSource;
 	Q_strncpy( pSource->filename, pSourceName, sizeof( pSource->filename ) );
 	Q_SetExtension( pSource->filename, "dmx", sizeof( pSource->filename ) );
@@ -2121,7 +2320,7 @@ static void CreateAnimFromSkeleton( s_source_t *pSource, const char *pSequenceNa
 	pSourceAnim->numframes = 1;
 
 	// Default all transforms to identity
-	pSourceAnim->rawanim[0] = (s_bone_t *)calloc( pSource->numbones, sizeof(s_bone_t) );
+	pSourceAnim->rawanim[0] = (s_bone_t *)MdlCalloc( pSource->numbones, sizeof(s_bone_t) );
 	for ( int i = 0; i < pSource->numbones; ++i )
 	{
 		pSourceAnim->rawanim[0][i].pos.Init();
@@ -2721,7 +2920,7 @@ void LoadIkRuleList( CDmeSequence *pDmeSimpleSequence, s_animation_t *pAnimation
 		}
 
 		// calloc sets memory to 0
-		s_ikrule_t *pIkRule = reinterpret_cast< s_ikrule_t * >( calloc( 1, sizeof( s_ikrule_t ) ) );
+		s_ikrule_t *pIkRule = reinterpret_cast< s_ikrule_t * >( MdlCalloc( 1, sizeof( s_ikrule_t ) ) );
 		if ( !pIkRule )
 		{
 			MdlWarning( "1502: Cannot allocate memory for IkRule %s:%s, ignoring\n", pDmeIkRule->GetName(), pDmeIkRule->GetTypeString() );
@@ -3272,7 +3471,7 @@ static int LoadAndCreateSequences( s_source_t *pMainSource, CDmeSequenceList *pS
 
 					{
 						// allocate animation entry
-						g_panimation[g_numani] = (s_animation_t *)calloc( 1, sizeof( s_animation_t ) );
+						g_panimation[g_numani] = (s_animation_t *)MdlCalloc( 1, sizeof( s_animation_t ) );
 						g_panimation[g_numani]->index = g_numani;
 						pAnim = g_panimation[g_numani];
 						g_numani++;
@@ -4380,7 +4579,7 @@ static bool LoadBodyGroupList( s_source_t **ppMainSource, CDmeBodyGroupList *pBo
 		const int nDmeBodyPartCount = pDmeBodyGroup->m_BodyParts.Count();
 		for ( int j = 0; j < nDmeBodyPartCount; ++j )
 		{
-			s_model_t *pModel = (s_model_t *)calloc( 1, sizeof( s_model_t ) );
+			s_model_t *pModel = (s_model_t *)MdlCalloc( 1, sizeof( s_model_t ) );
 			const int nModel = g_nummodels++;
 			g_model[nModel] = pModel;
 			pBodyPart->pmodel[ pBodyPart->nummodels++ ] = pModel;
@@ -0,0 +1,418 @@
+//===== Copyright © 1996-2008, Valve Corporation, All rights reserved. ======//
+//
+// Purpose: Memory-mapped line input and fast number scanning for the
+//          text source loaders (SMD, VTA, VRM, OBJ)
+//
+//===========================================================================//
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <cstring>
+#include "tier0/platform.h"
+#include "tier0/dbg.h"
+#include "studiomdl/lineinput.h"
+
+
+// Empty files have nothing to map, but still have to open successfully
+static const char s_EmptyFile[1] = {0};
+
+//-----------------------------------------------------------------------------
+// Constructor, destructor
+//-----------------------------------------------------------------------------
+CLineInput::CLineInput()
+        : m_pBase(nullptr),
+          m_pCurr(nullptr),
+          m_pEnd(nullptr),
+          m_nMappedSize(0),
+          m_hFile(nullptr),
+          m_hMapping(nullptr) {
+}
+
+CLineInput::~CLineInput() {
+    Close();
+}
+
+
+//-----------------------------------------------------------------------------
+// Maps the whole file into memory
+//-----------------------------------------------------------------------------
+bool CLineInput::Open(const char *pFileName) {
+    Close();
+
+#ifdef _WIN32
+    HANDLE hFile = CreateFileA(pFileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                               FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (hFile == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(hFile, &size)) {
+        CloseHandle(hFile);
+        return false;
+    }
+
+    m_hFile = hFile;
+    m_nMappedSize = (size_t) size.QuadPart;
+    if (m_nMappedSize == 0) {
+        m_pBase = s_EmptyFile;
+    } else {
+        HANDLE hMapping = CreateFileMappingA(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (!hMapping) {
+            Close();
+            return false;
+        }
+        m_hMapping = hMapping;
+        m_pBase = (const char *) MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+        if (!m_pBase) {
+            Close();
+            return false;
+        }
+    }
+
+    m_pCurr = m_pBase;
+    m_pEnd = m_pBase + m_nMappedSize;
+
+    // Files opened in text mode end at the first ctrl-Z
+    const char *pCtrlZ = (const char *) memchr(m_pBase, 0x1A, m_nMappedSize);
+    if (pCtrlZ) {
+        m_pEnd = pCtrlZ;
+    }
+#else
+    int fd = open(pFileName, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+
+    m_nMappedSize = (size_t) st.st_size;
+    if (m_nMappedSize == 0) {
+        m_pBase = s_EmptyFile;
+    } else {
+        void *pView = mmap(nullptr, m_nMappedSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (pView == MAP_FAILED) {
+            close(fd);
+            m_nMappedSize = 0;
+            return false;
+        }
+        madvise(pView, m_nMappedSize, MADV_SEQUENTIAL);
+        m_pBase = (const char *) pView;
+    }
+    close(fd);
+
+    m_pCurr = m_pBase;
+    m_pEnd = m_pBase + m_nMappedSize;
+#endif
+
+    return true;
+}
+
+void CLineInput::Close() {
+#ifdef _WIN32
+    if (m_pBase && m_pBase != s_EmptyFile) {
+        UnmapViewOfFile(m_pBase);
+    }
+    if (m_hMapping) {
+        CloseHandle((HANDLE) m_hMapping);
+    }
+    if (m_hFile) {
+        CloseHandle((HANDLE) m_hFile);
+    }
+#else
+    if (m_pBase && m_pBase != s_EmptyFile) {
+        munmap((void *) m_pBase, m_nMappedSize);
+    }
+#endif
+
+    m_pBase = m_pCurr = m_pEnd = nullptr;
+    m_nMappedSize = 0;
+    m_hFile = nullptr;
+    m_hMapping = nullptr;
+}
+
+
+//-----------------------------------------------------------------------------
+// Reads the next line the way fgets would
+//-----------------------------------------------------------------------------
+bool CLineInput::ReadLine(char *pDest, int nMaxLen) {
+    Assert(nMaxLen > 1);
+    if (m_pCurr >= m_pEnd)
+        return false;
+
+    // Common case: the whole line fits. Look one character further than we
+    // can store, since a CR right before the newline doesn't take up space
+    size_t nRemaining = m_pEnd - m_pCurr;
+    size_t nSearch = MIN(nRemaining, (size_t) nMaxLen);
+    const char *pNewLine = (const char *) memchr(m_pCurr, '\n', nSearch);
+    if (!pNewLine) {
+        if (nRemaining >= (size_t) nMaxLen)
+            return ReadLineSlow(pDest, nMaxLen);
+
+        // Last line of the file, without a newline
+        memcpy(pDest, m_pCurr, nRemaining);
+        pDest[nRemaining] = '\0';
+        m_pCurr = m_pEnd;
+        return true;
+    }
+
+    size_t nLen = pNewLine - m_pCurr;
+#ifdef _WIN32
+    // Text mode turns CRLF into LF
+    if (nLen > 0 && pNewLine[-1] == '\r') {
+        --nLen;
+    }
+#endif
+    if (nLen + 1 >= (size_t) nMaxLen)
+        return ReadLineSlow(pDest, nMaxLen);
+
+    memcpy(pDest, m_pCurr, nLen);
+    pDest[nLen] = '\n';
+    pDest[nLen + 1] = '\0';
+    m_pCurr = pNewLine + 1;
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Lines which don't fit get split up across calls, like fgets does
+//-----------------------------------------------------------------------------
+bool CLineInput::ReadLineSlow(char *pDest, int nMaxLen) {
+    int nLen = 0;
+    while (nLen < nMaxLen - 1 && m_pCurr < m_pEnd) {
+        char c = *m_pCurr++;
+#ifdef _WIN32
+        if (c == '\r' && m_pCurr < m_pEnd && *m_pCurr == '\n') {
+            c = *m_pCurr++;
+        }
+#endif
+        pDest[nLen++] = c;
+        if (c == '\n')
+            break;
+    }
+    pDest[nLen] = '\0';
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Number scanning
+//-----------------------------------------------------------------------------
+static const double s_Pow10[] =
+        {
+                1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+        };
+
+enum {
+    MAX_EXACT_POW10 = 22,
+    MAX_MANTISSA_DIGITS = 19,
+    MAX_INT_DIGITS = 9,
+    MAX_SCAN_VALUES = 16,
+};
+
+// isspace() in the "C" locale
+static inline bool IsScanSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
+
+static inline bool IsDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+static inline const char *SkipScanSpace(const char *p) {
+    while (IsScanSpace(*p))
+        ++p;
+    return p;
+}
+
+// A value read for sscanf has to be followed by whitespace or the end of the
+// line, otherwise sscanf might make something else out of the rest of it
+static inline bool IsScanDelimiter(char c) {
+    return c == '\0' || IsScanSpace(c);
+}
+
+//-----------------------------------------------------------------------------
+// Parses [+-]digits[.digits][(e|E)[+-]digits] the way strtod does.
+// Fails if the value can't be computed as a single correctly rounded double
+// operation (Clinger's fast path), which makes the result identical to strtod
+//-----------------------------------------------------------------------------
+static bool ParseExactDouble(const char *p, const char **ppEnd, double &flValue) {
+    bool bNegative = false;
+    if (*p == '+' || *p == '-') {
+        bNegative = (*p == '-');
+        ++p;
+    }
+
+    uint64 nMantissa = 0;
+    int nDigits = 0;
+    int nExponent = 0;
+    bool bHasDigits = false;
+    for (; IsDigit(*p); ++p) {
+        bHasDigits = true;
+        if (nMantissa == 0 && *p == '0')
+            continue;
+        if (++nDigits > MAX_MANTISSA_DIGITS)
+            return false;
+        nMantissa = nMantissa * 10 + (*p - '0');
+    }
+
+    if (*p == '.') {
+        for (++p; IsDigit(*p); ++p) {
+            bHasDigits = true;
+            --nExponent;
+            if (nMantissa == 0 && *p == '0')
+                continue;
+            if (++nDigits > MAX_MANTISSA_DIGITS)
+                return false;
+            nMantissa = nMantissa * 10 + (*p - '0');
+        }
+    }
+
+    if (!bHasDigits)
+        return false;
+
+    // An 'e' without digits after it isn't part of the number
+    if (*p == 'e' || *p == 'E') {
+        const char *pExp = p + 1;
+        bool bNegativeExp = false;
+        if (*pExp == '+' || *pExp == '-') {
+            bNegativeExp = (*pExp == '-');
+            ++pExp;
+        }
+        if (IsDigit(*pExp)) {
+            int nExp = 0;
+            for (; IsDigit(*pExp); ++pExp) {
+                if (nExp < 10000) {
+                    nExp = nExp * 10 + (*pExp - '0');
+                }
+            }
+            nExponent += bNegativeExp ? -nExp : nExp;
+            p = pExp;
+        }
+    }
+
+    // Hex values look like a zero followed by garbage here
+    if (*p == 'x' || *p == 'X')
+        return false;
+
+    if (nMantissa == 0) {
+        flValue = 0.0;
+    } else {
+        if (nMantissa > (1ULL << 53))
+            return false;
+        if (nExponent < -MAX_EXACT_POW10 || nExponent > MAX_EXACT_POW10)
+            return false;
+
+        flValue = (double) nMantissa;
+        flValue = (nExponent < 0) ? flValue / s_Pow10[-nExponent] : flValue * s_Pow10[nExponent];
+    }
+
+    *ppEnd = p;
+    if (bNegative) {
+        flValue = -flValue;
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// scanf's %f rounds the decimal straight to float. Rounding the (correctly
+// rounded) double to float gives the same answer unless the double landed
+// exactly halfway between two floats, so bail out on those
+//-----------------------------------------------------------------------------
+static bool DoubleToScannedFloat(double flValue, float &flResult) {
+    uint64 nBits;
+    memcpy(&nBits, &flValue, sizeof(nBits));
+    if ((nBits & 0x1FFFFFFFULL) == 0x10000000ULL)
+        return false;
+
+    flResult = (float) flValue;
+    return true;
+}
+
+static bool ParseExactInt(const char *p, const char **ppEnd, int &nValue) {
+    bool bNegative = false;
+    if (*p == '+' || *p == '-') {
+        bNegative = (*p == '-');
+        ++p;
+    }
+
+    if (!IsDigit(*p))
+        return false;
+
+    int nDigits = 0;
+    int n = 0;
+    for (; IsDigit(*p); ++p) {
+        if (++nDigits > MAX_INT_DIGITS)
+            return false;
+        n = n * 10 + (*p - '0');
+    }
+
+    *ppEnd = p;
+    nValue = bNegative ? -n : n;
+    return true;
+}
+
+static const char *ScanFloats(const char *p, float *pFloats, int nCount) {
+    for (int i = 0; i < nCount; ++i) {
+        double flValue;
+        p = SkipScanSpace(p);
+        if (!ParseExactDouble(p, &p, flValue) || !IsScanDelimiter(*p))
+            return nullptr;
+        if (!DoubleToScannedFloat(flValue, pFloats[i]))
+            return nullptr;
+    }
+    return p;
+}
+
+bool FastScanFloats(const char *pLine, float *pFloats, int nCount) {
+    Assert(nCount <= MAX_SCAN_VALUES);
+
+    float flValues[MAX_SCAN_VALUES];
+    if (!ScanFloats(pLine, flValues, nCount))
+        return false;
+
+    memcpy(pFloats, flValues, nCount * sizeof(float));
+    return true;
+}
+
+bool FastScanIntAndFloats(const char *pLine, int &nValue, float *pFloats, int nCount) {
+    Assert(nCount <= MAX_SCAN_VALUES);
+
+    int nInt;
+    const char *p = SkipScanSpace(pLine);
+    if (!ParseExactInt(p, &p, nInt) || !IsScanDelimiter(*p))
+        return false;
+
+    float flValues[MAX_SCAN_VALUES];
+    if (!ScanFloats(p, flValues, nCount))
+        return false;
+
+    nValue = nInt;
+    memcpy(pFloats, flValues, nCount * sizeof(float));
+    return true;
+}
+
+bool FastAtof(const char *pString, float &flValue) {
+    double flDouble;
+    const char *pEnd;
+    if (!ParseExactDouble(SkipScanSpace(pString), &pEnd, flDouble))
+        return false;
+
+    flValue = (float) flDouble;
+    return true;
+}
+
+bool FastAtoi(const char *pString, int &nValue) {
+    const char *pEnd;
+    return ParseExactInt(SkipScanSpace(pString), &pEnd, nValue);
+}
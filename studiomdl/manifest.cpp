@@ -0,0 +1,403 @@
+//===== Copyright © 1996-2008, Valve Corporation, All rights reserved. ======//
+//
+// Purpose: Build manifest for incremental model compiles
+//
+//===========================================================================//
+
+#include <stdio.h>
+#include <sys/stat.h>
+#include <vector>
+
+#include "common/cmdlib.h"
+#include "tier0/icommandline.h"
+#include "tier1/checksum_md5.h"
+#include "tier1/strtools.h"
+#include "tier1/utlbuffer.h"
+#include "tier1/utlstring.h"
+#include "studio.h"
+#include "studiomdl/studiomdl.h"
+#include "studiomdl/manifest.h"
+
+
+#define MANIFEST_VERSION    2
+#define MANIFEST_EXTENSION  ".manifest"
+
+struct ManifestFile_t {
+    CUtlString m_Name;
+    char m_pHash[MD5_DIGEST_LENGTH * 2 + 1];
+    long long m_nSize;
+    long long m_nTime;
+};
+
+static std::vector<CUtlString> s_ManifestInputs;
+static std::vector<CUtlString> s_ManifestOutputs;
+
+// Switches which don't change what gets written
+static const char *s_pOutputNeutralSwitches[] = {
+        "-quiet",
+        "-verbose",
+        "-parsecompletion",
+        "-allowdebug",
+        "-nowarnings",
+        "-noincremental",
+};
+
+
+//-----------------------------------------------------------------------------
+// File helpers
+//-----------------------------------------------------------------------------
+static bool StatFile(const char *pFileName, long long &nSize, long long &nTime) {
+    struct _stat buf;
+    if (_stat(pFileName, &buf) == -1 || (buf.st_mode & _S_IFDIR))
+        return false;
+    nSize = buf.st_size;
+    nTime = buf.st_mtime;
+    return true;
+}
+
+static bool HashFile(const char *pFileName, char *pHash) {
+    FILE *fp = fopen(pFileName, "rb");
+    if (!fp)
+        return false;
+
+    MD5Context_t ctx;
+    MD5Init(&ctx);
+    static unsigned char s_Buffer[65536];
+    size_t nRead;
+    while ((nRead = fread(s_Buffer, 1, sizeof(s_Buffer), fp)) > 0) {
+        MD5Update(&ctx, s_Buffer, (unsigned int) nRead);
+    }
+    fclose(fp);
+
+    unsigned char digest[MD5_DIGEST_LENGTH];
+    MD5Final(digest, &ctx);
+    Q_strncpy(pHash, MD5_Print(digest, MD5_DIGEST_LENGTH), MD5_DIGEST_LENGTH * 2 + 1);
+    return true;
+}
+
+static bool DescribeFile(const char *pFileName, ManifestFile_t &file) {
+    file.m_Name = pFileName;
+    return StatFile(pFileName, file.m_nSize, file.m_nTime) && HashFile(pFileName, file.m_pHash);
+}
+
+// Same naming as the makefile target: <gamedir>models/<modelname>
+static void GetOutputBase(const char *pModelName, char *pOut, int nOutLen) {
+    Q_snprintf(pOut, nOutLen, "%smodels/%s", gamedir, pModelName);
+    Q_StripExtension(pOut, pOut, nOutLen);
+    Q_FixSlashes(pOut);
+}
+
+
+//-----------------------------------------------------------------------------
+// What else the output depends on: the compiler binary and the switches
+//-----------------------------------------------------------------------------
+static void GetCompilerId(CUtlString &id) {
+    char pExePath[MAX_PATH];
+    char pHash[MD5_DIGEST_LENGTH * 2 + 1];
+    if (!Plat_GetExecutablePath(pExePath, sizeof(pExePath)) || !HashFile(pExePath, pHash)) {
+        // can't tell which compiler this is, so never match a previous one
+        id.Format("%d unknown %f", STUDIO_VERSION, Plat_FloatTime());
+        return;
+    }
+    id.Format("%d %s", STUDIO_VERSION, pHash);
+}
+
+static void GetSwitches(CUtlString &switches) {
+    switches = "";
+
+    // the last argument is the script itself
+    int argc = CommandLine()->ParmCount();
+    for (int i = 1; i < argc - 1; i++) {
+        const char *pArgv = CommandLine()->GetParm(i);
+        bool bNeutral = false;
+        for (int j = 0; j < ARRAYSIZE(s_pOutputNeutralSwitches); j++) {
+            if (!Q_stricmp(pArgv, s_pOutputNeutralSwitches[j])) {
+                bNeutral = true;
+                break;
+            }
+        }
+        if (bNeutral)
+            continue;
+
+        if (!switches.IsEmpty()) {
+            switches += " ";
+        }
+        switches += pArgv;
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+// Finds the $modelname in the top level script without running it
+//-----------------------------------------------------------------------------
+static bool ScanModelName(const char *pScriptPath, char *pModelName, int nMaxLen) {
+    CUtlBuffer buf(0, 0, CUtlBuffer::TEXT_BUFFER);
+    FILE *fp = fopen(pScriptPath, "rb");
+    if (!fp)
+        return false;
+    fseek(fp, 0, SEEK_END);
+    int nSize = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    buf.EnsureCapacity(nSize + 1);
+    int nRead = (int) fread(buf.Base(), 1, nSize, fp);
+    fclose(fp);
+
+    // Tokenize the way scriplib does, minus macros and variables
+    const char *p = (const char *) buf.Base();
+    const char *pEnd = p + nRead;
+    char pToken[MAX_PATH];
+    bool bFound = false;
+    bool bWantName = false;
+    while (p < pEnd) {
+        if ((unsigned char) *p <= ' ') {
+            ++p;
+            continue;
+        }
+        if (*p == ';' || *p == '#' || (*p == '/' && p + 1 < pEnd && p[1] == '/')) {
+            while (p < pEnd && *p != '\n')
+                ++p;
+            continue;
+        }
+        if (*p == '/' && p + 1 < pEnd && p[1] == '*') {
+            p += 2;
+            while (p + 1 < pEnd && (p[0] != '*' || p[1] != '/'))
+                ++p;
+            p += 2;
+            continue;
+        }
+
+        int nLen = 0;
+        if (*p == '"') {
+            ++p;
+            while (p < pEnd && *p != '"') {
+                if (nLen < (int) sizeof(pToken) - 1) {
+                    pToken[nLen++] = *p;
+                }
+                ++p;
+            }
+            ++p;
+        } else {
+            while (p < pEnd && (unsigned char) *p > ' ' && *p != ';') {
+                if (nLen < (int) sizeof(pToken) - 1) {
+                    pToken[nLen++] = *p;
+                }
+                ++p;
+            }
+        }
+        pToken[nLen] = 0;
+
+        if (bWantName) {
+            // names built from macros or variables can't be resolved here
+            if (strchr(pToken, '$'))
+                return false;
+
+            const char *pName = (pToken[0] == '/' || pToken[0] == '\\') ? pToken + 1 : pToken;
+            if (bFound && Q_stricmp(pName, pModelName))
+                return false;
+            Q_strncpy(pModelName, pName, nMaxLen);
+            bFound = true;
+            bWantName = false;
+        } else if (!Q_stricmp(pToken, "$modelname")) {
+            bWantName = true;
+        }
+    }
+    return bFound;
+}
+
+
+//-----------------------------------------------------------------------------
+// Records a file read or written by the compile
+//-----------------------------------------------------------------------------
+static void AddFile(std::vector<CUtlString> &files, const char *pFileName) {
+    char pFullPath[MAX_PATH];
+    if (!Q_MakeAbsolutePath(pFullPath, sizeof(pFullPath), pFileName))
+        return;
+    Q_FixSlashes(pFullPath);
+
+    for (size_t i = 0; i < files.size(); i++) {
+        if (!Q_stricmp(files[i].Get(), pFullPath))
+            return;
+    }
+    files.emplace_back(pFullPath);
+}
+
+void Manifest_AddInput(const char *pFileName) {
+    AddFile(s_ManifestInputs, pFileName);
+}
+
+void Manifest_AddOutput(const char *pFileName) {
+    AddFile(s_ManifestOutputs, pFileName);
+}
+
+
+//-----------------------------------------------------------------------------
+// Manifest format, one entry per line:
+//	studiomdl_manifest <version>
+//	compiler <studio version> <md5 of the compiler binary>
+//	switches <arguments>
+//	script <path>
+//	output <md5> <size> <time> <path>
+//	input <md5> <size> <time> <path>
+//-----------------------------------------------------------------------------
+static void WriteFileLine(FILE *fp, const char *pKey, const ManifestFile_t &file) {
+    fprintf(fp, "%s %s %lld %lld %s\n", pKey, file.m_pHash, file.m_nSize, file.m_nTime, file.m_Name.Get());
+}
+
+static bool ReadFileLine(const char *pLine, const char *pKey, ManifestFile_t &file) {
+    int nKeyLen = Q_strlen(pKey);
+    if (Q_strncmp(pLine, pKey, nKeyLen) || pLine[nKeyLen] != ' ')
+        return false;
+
+    int nNameOffset = 0;
+    if (sscanf(pLine + nKeyLen + 1, "%32s %lld %lld %n", file.m_pHash, &file.m_nSize, &file.m_nTime, &nNameOffset) != 3 ||
+        !nNameOffset)
+        return false;
+
+    file.m_Name = pLine + nKeyLen + 1 + nNameOffset;
+    return !file.m_Name.IsEmpty();
+}
+
+// A file is unchanged if its size and time match, or failing that, its content hash
+static bool IsFileUnchanged(const ManifestFile_t &file) {
+    long long nSize, nTime;
+    if (!StatFile(file.m_Name.Get(), nSize, nTime) || nSize != file.m_nSize)
+        return false;
+    if (nTime == file.m_nTime)
+        return true;
+
+    char pHash[MD5_DIGEST_LENGTH * 2 + 1];
+    return HashFile(file.m_Name.Get(), pHash) && !Q_stricmp(pHash, file.m_pHash);
+}
+
+static bool ReadManifestLine(FILE *fp, char *pLine, int nMaxLen) {
+    if (!fgets(pLine, nMaxLen, fp))
+        return false;
+    int nLen = Q_strlen(pLine);
+    while (nLen > 0 && (pLine[nLen - 1] == '\n' || pLine[nLen - 1] == '\r')) {
+        pLine[--nLen] = 0;
+    }
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Returns true if the outputs of the script are up to date
+//-----------------------------------------------------------------------------
+bool Manifest_IsUpToDate(const char *pScriptPath) {
+    char pModelName[MAX_PATH];
+    if (!ScanModelName(pScriptPath, pModelName, sizeof(pModelName)))
+        return false;
+
+    char pManifestPath[MAX_PATH];
+    GetOutputBase(pModelName, pManifestPath, sizeof(pManifestPath));
+    Q_strncat(pManifestPath, MANIFEST_EXTENSION, sizeof(pManifestPath), COPY_ALL_CHARACTERS);
+
+    FILE *fp = fopen(pManifestPath, "r");
+    if (!fp)
+        return false;
+
+    char pScriptFullPath[MAX_PATH];
+    Q_MakeAbsolutePath(pScriptFullPath, sizeof(pScriptFullPath), pScriptPath);
+    Q_FixSlashes(pScriptFullPath);
+
+    CUtlString compilerId, switches;
+    GetCompilerId(compilerId);
+    GetSwitches(switches);
+
+    char pLine[MAX_PATH * 2];
+    char pExpected[MAX_PATH * 2];
+    bool bUpToDate = false;
+    int nOutputs = 0;
+    do {
+        Q_snprintf(pExpected, sizeof(pExpected), "studiomdl_manifest %d", MANIFEST_VERSION);
+        if (!ReadManifestLine(fp, pLine, sizeof(pLine)) || Q_strcmp(pLine, pExpected))
+            break;
+        Q_snprintf(pExpected, sizeof(pExpected), "compiler %s", compilerId.Get());
+        if (!ReadManifestLine(fp, pLine, sizeof(pLine)) || Q_strcmp(pLine, pExpected))
+            break;
+        Q_snprintf(pExpected, sizeof(pExpected), "switches %s", switches.Get());
+        if (!ReadManifestLine(fp, pLine, sizeof(pLine)) || Q_strcmp(pLine, pExpected))
+            break;
+        Q_snprintf(pExpected, sizeof(pExpected), "script %s", pScriptFullPath);
+        if (!ReadManifestLine(fp, pLine, sizeof(pLine)) || Q_stricmp(pLine, pExpected))
+            break;
+
+        bUpToDate = true;
+        ManifestFile_t file;
+        while (bUpToDate && ReadManifestLine(fp, pLine, sizeof(pLine))) {
+            if (ReadFileLine(pLine, "output", file)) {
+                ++nOutputs;
+                bUpToDate = IsFileUnchanged(file);
+            } else if (ReadFileLine(pLine, "input", file)) {
+                bUpToDate = IsFileUnchanged(file);
+            } else {
+                bUpToDate = false;
+            }
+        }
+    } while (0);
+    fclose(fp);
+
+    return bUpToDate && nOutputs > 0;
+}
+
+
+//-----------------------------------------------------------------------------
+// Writes the manifest next to the compiled model
+//-----------------------------------------------------------------------------
+void Manifest_Write(const char *pScriptPath) {
+    char pOutputBase[MAX_PATH];
+    GetOutputBase(g_outname, pOutputBase, sizeof(pOutputBase));
+
+    char pManifestPath[MAX_PATH];
+    Q_snprintf(pManifestPath, sizeof(pManifestPath), "%s" MANIFEST_EXTENSION, pOutputBase);
+
+    // every output has to be there, or the manifest would vouch for a partial build
+    std::vector<ManifestFile_t> outputs(s_ManifestOutputs.size());
+    bool bHaveOutputs = !outputs.empty();
+    for (size_t i = 0; bHaveOutputs && i < outputs.size(); i++) {
+        bHaveOutputs = DescribeFile(s_ManifestOutputs[i].Get(), outputs[i]);
+    }
+    if (!bHaveOutputs) {
+        // nothing to be up to date with, make sure a stale manifest doesn't say otherwise
+        remove(pManifestPath);
+        return;
+    }
+
+    char pScriptFullPath[MAX_PATH];
+    Q_MakeAbsolutePath(pScriptFullPath, sizeof(pScriptFullPath), pScriptPath);
+    Q_FixSlashes(pScriptFullPath);
+
+    CUtlString compilerId, switches;
+    GetCompilerId(compilerId);
+    GetSwitches(switches);
+
+    FILE *fp = fopen(pManifestPath, "w");
+    if (!fp) {
+        MdlWarning("Can't write build manifest %s\n", pManifestPath);
+        return;
+    }
+
+    fprintf(fp, "studiomdl_manifest %d\n", MANIFEST_VERSION);
+    fprintf(fp, "compiler %s\n", compilerId.Get());
+    fprintf(fp, "switches %s\n", switches.Get());
+    fprintf(fp, "script %s\n", pScriptFullPath);
+    for (size_t i = 0; i < outputs.size(); i++) {
+        WriteFileLine(fp, "output", outputs[i]);
+    }
+
+    bool bComplete = true;
+    for (size_t i = 0; i < s_ManifestInputs.size(); i++) {
+        ManifestFile_t input;
+        if (!DescribeFile(s_ManifestInputs[i].Get(), input)) {
+            bComplete = false;
+            break;
+        }
+        WriteFileLine(fp, "input", input);
+    }
+    fclose(fp);
+
+    if (!bComplete) {
+        // an input vanished during the compile, so the manifest can't vouch for anything
+        remove(pManifestPath);
+    }
+}
@@ -127,7 +127,7 @@ void Grab_Vertexlist( s_source_t *psource )
 {
 	while (1)
 	{
-		if (fgets( g_StudioMdlContext.szLine, sizeof( g_StudioMdlContext.szLine ), g_StudioMdlContext.fpInput ) != NULL)
+		if (ReadLineInput())
 		{
 			int j;
 			int bone;
@@ -189,7 +189,7 @@ void Grab_Facelist( s_source_t *psource )
 {
 	while (1)
 	{
-		if (fgets( g_StudioMdlContext.szLine, sizeof( g_StudioMdlContext.szLine ), g_StudioMdlContext.fpInput ) != NULL)
+		if (ReadLineInput())
 		{
 			int j;
 			s_tmpface_t f;
@@ -220,7 +220,7 @@ void Grab_Materiallist( s_source_t *psource )
 {
 	while (1)
 	{
-		if (fgets( g_StudioMdlContext.szLine, sizeof( g_StudioMdlContext.szLine ), g_StudioMdlContext.fpInput ) != NULL)
+		if (ReadLineInput())
 		{
 			// char name[256];
 			char path[MAX_PATH];
@@ -264,7 +264,7 @@ void Grab_Texcoordlist( s_source_t *psource )
 {
 	while (1)
 	{
-		if (fgets( g_StudioMdlContext.szLine, sizeof( g_StudioMdlContext.szLine ), g_StudioMdlContext.fpInput ) != NULL)
+		if (ReadLineInput())
 		{
 			int j;
 			Vector2D t;
@@ -296,7 +296,7 @@ void Grab_Normallist( s_source_t *psource )
 {
 	while (1)
 	{
-		if (fgets( g_StudioMdlContext.szLine, sizeof( g_StudioMdlContext.szLine ), g_StudioMdlContext.fpInput ) != NULL)
+		if (ReadLineInput())
 		{
 			int j;
 			int bone;
@@ -337,7 +337,7 @@ void Grab_Faceattriblist( s_source_t *psource )
 {
 	while (1)
 	{
-		if (fgets( g_StudioMdlContext.szLine, sizeof( g_StudioMdlContext.szLine ), g_StudioMdlContext.fpInput ) != NULL)
+		if (ReadLineInput())
 		{
 			int j;
 			int smooth;
@@ -409,19 +409,61 @@ int closestNormal( int v, int n )
 }
 
 
-int AddToVlist(int v, int m, int n, std::array<uint32_t, MAXSTUDIOTEXCOORDS>& t, int firstref)
+//-----------------------------------------------------------------------------
+// Open-addressed hash of unified vertices on ( v, m, n, t[] ), so corners don't
+// have to walk every entry sharing their position. s_VListTail holds the last
+// entry of each v_list chain so new entries are appended in creation order.
+//-----------------------------------------------------------------------------
+static CUtlVector< int > s_VListHash;
+static unsigned int s_nVListHashMask;
+static CUtlVector< v_unify_t* > s_VListTail;
+
+static inline unsigned int HashVlistKey( int v, int m, int n, const std::array<uint32_t, MAXSTUDIOTEXCOORDS>& t )
 {
-	v_unify_t *prev = nullptr;
-	v_unify_t *cur = v_list[v];
+	unsigned int h = (unsigned int)v * 0x9E3779B1;
+	h = ( ( h << 5 ) | ( h >> 27 ) ) ^ ( (unsigned int)n * 0x85EBCA77 );
+	h = ( ( h << 5 ) | ( h >> 27 ) ) ^ ( (unsigned int)m * 0xC2B2AE3D );
+	for (int i = 0; i < MAXSTUDIOTEXCOORDS; ++i)
+	{
+		h = ( ( h << 5 ) | ( h >> 27 ) ) ^ ( t[i] * 0x27D4EB2F );
+	}
+	return h ^ ( h >> 15 );
+}
 
-	while (cur)
+static void InitVlistHash( int nCorners, int nPositions )
+{
+	unsigned int nSize = 16;
+	while ( nSize < (unsigned int)nCorners * 2 )
+	{
+		nSize <<= 1;
+	}
+	s_VListHash.SetCount( nSize );
+	memset( s_VListHash.Base(), 0xFF, nSize * sizeof( int ) );
+	s_nVListHashMask = nSize - 1;
+
+	s_VListTail.SetCount( nPositions );
+	memset( v_list, 0, nPositions * sizeof( v_unify_t* ) );
+}
+
+static void PurgeVlistHash()
+{
+	s_VListHash.Purge();
+	s_VListTail.Purge();
+	s_nVListHashMask = 0;
+}
+
+int AddToVlist(int v, int m, int n, std::array<uint32_t, MAXSTUDIOTEXCOORDS>& t, int firstref)
+{
+	unsigned int nSlot = HashVlistKey( v, m, n, t ) & s_nVListHashMask;
+	for ( int nIndex = s_VListHash[nSlot]; nIndex >= 0; nSlot = ( nSlot + 1 ) & s_nVListHashMask, nIndex = s_VListHash[nSlot] )
 	{
-		if (cur->m == m && cur->n == n)
+		v_unify_t *cur = &v_listdata[nIndex];
+		if (cur->v == v && cur->m == m && cur->n == n)
 		{
 			bool bMatch = true;
 			for (int i = 0; (i < MAXSTUDIOTEXCOORDS) && bMatch; ++i)
 			{
-				if (cur->t[i] != t[i])
+				if ((uint32_t)cur->t[i] != t[i])
 				{
 					bMatch = false;
 				}
@@ -429,11 +471,9 @@ int AddToVlist(int v, int m, int n, std::array<uint32_t, MAXSTUDIOTEXCOORDS>& t,
 			if (bMatch)
 			{
 				cur->refcount++;
-				return cur - v_listdata;
+				return nIndex;
 			}
 		}
-		prev = cur;
-		cur = cur->next;
 	}
 
 	if (g_numvlist >= MAXSTUDIOSRCVERTS)
@@ -441,7 +481,8 @@ int AddToVlist(int v, int m, int n, std::array<uint32_t, MAXSTUDIOTEXCOORDS>& t,
 		MdlError( "Too many unified vertices\n");
 	}
 
-	cur = &v_listdata[g_numvlist++];
+	v_unify_t *cur = &v_listdata[g_numvlist];
+	memset( cur, 0, sizeof( *cur ) );
 	cur->lastref = -1;
 	cur->refcount = 1;
 	cur->v = v;
@@ -452,16 +493,18 @@ int AddToVlist(int v, int m, int n, std::array<uint32_t, MAXSTUDIOTEXCOORDS>& t,
 		cur->t[i] = t[i];
 	}
 
-	if (prev)
+	if (v_list[v])
 	{
-		prev->next = cur;
+		s_VListTail[v]->next = cur;
 	}
 	else
 	{
 		v_list[v] = cur;
 	}
+	s_VListTail[v] = cur;
 
-	return g_numvlist - 1;
+	s_VListHash[nSlot] = g_numvlist;
+	return g_numvlist++;
 }
 
 void DecrementReferenceVlist( int uv, int numverts )
@@ -488,10 +531,32 @@ void UnifyIndices( s_source_t *psource )
 
 	s_face_t uface;
 
-	// clear v_list
+	// clear v_list; only the positions this source can reference need resetting,
+	// and v_listdata entries are cleared as they're handed out
 	g_numvlist = 0;
-	memset( v_list, 0, sizeof( v_list ) );
-	memset( v_listdata, 0, sizeof( v_listdata ) );
+
+	int nCorners = 0;
+	int nPositions = g_StudioMdlContext.numverts;
+	for (i = 0; i < g_StudioMdlContext.numfaces; i++)
+	{
+		const s_tmpface_t &face = g_StudioMdlContext.face[i];
+		uint32_t nMaxPosition = MAX( MAX( face.a, face.b ), face.c );
+		nCorners += 3;
+		if ( face.d != 0xFFFFFFFF )
+		{
+			nMaxPosition = MAX( nMaxPosition, face.d );
+			++nCorners;
+		}
+		if ( nMaxPosition >= (uint32_t)nPositions )
+		{
+			if ( nMaxPosition >= MAXSTUDIOSRCVERTS )
+			{
+				MdlError( "Too many unified vertices\n");
+			}
+			nPositions = nMaxPosition + 1;
+		}
+	}
+	InitVlistHash( nCorners, nPositions );
 
 	// create an list of all the
 	for (i = 0; i < g_StudioMdlContext.numfaces; i++)
@@ -510,6 +575,8 @@ void UnifyIndices( s_source_t *psource )
 		g_StudioMdlContext.src_uface[i] = uface;
 	}
 
+	PurgeVlistHash();
+
 	// printf("%d : %d %d %d\n", numvlist, g_StudioMdlContext.numverts, g_StudioMdlContext.numnormals, g_numtexcoords );
 }
 
@@ -522,7 +589,7 @@ void CalcModelTangentSpaces( s_source_t *pSrc );
 static void BuildUniqueVertexList( s_source_t *pSource, const int *pDesiredToVList )
 {
 	// allocate memory
-	pSource->vertex = (s_vertexinfo_t *)calloc( pSource->numvertices, sizeof( s_vertexinfo_t ) );
+	pSource->vertex = (s_vertexinfo_t *)MdlCalloc( pSource->numvertices, sizeof( s_vertexinfo_t ) );
 
 	int numValidTexcoords = 1;
 
@@ -576,6 +643,11 @@ static void BuildUniqueVertexList( s_source_t *pSource, const int *pDesiredToVLi
 
 //-----------------------------------------------------------------------------
 // sort new vertices by materials, last used
+//
+// Unified vertices all have the same last used value, so ties within a
+// material are common and their order is whatever qsort leaves them in.
+// The vertex order (and the face remap) depends on it, so this stays a qsort
+// with the original comparator rather than a stable sort.
 //-----------------------------------------------------------------------------
 static int vlistCompare( const void *elem1, const void *elem2 )
 {
@@ -612,36 +684,25 @@ static void SortVerticesByMaterial( int *pDesiredToVList, int *pVListToDesired )
 
 
 //-----------------------------------------------------------------------------
-// sort new faces by materials, last used
+// sort new faces by materials, original usage
 //-----------------------------------------------------------------------------
-static int faceCompare( const void *elem1, const void *elem2 )
-{
-	int i1 = *(int *)elem1;
-	int i2 = *(int *)elem2;
-
-	// sort by material
-	if (g_StudioMdlContext.face[i1].material < g_StudioMdlContext.face[i2].material)
-		return -1;
-	if (g_StudioMdlContext.face[i1].material > g_StudioMdlContext.face[i2].material)
-		return 1;
-
-	// sort by original usage
-	if (i1 < i2)
-		return -1;
-	if (i1 > i2)
-		return 1;
-
-	return 0;
-}
-
 static void SortFacesByMaterial( int *pDesiredToSrcFace )
 {
 	// NOTE: Unlike SortVerticesByMaterial, srcFaceToDesired isn't needed, so we're not computing it
+	int materialStart[MAXSTUDIOSKINS + 1] = { 0 };
+	for ( int i = 0; i < g_StudioMdlContext.numfaces; i++ )
+	{
+		Assert( g_StudioMdlContext.face[i].material >= 0 && g_StudioMdlContext.face[i].material < MAXSTUDIOSKINS );
+		materialStart[ g_StudioMdlContext.face[i].material + 1 ]++;
+	}
+	for ( int m = 1; m <= MAXSTUDIOSKINS; m++ )
+	{
+		materialStart[m] += materialStart[m - 1];
+	}
 	for ( int i = 0; i < g_StudioMdlContext.numfaces; i++ )
 	{
-		pDesiredToSrcFace[i] = i;
+		pDesiredToSrcFace[ materialStart[ g_StudioMdlContext.face[i].material ]++ ] = i;
 	}
-	qsort( pDesiredToSrcFace, g_StudioMdlContext.numfaces, sizeof( int ), faceCompare );
 }
 
 
@@ -698,7 +759,7 @@ static void PointMeshesToVertexAndFaceData( s_source_t *pSource, int *pDesiredTo
 //-----------------------------------------------------------------------------
 static void BuildFaceList( s_source_t *pSource, int *pVListToDesired, int *pDesiredToSrcFace )
 {
-	pSource->face = (s_face_t *)calloc( pSource->numfaces, sizeof( s_face_t ));
+	pSource->face = (s_face_t *)MdlCalloc( pSource->numfaces, sizeof( s_face_t ));
 	for ( int m = 0; m < MAXSTUDIOSKINS; m++)
 	{
 		if ( !pSource->mesh[m].numfaces )
@@ -796,7 +857,7 @@ void Grab_MRMFaceupdates( s_source_t *psource )
 {
 	while (1)
 	{
-		if (fgets( g_StudioMdlContext.szLine, sizeof( g_StudioMdlContext.szLine ), g_StudioMdlContext.fpInput ) != NULL)
+		if (ReadLineInput())
 		{
 			g_StudioMdlContext.iLinecount++;
 
@@ -824,7 +885,7 @@ int Load_VRM ( s_source_t *psource )
 
 	g_StudioMdlContext.iLinecount = 0;
 
-	while (fgets( g_StudioMdlContext.szLine, sizeof( g_StudioMdlContext.szLine ), g_StudioMdlContext.fpInput ) != NULL)
+	while (ReadLineInput())
 	{
 		g_StudioMdlContext.iLinecount++;
 		sscanf( g_StudioMdlContext.szLine, "%1023s %d", cmd, &option );
@@ -926,7 +987,7 @@ int Load_VRM ( s_source_t *psource )
 	UnifyIndices( psource );
 	BuildIndividualMeshes( psource );
 
-	fclose( g_StudioMdlContext.fpInput );
+	CloseGlobalFile();
 
 	return 1;
 }
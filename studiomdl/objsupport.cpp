@@ -29,6 +29,7 @@
 #include "studio.h"
 #include "tier1/characterset.h"
 #include "studiomdl/studiomdl.h"
+#include "studiomdl/manifest.h"
 extern StudioMdlContext g_StudioMdlContext;
 
 bool IsEnd( char const* pLine );
@@ -180,7 +181,7 @@ int Load_OBJ( s_source_t *psource )
 	pSourceAnim->numframes = 1;
 	pSourceAnim->startframe = 0;
 	pSourceAnim->endframe = 0;
-	pSourceAnim->rawanim[0] = (s_bone_t *)calloc( 1, sizeof( s_bone_t ) );
+	pSourceAnim->rawanim[0] = (s_bone_t *)MdlCalloc( 1, sizeof( s_bone_t ) );
 	pSourceAnim->rawanim[0][0].pos.Init();
 	pSourceAnim->rawanim[0][0].rot.Init();
 	Build_Reference( psource, "BindPose" );
@@ -196,7 +197,10 @@ int Load_OBJ( s_source_t *psource )
 		{
 			i = g_StudioMdlContext.numverts++;
 
-			sscanf( g_StudioMdlContext.szLine, "v %f %f %f", &g_StudioMdlContext.vertex[i].x, &g_StudioMdlContext.vertex[i].y, &g_StudioMdlContext.vertex[i].z );
+			if ( !FastScanFloats( g_StudioMdlContext.szLine + 2, g_StudioMdlContext.vertex[i].Base(), 3 ) )
+			{
+				sscanf( g_StudioMdlContext.szLine, "v %f %f %f", &g_StudioMdlContext.vertex[i].x, &g_StudioMdlContext.vertex[i].y, &g_StudioMdlContext.vertex[i].z );
+			}
 			g_StudioMdlContext.bone[i].numbones = 1;
 			g_StudioMdlContext.bone[i].bone[0] = 0;
 			g_StudioMdlContext.bone[i].weight[0] = 1.0;
@@ -206,14 +210,20 @@ int Load_OBJ( s_source_t *psource )
 		if (strncmp( g_StudioMdlContext.szLine, "vn ", 3 ) == 0)
 		{
 			i = g_StudioMdlContext.numnormals++;
-			sscanf( g_StudioMdlContext.szLine, "vn %f %f %f", &g_StudioMdlContext.normal[i].x, &g_StudioMdlContext.normal[i].y, &g_StudioMdlContext.normal[i].z );
+			if ( !FastScanFloats( g_StudioMdlContext.szLine + 3, g_StudioMdlContext.normal[i].Base(), 3 ) )
+			{
+				sscanf( g_StudioMdlContext.szLine, "vn %f %f %f", &g_StudioMdlContext.normal[i].x, &g_StudioMdlContext.normal[i].y, &g_StudioMdlContext.normal[i].z );
+			}
 			continue;
 		}
 		
 		if (strncmp( g_StudioMdlContext.szLine, "vt ", 3 ) == 0)
 		{
 			i = g_StudioMdlContext.numtexcoords[0]++;
-			sscanf( g_StudioMdlContext.szLine, "vt %f %f", &g_StudioMdlContext.texcoord[0][i].x, &g_StudioMdlContext.texcoord[0][i].y );
+			if ( !FastScanFloats( g_StudioMdlContext.szLine + 3, g_StudioMdlContext.texcoord[0][i].Base(), 2 ) )
+			{
+				sscanf( g_StudioMdlContext.szLine, "vt %f %f", &g_StudioMdlContext.texcoord[0][i].x, &g_StudioMdlContext.texcoord[0][i].y );
+			}
 			g_StudioMdlContext.texcoord[0][i].y = 1.0 - g_StudioMdlContext.texcoord[0][i].y;
 			continue;
 		}
@@ -227,6 +237,7 @@ int Load_OBJ( s_source_t *psource )
 			Q_ComposeFileName( pFullDir, cmd, pFullMtlLibPath, sizeof(pFullMtlLibPath) );
 			if ( g_pFullFileSystem->ReadFile( pFullMtlLibPath, NULL, buf ) )
 			{
+				Manifest_AddInput( pFullMtlLibPath );
 				ParseMtlLib( buf );
 			}
 			continue;
@@ -292,7 +303,7 @@ int Load_OBJ( s_source_t *psource )
 
 	BuildIndividualMeshes( psource );
 
-	fclose( g_StudioMdlContext.fpInput );
+	CloseGlobalFile();
 
 	return 1;
 }
@@ -330,7 +341,10 @@ int AppendVTAtoOBJ( s_source_t *psource, char *filename, int frame )
 		{
 			i = g_StudioMdlContext.numverts++;
 
-			sscanf( g_StudioMdlContext.szLine, "v %f %f %f", &tmp.x, &tmp.y, &tmp.z );
+			if ( !FastScanFloats( g_StudioMdlContext.szLine + 2, tmp.Base(), 3 ) )
+			{
+				sscanf( g_StudioMdlContext.szLine, "v %f %f %f", &tmp.x, &tmp.y, &tmp.z );
+			}
 			VectorTransform( tmp, m, g_StudioMdlContext.vertex[i] );
 
 			// printf("%f %f %f\n", g_StudioMdlContext.vertex[i].x, g_StudioMdlContext.vertex[i].y, g_StudioMdlContext.vertex[i].z );
@@ -342,13 +356,19 @@ int AppendVTAtoOBJ( s_source_t *psource, char *filename, int frame )
 		else if (strncmp( g_StudioMdlContext.szLine, "vn ", 3 ) == 0)
 		{
 			i = g_StudioMdlContext.numnormals++;
-			sscanf( g_StudioMdlContext.szLine, "vn %f %f %f", &tmp.x, &tmp.y, &tmp.z );
+			if ( !FastScanFloats( g_StudioMdlContext.szLine + 3, tmp.Base(), 3 ) )
+			{
+				sscanf( g_StudioMdlContext.szLine, "vn %f %f %f", &tmp.x, &tmp.y, &tmp.z );
+			}
 			VectorRotate( tmp, m, g_StudioMdlContext.normal[i] );
 		}
 		else if (strncmp( g_StudioMdlContext.szLine, "vt ", 3 ) == 0)
 		{
 			i = g_StudioMdlContext.numtexcoords[0]++;
-			sscanf( g_StudioMdlContext.szLine, "vt %f %f", &g_StudioMdlContext.texcoord[0][i].x, &g_StudioMdlContext.texcoord[0][i].y );
+			if ( !FastScanFloats( g_StudioMdlContext.szLine + 3, g_StudioMdlContext.texcoord[0][i].Base(), 2 ) )
+			{
+				sscanf( g_StudioMdlContext.szLine, "vt %f %f", &g_StudioMdlContext.texcoord[0][i].x, &g_StudioMdlContext.texcoord[0][i].y );
+			}
 		}
 		else if (strncmp( g_StudioMdlContext.szLine, "usemtl ", 7 ) == 0)
 		{
@@ -404,7 +424,7 @@ int AppendVTAtoOBJ( s_source_t *psource, char *filename, int frame )
 		pSourceAnim->numframes = 1;
 		pSourceAnim->startframe = 0;
 		pSourceAnim->endframe = 0;
-		pSourceAnim->rawanim[0] = (s_bone_t *)calloc( 1, sizeof( s_bone_t ) );
+		pSourceAnim->rawanim[0] = (s_bone_t *)MdlCalloc( 1, sizeof( s_bone_t ) );
 		pSourceAnim->rawanim[0][0].pos.Init();
 		pSourceAnim->rawanim[0][0].rot = RadianEuler( 1.570796, 0.0, 0.0 );
 		Build_Reference( psource, "BindPose" );
@@ -418,7 +438,7 @@ int AppendVTAtoOBJ( s_source_t *psource, char *filename, int frame )
 	int count = g_numvlist;
 
 	pSourceAnim->numvanims[t] = count;
-	pSourceAnim->vanim[t] = (s_vertanim_t *)calloc( count, sizeof( s_vertanim_t ) );
+	pSourceAnim->vanim[t] = (s_vertanim_t *)MdlCalloc( count, sizeof( s_vertanim_t ) );
 	for (i = 0; i < count; i++)
 	{
 		pSourceAnim->vanim[t][i].vertex = i;
@@ -426,7 +446,7 @@ int AppendVTAtoOBJ( s_source_t *psource, char *filename, int frame )
 		pSourceAnim->vanim[t][i].normal = g_StudioMdlContext.normal[v_listdata[i].n];
 	}
 
-	fclose( g_StudioMdlContext.fpInput );
+	CloseGlobalFile();
 
 	return 1;
 }
@@ -32,6 +32,7 @@
 #include "studiomdl/hardwarematrixstate.h"
 #include "studiomdl/hardwarevertexcache.h"
 #include "studiomdl/optimize.h"
+#include "studiomdl/manifest.h"
 #include <malloc.h>
 #include <nvtristrip.h>
 #include "studiomdl/filebuffer.h"
@@ -3002,6 +3003,7 @@ namespace OptimizedModel {
 #endif
 
         m_FileBuffer->WriteToFile(pFileName, m_EndOfFileOffset);
+        Manifest_AddOutput(pFileName);
 
         FileHeader_t *pVtxHeader = (FileHeader_t *) m_FileBuffer->GetPointer(0);
         SanityCheckVertexBoneLODFlags(pHdr, pVtxHeader);
@@ -22,6 +22,7 @@
 #include "common/cmdlib.h"
 #include "common/scriplib.h"
 #include "mathlib/mathlib.h"
+#include "mathlib/ssemath.h"
 #include "studio.h"
 #include "studiomdl/studiomdl.h"
 #include "studiomdl/bone_setup.h"
@@ -29,6 +30,7 @@
 #include "mathlib/vmatrix.h"
 #include "mdlobjects/dmeboneflexdriver.h"
 #include "tier1/utlspheretree.h"
+#include "tier0/memalloc.h"
 
 extern StudioMdlContext g_StudioMdlContext;
 
@@ -447,7 +449,7 @@ void processAnimations() {
                     for (k = 0; k < g_sequence[i].groupsize[1]; k++) {
                         if (g_sequence[i].panim[j][k]->weight[n] && g_bonetable[n].parent != -1 &&
                             g_sequence[i].panim[j][k]->weight[g_bonetable[n].parent] == 0.0) {
-                            g_sequence[i].panim[j][k]->weight[g_bonetable[n].parent] = 0.001;
+                            g_sequence[i].panim[j][k]->weight.Set(g_StudioMdlContext.numbones, g_bonetable[n].parent, 0.001);
                             // printf("%s : %d %d\n", g_sequence[i].panim[j][k]->name, n, g_bonetable[n].parent );
                         }
                     }
@@ -850,7 +852,7 @@ void fixupMissingFrame(s_animation_t *panim) {
 
     float scale = 1 / (j - 1.0f);
 
-    panim->sanim[j] = (s_bone_t *) calloc(1, size);
+    panim->sanim[j] = (s_bone_t *) MdlCalloc(1, size);
 
     Vector deltapos;
 
@@ -1362,7 +1364,7 @@ void forceNumframes(s_animation_t *panim, int numframes) {
 
     // copy
     for (j = panim->numframes; j < numframes; j++) {
-        panim->sanim[j] = (s_bone_t *) calloc(1, size);
+        panim->sanim[j] = (s_bone_t *) MdlCalloc(1, size);
         memcpy(panim->sanim[j], panim->sanim[panim->numframes - 1], size);
     }
 
@@ -1460,9 +1462,9 @@ void clearAnimations(s_animation_t *panim, bool bRetainDuration) {
         for (k = 0; k < g_StudioMdlContext.numbones; k++) {
             panim->sanim[0][k].pos = Vector(0, 0, 0);
             panim->sanim[0][k].rot = RadianEuler(0, 0, 0);
-            panim->weight[k] = 0.0;
-            panim->posweight[k] = 0.0;
         }
+        panim->weight.Share(NULL);
+        panim->posweight.Share(NULL);
     } else {
         // fixme: zero the bone data?
     }
@@ -1652,7 +1654,7 @@ void RemapAnimations() {
         int n = panim->startframe - pSourceAnim->startframe;
         // printf("%s %d:%d\n", g_panimation[i]->filename, g_panimation[i]->startframe, pSourceAnim->startframe );
         for (j = 0; j < panim->numframes; j++) {
-            panim->sanim[j] = (s_bone_t *) calloc(1, size);
+            panim->sanim[j] = (s_bone_t *) MdlCalloc(1, size);
 
             ConvertAnimation(psource, panim->animationname, n + j, panim->scale, panim->adjust, panim->rotation,
                              panim->sanim[j]);
@@ -1719,11 +1721,9 @@ void buildAnimationWeights() {
 }
 
 void setAnimationWeight(s_animation_t *panim, int index) {
-    // copy weightlists to animations
-    for (int k = 0; k < g_StudioMdlContext.numbones; k++) {
-        panim->weight[k] = g_weightlist[index].weight[k];
-        panim->posweight[k] = g_weightlist[index].posweight[k];
-    }
+    // animations share their weightlist's weights until they change one
+    panim->weight.Share(g_weightlist[index].weight);
+    panim->posweight.Share(g_weightlist[index].posweight);
 }
 
 void addDeltas(s_animation_t *panim, int frame, float s, Vector delta_pos[], Quaternion delta_q[]) {
@@ -1968,7 +1968,7 @@ void localHierarchy(s_animation_t *panim, char *pBonename, char *pParentname, in
     if (pRule->end >= panim->numframes)
         pRule->localData.numerror = pRule->localData.numerror + 2;
 
-    pRule->localData.pError = (s_streamdata_t *) calloc(pRule->localData.numerror, sizeof(s_streamdata_t));
+    pRule->localData.pError = (s_streamdata_t *) MdlCalloc(pRule->localData.numerror, sizeof(s_streamdata_t));
 
     matrix3x4_t boneToWorld[MAXSTUDIOBONES];
     matrix3x4_t worldToBone;
@@ -2343,7 +2343,7 @@ static void ComputeVertexAnimationSpeed(s_flexkey_t &flexKey) {
 // Purpose: map the vertex animations to their equivalent vertex in the base animations
 //-----------------------------------------------------------------------------
 static void BuildVAnimFlags(s_source_t *pVSource, s_sourceanim_t *pVSourceAnim, int nCurrentFlexKey) {
-    pVSourceAnim->vanim_flag = (int *) calloc(pVSource->numvertices, sizeof(int));
+    pVSourceAnim->vanim_flag = (int *) MdlCalloc(pVSource->numvertices, sizeof(int));
     for (int n = nCurrentFlexKey; n < g_numflexkeys; n++) {
         // make sure it's the current flex file and that it's not frame 0 (happens with eyeball stuff).
         if (g_flexkey[n].source != pVSource)
@@ -2469,7 +2469,7 @@ BuildVAnimMap(s_source_t *pVSource, s_sourceanim_t *pVSourceAnim, s_loddata_t *p
 
     // count number of times each vanim vert connectes to a model vert
     int n = 0;
-    pVSourceAnim->vanim_mapcount = (int *) calloc(pVSource->numvertices, sizeof(int));
+    pVSourceAnim->vanim_mapcount = (int *) MdlCalloc(pVSource->numvertices, sizeof(int));
     for (int j = 0; j < pmLodSource->numvertices; j++) {
         if (pModelToVAnim[j] != -1) {
             pVSourceAnim->vanim_mapcount[pModelToVAnim[j]]++;
@@ -2477,8 +2477,8 @@ BuildVAnimMap(s_source_t *pVSource, s_sourceanim_t *pVSourceAnim, s_loddata_t *p
         }
     }
 
-    pVSourceAnim->vanim_map = (int **) calloc(pVSource->numvertices, sizeof(int *));
-    int *vmap = (int *) calloc(n, sizeof(int));
+    pVSourceAnim->vanim_map = (int **) MdlCalloc(pVSource->numvertices, sizeof(int *));
+    int *vmap = (int *) MdlCalloc(n, sizeof(int));
 
     // build mapping arrays
     for (int j = 0; j < pVSource->numvertices; j++) {
@@ -2518,7 +2518,7 @@ static void AllocateDestVAnim(s_flexkey_t &flexKey, s_sourceanim_t *pVSourceAnim
     }
 
     // allocate room to all possible resulting deltas
-    s_vertanim_t *pDestAnim = (s_vertanim_t *) calloc(nNumDestVAnims, sizeof(s_vertanim_t));
+    s_vertanim_t *pDestAnim = (s_vertanim_t *) MdlCalloc(nNumDestVAnims, sizeof(s_vertanim_t));
     flexKey.vanim = pDestAnim;
     flexKey.vanimtype = STUDIO_VERT_ANIM_NORMAL;    // default
 }
@@ -2761,7 +2761,7 @@ static void RemapVertexAnimationsNewVersion() {
         if (pVSourceAnim->vanim_flag)
             continue;
 
-        pVSourceAnim->vanim_flag = (int *) calloc(pVSource->numvertices, sizeof(int));
+        pVSourceAnim->vanim_flag = (int *) MdlCalloc(pVSource->numvertices, sizeof(int));
 
         // flag all the vertices that animate (builds the vanim_flag field of the source anim)
         int j;
@@ -6470,26 +6470,26 @@ static void ProcessIKRules() {
             if (panim->numikrules >= MAXSTUDIOIKRULES) {
                 MdlError("Too many IK rules in %s (%s)\n", panim->name, panim->filename);
             }
-            s_ikrule_t *pRule = &panim->ikrule[panim->numikrules++];
+            int iRule = panim->numikrules++;
 
             // make a copy of the rule;
-            *pRule = *panim->cmds[j].u.ikrule.pRule;
+            panim->ikrule[iRule] = *panim->cmds[j].u.ikrule.pRule;
 
             // -2 is a hack to tag the rule as 'auto-detect footsteps'
-            if (pRule->start == -2) {
+            if (panim->ikrule[iRule].start == -2) {
                 // use the end var to store the step index
-                if (pRule->end > 1) {
-                    for (k = 1; k < pRule->end; k++) {
-                        s_ikrule_t *pRuleSub = &panim->ikrule[panim->numikrules++];
+                int nSteps = panim->ikrule[iRule].end;
+                for (k = 1; k < nSteps; k++) {
+                    // adding rules can move the array, so don't hold pointers across this
+                    s_ikrule_t *pRuleSub = &panim->ikrule[panim->numikrules++];
 
-                        // make a copy of the rule;
-                        *pRuleSub = *panim->cmds[j].u.ikrule.pRule;
+                    // make a copy of the rule;
+                    *pRuleSub = *panim->cmds[j].u.ikrule.pRule;
 
-                        pRuleSub->peak = k;
-                    }
+                    pRuleSub->peak = k;
                 }
 
-                pRule->peak = 0;
+                panim->ikrule[iRule].peak = 0;
             }
 
         }
@@ -6756,7 +6756,7 @@ static void ProcessIKRules() {
             if (pRule->end >= panim->numframes)
                 pRule->errorData.numerror = pRule->errorData.numerror + 2;
 
-            pRule->errorData.pError = (s_streamdata_t *) calloc(pRule->errorData.numerror, sizeof(s_streamdata_t));
+            pRule->errorData.pError = (s_streamdata_t *) MdlCalloc(pRule->errorData.numerror, sizeof(s_streamdata_t));
 
             int n = 0;
 
@@ -7097,74 +7097,489 @@ static void ProcessIKRules() {
 }
 
 
+//-----------------------------------------------------------------------------
+// Channel-major copy of the processed animation frames
+//-----------------------------------------------------------------------------
+void s_animchannels_t::Build(const s_animation_t *panim, int nBones) {
+    m_nFrames = panim->numframes;
+    m_nStride = (m_nFrames + 3) & ~3;
+    m_Data.SetCount(nBones * NUM_CHANNELS * m_nStride);
+
+    for (int n = 0; n < m_nFrames; n++) {
+        const s_bone_t *pFrame = panim->sanim[n];
+        for (int j = 0; j < nBones; j++) {
+            float *pDest = m_Data.Base() + j * NUM_CHANNELS * m_nStride + n;
+            pDest[0 * m_nStride] = pFrame[j].pos[0];
+            pDest[1 * m_nStride] = pFrame[j].pos[1];
+            pDest[2 * m_nStride] = pFrame[j].pos[2];
+            pDest[3 * m_nStride] = pFrame[j].rot[0];
+            pDest[4 * m_nStride] = pFrame[j].rot[1];
+            pDest[5 * m_nStride] = pFrame[j].rot[2];
+        }
+    }
+
+    // repeat the last frame into the padding so it never changes a channel's range
+    for (int c = 0; m_nFrames > 0 && c < nBones * NUM_CHANNELS; c++) {
+        float *pChannel = m_Data.Base() + c * m_nStride;
+        for (int n = m_nFrames; n < m_nStride; n++) {
+            pChannel[n] = pChannel[m_nFrames - 1];
+        }
+    }
+}
+
+void s_animchannels_t::Purge() {
+    m_Data.Purge();
+    m_nFrames = 0;
+    m_nStride = 0;
+}
+
+
+//-----------------------------------------------------------------------------
+// Min and max of a padded channel, four frames at a time
+//-----------------------------------------------------------------------------
+static void FindChannelRange(const float *pChannel, int nPaddedFrames, float &flMin, float &flMax) {
+    fltx4 fl4Min = LoadUnalignedSIMD(pChannel);
+    fltx4 fl4Max = fl4Min;
+    for (int n = 4; n < nPaddedFrames; n += 4) {
+        fltx4 fl4Value = LoadUnalignedSIMD(pChannel + n);
+        fl4Min = MinSIMD(fl4Min, fl4Value);
+        fl4Max = MaxSIMD(fl4Max, fl4Value);
+    }
+    flMin = MIN(MIN(SubFloat(fl4Min, 0), SubFloat(fl4Min, 1)), MIN(SubFloat(fl4Min, 2), SubFloat(fl4Min, 3)));
+    flMax = MAX(MAX(SubFloat(fl4Max, 0), SubFloat(fl4Max, 1)), MAX(SubFloat(fl4Max, 2), SubFloat(fl4Max, 3)));
+}
+
+
+//-----------------------------------------------------------------------------
+// Run length encodes one channel of quantized values into data, which must
+// hold MAXSTUDIOANIMFRAMES entries. Returns the number of entries used.
+//-----------------------------------------------------------------------------
+static int EncodeAnimValues(const short *value, int n, mstudioanimvalue_t *data) {
+    mstudioanimvalue_t *pcount, *pvalue;
+    int m;
+
+    // initialize animation RLE block
+    memset(data, 0, MAXSTUDIOANIMFRAMES * sizeof(mstudioanimvalue_t));
+    pcount = data;
+    pvalue = pcount + 1;
+
+    pcount->num.valid = 1;
+    pcount->num.total = 1;
+    pvalue->value = value[0];
+    pvalue++;
+
+    // build a RLE of deltas from the default pose
+    for (m = 1; m < n; m++) {
+        if (pcount->num.total == 255) {
+            // chain too long, force a new entry
+            pcount = pvalue;
+            pvalue = pcount + 1;
+            pcount->num.valid++;
+            pvalue->value = value[m];
+            pvalue++;
+        }
+            // insert value if they're not equal, 
+            // or if we're not on a run and the run is less than 3 units
+        else if ((value[m] != value[m - 1])
+                 || ((pcount->num.total == pcount->num.valid) &&
+                     ((m < n - 1) && value[m] != value[m + 1]))) {
+            if (pcount->num.total != pcount->num.valid) {
+                pcount = pvalue;
+                pvalue = pcount + 1;
+            }
+            pcount->num.valid++;
+            pvalue->value = value[m];
+            pvalue++;
+        }
+        pcount->num.total++;
+    }
+    //if (j == 0) printf("%d:%d\n", pcount->num.valid, pcount->num.total );
+
+    return pvalue - data;
+}
+
+
+//-----------------------------------------------------------------------------
+// Replaces a channel with runs of constant values, each within nTolerance of
+// the values it replaces. Runs are grown greedily and hold the middle of their
+// range, so the RLE encoder can store them as repeats.
+//-----------------------------------------------------------------------------
+static void SnapAnimValues(short *value, int n, int nTolerance) {
+    int nStart = 0;
+    while (nStart < n) {
+        int nLow = value[nStart];
+        int nHigh = nLow;
+        int nEnd = nStart + 1;
+        while (nEnd < n) {
+            int nNewLow = MIN(nLow, (int) value[nEnd]);
+            int nNewHigh = MAX(nHigh, (int) value[nEnd]);
+            if (nNewHigh - nNewLow > 2 * nTolerance)
+                break;
+            nLow = nNewLow;
+            nHigh = nNewHigh;
+            nEnd++;
+        }
+
+        short nHold = (short) ((nLow + nHigh) / 2);
+        for (int m = nStart; m < nEnd; m++) {
+            value[m] = nHold;
+        }
+        nStart = nEnd;
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+// Compresses the frames [iStartFrame, iEndFrame] of every bone into section w.
+// Channels may move by up to the given tolerances to make the encoding smaller.
+// The exact quantized values are copied to pQuantized (bone, channel, frame)
+// when it's non-NULL. Returns the entries a lossless encoding would have used.
+//-----------------------------------------------------------------------------
+static int CompressAnimationSection(s_animation_t *panim, int w, int iStartFrame, int iEndFrame,
+                                    float flPosTolerance, float flRotTolerance, short *pQuantized) {
+    int j, k, n;
+    s_source_t *psource = panim->source;
+    int nExactValues = 0;
+
+    for (j = 0; j < g_StudioMdlContext.numbones; j++) {
+        for (k = 0; k < 6; k++) {
+            panim->anim[w][j].num[k] = 0;
+            panim->anim[w][j].data[k] = NULL;
+        }
+
+        // skip bones that are always procedural
+        if (g_bonetable[j].flags & BONE_ALWAYS_PROCEDURAL) {
+            // panim->weight[j] = 0.0;
+            continue;
+        }
+
+        // skip bones that have no influence
+        if (panim->weight[j] < 0.001)
+            continue;
+
+        int checkmin[6], checkmax[6];
+        for (k = 0; k < 6; k++) {
+            checkmin[k] = 32767;
+            checkmax[k] = -32768;
+        }
+
+        for (k = 0; k < 6; k++) {
+            float v;
+            short value[MAXSTUDIOANIMFRAMES];
+            mstudioanimvalue_t data[MAXSTUDIOANIMFRAMES];
+            const float *psrcdata = panim->channels.Channel(j, k) + iStartFrame;
+
+            // find deltas from default pose
+            for (n = 0; n <= iEndFrame - iStartFrame; n++) {
+                switch (k) {
+                    case 0: /* X Position */
+                    case 1: /* Y Position */
+                    case 2: /* Z Position */
+                        if (panim->flags & STUDIO_DELTA) {
+                            value[n] = psrcdata[n] / g_bonetable[j].posscale[k];
+                            // pre-scale pos delta since format only has room for "overall" weight
+                            float r = panim->posweight[j] / panim->weight[j];
+                            value[n] *= r;
+                        } else {
+                            value[n] = (psrcdata[n] - g_bonetable[j].pos[k]) / g_bonetable[j].posscale[k];
+                        }
+
+                        break;
+                    case 3: /* X Rotation */
+                    case 4: /* Y Rotation */
+                    case 5: /* Z Rotation */
+                        if (panim->flags & STUDIO_DELTA) {
+                            v = psrcdata[n];
+                        } else {
+                            v = (psrcdata[n] - g_bonetable[j].rot[k - 3]);
+                        }
+
+                        while (v >= M_PI)
+                            v -= M_PI * 2;
+                        while (v < -M_PI)
+                            v += M_PI * 2;
+
+                        value[n] = v / g_bonetable[j].rotscale[k - 3];
+                        break;
+                }
+                checkmin[k] = MIN(value[n], checkmin[k]);
+                checkmax[k] = MAX(value[n], checkmax[k]);
+            }
+            if (n == 0)
+                MdlError("no animation frames: \"%s\"\n", psource->filename);
+
+            // FIXME: this compression algorithm needs work
+            int nValues = EncodeAnimValues(value, n, data);
+            nExactValues += (nValues == 2 && value[0] == 0) ? 0 : nValues;
+
+            if (pQuantized) {
+                memcpy(pQuantized + (j * 6 + k) * n, value, n * sizeof(short));
+            }
+
+            // let the channel drift within the error bounds to get longer runs
+            float flTolerance = (k < 3) ? flPosTolerance / g_bonetable[j].posscale[k]
+                                        : flRotTolerance / g_bonetable[j].rotscale[k - 3];
+            if (flTolerance >= 1.0f) {
+                SnapAnimValues(value, n, (int) MIN(flTolerance, 32767.0f));
+                nValues = EncodeAnimValues(value, n, data);
+            }
+
+            panim->anim[w][j].num[k] = nValues;
+            if (panim->anim[w][j].num[k] == 2 && value[0] == 0) {
+                panim->anim[w][j].num[k] = 0;
+            } else {
+                panim->anim[w][j].data[k] = (mstudioanimvalue_t *) MdlCalloc(nValues, sizeof(mstudioanimvalue_t));
+                memmove(panim->anim[w][j].data[k], data, nValues * sizeof(mstudioanimvalue_t));
+            }
+            // printf("%d(%d) ", g_source[i]->panim[q]->numanim[j][k], n );
+        }
+
+        if (g_StudioMdlContext.checkLengths) {
+            char *tmp[6] = {"X", "Y", "Z", "XR", "YR", "ZR"};
+            n = 0;
+            float s = 0.0f;
+            for (k = 0; k < 6; k++) {
+                if (panim->anim[w][j].num[k]) {
+                    if (n == 0)
+                        printf("%30s :", g_bonetable[j].name);
+
+                    // printf("%2s (%8.3f: %8.3f %8.3f) ", tmp[k], g_bonetable[j].pos[k], checkmin[k], checkmax[k] );
+                    if (k < 3)
+                        s = g_bonetable[j].posscale[k];
+                    else
+                        s = g_bonetable[j].rotscale[k - 3];
+
+                    // printf("%2s %8.5f (%d %d)  ", tmp[k], checkmax[k] - checkmin[k] );
+                    printf("%2s %8.5f  ", tmp[k], (checkmax[k] - checkmin[k]) * s);
+                    n = 1;
+                }
+            }
+            if (n)
+                printf("\n");
+        }
+    }
+
+    return nExactValues;
+}
+
+
+static void FreeAnimationSection(s_animation_t *panim, int w) {
+    for (int j = 0; j < g_StudioMdlContext.numbones; j++) {
+        for (int k = 0; k < 6; k++) {
+            MemAlloc_Free(panim->anim[w][j].data[k]);
+            panim->anim[w][j].data[k] = NULL;
+            panim->anim[w][j].num[k] = 0;
+        }
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+// Decodes section w with the runtime ExtractAnimValue path and measures how far
+// each bone ends up in world space from where the exact quantized values
+// (see CompressAnimationSection) put it
+//-----------------------------------------------------------------------------
+static void MeasureSectionError(s_animation_t *panim, int w, int nFrames, const short *pQuantized,
+                                float &flPosError, float &flAngError) {
+    int nBones = g_StudioMdlContext.numbones;
+    CUtlVector<float> decoded;
+    decoded.SetCount(nBones * 6 * nFrames);
+
+    double flStartTime = Plat_FloatTime();
+    for (int j = 0; j < nBones; j++) {
+        for (int k = 0; k < 6; k++) {
+            float flScale = (k < 3) ? g_bonetable[j].posscale[k] : g_bonetable[j].rotscale[k - 3];
+            float *pDecoded = &decoded[(j * 6 + k) * nFrames];
+            for (int n = 0; n < nFrames; n++) {
+                ExtractAnimValue(n, panim->anim[w][j].data[k], flScale, pDecoded[n]);
+            }
+        }
+    }
+    panim->decodetime += Plat_FloatTime() - flStartTime;
+
+    CUtlVector<matrix3x4_t> exactToWorld, decodedToWorld;
+    exactToWorld.SetCount(nBones);
+    decodedToWorld.SetCount(nBones);
+
+    flPosError = 0.0f;
+    flAngError = 0.0f;
+    for (int n = 0; n < nFrames; n++) {
+        for (int j = 0; j < nBones; j++) {
+            // delta animations are measured as if applied to the bind pose
+            Vector exactPos = g_bonetable[j].pos;
+            Vector decodedPos = g_bonetable[j].pos;
+            RadianEuler exactRot = g_bonetable[j].rot;
+            RadianEuler decodedRot = g_bonetable[j].rot;
+            for (int k = 0; k < 3; k++) {
+                exactPos[k] += pQuantized[(j * 6 + k) * nFrames + n] * g_bonetable[j].posscale[k];
+                decodedPos[k] += decoded[(j * 6 + k) * nFrames + n];
+                exactRot[k] += pQuantized[(j * 6 + k + 3) * nFrames + n] * g_bonetable[j].rotscale[k];
+                decodedRot[k] += decoded[(j * 6 + k + 3) * nFrames + n];
+            }
+
+            matrix3x4_t exactLocal, decodedLocal;
+            AngleMatrix(exactRot, exactPos, exactLocal);
+            AngleMatrix(decodedRot, decodedPos, decodedLocal);
+
+            int nParent = g_bonetable[j].parent;
+            Assert(nParent < j);
+            if (nParent >= 0) {
+                ConcatTransforms(exactToWorld[nParent], exactLocal, exactToWorld[j]);
+                ConcatTransforms(decodedToWorld[nParent], decodedLocal, decodedToWorld[j]);
+            } else {
+                exactToWorld[j] = exactLocal;
+                decodedToWorld[j] = decodedLocal;
+            }
+
+            Vector exactOrigin, decodedOrigin;
+            MatrixPosition(exactToWorld[j], exactOrigin);
+            MatrixPosition(decodedToWorld[j], decodedOrigin);
+            flPosError = MAX(flPosError, exactOrigin.DistTo(decodedOrigin));
+
+            Quaternion exactQ, decodedQ;
+            MatrixQuaternion(exactToWorld[j], exactQ);
+            MatrixQuaternion(decodedToWorld[j], decodedQ);
+            flAngError = MAX(flAngError, QuaternionAngleDiff(exactQ, decodedQ));
+        }
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+// Size, error and decode time of the compressed animations, per sequence
+//-----------------------------------------------------------------------------
+static void ReportAnimationCompression() {
+    printf("animation compression (pos error %.4f, rot error %.3f deg):\n",
+           g_StudioMdlContext.animPosError, g_StudioMdlContext.animAngError);
+
+    int nTotalBytes = 0;
+    int nTotalExactBytes = 0;
+    for (int i = 0; i < g_sequence.Count(); i++) {
+        const s_sequence_t &seq = g_sequence[i];
+        int nFrames = 0;
+        int nBytes = 0;
+        int nExactBytes = 0;
+        float flPosError = 0.0f;
+        float flAngError = 0.0f;
+        double flDecodeTime = 0.0;
+        for (int j = 0; j < seq.groupsize[0]; j++) {
+            for (int k = 0; k < seq.groupsize[1]; k++) {
+                const s_animation_t *panim = seq.panim[j][k];
+                nFrames += panim->numframes;
+                nBytes += panim->numanimvalues * sizeof(mstudioanimvalue_t);
+                nExactBytes += panim->numexactvalues * sizeof(mstudioanimvalue_t);
+                flPosError = MAX(flPosError, panim->maxposerror);
+                flAngError = MAX(flAngError, panim->maxangerror);
+                flDecodeTime += panim->decodetime;
+            }
+        }
+        printf("%30s : %5d frames %8d bytes (%8d lossless) error %.4f %.3f deg, decode %.3f ms\n",
+               seq.name, nFrames, nBytes, nExactBytes, flPosError, flAngError, flDecodeTime * 1000.0);
+        nTotalBytes += nBytes;
+        nTotalExactBytes += nExactBytes;
+    }
+    printf("%30s : %8d bytes (%8d lossless)\n", "total", nTotalBytes, nTotalExactBytes);
+}
+
+
 //-----------------------------------------------------------------------------
 // CompressAnimations
 //-----------------------------------------------------------------------------
 
 static void CompressAnimations() {
-    int i, j, k, n, m;
+    int i, j, k, n;
 
 
     // !!!
     //g_minSectionFrameLimit = 100000;
     //g_animblocksize = 0;
 
-
-    // find scales for all bones
+    // find the range of every bone channel across all animations, one animation's
+    // channels at a time so only one copy of the frames is alive alongside sanim
+    int nRanges = g_StudioMdlContext.numbones * 6;
+    CUtlVector<float> rangeMin, rangeMax, totalMin, totalMax, rangeBase;
+    rangeMin.SetCount(nRanges);
+    rangeMax.SetCount(nRanges);
+    totalMin.SetCount(nRanges);
+    totalMax.SetCount(nRanges);
+    rangeBase.SetCount(nRanges);
     for (j = 0; j < g_StudioMdlContext.numbones; j++) {
-        // printf("%s : ", g_bonetable[j].name );
         for (k = 0; k < 6; k++) {
-            float minv, maxv, scale;
-            float total_minv, total_maxv;
-
+            int r = j * 6 + k;
             if (k < 3) {
-                minv = -128.0;
-                maxv = 128.0;
-                total_maxv = total_minv = g_bonetable[j].pos[k];
+                rangeMin[r] = -128.0;
+                rangeMax[r] = 128.0;
+                rangeBase[r] = g_bonetable[j].pos[k];
             } else {
-                minv = -M_PI / 8.0;
-                maxv = M_PI / 8.0;
-                total_maxv = total_minv = g_bonetable[j].rot[k - 3];
+                rangeMin[r] = -M_PI / 8.0;
+                rangeMax[r] = M_PI / 8.0;
+                rangeBase[r] = g_bonetable[j].rot[k - 3];
             }
+            totalMin[r] = totalMax[r] = rangeBase[r];
+        }
+    }
 
-            for (i = 0; i < g_numani; i++) {
-                for (n = 0; n < g_panimation[i]->numframes; n++) {
-                    float v = 0.0f;
-                    switch (k) {
-                        case 0:
-                        case 1:
-                        case 2:
-                            if (g_panimation[i]->flags & STUDIO_DELTA) {
-                                v = g_panimation[i]->sanim[n][j].pos[k];
-                            } else {
-                                v = (g_panimation[i]->sanim[n][j].pos[k] - g_bonetable[j].pos[k]);
+    for (i = 0; i < g_numani; i++) {
+        s_animchannels_t &channels = g_panimation[i]->channels;
+        channels.Build(g_panimation[i], g_StudioMdlContext.numbones);
+        if (channels.FrameCount() == 0)
+            continue;
 
-                                if (g_panimation[i]->sanim[n][j].pos[k] < total_minv)
-                                    total_minv = g_panimation[i]->sanim[n][j].pos[k];
-                                if (g_panimation[i]->sanim[n][j].pos[k] > total_maxv)
-                                    total_maxv = g_panimation[i]->sanim[n][j].pos[k];
-                            }
-                            break;
-                        case 3:
-                        case 4:
-                        case 5:
-                            if (g_panimation[i]->flags & STUDIO_DELTA) {
-                                v = g_panimation[i]->sanim[n][j].rot[k - 3];
-                            } else {
-                                v = (g_panimation[i]->sanim[n][j].rot[k - 3] - g_bonetable[j].rot[k - 3]);
-                            }
-                            while (v >= M_PI)
-                                v -= M_PI * 2;
-                            while (v < -M_PI)
-                                v += M_PI * 2;
-                            break;
+        bool bDelta = (g_panimation[i]->flags & STUDIO_DELTA) != 0;
+        for (j = 0; j < g_StudioMdlContext.numbones; j++) {
+            for (k = 0; k < 6; k++) {
+                int r = j * 6 + k;
+                float base = rangeBase[r];
+
+                const float *pChannel = channels.Channel(j, k);
+                float flLow, flHigh;
+                FindChannelRange(pChannel, channels.PaddedFrameCount(), flLow, flHigh);
+
+                if (k < 3 && !bDelta) {
+                    totalMin[r] = MIN(totalMin[r], flLow);
+                    totalMax[r] = MAX(totalMax[r], flHigh);
+                }
+
+                // subtraction is monotonic, so the range of the deltas is the delta of the range
+                if (!bDelta) {
+                    flLow -= base;
+                    flHigh -= base;
+                }
+
+                if (k >= 3 && (flLow < -M_PI || flHigh >= M_PI)) {
+                    // some frames need wrapping, which doesn't preserve order
+                    flLow = FLT_MAX;
+                    flHigh = -FLT_MAX;
+                    for (n = 0; n < channels.FrameCount(); n++) {
+                        float v = bDelta ? pChannel[n] : pChannel[n] - base;
+                        while (v >= M_PI)
+                            v -= M_PI * 2;
+                        while (v < -M_PI)
+                            v += M_PI * 2;
+                        flLow = MIN(flLow, v);
+                        flHigh = MAX(flHigh, v);
                     }
-                    if (v < minv)
-                        minv = v;
-                    if (v > maxv)
-                        maxv = v;
                 }
+
+                if (flLow < rangeMin[r])
+                    rangeMin[r] = flLow;
+                if (flHigh > rangeMax[r])
+                    rangeMax[r] = flHigh;
             }
+        }
+
+        channels.Purge();
+    }
+
+    // find scales for all bones
+    for (j = 0; j < g_StudioMdlContext.numbones; j++) {
+        // printf("%s : ", g_bonetable[j].name );
+        for (k = 0; k < 6; k++) {
+            int r = j * 6 + k;
+            float minv = rangeMin[r];
+            float maxv = rangeMax[r];
+            float scale;
+
             if (minv < maxv) {
                 if (-minv > maxv) {
                     scale = minv / -32768.0;
@@ -7179,7 +7594,7 @@ static void CompressAnimations() {
                 case 1:
                 case 2:
                     g_bonetable[j].posscale[k] = scale;
-                    g_bonetable[j].posrange[k] = total_maxv - total_minv;
+                    g_bonetable[j].posrange[k] = totalMax[r] - totalMin[r];
                     break;
                 case 3:
                 case 4:
@@ -7196,14 +7611,18 @@ static void CompressAnimations() {
 
 
     // reduce animations
+    bool bLossy = g_StudioMdlContext.animPosError > 0.0f || g_StudioMdlContext.animAngError > 0.0f;
+    bool bVerify = bLossy || g_StudioMdlContext.checkLengths;
+    CUtlVector<short> quantized;
     for (i = 0; i < g_numani; i++) {
         s_animation_t *panim = g_panimation[i];
-        s_source_t *psource = panim->source;
 
         if (g_StudioMdlContext.checkLengths) {
             printf("%s\n", panim->name);
         }
 
+        panim->channels.Build(panim, g_StudioMdlContext.numbones);
+
         // setup animation interior sections
         int iSectionFrames = panim->numframes;
         if (panim->numframes >= g_StudioMdlContext.minSectionFrameLimit) {
@@ -7224,147 +7643,45 @@ static void CompressAnimations() {
 
             // printf("%s : %d %d\n", panim->name, iStartFrame, iEndFrame );
 
-            for (j = 0; j < g_StudioMdlContext.numbones; j++) {
-                for (k = 0; k < 6; k++) {
-                    panim->anim[w][j].num[k] = 0;
-                    panim->anim[w][j].data[k] = NULL;
-                }
-
-                // skip bones that are always procedural
-                if (g_bonetable[j].flags & BONE_ALWAYS_PROCEDURAL) {
-                    // panim->weight[j] = 0.0;
-                    continue;
-                }
-
-                // skip bones that have no influence
-                if (panim->weight[j] < 0.001)
-                    continue;
-
-                int checkmin[6], checkmax[6];
-                for (k = 0; k < 6; k++) {
-                    checkmin[k] = 32767;
-                    checkmax[k] = -32768;
-                }
-
-                for (k = 0; k < 6; k++) {
-                    mstudioanimvalue_t *pcount, *pvalue;
-                    float v;
-                    short value[MAXSTUDIOANIMFRAMES];
-                    mstudioanimvalue_t data[MAXSTUDIOANIMFRAMES];
-
-                    // find deltas from default pose
-                    for (n = 0; n <= iEndFrame - iStartFrame; n++) {
-                        s_bone_t *psrcdata = &panim->sanim[n + iStartFrame][j];
-                        switch (k) {
-                            case 0: /* X Position */
-                            case 1: /* Y Position */
-                            case 2: /* Z Position */
-                                if (panim->flags & STUDIO_DELTA) {
-                                    value[n] = psrcdata->pos[k] / g_bonetable[j].posscale[k];
-                                    // pre-scale pos delta since format only has room for "overall" weight
-                                    float r = panim->posweight[j] / panim->weight[j];
-                                    value[n] *= r;
-                                } else {
-                                    value[n] = (psrcdata->pos[k] - g_bonetable[j].pos[k]) / g_bonetable[j].posscale[k];
-                                }
-
-                                break;
-                            case 3: /* X Rotation */
-                            case 4: /* Y Rotation */
-                            case 5: /* Z Rotation */
-                                if (panim->flags & STUDIO_DELTA) {
-                                    v = psrcdata->rot[k - 3];
-                                } else {
-                                    v = (psrcdata->rot[k - 3] - g_bonetable[j].rot[k - 3]);
-                                }
-
-                                while (v >= M_PI)
-                                    v -= M_PI * 2;
-                                while (v < -M_PI)
-                                    v += M_PI * 2;
-
-                                value[n] = v / g_bonetable[j].rotscale[k - 3];
-                                break;
-                        }
-                        checkmin[k] = MIN(value[n], checkmin[k]);
-                        checkmax[k] = MAX(value[n], checkmax[k]);
-                    }
-                    if (n == 0)
-                        MdlError("no animation frames: \"%s\"\n", psource->filename);
-
-                    // FIXME: this compression algorithm needs work
-
-                    // initialize animation RLE block
-                    memset(data, 0, sizeof(data));
-                    pcount = data;
-                    pvalue = pcount + 1;
-
-                    pcount->num.valid = 1;
-                    pcount->num.total = 1;
-                    pvalue->value = value[0];
-                    pvalue++;
-
-                    // build a RLE of deltas from the default pose
-                    for (m = 1; m < n; m++) {
-                        if (pcount->num.total == 255) {
-                            // chain too long, force a new entry
-                            pcount = pvalue;
-                            pvalue = pcount + 1;
-                            pcount->num.valid++;
-                            pvalue->value = value[m];
-                            pvalue++;
-                        }
-                            // insert value if they're not equal, 
-                            // or if we're not on a run and the run is less than 3 units
-                        else if ((value[m] != value[m - 1])
-                                 || ((pcount->num.total == pcount->num.valid) &&
-                                     ((m < n - 1) && value[m] != value[m + 1]))) {
-                            if (pcount->num.total != pcount->num.valid) {
-                                //if (j == 0) printf("%d:%d   ", pcount->num.valid, pcount->num.total ); 
-                                pcount = pvalue;
-                                pvalue = pcount + 1;
-                            }
-                            pcount->num.valid++;
-                            pvalue->value = value[m];
-                            pvalue++;
-                        }
-                        pcount->num.total++;
+            int nSectionFrames = iEndFrame - iStartFrame + 1;
+            if (!bVerify) {
+                panim->numexactvalues += CompressAnimationSection(panim, w, iStartFrame, iEndFrame, 0.0f, 0.0f, NULL);
+            } else {
+                quantized.SetCount(g_StudioMdlContext.numbones * 6 * nSectionFrames);
+                memset(quantized.Base(), 0, quantized.Count() * sizeof(short));
+
+                // tighten the tolerances until the decoded bones stay within the error bounds,
+                // falling back to the lossless encoding
+                float flPosTolerance = g_StudioMdlContext.animPosError;
+                float flRotTolerance = DEG2RAD(g_StudioMdlContext.animAngError);
+                for (int nAttempt = 0;; nAttempt++) {
+                    int nExactValues = CompressAnimationSection(panim, w, iStartFrame, iEndFrame,
+                                                                flPosTolerance, flRotTolerance, quantized.Base());
+                    float flPosError, flAngError;
+                    MeasureSectionError(panim, w, nSectionFrames, quantized.Base(), flPosError, flAngError);
+
+                    bool bPosOk = g_StudioMdlContext.animPosError == 0.0f || flPosError <= g_StudioMdlContext.animPosError;
+                    bool bAngOk = g_StudioMdlContext.animAngError == 0.0f || flAngError <= g_StudioMdlContext.animAngError;
+                    if ((bPosOk && bAngOk) || (flPosTolerance == 0.0f && flRotTolerance == 0.0f)) {
+                        panim->numexactvalues += nExactValues;
+                        panim->maxposerror = MAX(panim->maxposerror, flPosError);
+                        panim->maxangerror = MAX(panim->maxangerror, flAngError);
+                        break;
                     }
-                    //if (j == 0) printf("%d:%d\n", pcount->num.valid, pcount->num.total ); 
 
-                    panim->anim[w][j].num[k] = pvalue - data;
-                    if (panim->anim[w][j].num[k] == 2 && value[0] == 0) {
-                        panim->anim[w][j].num[k] = 0;
+                    FreeAnimationSection(panim, w);
+                    if (nAttempt < 3) {
+                        flPosTolerance *= 0.5f;
+                        flRotTolerance *= 0.5f;
                     } else {
-                        panim->anim[w][j].data[k] = (mstudioanimvalue_t *) calloc(pvalue - data,
-                                                                                  sizeof(mstudioanimvalue_t));
-                        memmove(panim->anim[w][j].data[k], data, (pvalue - data) * sizeof(mstudioanimvalue_t));
+                        flPosTolerance = flRotTolerance = 0.0f;
                     }
-                    // printf("%d(%d) ", g_source[i]->panim[q]->numanim[j][k], n );
                 }
+            }
 
-                if (g_StudioMdlContext.checkLengths) {
-                    char *tmp[6] = {"X", "Y", "Z", "XR", "YR", "ZR"};
-                    n = 0;
-                    float s = 0.0f;
-                    for (k = 0; k < 6; k++) {
-                        if (panim->anim[w][j].num[k]) {
-                            if (n == 0)
-                                printf("%30s :", g_bonetable[j].name);
-
-                            // printf("%2s (%8.3f: %8.3f %8.3f) ", tmp[k], g_bonetable[j].pos[k], checkmin[k], checkmax[k] );
-                            if (k < 3)
-                                s = g_bonetable[j].posscale[k];
-                            else
-                                s = g_bonetable[j].rotscale[k - 3];
-
-                            // printf("%2s %8.5f (%d %d)  ", tmp[k], checkmax[k] - checkmin[k] );
-                            printf("%2s %8.5f  ", tmp[k], (checkmax[k] - checkmin[k]) * s);
-                            n = 1;
-                        }
-                    }
-                    if (n)
-                        printf("\n");
+            for (j = 0; j < g_StudioMdlContext.numbones; j++) {
+                for (k = 0; k < 6; k++) {
+                    panim->numanimvalues += panim->anim[w][j].num[k];
                 }
             }
         }
@@ -7372,6 +7689,12 @@ static void CompressAnimations() {
         if (panim->numsections == 1) {
             panim->sectionframes = 0;
         }
+
+        panim->channels.Purge();
+    }
+
+    if (bVerify && !g_StudioMdlContext.quiet) {
+        ReportAnimationCompression();
     }
 }
 
@@ -7502,7 +7825,7 @@ static void CompressSingle(s_animationstream_t *pStream) {
         //if (j == 0) printf("%d:%d\n", pcount->num.valid, pcount->num.total ); 
 
         pStream->numanim[k] = pvalue - data;
-        pStream->anim[k] = (mstudioanimvalue_t *) calloc(pvalue - data, sizeof(mstudioanimvalue_t));
+        pStream->anim[k] = (mstudioanimvalue_t *) MdlCalloc(pvalue - data, sizeof(mstudioanimvalue_t));
         memmove(pStream->anim[k], data, (pvalue - data) * sizeof(mstudioanimvalue_t));
         // printf("%d (%d) : %d\n", pRule->numanim[k], n, pRule->errorData.numerror );
     }
@@ -8058,15 +8381,54 @@ void SetIlluminationPosition() {
     }
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: -memstats reporting. Each call closes the stage opened by the
+//			previous one and prints what it allocated; NULL just closes it.
+//			Counts everything allocated through the tier0 allocator on any
+//			thread: CUtl containers, datamodel, strings and the MdlCalloc'd
+//			source, mesh and animation data. Plain malloc/calloc (write.cpp's
+//			output buffers, loader scratch) is not seen.
+//-----------------------------------------------------------------------------
+static const char *s_pMemStatsStage = NULL;
+
+static void PrintMemStats(const char *pName, const MemAllocScopeStats_t &stats) {
+    printf("  %-24s %10.1f KB allocated %8u allocs %8u frees %+10.1f KB net %10.1f KB peak\n",
+           pName, stats.m_nBytesAllocated / 1024.0, stats.m_nAllocs, stats.m_nFrees,
+           stats.m_nNetBytes / 1024.0, stats.m_nPeakBytes / 1024.0);
+}
+
+static void SimplifyMemStatsStage(const char *pStageName) {
+    if (!g_StudioMdlContext.memStats)
+        return;
+
+    if (s_pMemStatsStage) {
+        MemAllocScopeStats_t stats;
+        MemAlloc_EndStatsScope(&stats);
+        PrintMemStats(s_pMemStatsStage, stats);
+    }
+
+    s_pMemStatsStage = pStageName;
+    if (s_pMemStatsStage) {
+        MemAlloc_BeginStatsScope();
+    }
+}
+
 void SimplifyModel() {
     if (g_sequence.Count() == 0 && g_numincludemodels == 0) {
         MdlError("model has no sequences\n");
     }
 
+    if (g_StudioMdlContext.memStats) {
+        printf("Memory allocated while processing the model (tier0 allocations on all threads):\n");
+        MemAlloc_BeginStatsScope();
+    }
+
     // have to load the lod sources before remapping bones so that the remap
     // happens for all LODs.
+    SimplifyMemStatsStage("LoadLODSources");
     LoadLODSources();
 
+    SimplifyMemStatsStage("RemapBones");
     RemapBones();
 
     LinkIKChains();
@@ -8093,6 +8455,7 @@ void SimplifyModel() {
     // replacebone "bone2" "bone3"
     FixupReplacedBones();
 
+    SimplifyMemStatsStage("RemapVertices");
     RemapVerticesToGlobalBones();
 
     if (g_StudioMdlContext.centerBonesOnVerts) {
@@ -8101,6 +8464,7 @@ void SimplifyModel() {
 
     // remap lods to root, building aggregate final pools
     // mark bones used by an lod
+    SimplifyMemStatsStage("UnifyLODs");
     UnifyLODs();
 
     if (g_StudioMdlContext.printBones) {
@@ -8115,8 +8479,10 @@ void SimplifyModel() {
     }
     SpewBoneUsageStats();
 
+    SimplifyMemStatsStage("RemapAnimations");
     RemapAnimations();
 
+    SimplifyMemStatsStage("processAnimations");
     processAnimations();
 
     limitBoneRotations();
@@ -8125,10 +8491,13 @@ void SimplifyModel() {
 
     RemapProceduralBones();
 
+    SimplifyMemStatsStage("MakeTransitions");
     MakeTransitions();
+    SimplifyMemStatsStage("RemapVertexAnimations");
     RemapVertexAnimations();
     RemapVertexAnimationsNewVersion();
 
+    SimplifyMemStatsStage("LinkBones");
     FindAutolayers();
 
     // link bonecontrollers
@@ -8151,12 +8520,14 @@ void SimplifyModel() {
 
     LockBoneLengths();
 
+    SimplifyMemStatsStage("ProcessIKRules");
     ProcessIKRules();
 
     CompressIKErrors();
 
     CompressLocalHierarchy();
 
+    SimplifyMemStatsStage("CalcPoseParameters");
     CalcPoseParameters();
 
     ReLinkAttachments();
@@ -8165,12 +8536,21 @@ void SimplifyModel() {
 
     SetupHitBoxes();
 
+    SimplifyMemStatsStage("CompressAnimations");
     CompressAnimations();
 
+    SimplifyMemStatsStage("CalcSequenceBounds");
     CalcSequenceBoundingBoxes();
 
     SetIlluminationPosition();
 
+    SimplifyMemStatsStage(NULL);
+    if (g_StudioMdlContext.memStats) {
+        MemAllocScopeStats_t stats;
+        MemAlloc_EndStatsScope(&stats);
+        PrintMemStats("total", stats);
+    }
+
     if (g_StudioMdlContext.buildPreview) {
         gflags |= STUDIOHDR_FLAGS_BUILT_IN_PREVIEW_MODE;
     }
@@ -45,6 +45,7 @@
 
 #include "studiomdl_commands.h"
 #include "studiomdl_errors.h"
+#include "studiomdl/manifest.h"
 
 
 #ifdef WIN32
@@ -90,11 +91,18 @@ float verify_atof(const char *token) {
     return atof(token);
 }
 
+//-----------------------------------------------------------------------------
+// Read the next line of global input into common string
+//-----------------------------------------------------------------------------
+bool ReadLineInput() {
+    return g_StudioMdlContext.lineInput.ReadLine(g_StudioMdlContext.szLine, sizeof(g_StudioMdlContext.szLine));
+}
+
 //-----------------------------------------------------------------------------
 // Read global input into common string
 //-----------------------------------------------------------------------------
 bool GetLineInput() {
-    while (fgets(g_StudioMdlContext.szLine, sizeof(g_StudioMdlContext.szLine), g_StudioMdlContext.fpInput) != NULL) {
+    while (ReadLineInput()) {
         g_StudioMdlContext.iLinecount++;
         // skip comments
         if (g_StudioMdlContext.szLine[0] == '/' && g_StudioMdlContext.szLine[1] == '/')
@@ -504,13 +512,13 @@ void CClampedSource::AddAnimations(const s_source_t *pOrigSource) {
 void CClampedSource::Copy(s_source_t *pNewSource) {
     // copy over new meshes
     pNewSource->numfaces = m_face.Count();
-    pNewSource->face = (s_face_t *) calloc(pNewSource->numfaces, sizeof(s_face_t));
+    pNewSource->face = (s_face_t *) MdlCalloc(pNewSource->numfaces, sizeof(s_face_t));
     for (int i = 0; i < pNewSource->numfaces; i++) {
         pNewSource->face[i] = m_face[i];
     }
 
     pNewSource->numvertices = m_vertex.Count();
-    pNewSource->vertex = (s_vertexinfo_t *) calloc(pNewSource->numvertices, sizeof(s_vertexinfo_t));
+    pNewSource->vertex = (s_vertexinfo_t *) MdlCalloc(pNewSource->numvertices, sizeof(s_vertexinfo_t));
     for (int i = 0; i < pNewSource->numvertices; i++) {
         pNewSource->vertex[i] = m_vertex[i];
     }
@@ -605,6 +613,7 @@ void PostProcessSource(s_source_t *pSource, int imodel) {
 void Grab_Animation(s_source_t *pSource, const char *pAnimName) {
     Vector pos;
     RadianEuler rot;
+    float values[6];
     char cmd[1024];
     int index;
     int t = -99999999;
@@ -616,8 +625,16 @@ void Grab_Animation(s_source_t *pSource, const char *pAnimName) {
     size = pSource->numbones * sizeof(s_bone_t);
 
     while (GetLineInput()) {
-        if (sscanf(g_StudioMdlContext.szLine, "%d %f %f %f %f %f %f", &index, &pos[0], &pos[1], &pos[2], &rot[0], &rot[1], &rot[2]) ==
-            7) {
+        bool bParsed = FastScanIntAndFloats(g_StudioMdlContext.szLine, index, values, 6);
+        if (bParsed) {
+            pos.Init(values[0], values[1], values[2]);
+            rot.Init(values[3], values[4], values[5]);
+        } else {
+            bParsed = sscanf(g_StudioMdlContext.szLine, "%d %f %f %f %f %f %f", &index, &pos[0], &pos[1], &pos[2], &rot[0],
+                             &rot[1], &rot[2]) == 7;
+        }
+
+        if (bParsed) {
             if (pAnim->startframe < 0) {
                 MdlError("Missing frame start(%d) : %s", g_StudioMdlContext.iLinecount, g_StudioMdlContext.szLine);
             }
@@ -657,7 +674,7 @@ void Grab_Animation(s_source_t *pSource, const char *pAnimName) {
                 continue;
             }
 
-            pAnim->rawanim[t] = (s_bone_t *) calloc(1, size);
+            pAnim->rawanim[t] = (s_bone_t *) MdlCalloc(1, size);
 
             // duplicate previous frames keys
             if (t > 0 && pAnim->rawanim[t - 1]) {
@@ -811,8 +828,8 @@ void AddSrcToSrc(s_source_t *pOrigSource, s_source_t *pAppendSource, matrix3x4_t
         }
     }
 
-    free(pOrigSource->face);
-    free(pOrigSource->vertex);
+    MemAlloc_Free(pOrigSource->face);
+    MemAlloc_Free(pOrigSource->vertex);
     newSource.Copy(pOrigSource);
 }
 
@@ -860,7 +877,7 @@ s_source_t *Load_Source(const char *name, const char *ext, bool reverse, bool is
     // NOTE: The load proc can potentially add other sources (for the MPP format)
     // So we have to deal with setting everything up in this source prior to
     // calling the load func, and we cannot reference g_source anywhere below
-    pSource = (s_source_t *) calloc(1, sizeof(s_source_t));
+    pSource = (s_source_t *) MdlCalloc(1, sizeof(s_source_t));
     g_source[g_numsources++] = pSource;
     if (isActiveModel) {
         pSource->isActiveModel = true;
@@ -1299,6 +1316,7 @@ void Grab_Vertexanimation(s_source_t *psource, const char *pAnimName) {
     int index;
     Vector pos;
     Vector normal;
+    float values[6];
     int t = -1;
     int count = 0;
     static s_vertanim_t tmpvanim[MAXSTUDIOVERTS * 4];
@@ -1309,8 +1327,16 @@ void Grab_Vertexanimation(s_source_t *psource, const char *pAnimName) {
     }
 
     while (GetLineInput()) {
-        if (sscanf(g_StudioMdlContext.szLine, "%d %f %f %f %f %f %f", &index, &pos[0], &pos[1], &pos[2], &normal[0], &normal[1],
-                   &normal[2]) == 7) {
+        bool bParsed = FastScanIntAndFloats(g_StudioMdlContext.szLine, index, values, 6);
+        if (bParsed) {
+            pos.Init(values[0], values[1], values[2]);
+            normal.Init(values[3], values[4], values[5]);
+        } else {
+            bParsed = sscanf(g_StudioMdlContext.szLine, "%d %f %f %f %f %f %f", &index, &pos[0], &pos[1], &pos[2], &normal[0],
+                             &normal[1], &normal[2]) == 7;
+        }
+
+        if (bParsed) {
             if (pAnim->startframe < 0) {
                 MdlError("Missing frame start(%d) : %s", g_StudioMdlContext.iLinecount, g_StudioMdlContext.szLine);
             }
@@ -1333,7 +1359,7 @@ void Grab_Vertexanimation(s_source_t *psource, const char *pAnimName) {
             if (count) {
                 pAnim->numvanims[t] = count;
 
-                pAnim->vanim[t] = (s_vertanim_t *) calloc(count, sizeof(s_vertanim_t));
+                pAnim->vanim[t] = (s_vertanim_t *) MdlCalloc(count, sizeof(s_vertanim_t));
 
                 memcpy(pAnim->vanim[t], tmpvanim, count * sizeof(s_vertanim_t));
             } else if (t > 0) {
@@ -1386,6 +1412,7 @@ bool GetGlobalFilePath(const char *pSrc, char *pFullPath, int nMaxLen) {
             int rt = _stat(tmp, &buf);
             if (rt != -1 && (buf.st_size > 0) && ((buf.st_mode & _S_IFDIR) == 0)) {
                 Q_strncpy(pFullPath, tmp, nMaxLen);
+                Manifest_AddInput(pFullPath);
                 return true;
             }
         }
@@ -1396,6 +1423,7 @@ bool GetGlobalFilePath(const char *pSrc, char *pFullPath, int nMaxLen) {
     int rt = _stat(pFileName, &buf);
     if (rt != -1 && (buf.st_size > 0) && ((buf.st_mode & _S_IFDIR) == 0)) {
         Q_strncpy(pFullPath, pFileName, nMaxLen);
+        Manifest_AddInput(pFullPath);
         return true;
     }
     return false;
@@ -1427,10 +1455,11 @@ int OpenGlobalFile(char *src) {
 
             time1 = FileTime(tmp);
             if (time1 != -1) {
-                if ((g_StudioMdlContext.fpInput = fopen(tmp, "r")) == 0) {
+                if (!g_StudioMdlContext.lineInput.Open(tmp)) {
                     MdlWarning("reader: could not open file '%s'\n", src);
                     return 0;
                 } else {
+                    Manifest_AddInput(tmp);
                     return 1;
                 }
             }
@@ -1445,15 +1474,20 @@ int OpenGlobalFile(char *src) {
             CreateMakefile_AddDependency(filename);
             return 0;
         }
-        if ((g_StudioMdlContext.fpInput = fopen(filename, "r")) == 0) {
+        if (!g_StudioMdlContext.lineInput.Open(filename)) {
             MdlWarning("reader: could not open file '%s'\n", src);
             return 0;
         }
 
+        Manifest_AddInput(filename);
         return 1;
     }
 }
 
+void CloseGlobalFile() {
+    g_StudioMdlContext.lineInput.Close();
+}
+
 int Load_VTA(s_source_t *psource) {
     char cmd[1024];
     int option;
@@ -1489,7 +1523,7 @@ int Load_VTA(s_source_t *psource) {
                        g_StudioMdlContext.iLinecount - 1);
         }
     }
-    fclose(g_StudioMdlContext.fpInput);
+    CloseGlobalFile();
 
     return 1;
 }
\ No newline at end of file
@@ -11,11 +11,14 @@
 #include "common/cmdlib.h"
 #include "studiomdl_errors.h"
 #include "tier1/keyvalues.h"
+#include "tier1/fmtstr.h"
+#include "tier1/batchworkers.h"
 #include "tier2/fileutils.h"
 #include "studiomdl/optimize.h"
 #include "common/scriplib.h"
 #include "appframework/AppFramework.h"
 #include "studiomdl/perfstats.h"
+#include "studiomdl/manifest.h"
 #include "datamodel/idatamodel.h"
 #include "dmserializers/idmserializers.h"
 #include "mdllib/mdllib.h"
@@ -306,6 +309,7 @@ bool HandleMdlReport(int &returnValue) {
 void
 StudioMdl_ScriptLoadedCallback(const char *pFilenameLoaded, const char *pIncludedFromFileName, int nIncludeLineNumber) {
 //    printf("Script loaded callback: %s",pFilenameLoaded);
+    Manifest_AddInput(pFilenameLoaded);
 }
 
 void CreateMakefile_OutputMakefile() {
@@ -393,13 +397,13 @@ void ClampMaxVerticesPerModel(s_source_t *pOrigSource) {
     }
 
     // copy over new meshes and animations back into initial source
-    free(pOrigSource->face);
-    free(pOrigSource->vertex);
+    MemAlloc_Free(pOrigSource->face);
+    MemAlloc_Free(pOrigSource->vertex);
     newSource[0].Copy(pOrigSource);
 
     for (int n = 1; n < newSource.Count(); n++) {
         // create a new internal "source"
-        s_source_t *pSource = (s_source_t *) calloc(1, sizeof(s_source_t));
+        s_source_t *pSource = (s_source_t *) MdlCalloc(1, sizeof(s_source_t));
         g_source[g_numsources++] = pSource;
 
         // copy all the members, in order
@@ -440,7 +444,7 @@ void ClampMaxVerticesPerModel(s_source_t *pOrigSource) {
         pSource->bNoAutoDMXRules = pOrigSource->bNoAutoDMXRules;
 
         // allocate a model
-        s_model_t *pModel = (s_model_t *) calloc(1, sizeof(s_model_t));
+        s_model_t *pModel = (s_model_t *) MdlCalloc(1, sizeof(s_model_t));
         pModel->source = pSource;
         sprintf(pModel->name, "%s%d", "clamped", n);
         int imodel = g_nummodels++;
@@ -611,17 +615,18 @@ bool LoadBufferFromFile(CUtlBuffer &buffer, const char *szFilebase, const char *
     return false;
 }
 
-bool Load3ModelBuffers(CUtlBuffer &bufMDL, CUtlBuffer &bufVVD, CUtlBuffer &bufVTX, const char *szFilebase) {
+bool Load3ModelBuffers(CUtlBuffer &bufMDL, CUtlBuffer &bufVVD, CUtlBuffer &bufVTX, const char *szFilebase,
+                       bool bError = true) {
     // Load up the mdl file
-    if (!LoadBufferFromFile(bufMDL, szFilebase, ".mdl"))
+    if (!LoadBufferFromFile(bufMDL, szFilebase, ".mdl", bError))
         return false;
 
     // Load up the vvd file
-    if (!LoadBufferFromFile(bufVVD, szFilebase, ".vvd"))
+    if (!LoadBufferFromFile(bufVVD, szFilebase, ".vvd", bError))
         return false;
 
     // Load up the dx90.vtx file
-    if (!LoadBufferFromFile(bufVTX, szFilebase, ".dx90.vtx"))
+    if (!LoadBufferFromFile(bufVTX, szFilebase, ".dx90.vtx", bError))
         return false;
 
     return true;
@@ -636,6 +641,7 @@ void UsageAndExit() {
              #endif
              "options:\n"
              "[-a <normal_blend_angle>]\n"
+             "[-animerror <pos> <degrees>] - lossy animation compression within these bone errors\n"
              "[-checklengths]\n"
              "[-d] - dump glview files\n"
              "[-definebones]\n"
@@ -646,6 +652,7 @@ void UsageAndExit() {
              "[-i] - ignore warnings\n"
              "[-minlod <lod>] - truncate to highest detail <lod>\n"
              "[-n] - tag bad normals\n"
+             "[-memstats] report memory allocated by each model processing stage\n"
              "[-perf] report perf info upon compiling model\n"
              "[-printbones]\n"
              "[-printgraph]\n"
@@ -664,12 +671,16 @@ void UsageAndExit() {
              "[-stripmodel] - process binary model files and strip extra lod data\n"
              "[-stripvhv] - strip hardware verts to match the stripped model\n"
              "[-vsi] - generate stripping information .vsi file - can be used on .mdl files too\n"
+             "[-batch] - with -stripmodel, -stripvhv or -vsi: the file is a list of models to process\n"
+             "[-workers <count>] - processes to split a -batch between (default: one per CPU)\n"
+             "[-force] - process -batch models even if their outputs are up to date\n"
              "[-allowdebug]\n"
              "[-ihvtest]\n"
              "[-overridedefinebones]\n"
              "[-verbose]\n"
              "[-makefile]\n"
              "[-verify]\n"
+             "[-noincremental] - always rebuild, even if the build manifest says the model is up to date\n"
              "[-fastbuild]\n"
              "[-maxwarnings]\n"
              "[-preview]\n"
@@ -709,6 +720,9 @@ int CStudioMDLApp::Main() {
         printf("g_path:  \"%s\"\n", g_StudioMdlContext.g_path);
     }
 
+    if (g_StudioMdlContext.batchModels)
+        return Main_Batch();
+
     switch (g_eRunMode) {
         case RUN_MODE_STRIP_MODEL:
             return Main_StripModel();
@@ -773,6 +787,19 @@ int CStudioMDLApp::Main() {
     strcpy(g_fullpath, ExpandPath(g_fullpath));
     strcpy(g_fullpath, ExpandArg(g_fullpath));
 
+    // nothing the model depends on changed since the last compile
+    if (!bLoadingPreprocessedFile && !g_StudioMdlContext.createMakefile && !g_StudioMdlContext.noIncremental &&
+        !g_StudioMdlContext.bMakeVsi && !g_StudioMdlContext.verifyOnly && Manifest_IsUpToDate(g_fullpath)) {
+        if (!g_StudioMdlContext.quiet) {
+            printf("\n\"%s\" is up to date\n", g_StudioMdlContext.g_path);
+        }
+
+        if (g_StudioMdlContext.parseable_completion_output) {
+            printf("\nRESULT: SUCCESS\n");
+        }
+        return 0;
+    }
+
     // default to having one entry in the LOD list that doesn't do anything so
     // that we don't have to do any special cases for the first LOD.
     g_ScriptLODs.Purge();
@@ -811,6 +838,10 @@ int CStudioMDLApp::Main() {
         // ValidateSharedAnimationGroups();
 
         WriteModelFiles();
+
+        if (!bLoadingPreprocessedFile && !g_StudioMdlContext.verifyOnly) {
+            Manifest_Write(g_fullpath);
+        }
     }
 
     if (g_StudioMdlContext.createMakefile) {
@@ -820,6 +851,8 @@ int CStudioMDLApp::Main() {
         Main_MakeVsi();
     }
 
+    CmdLib_PrintRepeatedWarningSummary();
+
     if (!g_StudioMdlContext.quiet) {
         printf("\nCompleted \"%s\"\n", g_StudioMdlContext.g_path);
     }
@@ -991,6 +1024,11 @@ bool CStudioMDLApp::ParseArguments() {
             continue;
         }
 
+        if (!Q_stricmp(pArgv, "-batch")) {
+            g_StudioMdlContext.batchModels = true;
+            continue;
+        }
+
         if (!Q_stricmp(pArgv, "-quiet")) {
             g_StudioMdlContext.quiet = true;
             g_StudioMdlContext.verbose = false;
@@ -1009,6 +1047,12 @@ bool CStudioMDLApp::ParseArguments() {
             continue;
         }
 
+        if (!Q_stricmp(pArgv, "-animerror")) {
+            g_StudioMdlContext.animPosError = MAX(atof(CommandLine()->GetParm(++i)), 0.0);
+            g_StudioMdlContext.animAngError = MAX(atof(CommandLine()->GetParm(++i)), 0.0);
+            continue;
+        }
+
         if (!Q_stricmp(pArgv, "-printbones")) {
             g_StudioMdlContext.printBones = true;
             continue;
@@ -1019,6 +1063,11 @@ bool CStudioMDLApp::ParseArguments() {
             continue;
         }
 
+        if (!Q_stricmp(pArgv, "-memstats")) {
+            g_StudioMdlContext.memStats = true;
+            continue;
+        }
+
         if (!Q_stricmp(pArgv, "-printgraph")) {
             g_StudioMdlContext.dumpGraph = true;
             continue;
@@ -1040,6 +1089,11 @@ bool CStudioMDLApp::ParseArguments() {
             continue;
         }
 
+        if (!Q_stricmp(pArgv, "-noincremental")) {
+            g_StudioMdlContext.noIncremental = true;
+            continue;
+        }
+
         if (!Q_stricmp(pArgv, "-minlod")) {
             g_StudioMdlContext.minLod = atoi(CommandLine()->GetParm(++i));
             continue;
@@ -1113,7 +1167,7 @@ bool CStudioMDLApp::ParseArguments() {
 
     const char *pArgv = CommandLine()->GetParm(i);
     Q_strncpy(g_StudioMdlContext.g_path, pArgv, sizeof(g_StudioMdlContext.g_path));
-    if (Q_IsAbsolutePath(g_StudioMdlContext.g_path)) {
+    if (Q_IsAbsolutePath(g_StudioMdlContext.g_path) && !g_StudioMdlContext.batchModels) {
         // Set the working directory to be the path of the qc file
         // so the relative-file fopen code works
         char pQCDir[MAX_PATH];
@@ -1130,34 +1184,23 @@ bool CStudioMDLApp::ParseArguments() {
 //	Main_StripModel
 //-----------------------------------------------------------------------------
 
-int CStudioMDLApp::Main_StripVhv() {
-    if (!g_StudioMdlContext.quiet) {
-        printf("Stripping vhv data...\n");
-    }
-
-    if (!mdllib) {
-        printf("ERROR: mdllib is not available!\n");
-        return 1;
-    }
-
-    Q_StripExtension(g_StudioMdlContext.g_path, g_StudioMdlContext.g_path, sizeof(g_StudioMdlContext.g_path));
-    char *pExt = g_StudioMdlContext.g_path + strlen(g_StudioMdlContext.g_path);
-    *pExt = 0;
-
+// Strips pFileBase.vhv using the .info.strip (or .vsi) next to it.
+// bError makes a missing input fatal, otherwise it just returns false.
+static bool StripVhv(const char *pFileBase, bool bError) {
     //
     // ====== Load files
     //
 
     // Load up the vhv file
     CUtlBuffer bufVHV;
-    if (!LoadBufferFromFile(bufVHV, g_StudioMdlContext.g_path, ".vhv"))
-        return 1;
+    if (!LoadBufferFromFile(bufVHV, pFileBase, ".vhv", bError))
+        return false;
 
     // Load up the info.strip file
     CUtlBuffer bufRemapping;
-    if (!LoadBufferFromFile(bufRemapping, g_StudioMdlContext.g_path, ".info.strip", false) &&
-        !LoadBufferFromFile(bufRemapping, g_StudioMdlContext.g_path, ".vsi"))
-        return 1;
+    if (!LoadBufferFromFile(bufRemapping, pFileBase, ".info.strip", false) &&
+        !LoadBufferFromFile(bufRemapping, pFileBase, ".vsi", bError))
+        return false;
 
     //
     // ====== Process file contents
@@ -1180,7 +1223,7 @@ int CStudioMDLApp::Main_StripVhv() {
 
     if (!bResult) {
         printf("ERROR: stripping failed!\n");
-        return 1;
+        return false;
     }
 
     //
@@ -1188,30 +1231,22 @@ int CStudioMDLApp::Main_StripVhv() {
     //
 
     // Save vhv
-    if (!WriteBufferToFile(bufVHV, g_StudioMdlContext.g_path, ".vhv.strip")) {
-        printf("ERROR: Failed to save '%s'!\n", g_StudioMdlContext.g_path);
-        return 1;
+    if (!WriteBufferToFile(bufVHV, pFileBase, ".vhv.strip")) {
+        printf("ERROR: Failed to save '%s'!\n", pFileBase);
+        return false;
     }
 
-    return 0;
+    return true;
 }
 
-int CStudioMDLApp::Main_MakeVsi() {
-    if (!mdllib) {
-        printf("ERROR: mdllib is not available!\n");
-        return 1;
-    }
-
-    Q_StripExtension(g_StudioMdlContext.g_path, g_StudioMdlContext.g_path, sizeof(g_StudioMdlContext.g_path));
-    char *pExt = g_StudioMdlContext.g_path + strlen(g_StudioMdlContext.g_path);
-    *pExt = 0;
-
+// Writes pFileBase.vsi for the pFileBase .mdl/.vvd/.dx90.vtx
+static bool MakeVsi(const char *pFileBase, bool bError) {
     // Load up the files
     CUtlBuffer bufMDL;
     CUtlBuffer bufVVD;
     CUtlBuffer bufVTX;
-    if (!Load3ModelBuffers(bufMDL, bufVVD, bufVTX, g_StudioMdlContext.g_path))
-        return 1;
+    if (!Load3ModelBuffers(bufMDL, bufVVD, bufVTX, pFileBase, bError))
+        return false;
 
     //
     // ====== Process file contents
@@ -1239,7 +1274,7 @@ int CStudioMDLApp::Main_MakeVsi() {
 
     if (!bResult) {
         printf("ERROR: stripping failed!\n");
-        return 1;
+        return false;
     }
 
     //
@@ -1247,39 +1282,28 @@ int CStudioMDLApp::Main_MakeVsi() {
     //
 
     // Save remapping data using "P4 edit -> save -> P4 add"  approach
-    sprintf(pExt, ".vsi");
-//	CP4AutoEditAddFile _auto_edit_vsi( g_path );
+    char pFileName[1024];
+    Q_snprintf(pFileName, sizeof(pFileName), "%s.vsi", pFileBase);
+//	CP4AutoEditAddFile _auto_edit_vsi( pFileName );
 
-    if (!WriteFileToDisk(g_StudioMdlContext.g_path, nullptr, bufMappingTable)) {
-        printf("ERROR: Failed to save '%s'!\n", g_StudioMdlContext.g_path);
-        return 1;
+    if (!WriteFileToDisk(pFileName, nullptr, bufMappingTable)) {
+        printf("ERROR: Failed to save '%s'!\n", pFileName);
+        return false;
     } else if (!g_StudioMdlContext.quiet) {
         printf("Generated .vsi stripping information.\n");
     }
 
-    return 0;
+    return true;
 }
 
-int CStudioMDLApp::Main_StripModel() {
-    if (!g_StudioMdlContext.quiet) {
-        printf("Stripping binary model files...\n");
-    }
-
-    if (!mdllib) {
-        printf("ERROR: mdllib is not available!\n");
-        return 1;
-    }
-
-    Q_FileBase(g_StudioMdlContext.g_path, g_StudioMdlContext.g_path, sizeof(g_StudioMdlContext.g_path));
-    char *pExt = g_StudioMdlContext.g_path + strlen(g_StudioMdlContext.g_path);
-    *pExt = 0;
-
+// Writes the stripped pFileBase .mdl/.vvd/.vtx and .info.strip
+static bool StripModel(const char *pFileBase, bool bError) {
     // Load up the files
     CUtlBuffer bufMDL;
     CUtlBuffer bufVVD;
     CUtlBuffer bufVTX;
-    if (!Load3ModelBuffers(bufMDL, bufVVD, bufVTX, g_StudioMdlContext.g_path))
-        return 1;
+    if (!Load3ModelBuffers(bufMDL, bufVVD, bufVTX, pFileBase, bError))
+        return false;
 
     //
     // ====== Process file contents
@@ -1302,40 +1326,266 @@ int CStudioMDLApp::Main_StripModel() {
 
     if (!bResult) {
         printf("ERROR: stripping failed!\n");
-        return 1;
+        return false;
     }
 
     //
     // ====== Save out processed data
     //
 
-    // Save mdl
-    sprintf(pExt, ".mdl.strip");
-    if (!WriteFileToDisk(g_StudioMdlContext.g_path, nullptr, bufMDL)) {
-        printf("ERROR: Failed to save '%s'!\n", g_StudioMdlContext.g_path);
+    // Save mdl, vvd, vtx and the remapping data
+    CUtlBuffer *pBuffers[] = {&bufMDL, &bufVVD, &bufVTX, &bufMappingTable};
+    const char *pExtensions[] = {".mdl.strip", ".vvd.strip", ".vtx.strip", ".info.strip"};
+    for (int i = 0; i < ARRAYSIZE(pBuffers); ++i) {
+        if (!WriteBufferToFile(*pBuffers[i], pFileBase, pExtensions[i])) {
+            printf("ERROR: Failed to save '%s%s'!\n", pFileBase, pExtensions[i]);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int CStudioMDLApp::Main_StripVhv() {
+    if (!g_StudioMdlContext.quiet) {
+        printf("Stripping vhv data...\n");
+    }
+
+    if (!mdllib) {
+        printf("ERROR: mdllib is not available!\n");
         return 1;
     }
 
-    // Save vvd
-    sprintf(pExt, ".vvd.strip");
-    if (!WriteFileToDisk(g_StudioMdlContext.g_path, nullptr, bufVVD)) {
-        printf("ERROR: Failed to save '%s'!\n", g_StudioMdlContext.g_path);
+    Q_StripExtension(g_StudioMdlContext.g_path, g_StudioMdlContext.g_path, sizeof(g_StudioMdlContext.g_path));
+    return StripVhv(g_StudioMdlContext.g_path, true) ? 0 : 1;
+}
+
+int CStudioMDLApp::Main_MakeVsi() {
+    if (!mdllib) {
+        printf("ERROR: mdllib is not available!\n");
         return 1;
     }
 
-    // Save vtx
-    sprintf(pExt, ".vtx.strip");
-    if (!WriteFileToDisk(g_StudioMdlContext.g_path, nullptr, bufVTX)) {
-        printf("ERROR: Failed to save '%s'!\n", g_StudioMdlContext.g_path);
+    Q_StripExtension(g_StudioMdlContext.g_path, g_StudioMdlContext.g_path, sizeof(g_StudioMdlContext.g_path));
+    return MakeVsi(g_StudioMdlContext.g_path, true) ? 0 : 1;
+}
+
+int CStudioMDLApp::Main_StripModel() {
+    if (!g_StudioMdlContext.quiet) {
+        printf("Stripping binary model files...\n");
+    }
+
+    if (!mdllib) {
+        printf("ERROR: mdllib is not available!\n");
         return 1;
     }
 
-    // Save remapping data
-    sprintf(pExt, ".info.strip");
-    if (!WriteFileToDisk(g_StudioMdlContext.g_path, nullptr, bufMappingTable)) {
-        printf("ERROR: Failed to save '%s'!\n", g_StudioMdlContext.g_path);
+    Q_FileBase(g_StudioMdlContext.g_path, g_StudioMdlContext.g_path, sizeof(g_StudioMdlContext.g_path));
+    return StripModel(g_StudioMdlContext.g_path, true) ? 0 : 1;
+}
+
+//-----------------------------------------------------------------------------
+// -batch: runs -stripmodel, -stripvhv or -vsi over every model named in a list
+// file (one .mdl or .vhv path per line), skipping models whose outputs are
+// newer than their inputs unless -force is given. Outputs are written next to
+// each model. The list is split between -workers copies of studiomdl (see
+// batchworkers.h), each of which strips its share in one process.
+//-----------------------------------------------------------------------------
+
+// Gets the files a strip of pFileBase reads and writes
+static void GetBatchModelFiles(const char *pFileBase, CUtlVector<CUtlString> &inputs, CUtlVector<CUtlString> &outputs) {
+    static const char *s_pModelInputs[] = {".mdl", ".vvd", ".dx90.vtx"};
+    static const char *s_pStripOutputs[] = {".mdl.strip", ".vvd.strip", ".vtx.strip", ".info.strip"};
+
+    if (g_eRunMode == RUN_MODE_STRIP_VHV) {
+        inputs.AddToTail(CFmtStr("%s.vhv", pFileBase).Get());
+
+        int64 nSize, nTime;
+        CFmtStr remapping("%s.info.strip", pFileBase);
+        if (!Batch_GetFileInfo(remapping, nSize, nTime)) {
+            remapping.sprintf("%s.vsi", pFileBase);
+        }
+        inputs.AddToTail(remapping.Get());
+        outputs.AddToTail(CFmtStr("%s.vhv.strip", pFileBase).Get());
+        return;
+    }
+
+    for (int i = 0; i < ARRAYSIZE(s_pModelInputs); ++i) {
+        inputs.AddToTail(CFmtStr("%s%s", pFileBase, s_pModelInputs[i]).Get());
+    }
+
+    if (g_eRunMode == RUN_MODE_STRIP_MODEL) {
+        for (int i = 0; i < ARRAYSIZE(s_pStripOutputs); ++i) {
+            outputs.AddToTail(CFmtStr("%s%s", pFileBase, s_pStripOutputs[i]).Get());
+        }
+    } else {
+        outputs.AddToTail(CFmtStr("%s.vsi", pFileBase).Get());
+    }
+}
+
+// Returns false if an input is missing. nSize is the total input size.
+static bool IsBatchModelUpToDate(const char *pFileBase, int64 &nSize, bool &bUpToDate) {
+    CUtlVector<CUtlString> inputs;
+    CUtlVector<CUtlString> outputs;
+    GetBatchModelFiles(pFileBase, inputs, outputs);
+
+    nSize = 0;
+    int64 nNewestInput = 0;
+    for (int i = 0; i < inputs.Count(); ++i) {
+        int64 nFileSize, nTime;
+        if (!Batch_GetFileInfo(inputs[i].Get(), nFileSize, nTime))
+            return false;
+        nSize += nFileSize;
+        nNewestInput = MAX(nNewestInput, nTime);
+    }
+
+    bUpToDate = true;
+    for (int i = 0; i < outputs.Count() && bUpToDate; ++i) {
+        int64 nFileSize, nTime;
+        bUpToDate = Batch_GetFileInfo(outputs[i].Get(), nFileSize, nTime) && nTime >= nNewestInput;
+    }
+    return true;
+}
+
+int CStudioMDLApp::Main_Batch() {
+    if (g_eRunMode == RUN_MODE_BUILD && !g_StudioMdlContext.bMakeVsi) {
+        printf("ERROR: -batch needs -stripmodel, -stripvhv or -vsi.\n");
         return 1;
     }
 
-    return 0;
+    if (!mdllib) {
+        printf("ERROR: mdllib is not available!\n");
+        return 1;
+    }
+
+    double flStartTime = Plat_FloatTime();
+
+    FILE *fp = fopen(g_StudioMdlContext.g_path, "rt");
+    if (!fp) {
+        printf("ERROR: Unable to open list file '%s'!\n", g_StudioMdlContext.g_path);
+        return 1;
+    }
+
+    // One model per line, with or without its extension
+    CUtlVector<BatchJob_t> jobs;
+    char pLine[1024];
+    while (fgets(pLine, sizeof(pLine), fp)) {
+        int nLen = Q_strlen(pLine);
+        while (nLen > 0 && (pLine[nLen - 1] == '\n' || pLine[nLen - 1] == '\r')) {
+            pLine[--nLen] = 0;
+        }
+        BatchJob_t &job = jobs[jobs.AddToTail()];
+        job.m_Line = pLine;
+        job.m_nSize = 0;
+        job.m_bDone = false;
+    }
+    fclose(fp);
+
+    // Leave out blank lines, missing inputs and current outputs.
+    // Workers are started with -force, their parent has already done this.
+    CBatchDoneFile doneFile;
+    bool bForce = CommandLine()->FindParm("-force") != 0;
+    CUtlVector<int> todo;
+    int nMissing = 0;
+    int nUpToDate = 0;
+    for (int i = 0; i < jobs.Count(); ++i) {
+        if (jobs[i].m_Line.IsEmpty())
+            continue;
+
+        char pFileBase[MAX_PATH];
+        Q_StripExtension(jobs[i].m_Line.Get(), pFileBase, sizeof(pFileBase));
+
+        bool bUpToDate;
+        if (!IsBatchModelUpToDate(pFileBase, jobs[i].m_nSize, bUpToDate)) {
+            printf("missing %s\n", jobs[i].m_Line.Get());
+            ++nMissing;
+        } else if (bUpToDate && !bForce) {
+            ++nUpToDate;
+        } else {
+            todo.AddToTail(i);
+        }
+    }
+
+    int nWorkerCount = doneFile.IsWorker() ? 1 : Batch_GetWorkerCount(todo.Count());
+    bool bRunInProcess = nWorkerCount == 1;
+    if (!bRunInProcess) {
+        CUtlVector<BatchJob_t> workerJobs;
+        for (int i = 0; i < todo.Count(); ++i) {
+            workerJobs.AddToTail(jobs[todo[i]]);
+        }
+
+        // Workers get the same command line, less what only the parent uses
+        CUtlVector<CUtlString> args;
+        int argc = CommandLine()->ParmCount();
+        for (int i = 1; i < argc - 1; ++i) {
+            const char *pArg = CommandLine()->GetParm(i);
+            if (!Q_stricmp(pArg, "-workers") || !Q_stricmp(pArg, "-donefile")) {
+                ++i;
+                continue;
+            }
+            if (!Q_stricmp(pArg, "-force"))
+                continue;
+            args.AddToTail(pArg);
+        }
+        args.AddToTail("-workers");
+        args.AddToTail("1");
+        args.AddToTail("-force");
+
+        bRunInProcess = !Batch_RunWorkers(workerJobs, nWorkerCount, args);
+        for (int i = 0; i < todo.Count(); ++i) {
+            jobs[todo[i]].m_bDone = workerJobs[i].m_bDone;
+            if (!bRunInProcess && !workerJobs[i].m_bDone) {
+                printf("failed  %s\n", jobs[todo[i]].m_Line.Get());
+            }
+        }
+    }
+
+    if (bRunInProcess) {
+        for (int i = 0; i < todo.Count(); ++i) {
+            BatchJob_t &job = jobs[todo[i]];
+            char pFileBase[MAX_PATH];
+            Q_StripExtension(job.m_Line.Get(), pFileBase, sizeof(pFileBase));
+
+            // A bad model fails on its own rather than ending the batch. Anything
+            // mdllib finds fatal still exits, which the parent of a worker recovers from.
+            double flModelStartTime = Plat_FloatTime();
+            doneFile.MarkStarted(todo[i]);
+            if (g_eRunMode == RUN_MODE_STRIP_MODEL) {
+                job.m_bDone = StripModel(pFileBase, false);
+            } else if (g_eRunMode == RUN_MODE_STRIP_VHV) {
+                job.m_bDone = StripVhv(pFileBase, false);
+            } else {
+                job.m_bDone = MakeVsi(pFileBase, false);
+            }
+
+            if (job.m_bDone) {
+                printf("ok      %s (%.3fs)\n", job.m_Line.Get(), Plat_FloatTime() - flModelStartTime);
+                doneFile.MarkDone(todo[i]);
+            } else {
+                printf("failed  %s\n", job.m_Line.Get());
+            }
+            fflush(stdout);
+        }
+    }
+
+    // Workers report their own models, the parent just sums them up
+    if (doneFile.IsWorker())
+        return 0;
+
+    int nDone = 0;
+    int64 nDoneBytes = 0;
+    for (int i = 0; i < todo.Count(); ++i) {
+        if (jobs[todo[i]].m_bDone) {
+            ++nDone;
+            nDoneBytes += jobs[todo[i]].m_nSize;
+        }
+    }
+
+    double flTime = MAX(Plat_FloatTime() - flStartTime, 0.001);
+    int nFailed = todo.Count() - nDone + nMissing;
+    printf("%d processed, %d failed, %d up to date in %.2fs with %d worker%s (%.1f models/s, %.2f MB/s)\n",
+           nDone, nFailed, nUpToDate, flTime, nWorkerCount, nWorkerCount == 1 ? "" : "s",
+           nDone / flTime, nDoneBytes / (1024.0 * 1024.0) / flTime);
+
+    return nFailed ? 1 : 0;
 }
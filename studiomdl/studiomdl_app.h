@@ -32,6 +32,8 @@ private:
 
     int Main_MakeVsi();
 
+    int Main_Batch();
+
 private:
     bool ParseArguments();
 };
@@ -149,7 +149,7 @@ void ProcessCmdBody(const char *pFullPath, const char *pBodyPartName, float flSc
     }
     Q_strncpy(g_bodypart[g_numbodyparts].name, pBodyPartName, sizeof(g_bodypart[g_numbodyparts].name));
 
-    g_model[g_nummodels] = (s_model_t *) calloc(1, sizeof(s_model_t));
+    g_model[g_nummodels] = (s_model_t *) MdlCalloc(1, sizeof(s_model_t));
     g_bodypart[g_numbodyparts].pmodel[0] = g_model[g_nummodels];
     g_bodypart[g_numbodyparts].nummodels = 1;
 
@@ -420,9 +420,9 @@ void Option_Studio(s_model_t *pmodel) {
 }
 
 int Option_Blank() {
-    g_model[g_nummodels] = (s_model_t *) calloc(1, sizeof(s_model_t));
+    g_model[g_nummodels] = (s_model_t *) MdlCalloc(1, sizeof(s_model_t));
 
-    g_source[g_numsources] = (s_source_t *) calloc(1, sizeof(s_source_t));
+    g_source[g_numsources] = (s_source_t *) MdlCalloc(1, sizeof(s_source_t));
     g_model[g_nummodels]->source = g_source[g_numsources];
     g_numsources++;
 
@@ -457,7 +457,7 @@ void Cmd_Bodygroup() {
         } else if (token[0] == '}') {
             break;
         } else if (stricmp("studio", token) == 0) {
-            g_model[g_nummodels] = (s_model_t *) calloc(1, sizeof(s_model_t));
+            g_model[g_nummodels] = (s_model_t *) MdlCalloc(1, sizeof(s_model_t));
             g_bodypart[g_numbodyparts].pmodel[g_bodypart[g_numbodyparts].nummodels] = g_model[g_nummodels];
             g_bodypart[g_numbodyparts].nummodels++;
 
@@ -2278,7 +2278,7 @@ void Option_Eyelid(int imodel) {
 }
 
 void Cmd_Model() {
-    g_model[g_nummodels] = (s_model_t *) calloc(1, sizeof(s_model_t));
+    g_model[g_nummodels] = (s_model_t *) MdlCalloc(1, sizeof(s_model_t));
 
     // name
     if (!GetToken(false))
@@ -2418,7 +2418,7 @@ void Cmd_FakeVTA() {
 
     GetToken(false);
 
-    s_source_t *psource = (s_source_t *) calloc(1, sizeof(s_source_t));
+    s_source_t *psource = (s_source_t *) MdlCalloc(1, sizeof(s_source_t));
     g_source[g_numsources] = psource;
     strcpyn(g_source[g_numsources]->filename, token);
     g_numsources++;
@@ -3316,6 +3316,7 @@ void Cmd_LOD(const char *cmdname) {
     newLOD.switchValue = -1.0f;
 
     bool isShadowCall = (!stricmp(cmdname, "$shadowlod")) ? true : false;
+    bool isAutoCall = (!stricmp(cmdname, "$autolod")) ? true : false;
 
     if (isShadowCall) {
         if (TokenAvailable()) {
@@ -3337,16 +3338,38 @@ void Cmd_LOD(const char *cmdname) {
         }
     }
 
-    GetToken(true);
-    if (stricmp("{", token) != 0) {
-        MdlError("\"{\" expected while processing %s (%d) : %s", cmdname, g_StudioMdlContext.iLinecount, g_StudioMdlContext.szLine);
+    if (isAutoCall) {
+        if (TokenAvailable()) {
+            GetToken(false);
+            newLOD.autoLODRatio = verify_atof(token);
+            if (newLOD.autoLODRatio <= 0.0f || newLOD.autoLODRatio > 1.0f) {
+                MdlError("%s ratio must be in (0, 1] (%d) : %s\n", cmdname, g_StudioMdlContext.iLinecount, g_StudioMdlContext.szLine);
+            }
+        } else {
+            MdlError("Expected %s triangle ratio (%d) : %s\n", cmdname, g_StudioMdlContext.iLinecount, g_StudioMdlContext.szLine);
+        }
+    }
+
+    // The block is optional for $autolod, which works without any replacements
+    bool bHasBlock = true;
+    if (!GetToken(true)) {
+        if (!isAutoCall) {
+            MdlError("\"{\" expected while processing %s (%d) : %s", cmdname, g_StudioMdlContext.iLinecount, g_StudioMdlContext.szLine);
+        }
+        bHasBlock = false;
+    } else if (stricmp("{", token) != 0) {
+        if (!isAutoCall) {
+            MdlError("\"{\" expected while processing %s (%d) : %s", cmdname, g_StudioMdlContext.iLinecount, g_StudioMdlContext.szLine);
+        }
+        UnGetToken();
+        bHasBlock = false;
     }
 
     // In case we are stripping all lods and it's not Lod0, strip it
     if (i && g_StudioMdlContext.stripLods)
         newLOD.StripFromModel(true);
 
-    while (1) {
+    while (bHasBlock) {
         GetToken(true);
         if (stricmp("replacemodel", token) == 0) {
             Cmd_ReplaceModel(newLOD);
@@ -3518,6 +3541,17 @@ void Cmd_SectionFrames() {
 }
 
 
+//-----------------------------------------------------------------------------
+// error bounds for lossy animation compression
+//-----------------------------------------------------------------------------
+void Cmd_AnimCompression() {
+    GetToken(false);
+    g_StudioMdlContext.animPosError = MAX(verify_atof(token), 0.0f);
+    GetToken(false);
+    g_StudioMdlContext.animAngError = MAX(verify_atof(token), 0.0f);
+}
+
+
 //-----------------------------------------------------------------------------
 // world space clamping boundaries for animations
 //-----------------------------------------------------------------------------
@@ -4302,6 +4336,10 @@ void Cmd_BaseLOD() {
     Cmd_LOD("$lod");
 }
 
+void Cmd_AutoLOD() {
+    Cmd_LOD("$autolod");
+}
+
 //-----------------------------------------------------------------------------
 // Key value block
 //-----------------------------------------------------------------------------
@@ -5215,13 +5253,13 @@ int ParseCmdlistToken(int &numcmds, s_animcmd_t *cmds) {
     } else if (stricmp("ikrule", token) == 0) {
         pcmd->cmd = CMD_IKRULE;
 
-        pcmd->u.ikrule.pRule = (s_ikrule_t *) calloc(1, sizeof(s_ikrule_t));
+        pcmd->u.ikrule.pRule = (s_ikrule_t *) MdlCalloc(1, sizeof(s_ikrule_t));
 
         Option_IKRule(pcmd->u.ikrule.pRule);
     } else if (stricmp("ikfixup", token) == 0) {
         pcmd->cmd = CMD_IKFIXUP;
 
-        pcmd->u.ikfixup.pRule = (s_ikrule_t *) calloc(1, sizeof(s_ikrule_t));
+        pcmd->u.ikfixup.pRule = (s_ikrule_t *) MdlCalloc(1, sizeof(s_ikrule_t));
 
         Option_IKRule(pcmd->u.ikrule.pRule);
     } else if (stricmp("walkframe", token) == 0) {
@@ -5789,7 +5827,9 @@ bool ParseAnimationToken(s_animation_t *panim) {
         return true;
     }
 
-    if (ParseCmdlistToken(panim->numcmds, panim->cmds))
+    // ParseCmdlistToken fills in cmds[numcmds] if the token is a command
+    panim->cmds.EnsureCount(panim->numcmds + 1);
+    if (ParseCmdlistToken(panim->numcmds, panim->cmds.Base()))
         return true;
 
     if (!Q_stricmp("cmdlist", token)) {
@@ -5909,7 +5949,7 @@ void Cmd_Animation() {
     }
 
     // allocate animation entry
-    g_panimation[g_numani] = (s_animation_t *) calloc(1, sizeof(s_animation_t));
+    g_panimation[g_numani] = (s_animation_t *) MdlCalloc(1, sizeof(s_animation_t));
     g_panimation[g_numani]->index = g_numani;
     panim = g_panimation[g_numani];
     strcpyn(panim->name, token);
@@ -6036,7 +6076,7 @@ int Option_ActivityModifier(s_sequence_t *psequence) {
 //-----------------------------------------------------------------------------
 s_animation_t *ProcessImpliedAnimation(s_sequence_t *psequence, const char *filename) {
     // allocate animation entry
-    g_panimation[g_numani] = (s_animation_t *) calloc(1, sizeof(s_animation_t));
+    g_panimation[g_numani] = (s_animation_t *) MdlCalloc(1, sizeof(s_animation_t));
     g_panimation[g_numani]->index = g_numani;
     s_animation_t *panim = g_panimation[g_numani];
     g_numani++;
@@ -6108,6 +6148,7 @@ void CopyAnimationSettings(s_animation_t *pdest, s_animation_t *psrc) {
 
 	pdest->numframes = pdest->endframe - pdest->startframe + 1;*/
 
+    pdest->cmds.EnsureCapacity(pdest->numcmds + psrc->numcmds);
     for (int i = 0; i < psrc->numcmds; i++) {
         if (pdest->numcmds >= MAXSTUDIOCMDS) {
             TokenError("Too many cmds in %s\n", pdest->name);
@@ -6572,7 +6613,7 @@ void Cmd_DeclareAnimation() {
     }
 
     // allocate animation entry
-    s_animation_t *panim = (s_animation_t *) calloc(1, sizeof(s_animation_t));
+    s_animation_t *panim = (s_animation_t *) MdlCalloc(1, sizeof(s_animation_t));
     g_panimation[g_numani] = panim;
     panim->index = g_numani;
     panim->flags = STUDIO_OVERRIDE;
@@ -6818,7 +6859,7 @@ void Load_ProceduralBones() {
             }
         }
     }
-    fclose(g_StudioMdlContext.fpInput);
+    CloseGlobalFile();
 }
 
 //
@@ -6896,6 +6937,7 @@ MDLCommand_t g_Commands[] =
                 {"$forcerealign",                    Cmd_ForceRealign,},
                 {"$lod",                             Cmd_BaseLOD,},
                 {"$shadowlod",                       Cmd_ShadowLOD,},
+                {"$autolod",                         Cmd_AutoLOD,},
                 {"$poseparameter",                   Cmd_PoseParameter,},
                 {"$heirarchy",                       Cmd_ForcedHierarchy,},
                 {"$hierarchy",                       Cmd_ForcedHierarchy,},
@@ -6926,6 +6968,7 @@ MDLCommand_t g_Commands[] =
                 {"$casttextureshadows",              Cmd_CastTextureShadows,},
                 {"$motionrollback",                  Cmd_MotionExtractionRollBack,},
                 {"$sectionframes",                   Cmd_SectionFrames,},
+                {"$animcompression",                 Cmd_AnimCompression,},
                 {"$clampworldspace",                 Cmd_ClampWorldspace,},
                 {"$maxeyedeflection",                Cmd_MaxEyeDeflection,},
                 {"$addsearchdir",                    Cmd_AddSearchDir,},
@@ -12,6 +12,16 @@
 extern StudioMdlContext g_StudioMdlContext;
 static bool g_bFirstWarning = true;
 
+// MdlError and MdlWarning print straight to the console, so they hold the logging
+// lock to keep their lines whole next to messages logged by worker threads. It
+// also guards g_bFirstWarning, the warning budget and the console colour.
+class CMdlConsoleLock {
+public:
+    CMdlConsoleLock() { LoggingSystem_Lock(); }
+
+    ~CMdlConsoleLock() { LoggingSystem_Unlock(); }
+};
+
 void TokenError(const char *fmt, ...) {
     static char output[1024];
     va_list args;
@@ -39,6 +49,9 @@ void MdlError(const char *fmt, ...) {
     va_list args;
 
 //	Assert( 0 );
+    // held until just before exit, other threads wait rather than interleave with the error
+    LoggingSystem_Lock();
+
     if (g_StudioMdlContext.quiet) {
         if (g_bFirstWarning) {
             printf("%s :\n", g_fullpath);
@@ -86,16 +99,27 @@ void MdlError(const char *fmt, ...) {
         printf("\nRESULT: ERROR\n");
     }
 
+    LoggingSystem_Unlock();
     exit(-1);
 }
 
 void MdlWarning(const char *fmt, ...) {
     va_list args;
-    static char output[1024];
+    char output[1024];
+
+    CMdlConsoleLock lock;
 
     if (g_StudioMdlContext.bNoWarnings || g_StudioMdlContext.g_maxWarnings == 0)
         return;
 
+    va_start(args, fmt);
+    V_vsnprintf(output, sizeof(output), fmt, args);
+    va_end(args);
+
+    // per-vertex and per-bone warnings repeat a lot; print each one once and summarize at the end
+    if (CmdLib_IsRepeatedWarning(output))
+        return;
+
     ushort old = SetConsoleTextColor(1, 1, 0, 1);
 
     if (g_StudioMdlContext.quiet) {
@@ -108,9 +132,7 @@ void MdlWarning(const char *fmt, ...) {
 
     //Assert( 0 );
 
-    printf("WARNING: ");
-            va_start(args, fmt);
-    vprintf(fmt, args);
+    printf("WARNING: %s", output);
 
     if (g_StudioMdlContext.g_maxWarnings > 0)
         g_StudioMdlContext.g_maxWarnings--;
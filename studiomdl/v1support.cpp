@@ -137,10 +137,12 @@ void ParseFaceData(s_source_t *psource, int material, s_face_t *pFace) {
     float weights[MAXSTUDIOSRCBONES];
     int iExtras;
     float extras[(MAXSTUDIOTEXCOORDS - 1) * 2];
+    float values[8];
     int bone;
 
     for (j = 0; j < 3; j++) {
-        memset(g_StudioMdlContext.szLine, 0, sizeof(g_StudioMdlContext.szLine));
+        // Clear the line so a read failure reports an empty one
+        g_StudioMdlContext.szLine[0] = '\0';
 
         if (!GetLineInput()) {
             MdlError("%s: error on g_StudioMdlContext.szLine %d: %s", g_StudioMdlContext.szFilename, g_StudioMdlContext.iLinecount, g_StudioMdlContext.szLine);
@@ -149,11 +151,18 @@ void ParseFaceData(s_source_t *psource, int material, s_face_t *pFace) {
         iCount = 0;
         iExtras = 0;
 
-        i = sscanf(g_StudioMdlContext.szLine, "%d %f %f %f %f %f %f %f %f",
-                   &bone,
-                   &p[0], &p[1], &p[2],
-                   &normal[0], &normal[1], &normal[2],
-                   &t[0], &t[1]);
+        if (FastScanIntAndFloats(g_StudioMdlContext.szLine, bone, values, 8)) {
+            p.Init(values[0], values[1], values[2]);
+            normal.Init(values[3], values[4], values[5]);
+            t.Init(values[6], values[7]);
+            i = 9;
+        } else {
+            i = sscanf(g_StudioMdlContext.szLine, "%d %f %f %f %f %f %f %f %f",
+                       &bone,
+                       &p[0], &p[1], &p[2],
+                       &normal[0], &normal[1], &normal[2],
+                       &t[0], &t[1]);
+        }
 
         if (i < 9)
             continue;
@@ -174,26 +183,34 @@ void ParseFaceData(s_source_t *psource, int material, s_face_t *pFace) {
         }
         // Read bone count
         if (pItem) {
-            iCount = atoi(pItem);
+            if (!FastAtoi(pItem, iCount)) {
+                iCount = atoi(pItem);
+            }
             if (iCount > 0) {
                 for (k = 0; k < iCount && k < MAXSTUDIOSRCBONES; k++) {
                     pItem = GetNextFaceItem(pItem);
                     if (!pItem) {
                         MdlError("Bone ID %d not found\n%d %s :\n%s", k, g_StudioMdlContext.iLinecount, g_StudioMdlContext.szFilename, g_StudioMdlContext.szLine);
                     }
-                    bones[k] = atoi(pItem);
+                    if (!FastAtoi(pItem, bones[k])) {
+                        bones[k] = atoi(pItem);
+                    }
 
                     pItem = GetNextFaceItem(pItem);
                     if (!pItem) {
                         MdlError("Bone weight %d not found\n%d %s :\n%s", k, g_StudioMdlContext.iLinecount, g_StudioMdlContext.szFilename, g_StudioMdlContext.szLine);
                     }
-                    weights[k] = atof(pItem);
+                    if (!FastAtof(pItem, weights[k])) {
+                        weights[k] = atof(pItem);
+                    }
                 }
             }
             if (psource->version >= 3) {
                 pItem = GetNextFaceItem(pItem);
                 if (pItem) {
-                    iExtras = atoi(pItem);
+                    if (!FastAtoi(pItem, iExtras)) {
+                        iExtras = atoi(pItem);
+                    }
                     if (iExtras > 0) {
                         iExtras = MIN(iExtras, (MAXSTUDIOTEXCOORDS - 1) * 2);
                         for (int e = 0; e < iExtras; e++) {
@@ -202,7 +219,9 @@ void ParseFaceData(s_source_t *psource, int material, s_face_t *pFace) {
                                 MdlError("Extra data item %d not found\n%d %s :\n%s", e, g_StudioMdlContext.iLinecount, g_StudioMdlContext.szFilename,
                                          g_StudioMdlContext.szLine);
                             }
-                            extras[e] = atof(pItem);
+                            if (!FastAtof(pItem, extras[e])) {
+                                extras[e] = atof(pItem);
+                            }
                         }
                     }
                 }
@@ -386,7 +405,7 @@ int Load_SMD(s_source_t *psource) {
             MdlWarning("unknown studio command \"%s\"\n", cmd);
         }
     }
-    fclose(g_StudioMdlContext.fpInput);
+    CloseGlobalFile();
 
     return 1;
 }
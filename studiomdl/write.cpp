@@ -20,6 +20,8 @@
 #include <cstdlib>
 #include <sys/stat.h>
 #include <climits>
+#include <atomic>
+#include <thread>
 
 #include "common/cmdlib.h"
 #include "common/scriplib.h"
@@ -30,6 +32,7 @@
 #include "materialsystem/imaterial.h"
 #include "mdlobjects/dmeboneflexdriver.h"
 #include "studiomdl/perfstats.h"
+#include "studiomdl/manifest.h"
 
 #include "tier1/smartptr.h"
 
@@ -56,8 +59,10 @@ WriteModel
 
 static byte *pData;
 static byte *pStart;
-static byte *pBlockData;
-static byte *pBlockStart;
+static bool bWriteAnimBlocks;           // demand loaded animation data goes to an .ani file
+static int nBlockData;                  // end of the animation block data laid out so far, as an .ani offset
+static int nBlockWritten;               // how much of it has been streamed out
+static FileHandle_t blockouthandle;
 static int sExtraTexcoordsToWrite = 0;
 
 
@@ -1030,12 +1035,13 @@ int studiohdr_t::GetAutoplayList(unsigned short **pOut) const {
 }
 
 
-int rawanimbytes = 0;
-int animboneframes = 0;
+// animations are encoded in parallel
+std::atomic<int> rawanimbytes(0);
+std::atomic<int> animboneframes(0);
 
-int numAxis[4] = {0, 0, 0, 0};
-int numPos[4] = {0, 0, 0, 0};
-int useRaw = 0;
+std::atomic<int> numAxis[4];
+std::atomic<int> numPos[4];
+std::atomic<int> useRaw(0);
 
 
 void WriteRLEAnimationData(s_animation_t *srcanim, mstudioanimdesc_t *destanimdesc, byte *&pData, int w) {
@@ -1162,6 +1168,17 @@ void WriteRLEAnimationData(s_animation_t *srcanim, mstudioanimdesc_t *destanimde
     ALIGN4(pData);
 }
 
+// Frames written for section w
+static void GetSectionFrames(const s_animation_t *srcanim, int w, int &iStartFrame, int &iEndFrame) {
+    iStartFrame = 0;
+    iEndFrame = srcanim->numframes - 1;
+
+    if (srcanim->sectionframes > 0) {
+        iStartFrame = MIN(w * srcanim->sectionframes, srcanim->numframes - 1);
+        iEndFrame = MIN((w + 1) * srcanim->sectionframes, srcanim->numframes - 1);
+    }
+}
+
 void WriteFrameAnimationData(s_animation_t *srcanim, mstudioanimdesc_t *destanimdesc, byte *&pData, int w) {
     // allocate room for header
     mstudio_frame_anim_t *destframeanim = (mstudio_frame_anim_t *) pData;
@@ -1224,13 +1241,8 @@ void WriteFrameAnimationData(s_animation_t *srcanim, mstudioanimdesc_t *destanim
     destframeanim->frameoffset = pData - (byte *) destframeanim;
     destframeanim->framelength = framelength;
 
-    int iStartFrame = 0;
-    int iEndFrame = srcanim->numframes - 1;
-
-    if (srcanim->sectionframes > 0) {
-        iStartFrame = MIN(w * srcanim->sectionframes, srcanim->numframes - 1);
-        iEndFrame = MIN((w + 1) * srcanim->sectionframes, srcanim->numframes - 1);
-    }
+    int iStartFrame, iEndFrame;
+    GetSectionFrames(srcanim, w, iStartFrame, iEndFrame);
 
     /*
 	printf("%s (%d : %d %d):\n", srcanim->name, srcanim->numframes, iStartFrame, iEndFrame );
@@ -1267,68 +1279,6 @@ void WriteFrameAnimationData(s_animation_t *srcanim, mstudioanimdesc_t *destanim
 }
 
 
-void WriteAnimationData(s_animation_t *srcanim, mstudioanimdesc_t *destanimdesc, byte *&pLocalData, byte *&pExtData) {
-    byte *pData = nullptr;
-
-    for (int w = 0; w < srcanim->numsections; w++) {
-        bool bUseExtData = false;
-        pData = pLocalData;
-
-        if (pExtData != nullptr && !srcanim->disableAnimblocks &&
-            !((w * srcanim->sectionframes < srcanim->numNostallFrames) && srcanim->isFirstSectionLocal)) {
-            pData = pExtData;
-            bUseExtData = true;
-        }
-
-        byte *pStartSection = pData;
-
-        // use frameanim if not lowres data
-        if (pExtData != nullptr && !g_StudioMdlContext.animblockLowRes) {
-            srcanim->flags |= STUDIO_FRAMEANIM;
-            destanimdesc->flags |= STUDIO_FRAMEANIM;
-        }
-
-        if (srcanim->flags & STUDIO_FRAMEANIM) {
-            WriteFrameAnimationData(srcanim, destanimdesc, pData, w);
-        } else {
-            WriteRLEAnimationData(srcanim, destanimdesc, pData, w);
-        }
-
-
-        if ((pData - pStartSection) > g_animblocksize && g_animblocksize > 0) {
-            MdlWarning(
-                    "Single animation \"%s\" is %d. Specificed block size is %d.  Use smaller animations or increase the block size.\n",
-                    srcanim->name, (uintptr_t) (pData - pStartSection), g_animblocksize);
-        }
-
-        // write into anim blocks if needed
-        if (destanimdesc->sectionindex) {
-            if (bUseExtData) {
-                if (g_numanimblocks && pData - g_animblock[g_numanimblocks - 1].start > g_animblocksize) {
-                    // advance to next animblock
-                    g_animblock[g_numanimblocks - 1].end = pStartSection;
-                    g_animblock[g_numanimblocks].start = pStartSection;
-                    g_numanimblocks++;
-                }
-
-                destanimdesc->pSection(w)->animblock = g_numanimblocks - 1;
-                destanimdesc->pSection(w)->animindex = pStartSection - g_animblock[g_numanimblocks - 1].start;
-            } else {
-                destanimdesc->pSection(w)->animblock = 0;
-                destanimdesc->pSection(w)->animindex = pStartSection - (byte *) destanimdesc;
-            }
-            // printf("%s (%d) : %d:%d\n", srcanim->name, w, destanimdesc->pSection(w)->animblock, destanimdesc->pSection(w)->animindex );
-        }
-
-        if (!bUseExtData) {
-            pLocalData = pData;
-        } else {
-            pExtData = pData;
-        }
-    }
-}
-
-
 byte *WriteIkErrors(s_animation_t *srcanim, byte *pData) {
     int j, k;
 
@@ -1498,6 +1448,185 @@ byte *WriteLocalHierarchy(s_animation_t *srcanim, byte *pData) {
 }
 
 
+//-----------------------------------------------------------------------------
+// Animation data is encoded one animation at a time, in parallel, into buffers
+// of its own: one for what stays in the .mdl and one for what goes into the
+// animation blocks. Both start 16 byte aligned, as they are once laid out, and
+// everything in them is self relative, so laying out is just a copy.
+//-----------------------------------------------------------------------------
+struct s_animsection_t {
+    int offset;
+    int size;
+    bool inBlock;
+};
+
+struct s_encodedanim_t {
+    byte *pLocal;
+    byte *pBlock;
+    int localSize;
+    int blockSize;
+    int blockSectionsSize;      // the section data at the start of pBlock
+    int ikOffset;               // ik rules and local hierarchy follow the sections, in pBlock
+    int localHierarchyOffset;   // or in pLocal if the animation isn't demand loaded
+    CUtlVector<s_animsection_t> sections;
+};
+
+
+// Upper bound of what WriteFrameAnimationData / WriteRLEAnimationData write for a section
+static int MaxSectionSize(s_animation_t *srcanim, int w) {
+    int numbones = g_StudioMdlContext.numbones;
+    int bonesize = sizeof(Quaternion48S) + sizeof(Vector);
+
+    if (srcanim->flags & STUDIO_FRAMEANIM) {
+        int iStartFrame, iEndFrame;
+        GetSectionFrames(srcanim, w, iStartFrame, iEndFrame);
+        return sizeof(mstudio_frame_anim_t) + numbones + (iEndFrame - iStartFrame + 2) * numbones * bonesize + 12;
+    }
+
+    int size = sizeof(mstudio_rle_anim_t) + 4;
+    for (int j = 0; j < numbones; j++) {
+        s_compressed_t *psrcdata = &srcanim->anim[w][j];
+        size += sizeof(mstudio_rle_anim_t) + sizeof(Quaternion64) + sizeof(Vector48) + 2 * sizeof(mstudioanim_valueptr_t);
+        for (int k = 0; k < 6; k++) {
+            size += psrcdata->num[k] * sizeof(mstudioanimvalue_t);
+        }
+    }
+    return size;
+}
+
+// Upper bound of what WriteIkErrors and WriteLocalHierarchy write
+static int MaxIkSize(s_animation_t *srcanim) {
+    int size = srcanim->numikrules * sizeof(mstudioikrule_t) + 4;
+    for (int j = 0; j < srcanim->numikrules; j++) {
+        size += sizeof(mstudiocompressedikerror_t) + strlen(srcanim->ikrule[j].attachment) + 1 + 4;
+        for (int k = 0; k < 6; k++) {
+            size += srcanim->ikrule[j].errorData.numanim[k] * sizeof(mstudioanimvalue_t);
+        }
+    }
+
+    size += srcanim->numlocalhierarchy * sizeof(mstudiolocalhierarchy_t) + 4;
+    for (int j = 0; j < srcanim->numlocalhierarchy; j++) {
+        size += sizeof(mstudiocompressedikerror_t) + 4;
+        for (int k = 0; k < 6; k++) {
+            size += srcanim->localhierarchy[j].localData.numanim[k] * sizeof(mstudioanimvalue_t);
+        }
+    }
+    return size;
+}
+
+static byte *AllocEncodeBuffer(int size) {
+    byte *pBuffer = (byte *) MemAlloc_AllocAligned(size, 16);
+    memset(pBuffer, 0, size);
+    return pBuffer;
+}
+
+static void FreeEncodedAnimation(s_encodedanim_t &encoded) {
+    MemAlloc_FreeAligned(encoded.pLocal);
+    MemAlloc_FreeAligned(encoded.pBlock);
+    encoded.pLocal = nullptr;
+    encoded.pBlock = nullptr;
+}
+
+static void EncodeAnimation(s_animation_t *srcanim, s_encodedanim_t &encoded) {
+    // header data stays in the .mdl unless the whole animation is demand loaded
+    bool bLocal = srcanim->disableAnimblocks || srcanim->isFirstSectionLocal;
+
+    encoded.sections.SetCount(srcanim->numsections);
+
+    // The writers don't check bounds, they rely on these buffers being sized from
+    // MaxSectionSize / MaxIkSize. The asserts below catch a bound that is too small.
+    CUtlVector<int> maxSectionSize;
+    maxSectionSize.SetCount(srcanim->numsections);
+    int maxIkSize = MaxIkSize(srcanim);
+    int maxLocalSize = 16;
+    int maxBlockSize = 16;
+    for (int w = 0; w < srcanim->numsections; w++) {
+        s_animsection_t &section = encoded.sections[w];
+        section.inBlock = bWriteAnimBlocks && !srcanim->disableAnimblocks &&
+                          !((w * srcanim->sectionframes < srcanim->numNostallFrames) && srcanim->isFirstSectionLocal);
+        maxSectionSize[w] = MaxSectionSize(srcanim, w);
+        (section.inBlock ? maxBlockSize : maxLocalSize) += maxSectionSize[w];
+    }
+    (bLocal ? maxLocalSize : maxBlockSize) += maxIkSize;
+
+    encoded.pLocal = AllocEncodeBuffer(maxLocalSize);
+    encoded.pBlock = AllocEncodeBuffer(maxBlockSize);
+
+    byte *pLocalData = encoded.pLocal;
+    byte *pBlockData = encoded.pBlock;
+    for (int w = 0; w < srcanim->numsections; w++) {
+        s_animsection_t &section = encoded.sections[w];
+        byte *&pData = section.inBlock ? pBlockData : pLocalData;
+        byte *pStartSection = pData;
+
+        if (srcanim->flags & STUDIO_FRAMEANIM) {
+            WriteFrameAnimationData(srcanim, nullptr, pData, w);
+        } else {
+            WriteRLEAnimationData(srcanim, nullptr, pData, w);
+        }
+
+        section.offset = pStartSection - (section.inBlock ? encoded.pBlock : encoded.pLocal);
+        section.size = pData - pStartSection;
+        Assert(section.size <= maxSectionSize[w]);
+    }
+    encoded.blockSectionsSize = pBlockData - encoded.pBlock;
+
+    byte *&pData = bLocal ? pLocalData : pBlockData;
+    byte *pBase = bLocal ? encoded.pLocal : encoded.pBlock;
+    encoded.ikOffset = pData - pBase;
+    pData = WriteIkErrors(srcanim, pData);
+    encoded.localHierarchyOffset = pData - pBase;
+    pData = WriteLocalHierarchy(srcanim, pData);
+    Assert(pData - (pBase + encoded.ikOffset) <= maxIkSize);
+
+    encoded.localSize = pLocalData - encoded.pLocal;
+    encoded.blockSize = pBlockData - encoded.pBlock;
+}
+
+static void EncodeAnimations(int iFirst, int nCount, CUtlVector<s_encodedanim_t> &encoded) {
+    int nThreadCount = MIN((int) std::thread::hardware_concurrency(), nCount);
+
+    std::atomic<int> nNext(0);
+    auto encodeThread = [&]() {
+        for (int i = nNext++; i < nCount; i = nNext++) {
+            EncodeAnimation(g_panimation[iFirst + i], encoded[i]);
+        }
+    };
+
+    CUtlVector<std::thread *> threads;
+    for (int i = 1; i < nThreadCount; ++i) {
+        threads.AddToTail(new std::thread(encodeThread));
+    }
+    encodeThread();
+    for (int i = 0; i < threads.Count(); ++i) {
+        threads[i]->join();
+        delete threads[i];
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+// Appends data to the .ani file at nOffset, zero filling any gap before it
+//-----------------------------------------------------------------------------
+static void WriteAnimBlockData(const void *pBuffer, int nOffset, int nSize) {
+    static byte s_Zero[16];
+
+    if (!blockouthandle)
+        return;
+
+    Assert(nOffset >= nBlockWritten);
+    while (nBlockWritten < nOffset) {
+        int nPad = MIN(nOffset - nBlockWritten, (int) sizeof(s_Zero));
+        SafeWrite(blockouthandle, s_Zero, nPad);
+        nBlockWritten += nPad;
+    }
+    if (nSize) {
+        SafeWrite(blockouthandle, (void *) pBuffer, nSize);
+        nBlockWritten += nSize;
+    }
+}
+
+
 static byte *WriteAnimations(byte *pData, byte *pStart, studiohdr_t *phdr) {
     int i, j;
 
@@ -1516,11 +1645,48 @@ static byte *WriteAnimations(byte *pData, byte *pStart, studiohdr_t *phdr) {
         printf("   animation       x       y       ips    angle\n");
     }
 
+    // decide where each animation's data goes before encoding it
     for (i = 0; i < g_numani; i++) {
         s_animation_t *srcanim = g_panimation[i];
-        mstudioanimdesc_t *destanim = &panimdesc[i];
         Assert(srcanim);
 
+        if (!bWriteAnimBlocks || (g_bonesaveframe.Count() == 0 && srcanim->numframes == 1)) {
+            // hack
+            srcanim->disableAnimblocks = true;
+        } else if (g_StudioMdlContext.noAnimblockStall) {
+            srcanim->isFirstSectionLocal = true;
+        }
+
+        // make sure number of preload frames is initialized
+        if (srcanim->numNostallFrames == 0) {
+            srcanim->numNostallFrames = srcanim->fps * g_StudioMdlContext.preloadTime;
+        }
+
+        // use frameanim if not lowres data
+        if (bWriteAnimBlocks && !g_StudioMdlContext.animblockLowRes) {
+            srcanim->flags |= STUDIO_FRAMEANIM;
+        }
+    }
+
+    // a few animations per thread are encoded at a time, then laid out and streamed out in order
+    int nEncodeCount = MAX((int) std::thread::hardware_concurrency(), 1) * 2;
+    CUtlVector<s_encodedanim_t> encoded;
+    encoded.SetCount(nEncodeCount);
+
+    // ik rules of demand loaded animations, for the zero frames
+    CUtlVector<byte> blockIkRules;
+    CUtlVector<int> blockIkRuleIndex;
+    blockIkRuleIndex.SetCount(g_numani);
+
+    for (i = 0; i < g_numani; i++) {
+        s_animation_t *srcanim = g_panimation[i];
+        mstudioanimdesc_t *destanim = &panimdesc[i];
+
+        if (i % nEncodeCount == 0) {
+            EncodeAnimations(i, MIN(nEncodeCount, g_numani - i), encoded);
+        }
+        s_encodedanim_t &enc = encoded[i % nEncodeCount];
+
         AddToStringTable(destanim, &destanim->sznameindex, srcanim->name);
 
         destanim->baseptr = pStart - (byte *) destanim;
@@ -1562,90 +1728,110 @@ static byte *WriteAnimations(byte *pData, byte *pStart, studiohdr_t *phdr) {
 
         // align all animation data to cache line boundaries
         ALIGN16(pData);
-        ALIGN16(pBlockData);
+        nBlockData = (nBlockData + 15) & ~15;
 
-        if (pBlockStart) {
+        if (bWriteAnimBlocks) {
             // allocate the first block if needed
             if (g_numanimblocks == 0) {
                 g_numanimblocks = 1;
-                g_animblock[g_numanimblocks].start = pBlockData;
+                g_animblock[g_numanimblocks].start = nBlockData;
                 g_numanimblocks++;
             }
         }
 
-        if (!pBlockStart || (g_bonesaveframe.Count() == 0 && srcanim->numframes == 1)) {
-            // hack
-            srcanim->disableAnimblocks = true;
-        } else if (g_StudioMdlContext.noAnimblockStall) {
-            srcanim->isFirstSectionLocal = true;
-        }
+        byte *pLocalData = pData;
+        memcpy(pLocalData, enc.pLocal, enc.localSize);
+        pData += enc.localSize;
 
-        // make sure number of preload frames is initialized
-        if (srcanim->numNostallFrames == 0) {
-            srcanim->numNostallFrames = srcanim->fps * g_StudioMdlContext.preloadTime;
-        }
+        int nBlockStart = nBlockData;
+        int nBlockEnd = nBlockStart + enc.blockSize;
+
+        for (int w = 0; w < srcanim->numsections; w++) {
+            const s_animsection_t &section = enc.sections[w];
+
+            if (section.size > g_animblocksize && g_animblocksize > 0) {
+                MdlWarning(
+                        "Single animation \"%s\" is %d. Specificed block size is %d.  Use smaller animations or increase the block size.\n",
+                        srcanim->name, section.size, g_animblocksize);
+            }
 
-        // block zero is relative to me
-        g_animblock[0].start = (byte *) (destanim);
+            // write into anim blocks if needed
+            if (destanim->sectionindex) {
+                if (section.inBlock) {
+                    int nStartSection = nBlockStart + section.offset;
+                    if (g_numanimblocks &&
+                        nStartSection + section.size - g_animblock[g_numanimblocks - 1].start > g_animblocksize) {
+                        // advance to next animblock
+                        g_animblock[g_numanimblocks - 1].end = nStartSection;
+                        g_animblock[g_numanimblocks].start = nStartSection;
+                        g_numanimblocks++;
+                    }
 
-        byte *pAnimData = nullptr;
-        byte *pIkData = nullptr;
-        byte *pLocalHierarchy = nullptr;
-        byte *pBlockEnd = pBlockData;
+                    destanim->pSection(w)->animblock = g_numanimblocks - 1;
+                    destanim->pSection(w)->animindex = nStartSection - g_animblock[g_numanimblocks - 1].start;
+                } else {
+                    destanim->pSection(w)->animblock = 0;
+                    destanim->pSection(w)->animindex = pLocalData + section.offset - (byte *) destanim;
+                }
+                // printf("%s (%d) : %d:%d\n", srcanim->name, w, destanim->pSection(w)->animblock, destanim->pSection(w)->animindex );
+            }
+        }
 
         if (srcanim->disableAnimblocks || srcanim->isFirstSectionLocal) {
+            // block zero is relative to me
             destanim->animblock = 0;
-            pAnimData = pData;
-            WriteAnimationData(srcanim, destanim, pData, pBlockEnd);
-            pIkData = pData;
-            pLocalHierarchy = WriteIkErrors(srcanim, pIkData);
-            pData = WriteLocalHierarchy(srcanim, pLocalHierarchy);
+            destanim->animindex = pLocalData - (byte *) destanim;
+
+            if (srcanim->numikrules) {
+                destanim->numikrules = srcanim->numikrules;
+                destanim->ikruleindex = pLocalData + enc.ikOffset - (byte *) destanim;
+            }
+            if (srcanim->numlocalhierarchy) {
+                destanim->numlocalhierarchy = srcanim->numlocalhierarchy;
+                destanim->localhierarchyindex = pLocalData + enc.localHierarchyOffset - (byte *) destanim;
+            }
         } else {
-            pAnimData = pBlockEnd;
-            WriteAnimationData(srcanim, destanim, pData, pBlockEnd);
             if (destanim->sectionindex) {
                 // if sections were written, don't move the data already written to the last block
-                pBlockData = pBlockEnd;
+                nBlockData = nBlockStart + enc.blockSectionsSize;
             }
             destanim->animblock = g_numanimblocks - 1;
-            pIkData = pBlockEnd;
-            pLocalHierarchy = WriteIkErrors(srcanim, pIkData);
-            pBlockEnd = WriteLocalHierarchy(srcanim, pLocalHierarchy);
-        }
 
-        // printf("%d %x %x %x   %s : %d\n", g_numanimblocks - 1, g_animblock[g_numanimblocks-1].start, pBlockData, pBlockEnd, srcanim->name, srcanim->numsections );
+            // printf("%d %x %x %x   %s : %d\n", g_numanimblocks - 1, g_animblock[g_numanimblocks-1].start, nBlockData, nBlockEnd, srcanim->name, srcanim->numsections );
 
-        if (pBlockData != pBlockEnd && pBlockEnd - g_animblock[g_numanimblocks - 1].start > g_animblocksize) {
-            g_animblock[g_numanimblocks - 1].end = pBlockData;
-            g_animblock[g_numanimblocks].start = pBlockData;
-            g_numanimblocks++;
-            destanim->animblock = g_numanimblocks - 1;
-        }
+            if (nBlockData != nBlockEnd && nBlockEnd - g_animblock[g_numanimblocks - 1].start > g_animblocksize) {
+                g_animblock[g_numanimblocks - 1].end = nBlockData;
+                g_animblock[g_numanimblocks].start = nBlockData;
+                g_numanimblocks++;
+                destanim->animblock = g_numanimblocks - 1;
+            }
 
-        destanim->animindex = pAnimData - g_animblock[destanim->animblock].start;
+            int nBlockBase = g_animblock[destanim->animblock].start;
+            destanim->animindex = nBlockStart - nBlockBase;
 
-        if (srcanim->numikrules) {
-            destanim->numikrules = srcanim->numikrules;
-            if (destanim->animblock == 0) {
-                destanim->ikruleindex = pIkData - g_animblock[destanim->animblock].start;
-            } else {
-                destanim->animblockikruleindex = pIkData - g_animblock[destanim->animblock].start;
+            if (srcanim->numikrules) {
+                destanim->numikrules = srcanim->numikrules;
+                destanim->animblockikruleindex = nBlockStart + enc.ikOffset - nBlockBase;
+
+                blockIkRuleIndex[i] = blockIkRules.AddMultipleToTail(srcanim->numikrules * sizeof(mstudioikrule_t),
+                                                                     enc.pBlock + enc.ikOffset);
+            }
+            if (srcanim->numlocalhierarchy) {
+                destanim->numlocalhierarchy = srcanim->numlocalhierarchy;
+                destanim->localhierarchyindex = nBlockStart + enc.localHierarchyOffset - nBlockBase;
             }
-        }
-        if (srcanim->numlocalhierarchy) {
-            destanim->numlocalhierarchy = srcanim->numlocalhierarchy;
-            destanim->localhierarchyindex = pLocalHierarchy - g_animblock[destanim->animblock].start;
         }
 
         if (g_numanimblocks) {
-            g_animblock[g_numanimblocks - 1].end = pBlockEnd;
-            pBlockData = pBlockEnd;
+            g_animblock[g_numanimblocks - 1].end = nBlockEnd;
+            nBlockData = nBlockEnd;
         }
 
-        // printf("%s : %d:%d\n", srcanim->name, destanim->animblock, destanim->animindex );
+        // the block data won't move anymore, send it on its way
+        WriteAnimBlockData(enc.pBlock, nBlockStart, enc.blockSize);
+        FreeEncodedAnimation(enc);
 
-        //if (pData != pAStart)
-        //	printf("extra %d : %s\n", pData - (byte *)pAStart, srcanim->name);
+        // printf("%s : %d:%d\n", srcanim->name, destanim->animblock, destanim->animindex );
     }
 
     if (!g_StudioMdlContext.quiet) {
@@ -1691,7 +1877,7 @@ static byte *WriteAnimations(byte *pData, byte *pStart, studiohdr_t *phdr) {
     }
 
     // only write zero frames if the animation data is demand loaded
-    if (!pBlockStart)
+    if (!bWriteAnimBlocks)
         return pData;
 
 
@@ -1816,8 +2002,8 @@ static byte *WriteAnimations(byte *pData, byte *pStart, studiohdr_t *phdr) {
                 if (destanim->ikruleindex) {
                     psrcikrule = (mstudioikrule_t *) ((byte *) destanim + destanim->ikruleindex);
                 } else {
-                    psrcikrule = (mstudioikrule_t *) (g_animblock[destanim->animblock].start +
-                                                      destanim->animblockikruleindex);
+                    // the block itself has already been written out
+                    psrcikrule = (mstudioikrule_t *) &blockIkRules[blockIkRuleIndex[i]];
                 }
 
                 for (j = 0; j < destanim->numikrules; j++, psrcikrule++, pdestikrule++) {
@@ -2218,6 +2404,7 @@ static void WriteVertices(studiohdr_t *phdr) {
     {
 //		CP4AutoEditAddFile autop4( fileName );
         SaveFile(fileName, pStart, pData - pStart);
+        Manifest_AddOutput(fileName);
     }
 }
 
@@ -2831,8 +3018,8 @@ static void WriteModel(studiohdr_t *phdr) {
     ALIGN4(pData);
 
     for (i = 1; i < g_numanimblocks; i++) {
-        panimblock[i].datastart = g_animblock[i].start - pBlockStart;
-        panimblock[i].dataend = g_animblock[i].end - pBlockStart;
+        panimblock[i].datastart = g_animblock[i].start;
+        panimblock[i].dataend = g_animblock[i].end;
         // printf("block %d : %x %x (%d)\n", i, panimblock[i].datastart, panimblock[i].dataend, panimblock[i].dataend - panimblock[i].datastart );
     }
     AddToStringTable(phdr, &phdr->szanimblocknameindex, g_animblockname);
@@ -3008,18 +3195,19 @@ void EnsureFileDirectoryExists(const char *pFilename) {
 
 void WriteModelFiles() {
     FileHandle_t modelouthandle = 0;
-    FileHandle_t blockouthandle = 0;
 //	CPlainAutoPtr< CP4File > spFileBlockOut, spFileModelOut;
     int total = 0;
     int i;
     char filename[260];
     studiohdr_t *phdr;
-    studiohdr_t *pblockhdr = 0;
+    studiohdr_t blockhdr;
 
     pStart = (byte *) kalloc(1, FILEBUFFER);
 
-    pBlockData = nullptr;
-    pBlockStart = nullptr;
+    bWriteAnimBlocks = false;
+    nBlockData = 0;
+    nBlockWritten = 0;
+    blockouthandle = 0;
 
     Q_StripExtension(g_outname, g_outname, sizeof(g_outname));
 
@@ -3041,16 +3229,19 @@ void WriteModelFiles() {
 //			spFileBlockOut.Attach( g_p4factory->AccessFile( filename ) );
 //			spFileBlockOut->Edit();
             blockouthandle = SafeOpenWrite(filename);
+            Manifest_AddOutput(filename);
         }
 
-        pBlockStart = (byte *) kalloc(1, FILEBUFFER);
-        pBlockData = pBlockStart;
+        bWriteAnimBlocks = true;
 
-        pblockhdr = (studiohdr_t *) pBlockData;
-        pblockhdr->id = IDSTUDIOANIMGROUPHEADER;
-        pblockhdr->version = STUDIO_VERSION;
+        // the blocks are streamed out as the animations are laid out, the header's length
+        // gets filled in once they're all written
+        memset(&blockhdr, 0, sizeof(blockhdr));
+        blockhdr.id = IDSTUDIOANIMGROUPHEADER;
+        blockhdr.version = STUDIO_VERSION;
 
-        pBlockData += sizeof(*pblockhdr);
+        WriteAnimBlockData(&blockhdr, 0, sizeof(blockhdr));
+        nBlockData = sizeof(blockhdr);
     }
 
 //
@@ -3098,6 +3289,7 @@ void WriteModelFiles() {
 //		spFileModelOut.Attach( g_p4factory->AccessFile( filename ) );
 //		spFileModelOut->Edit();
         modelouthandle = SafeOpenWrite(filename);
+        Manifest_AddOutput(filename);
     }
 
     phdr->eyeposition = eyeposition;
@@ -3253,10 +3445,13 @@ void WriteModelFiles() {
     g_pFileSystem->Close(modelouthandle);
 //	if ( spFileModelOut.IsValid() ) spFileModelOut->Add();
 
-    if (pBlockStart) {
-        pblockhdr->length = pBlockData - pBlockStart;
+    if (bWriteAnimBlocks) {
+        // pad out to the end of the last block
+        WriteAnimBlockData(nullptr, nBlockData, 0);
 
-        SafeWrite(blockouthandle, pBlockStart, pblockhdr->length);
+        blockhdr.length = nBlockData;
+        g_pFileSystem->Seek(blockouthandle, 0, FILESYSTEM_SEEK_HEAD);
+        SafeWrite(blockouthandle, &blockhdr, sizeof(blockhdr));
         g_pFileSystem->Close(blockouthandle);
 //		if ( spFileBlockOut.IsValid() ) spFileBlockOut->Add();
 
@@ -3265,7 +3460,7 @@ void WriteModelFiles() {
             printf("---------------------\n");
             printf("writing %s:\n", g_animblockname);
             printf("blocks	   %7d\n", g_numanimblocks);
-            printf("total      %7d\n", pblockhdr->length);
+            printf("total      %7d\n", blockhdr.length);
         }
     }
 
@@ -4714,6 +4909,7 @@ void WriteSwappedFile(char *srcname, char *outname, int(*pfnSwapFunc)(void *, in
 
         if (bytes != 0) {
             SaveFile(outname, pOutBase, bytes);
+            Manifest_AddOutput(outname);
         }
 
         free(pOutBase);